@@ -35,6 +35,24 @@ static void ensure_config_dir_exists(void) {
     g_free(config_dir);
 }
 
+static gboolean get_boolean_with_default(GKeyFile *keyfile, const gchar *group,
+                                         const gchar *key, gboolean default_value) {
+    if (!g_key_file_has_key(keyfile, group, key, NULL)) return default_value;
+    return g_key_file_get_boolean(keyfile, group, key, NULL);
+}
+
+static gdouble get_double_with_default(GKeyFile *keyfile, const gchar *group,
+                                       const gchar *key, gdouble default_value) {
+    if (!g_key_file_has_key(keyfile, group, key, NULL)) return default_value;
+    return g_key_file_get_double(keyfile, group, key, NULL);
+}
+
+static gint get_integer_with_default(GKeyFile *keyfile, const gchar *group,
+                                     const gchar *key, gint default_value) {
+    if (!g_key_file_has_key(keyfile, group, key, NULL)) return default_value;
+    return g_key_file_get_integer(keyfile, group, key, NULL);
+}
+
 static void create_default_config(const gchar *config_path) {
     GKeyFile *keyfile = g_key_file_new();
 
@@ -45,7 +63,10 @@ static void create_default_config(const gchar *config_path) {
     g_key_file_set_string(keyfile, "openai", "api_key", "your_openai_api_key_here");
     g_key_file_set_string(keyfile, "openai", "model", DEFAULT_MODEL);
     g_key_file_set_string(keyfile, "openai", "system_prompt", "You are a helpful email writing assistant.");
+    g_key_file_set_boolean(keyfile, "openai", "stream", TRUE);
     g_key_file_set_string(keyfile, "ui", "hotkey", DEFAULT_HOTKEY);
+    g_key_file_set_boolean(keyfile, "cache", "stale_while_revalidate", TRUE);
+    g_key_file_set_double(keyfile, "cache", "min_similarity", DEFAULT_SWR_MIN_SIMILARITY);
 
     gchar *content = g_key_file_to_data(keyfile, NULL, NULL);
     g_file_set_contents(config_path, content, -1, NULL);
@@ -80,7 +101,51 @@ PluginConfig* config_load(void) {
     config->openai_api_key = g_key_file_get_string(keyfile, "openai", "api_key", NULL);
     config->model = g_key_file_get_string(keyfile, "openai", "model", NULL);
     config->system_prompt = g_key_file_get_string(keyfile, "openai", "system_prompt", NULL);
+    config->stream_responses = get_boolean_with_default(keyfile, "openai", "stream", TRUE);
+    config->max_tokens = get_integer_with_default(keyfile, "openai", "max_tokens", DEFAULT_MAX_TOKENS);
     config->hotkey = g_key_file_get_string(keyfile, "ui", "hotkey", NULL);
+    config->stale_while_revalidate =
+        get_boolean_with_default(keyfile, "cache", "stale_while_revalidate", TRUE);
+    config->swr_min_similarity =
+        get_double_with_default(keyfile, "cache", "min_similarity", DEFAULT_SWR_MIN_SIMILARITY);
+    config->cache_pack_dir = g_key_file_get_string(keyfile, "cache", "pack_dir", NULL);
+    config->canned_dir = g_key_file_get_string(keyfile, "canned", "dir", NULL);
+    config->canned_instant_score =
+        get_double_with_default(keyfile, "canned", "instant_score", DEFAULT_CANNED_INSTANT_SCORE);
+    config->canned_grounding_score =
+        get_double_with_default(keyfile, "canned", "grounding_score", DEFAULT_CANNED_GROUNDING_SCORE);
+    config->triage_enabled = get_boolean_with_default(keyfile, "triage", "enabled", FALSE);
+    config->triage_training_dir = g_key_file_get_string(keyfile, "triage", "training_dir", NULL);
+    config->triage_reply_label = g_key_file_get_string(keyfile, "triage", "reply_label", NULL);
+    config->triage_min_confidence =
+        get_double_with_default(keyfile, "triage", "min_confidence", DEFAULT_TRIAGE_MIN_CONFIDENCE);
+    config->compression_enabled = get_boolean_with_default(keyfile, "compression", "enabled", FALSE);
+    config->compression_ratio =
+        get_double_with_default(keyfile, "compression", "target_ratio", DEFAULT_COMPRESSION_RATIO);
+    config->boilerplate_enabled = get_boolean_with_default(keyfile, "boilerplate", "enabled", TRUE);
+    config->boilerplate_min_messages =
+        get_integer_with_default(keyfile, "boilerplate", "min_messages", DEFAULT_BOILERPLATE_MIN_MESSAGES);
+    config->attachments_enabled = get_boolean_with_default(keyfile, "attachments", "enabled", FALSE);
+    config->attachment_max_tokens =
+        get_integer_with_default(keyfile, "attachments", "max_tokens", DEFAULT_ATTACHMENT_MAX_TOKENS);
+    config->realtime_enabled = get_boolean_with_default(keyfile, "realtime", "enabled", FALSE);
+    config->realtime_url = g_key_file_get_string(keyfile, "realtime", "url", NULL);
+    config->realtime_model = g_key_file_get_string(keyfile, "realtime", "model", NULL);
+    config->draft_model = g_key_file_get_string(keyfile, "refine", "draft_model", NULL);
+    config->model_endpoints = g_key_file_get_string_list(keyfile, "models", "endpoints", NULL, NULL);
+    config->tools_enabled = get_boolean_with_default(keyfile, "tools", "enabled", FALSE);
+    config->tools_cache_ttl =
+        get_integer_with_default(keyfile, "tools", "cache_ttl", DEFAULT_TOOLS_CACHE_TTL_S);
+    config->smart_reply_enabled = get_boolean_with_default(keyfile, "smart_reply", "enabled", FALSE);
+    config->smart_reply_model = g_key_file_get_string(keyfile, "smart_reply", "model", NULL);
+    config->metrics_textfile = g_key_file_get_string(keyfile, "metrics", "textfile", NULL);
+    config->metrics_interval =
+        get_integer_with_default(keyfile, "metrics", "interval", DEFAULT_METRICS_INTERVAL_S);
+    config->budget_daily = get_double_with_default(keyfile, "budget", "daily", 0.0);
+    config->budget_monthly = get_double_with_default(keyfile, "budget", "monthly", 0.0);
+    config->budget_fallback_model = g_key_file_get_string(keyfile, "budget", "fallback_model", NULL);
+    config->review_enabled = get_boolean_with_default(keyfile, "review", "enabled", FALSE);
+    config->review_model = g_key_file_get_string(keyfile, "review", "model", NULL);
 
     if (!config->model) {
         config->model = g_strdup(DEFAULT_MODEL);
@@ -90,10 +155,34 @@ PluginConfig* config_load(void) {
         config->hotkey = g_strdup(DEFAULT_HOTKEY);
     }
 
+    if (!config->smart_reply_model) {
+        config->smart_reply_model = g_strdup(DEFAULT_SMART_REPLY_MODEL);
+    }
+
+    if (!config->budget_fallback_model) {
+        config->budget_fallback_model = g_strdup(DEFAULT_BUDGET_FALLBACK_MODEL);
+    }
+
+    if (!config->review_model) {
+        config->review_model = g_strdup(DEFAULT_REVIEW_MODEL);
+    }
+
     if (!config->system_prompt) {
         config->system_prompt = g_strdup("You are a helpful email writing assistant.");
     }
 
+    if (!config->triage_reply_label) {
+        config->triage_reply_label = g_strdup(DEFAULT_TRIAGE_REPLY_LABEL);
+    }
+
+    if (!config->realtime_url) {
+        config->realtime_url = g_strdup(DEFAULT_REALTIME_URL);
+    }
+
+    if (!config->realtime_model) {
+        config->realtime_model = g_strdup(DEFAULT_REALTIME_MODEL);
+    }
+
     g_key_file_free(keyfile);
     g_free(config_path);
 
@@ -107,9 +196,47 @@ void config_free(PluginConfig *config) {
     g_free(config->model);
     g_free(config->hotkey);
     g_free(config->system_prompt);
+    g_free(config->cache_pack_dir);
+    g_free(config->canned_dir);
+    g_free(config->triage_training_dir);
+    g_free(config->triage_reply_label);
+    g_free(config->realtime_url);
+    g_free(config->realtime_model);
+    g_free(config->draft_model);
+    g_strfreev(config->model_endpoints);
+    g_free(config->smart_reply_model);
+    g_free(config->metrics_textfile);
+    g_free(config->budget_fallback_model);
+    g_free(config->review_model);
     g_free(config);
 }
 
+PluginConfig* config_copy(PluginConfig *config) {
+    if (!config) return NULL;
+
+    PluginConfig *copy = g_new(PluginConfig, 1);
+    *copy = *config;
+
+    copy->openai_api_key = g_strdup(config->openai_api_key);
+    copy->model = g_strdup(config->model);
+    copy->hotkey = g_strdup(config->hotkey);
+    copy->system_prompt = g_strdup(config->system_prompt);
+    copy->cache_pack_dir = g_strdup(config->cache_pack_dir);
+    copy->canned_dir = g_strdup(config->canned_dir);
+    copy->triage_training_dir = g_strdup(config->triage_training_dir);
+    copy->triage_reply_label = g_strdup(config->triage_reply_label);
+    copy->realtime_url = g_strdup(config->realtime_url);
+    copy->realtime_model = g_strdup(config->realtime_model);
+    copy->draft_model = g_strdup(config->draft_model);
+    copy->model_endpoints = g_strdupv(config->model_endpoints);
+    copy->smart_reply_model = g_strdup(config->smart_reply_model);
+    copy->metrics_textfile = g_strdup(config->metrics_textfile);
+    copy->budget_fallback_model = g_strdup(config->budget_fallback_model);
+    copy->review_model = g_strdup(config->review_model);
+
+    return copy;
+}
+
 gboolean config_is_valid(PluginConfig *config) {
     if (!config) return FALSE;
 
@@ -135,8 +262,63 @@ gboolean config_save(PluginConfig *config) {
                           config->model ? config->model : DEFAULT_MODEL);
     g_key_file_set_string(keyfile, "openai", "system_prompt",
                           config->system_prompt ? config->system_prompt : "You are a helpful email writing assistant.");
+    g_key_file_set_boolean(keyfile, "openai", "stream", config->stream_responses);
+    g_key_file_set_integer(keyfile, "openai", "max_tokens", config->max_tokens);
     g_key_file_set_string(keyfile, "ui", "hotkey",
                           config->hotkey ? config->hotkey : DEFAULT_HOTKEY);
+    g_key_file_set_boolean(keyfile, "cache", "stale_while_revalidate",
+                           config->stale_while_revalidate);
+    g_key_file_set_double(keyfile, "cache", "min_similarity", config->swr_min_similarity);
+    if (config->cache_pack_dir) {
+        g_key_file_set_string(keyfile, "cache", "pack_dir", config->cache_pack_dir);
+    }
+    if (config->canned_dir) {
+        g_key_file_set_string(keyfile, "canned", "dir", config->canned_dir);
+    }
+    g_key_file_set_double(keyfile, "canned", "instant_score", config->canned_instant_score);
+    g_key_file_set_double(keyfile, "canned", "grounding_score", config->canned_grounding_score);
+    g_key_file_set_boolean(keyfile, "triage", "enabled", config->triage_enabled);
+    if (config->triage_training_dir) {
+        g_key_file_set_string(keyfile, "triage", "training_dir", config->triage_training_dir);
+    }
+    g_key_file_set_string(keyfile, "triage", "reply_label",
+                          config->triage_reply_label ? config->triage_reply_label : DEFAULT_TRIAGE_REPLY_LABEL);
+    g_key_file_set_double(keyfile, "triage", "min_confidence", config->triage_min_confidence);
+    g_key_file_set_boolean(keyfile, "compression", "enabled", config->compression_enabled);
+    g_key_file_set_double(keyfile, "compression", "target_ratio", config->compression_ratio);
+    g_key_file_set_boolean(keyfile, "boilerplate", "enabled", config->boilerplate_enabled);
+    g_key_file_set_integer(keyfile, "boilerplate", "min_messages", config->boilerplate_min_messages);
+    g_key_file_set_boolean(keyfile, "attachments", "enabled", config->attachments_enabled);
+    g_key_file_set_integer(keyfile, "attachments", "max_tokens", config->attachment_max_tokens);
+    g_key_file_set_boolean(keyfile, "realtime", "enabled", config->realtime_enabled);
+    g_key_file_set_string(keyfile, "realtime", "url",
+                          config->realtime_url ? config->realtime_url : DEFAULT_REALTIME_URL);
+    g_key_file_set_string(keyfile, "realtime", "model",
+                          config->realtime_model ? config->realtime_model : DEFAULT_REALTIME_MODEL);
+    if (config->draft_model) {
+        g_key_file_set_string(keyfile, "refine", "draft_model", config->draft_model);
+    }
+    if (config->model_endpoints) {
+        g_key_file_set_string_list(keyfile, "models", "endpoints",
+                                   (const gchar * const *)config->model_endpoints,
+                                   g_strv_length(config->model_endpoints));
+    }
+    g_key_file_set_boolean(keyfile, "tools", "enabled", config->tools_enabled);
+    g_key_file_set_integer(keyfile, "tools", "cache_ttl", config->tools_cache_ttl);
+    g_key_file_set_boolean(keyfile, "smart_reply", "enabled", config->smart_reply_enabled);
+    g_key_file_set_string(keyfile, "smart_reply", "model",
+                          config->smart_reply_model ? config->smart_reply_model : DEFAULT_SMART_REPLY_MODEL);
+    if (config->metrics_textfile) {
+        g_key_file_set_string(keyfile, "metrics", "textfile", config->metrics_textfile);
+    }
+    g_key_file_set_integer(keyfile, "metrics", "interval", config->metrics_interval);
+    g_key_file_set_double(keyfile, "budget", "daily", config->budget_daily);
+    g_key_file_set_double(keyfile, "budget", "monthly", config->budget_monthly);
+    g_key_file_set_string(keyfile, "budget", "fallback_model",
+                          config->budget_fallback_model ? config->budget_fallback_model : DEFAULT_BUDGET_FALLBACK_MODEL);
+    g_key_file_set_boolean(keyfile, "review", "enabled", config->review_enabled);
+    g_key_file_set_string(keyfile, "review", "model",
+                          config->review_model ? config->review_model : DEFAULT_REVIEW_MODEL);
 
     gchar *content = g_key_file_to_data(keyfile, NULL, NULL);
     gboolean result = g_file_set_contents(config_path, content, -1, NULL);
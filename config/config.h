@@ -17,17 +17,73 @@
 #define CONFIG_DIR_NAME "evolution-llm-assistant"
 #define CONFIG_FILE_NAME "config.conf"
 #define DEFAULT_MODEL "gpt-4o-mini"
+#define DEFAULT_MAX_TOKENS 500
+#define OPENAI_API_BASE "https://api.openai.com/v1"
 #define DEFAULT_HOTKEY "ctrl+shift+g"
+#define DEFAULT_SWR_MIN_SIMILARITY 0.6
+#define DEFAULT_CANNED_INSTANT_SCORE 0.6
+#define DEFAULT_CANNED_GROUNDING_SCORE 0.2
+#define DEFAULT_TRIAGE_REPLY_LABEL "reply"
+#define DEFAULT_TRIAGE_MIN_CONFIDENCE 0.8
+#define DEFAULT_COMPRESSION_RATIO 0.3
+#define DEFAULT_BOILERPLATE_MIN_MESSAGES 3
+#define DEFAULT_ATTACHMENT_MAX_TOKENS 2000
+#define DEFAULT_REALTIME_URL "wss://api.openai.com/v1/realtime"
+#define DEFAULT_REALTIME_MODEL "gpt-4o-realtime-preview"
+#define DEFAULT_TOOLS_CACHE_TTL_S 60
+#define DEFAULT_SMART_REPLY_MODEL "gpt-4o-mini"
+#define DEFAULT_METRICS_INTERVAL_S 15
+#define DEFAULT_BUDGET_FALLBACK_MODEL "gpt-4o-mini"
+#define DEFAULT_REVIEW_MODEL "gpt-4o-mini"
 
 typedef struct {
     gchar *openai_api_key;
     gchar *model;
     gchar *hotkey;
     gchar *system_prompt;
+    gboolean stream_responses; /* show the response in the composer as it is generated */
+    gint max_tokens;           /* longest answer a request may get */
+    gboolean stale_while_revalidate;
+    gdouble swr_min_similarity;
+    gchar *cache_pack_dir; /* shared directory of read-only *.llmpack files */
+    gchar *canned_dir;     /* directory of canned answers, one per file */
+    gdouble canned_instant_score;
+    gdouble canned_grounding_score;
+    gboolean triage_enabled;
+    gchar *triage_training_dir; /* one subdirectory of messages per label */
+    gchar *triage_reply_label;  /* label of mail that is worth a generation */
+    gdouble triage_min_confidence;
+    gboolean compression_enabled;
+    gdouble compression_ratio; /* fraction of words that may be pruned */
+    gboolean boilerplate_enabled;
+    gint boilerplate_min_messages; /* messages a footer must appear in before it is stripped */
+    gboolean attachments_enabled;
+    gint attachment_max_tokens;    /* budget for text taken from the replied-to message's attachments */
+    gboolean realtime_enabled;     /* generate over a persistent WebSocket session */
+    gchar *realtime_url;
+    gchar *realtime_model;
+    gchar *draft_model;            /* fast model that streams a first draft while model writes the answer */
+    gchar **model_endpoints;       /* extra OpenAI-compatible API base URLs, e.g. a local server */
+    gboolean tools_enabled;        /* let the model query calendars and address books */
+    gint tools_cache_ttl;          /* seconds a tool result is reused */
+    gboolean smart_reply_enabled;  /* suggest replies above the message in the reader */
+    gchar *smart_reply_model;      /* small model that writes the suggestions */
+    gchar *metrics_textfile;       /* OpenMetrics file for node_exporter's textfile collector */
+    gint metrics_interval;         /* seconds between writes of metrics_textfile */
+    gdouble budget_daily;          /* US dollars a day; 0 for no limit */
+    gdouble budget_monthly;        /* US dollars a calendar month; 0 for no limit */
+    gchar *budget_fallback_model;  /* cheaper model used when a budget is nearly spent */
+    gboolean review_enabled;       /* check tone and completeness of the draft while it is written */
+    gchar *review_model;           /* model that reviews the draft's paragraphs */
 } PluginConfig;
 
 PluginConfig* config_load(void);
 void config_free(PluginConfig *config);
+
+/**
+ * Deep copy of a configuration, for a thread that must not see it change
+ */
+PluginConfig* config_copy(PluginConfig *config);
 gboolean config_is_valid(PluginConfig *config);
 gchar* config_get_file_path(void);
 gboolean config_save(PluginConfig *config);
@@ -14,9 +14,20 @@
  */
 
 #include "evolution-llm-extension.h"
+#include "evolution-llm-reader-extension.h"
 #include "llm-preferences-dialog.h"
+#include "llm-history-popup.h"
+#include "llm_compress.h"
+#include "llm_metrics.h"
+#include "llm_boilerplate.h"
+#include "llm_html.h"
+#include "llm_attachment.h"
+#include "llm_catalog.h"
+#include "llm_bench.h"
+#include "llm_rewrite.h"
 #include <gmodule.h>
 #include <gdk/gdkkeysyms.h>
+#include <json-glib/json-glib.h>
 
 G_DEFINE_DYNAMIC_TYPE_EXTENDED(ELLMExtension, e_llm_extension, E_TYPE_EXTENSION, 0,
     G_ADD_PRIVATE_DYNAMIC(ELLMExtension))
@@ -25,12 +36,35 @@ typedef struct {
     ELLMExtension *extension;
     gchar *prompt;
     gchar *original_text;
+    LLMRequest *request;
+    WebKitWebView *web_view;
+    GtkWidget *progress_dialog;
+    gchar *draft_id; /* id of the provisional draft element, if one was shown */
+    gboolean draft_from_cache; /* the draft holds a cached answer */
+    LLMTokenQueue *token_queue; /* streamed tokens from the worker thread */
+    GSource *stream_source;     /* drains token_queue into the draft */
+    gboolean streaming_started; /* streamed text replaced the draft's content */
+    LLMRequest *draft_request;  /* fast first draft in draft-then-refine mode */
+    gboolean draft_ready;       /* the draft request finished */
+    gboolean draft_kept;        /* the user kept the draft; the final answer is dropped */
+    gboolean final_done;        /* the final request finished */
+    GCancellable *cancellable;       /* for the final request */
+    GCancellable *draft_cancellable; /* for the draft request */
+    GCancellable *parent_cancellable; /* the extension's, cancels both */
+    gulong parent_handler;
+    guint pending; /* generations still running */
+    LLMRewriteJob *rewrite_job; /* set for a paragraph-wise rewrite instead of a reply */
 } LLMProcessData;
 
+#define LLM_RESPONSE_KEEP_DRAFT 1
+
 static void llm_extension_process_prompt(ELLMExtension *extension);
 static void llm_extension_setup_composer(ELLMExtension *extension, EMsgComposer *composer);
 static void llm_extension_cleanup_composer(ELLMExtension *extension);
 static WebKitWebView* find_webkit_web_view_recursive(GtkWidget *widget);
+static void llm_extension_bench_next_run(ELLMExtension *extension, guint finished);
+static void on_bench_editor_ready(EContentEditor *content_editor, ELLMExtension *extension);
+static gboolean on_review_timeout(gpointer user_data);
 
 /**
  * Create new LLMProcessData
@@ -49,9 +83,89 @@ static void llm_process_data_free(LLMProcessData *data) {
     g_object_unref(data->extension);
     g_free(data->prompt);
     g_free(data->original_text);
+    llm_request_free(data->request);
+    if (data->web_view) g_object_unref(data->web_view);
+    if (data->progress_dialog) {
+        g_object_remove_weak_pointer(G_OBJECT(data->progress_dialog),
+                                     (gpointer *)&data->progress_dialog);
+        gtk_widget_destroy(data->progress_dialog);
+    }
+    g_free(data->draft_id);
+    if (data->stream_source) {
+        g_source_destroy(data->stream_source);
+        g_source_unref(data->stream_source);
+    }
+    llm_token_queue_free(data->token_queue);
+    llm_request_free(data->draft_request);
+    if (data->parent_cancellable) {
+        g_cancellable_disconnect(data->parent_cancellable, data->parent_handler);
+        g_object_unref(data->parent_cancellable);
+    }
+    g_clear_object(&data->cancellable);
+    g_clear_object(&data->draft_cancellable);
+    llm_rewrite_job_free(data->rewrite_job);
     g_free(data);
 }
 
+/* Drop one running generation's hold on the data; the last one frees it */
+static void llm_process_data_release(LLMProcessData *data) {
+    g_return_if_fail(data->pending > 0);
+
+    if (--data->pending == 0) {
+        llm_process_data_free(data);
+    }
+}
+
+/* Load the configuration, client and caches. Nothing of it is needed to
+ * open a composer, so it runs at idle time afterwards or on the first use
+ * of an action, whichever comes first. */
+static void
+llm_extension_ensure_initialized(ELLMExtension *extension) {
+    ELLMExtensionPrivate *priv = extension->priv;
+
+    if (priv->initialized) return;
+    priv->initialized = TRUE;
+
+    if (priv->init_idle_id) {
+        g_source_remove(priv->init_idle_id);
+        priv->init_idle_id = 0;
+    }
+
+    priv->config = config_load();
+    if (priv->config) {
+        priv->llm_client = llm_client_new(priv->config);
+    }
+
+    /* Routing falls back to OpenAI until the catalog knows the model */
+    if (priv->config &&
+        (config_is_valid(priv->config) || priv->config->model_endpoints) &&
+        llm_catalog_is_stale(llm_catalog_get_default())) {
+        llm_catalog_refresh_in_background(priv->config);
+    }
+
+    if (priv->config && priv->config->metrics_textfile) {
+        llm_metrics_start_export(priv->config->metrics_textfile, MAX(priv->config->metrics_interval, 1));
+    }
+
+    priv->cache = llm_cache_get_default();
+    if (priv->config && priv->config->cache_pack_dir) {
+        llm_cache_add_pack_dir(priv->cache, priv->config->cache_pack_dir);
+    }
+
+    if (priv->config && priv->config->review_enabled && priv->current_composer && !priv->review_timeout_id) {
+        priv->review_timeout_id = g_timeout_add_seconds(REVIEW_INTERVAL_S, on_review_timeout, extension);
+    }
+}
+
+static gboolean
+on_init_idle(gpointer user_data) {
+    ELLMExtension *extension = E_LLM_EXTENSION(user_data);
+
+    extension->priv->init_idle_id = 0;
+    llm_extension_ensure_initialized(extension);
+    return G_SOURCE_REMOVE;
+}
+
 /**
  * Callback when user saves preferences
  * Reinitializes the LLM client with new configuration
@@ -62,11 +176,12 @@ on_preferences_saved(PluginConfig *config, gpointer user_data) {
 
     /* Save to file */
     if (config_save(config)) {
-        /* Reinitialize LLM client */
-        if (extension->priv->llm_client) {
-            llm_client_free(extension->priv->llm_client);
-        }
+        /* The client works on its own copy of the config, which worker
+         * threads read without a lock, so the new settings get a new
+         * client; generations still running keep the old one alive. */
+        LLMClient *old_client = extension->priv->llm_client;
         extension->priv->llm_client = llm_client_new(config);
+        llm_client_free(old_client);
         g_print("LLM Assistant: Configuration saved successfully\n");
     } else {
         g_warning("LLM Assistant: Failed to save configuration");
@@ -81,6 +196,7 @@ action_llm_generate_cb(EUIAction *action G_GNUC_UNUSED,
 {
     ELLMExtension *extension = E_LLM_EXTENSION(user_data);
     g_print("LLM Assistant: Context menu action triggered\n");
+    llm_extension_ensure_initialized(extension);
     llm_extension_process_prompt(extension);
 }
 
@@ -92,6 +208,7 @@ action_llm_preferences_cb(EUIAction *action G_GNUC_UNUSED,
 {
     ELLMExtension *extension = E_LLM_EXTENSION(user_data);
     g_print("LLM Assistant: Preferences action triggered\n");
+    llm_extension_ensure_initialized(extension);
 
     if (!extension->priv->config) {
         g_warning("LLM Assistant: No configuration available");
@@ -104,10 +221,45 @@ action_llm_preferences_cb(EUIAction *action G_GNUC_UNUSED,
 
     llm_preferences_dialog_show(parent_window,
                                 extension->priv->config,
+                                extension->priv->cache,
                                 on_preferences_saved,
                                 extension);
 }
 
+/* Insert a past response picked in the history popup */
+static void
+on_history_response_picked(const gchar *response, gpointer user_data) {
+    ELLMExtension *extension = E_LLM_EXTENSION(user_data);
+    if (!extension->priv->current_composer) return;
+
+    EHTMLEditor *html_editor = e_msg_composer_get_editor(extension->priv->current_composer);
+    if (!html_editor) return;
+
+    EContentEditor *content_editor = e_html_editor_get_content_editor(html_editor);
+    if (!content_editor) return;
+
+    e_content_editor_insert_content(content_editor, response, E_CONTENT_EDITOR_INSERT_TEXT_PLAIN);
+    g_print("LLM Assistant: History response inserted\n");
+}
+
+/* Action callback for the history search popup */
+static void
+action_llm_history_cb(EUIAction *action G_GNUC_UNUSED,
+                      GVariant *parameter G_GNUC_UNUSED,
+                      gpointer user_data)
+{
+    ELLMExtension *extension = E_LLM_EXTENSION(user_data);
+    g_print("LLM Assistant: History action triggered\n");
+
+    GtkWindow *parent_window = extension->priv->current_composer ?
+                               GTK_WINDOW(extension->priv->current_composer) : NULL;
+
+    llm_history_popup_show(parent_window,
+                           llm_history_get_default(),
+                           on_history_response_picked,
+                           extension);
+}
+
 /* Define the action entries */
 static const EUIActionEntry llm_composer_entries[] = {
     { "llm-generate-response",
@@ -116,6 +268,12 @@ static const EUIActionEntry llm_composer_entries[] = {
       "<Shift><Control>G",  /* accelerator - Ctrl+Shift+G */
       "Generate AI response from selected text",
       action_llm_generate_cb, NULL, NULL, NULL },
+    { "llm-history-search",
+      "edit-find",  /* icon name */
+      "Search LLM History...",
+      "<Shift><Control>H",  /* accelerator - Ctrl+Shift+H */
+      "Search and reinsert previously generated responses",
+      action_llm_history_cb, NULL, NULL, NULL },
     { "llm-preferences",
       "preferences-system",  /* icon name */
       "LLM Assistant Preferences...",
@@ -124,6 +282,163 @@ static const EUIActionEntry llm_composer_entries[] = {
       action_llm_preferences_cb, NULL, NULL, NULL }
 };
 
+/* Callback with the draft's text for the pre-send review */
+static void
+on_review_js_result(GObject *source, GAsyncResult *result, gpointer user_data) {
+    ELLMExtension *extension = E_LLM_EXTENSION(user_data);
+    ELLMExtensionPrivate *priv = extension->priv;
+    GError *error = NULL;
+
+    JSCValue *value = webkit_web_view_evaluate_javascript_finish(WEBKIT_WEB_VIEW(source), result, &error);
+    priv->review_reading = FALSE;
+
+    if (error || !priv->current_composer) {
+        if (error && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("LLM Assistant: Failed to read the draft for review: %s", error->message);
+        }
+        g_clear_error(&error);
+        g_clear_object(&value);
+        g_object_unref(extension);
+        return;
+    }
+
+    gchar *json = jsc_value_to_string(value);
+    JsonParser *parser = json_parser_new();
+    gchar *text = NULL;
+    gchar *quoted = NULL;
+
+    if (json && json_parser_load_from_data(parser, json, -1, NULL) &&
+        JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser))) {
+        JsonObject *root_obj = json_node_get_object(json_parser_get_root(parser));
+        const gchar *draft_html = json_object_get_string_member_with_default(root_obj, "draft", "");
+        const gchar *quoted_html = json_object_get_string_member_with_default(root_obj, "quoted", "");
+
+        text = llm_html_to_text(draft_html, -1);
+        quoted = llm_html_to_text(quoted_html, -1);
+    }
+
+    /* A changed draft waits for one more look, so paragraphs are not sent
+     * while the user is still typing them */
+    if (text && g_strcmp0(text, priv->review_text) != 0) {
+        g_free(priv->review_text);
+        priv->review_text = g_steal_pointer(&text);
+        llm_review_draft_free(priv->review_draft);
+        priv->review_draft = llm_review_draft_new(priv->config->review_model, priv->review_text, quoted);
+        priv->review_submitted = FALSE;
+    } else if (priv->review_draft && !priv->review_submitted) {
+        llm_review_submit(llm_review_get_default(), priv->review_draft);
+        priv->review_submitted = TRUE;
+    }
+
+    g_free(text);
+    g_free(quoted);
+    g_object_unref(parser);
+    g_free(json);
+    g_object_unref(value);
+    g_object_unref(extension);
+}
+
+/* Read the draft, without quoted text and signature, every REVIEW_INTERVAL_S */
+static gboolean
+on_review_timeout(gpointer user_data) {
+    ELLMExtension *extension = E_LLM_EXTENSION(user_data);
+    ELLMExtensionPrivate *priv = extension->priv;
+
+    if (priv->review_reading || !priv->current_composer) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* The editor's widget tree does not change while the composer is open,
+     * so it is walked once instead of on every tick */
+    if (!priv->review_web_view) {
+        EHTMLEditor *html_editor = e_msg_composer_get_editor(priv->current_composer);
+        EContentEditor *content_editor = html_editor ? e_html_editor_get_content_editor(html_editor) : NULL;
+        priv->review_web_view = content_editor ? find_webkit_web_view_recursive(GTK_WIDGET(content_editor)) : NULL;
+        if (!priv->review_web_view) {
+            return G_SOURCE_CONTINUE;
+        }
+        g_object_add_weak_pointer(G_OBJECT(priv->review_web_view), (gpointer *)&priv->review_web_view);
+    }
+    WebKitWebView *web_view = priv->review_web_view;
+
+    if (!priv->cancellable) {
+        priv->cancellable = g_cancellable_new();
+    }
+
+    const gchar *js_code =
+        "(function() {"
+        "  var body = document.body.cloneNode(true);"
+        "  var quoted = [];"
+        "  body.querySelectorAll('blockquote[type=cite]').forEach(function(q) {"
+        "    if (body.contains(q)) { quoted.push(q.innerHTML); q.remove(); }"
+        "  });"
+        "  body.querySelectorAll('.-x-evo-signature-wrapper').forEach(function(s) { s.remove(); });"
+        "  return JSON.stringify({ draft: body.innerHTML, quoted: quoted.join('<br>') });"
+        "})();";
+
+    priv->review_reading = TRUE;
+    webkit_web_view_evaluate_javascript(web_view, js_code, -1, NULL, NULL,
+                                        priv->cancellable,
+                                        (GAsyncReadyCallback)on_review_js_result,
+                                        g_object_ref(extension));
+    return G_SOURCE_CONTINUE;
+}
+
+/* Show what the background review found; the verdict was computed while
+ * the user wrote, so sending never waits for the model */
+static gboolean
+on_composer_presend(EMsgComposer *composer, ELLMExtension *extension) {
+    ELLMExtensionPrivate *priv = extension->priv;
+
+    if (!priv->config || !priv->config->review_enabled || !priv->review_draft) {
+        return TRUE;
+    }
+
+    EAttachmentView *attachment_view = e_msg_composer_get_attachment_view(composer);
+    EAttachmentStore *store = e_attachment_view_get_store(attachment_view);
+    LLMReviewVerdict *verdict = llm_review_get_verdict(llm_review_get_default(), priv->review_draft,
+                                                       e_attachment_store_get_num_attachments(store) > 0);
+
+    if (llm_review_verdict_is_clean(verdict)) {
+        llm_review_verdict_free(verdict);
+        return TRUE;
+    }
+
+    GString *findings = g_string_new(NULL);
+    if (verdict->missing_attachment) {
+        g_string_append(findings, "The text mentions an attachment, but nothing is attached.\n");
+    }
+    for (gchar **question = verdict->unanswered; *question; question++) {
+        g_string_append_printf(findings, "Not answered: %s\n", *question);
+    }
+    for (gchar **note = verdict->tone; *note; note++) {
+        g_string_append_printf(findings, "Tone of %s\n", *note);
+    }
+    if (verdict->n_pending > 0) {
+        g_string_append_printf(findings, "%u paragraphs have not been checked yet.\n", verdict->n_pending);
+    }
+
+    GtkWidget *dialog = gtk_message_dialog_new(
+        GTK_WINDOW(composer),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_WARNING,
+        GTK_BUTTONS_NONE,
+        "Send this message anyway?");
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s", findings->str);
+    gtk_dialog_add_buttons(GTK_DIALOG(dialog),
+                           "_Keep Editing", GTK_RESPONSE_CANCEL,
+                           "_Send Anyway", GTK_RESPONSE_ACCEPT,
+                           NULL);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_CANCEL);
+
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+    g_string_free(findings, TRUE);
+    llm_review_verdict_free(verdict);
+
+    return response == GTK_RESPONSE_ACCEPT;
+}
+
 /* Cleanup when composer is destroyed */
 static void
 on_composer_destroyed(GtkWidget *composer G_GNUC_UNUSED, ELLMExtension *extension) {
@@ -143,6 +458,7 @@ llm_extension_setup_composer(ELLMExtension *extension, EMsgComposer *composer) {
     g_object_ref(composer);
 
     g_signal_connect(composer, "destroy", G_CALLBACK(on_composer_destroyed), extension);
+    g_signal_connect(composer, "presend", G_CALLBACK(on_composer_presend), extension);
 
     /* Add our actions to the composer's UI manager */
     EHTMLEditor *html_editor = e_msg_composer_get_editor(composer);
@@ -156,16 +472,19 @@ llm_extension_setup_composer(ELLMExtension *extension, EMsgComposer *composer) {
               "<menu id='context'>"
                 "<placeholder id='custom-actions'>"
                   "<item action='llm-generate-response'/>"
+                  "<item action='llm-history-search'/>"
                   "<item action='llm-preferences'/>"
                 "</placeholder>"
               "</menu>"
               /* Try alternative context menu IDs */
               "<menu id='context-menu'>"
                 "<item action='llm-generate-response'/>"
+                "<item action='llm-history-search'/>"
                 "<item action='llm-preferences'/>"
               "</menu>"
               "<menu id='mail-composer-context'>"
                 "<item action='llm-generate-response'/>"
+                "<item action='llm-history-search'/>"
                 "<item action='llm-preferences'/>"
               "</menu>"
             "</eui>";
@@ -176,23 +495,744 @@ llm_extension_setup_composer(ELLMExtension *extension, EMsgComposer *composer) {
             llm_composer_entries, G_N_ELEMENTS(llm_composer_entries),
             extension, eui_def);
         g_print("LLM Assistant: Actions registered (context menu + Edit menu + hotkeys)\n");
+
+        /* Benchmark mode takes over the first composer of the process */
+        static gboolean bench_claimed = FALSE;
+        if (llm_bench_get_runs() > 0 && !bench_claimed) {
+            EContentEditor *content_editor = e_html_editor_get_content_editor(html_editor);
+
+            bench_claimed = TRUE;
+            extension->priv->bench_active = TRUE;
+            if (e_content_editor_is_ready(content_editor)) {
+                llm_extension_bench_next_run(extension, 0);
+            } else {
+                g_signal_connect(content_editor, "load-finished",
+                                 G_CALLBACK(on_bench_editor_ready), extension);
+            }
+        }
     }
 
-    g_print("LLM Assistant: Module loaded.\n");
-    g_print("  Ctrl+Shift+G - Generate LLM response from selected text\n");
-    g_print("  Right-click menu - Access preferences and generation\n");
+    static gboolean help_printed = FALSE;
+    if (!help_printed) {
+        help_printed = TRUE;
+        g_print("LLM Assistant: Module loaded.\n");
+        g_print("  Ctrl+Shift+G - Generate LLM response from selected text\n");
+        g_print("  Ctrl+Shift+H - Search previously generated responses\n");
+        g_print("  Right-click menu - Access preferences and generation\n");
+    }
 }
 
 /* Cleanup composer connections */
 static void
 llm_extension_cleanup_composer(ELLMExtension *extension) {
+    if (extension->priv->cancellable) {
+        g_cancellable_cancel(extension->priv->cancellable);
+        g_clear_object(&extension->priv->cancellable);
+    }
+
+    if (extension->priv->init_idle_id) {
+        g_source_remove(extension->priv->init_idle_id);
+        extension->priv->init_idle_id = 0;
+    }
+
+    if (extension->priv->bench_timeout_id) {
+        g_source_remove(extension->priv->bench_timeout_id);
+        extension->priv->bench_timeout_id = 0;
+    }
+
+    if (extension->priv->review_timeout_id) {
+        g_source_remove(extension->priv->review_timeout_id);
+        extension->priv->review_timeout_id = 0;
+    }
+    if (extension->priv->review_web_view) {
+        g_object_remove_weak_pointer(G_OBJECT(extension->priv->review_web_view),
+                                     (gpointer *)&extension->priv->review_web_view);
+        extension->priv->review_web_view = NULL;
+    }
+    g_clear_pointer(&extension->priv->review_text, g_free);
+    g_clear_pointer(&extension->priv->review_draft, llm_review_draft_free);
+    extension->priv->review_submitted = FALSE;
+
     if (extension->priv->current_composer) {
+        if (extension->priv->bench_active) {
+            EHTMLEditor *html_editor = e_msg_composer_get_editor(extension->priv->current_composer);
+            if (html_editor) {
+                g_signal_handlers_disconnect_by_func(e_html_editor_get_content_editor(html_editor),
+                                                     on_bench_editor_ready, extension);
+            }
+            extension->priv->bench_active = FALSE;
+        }
+
         g_signal_handlers_disconnect_by_data(extension->priv->current_composer, extension);
         g_object_unref(extension->priv->current_composer);
         extension->priv->current_composer = NULL;
     }
 }
 
+/* Quote a string as a JavaScript (JSON) string literal */
+static gchar*
+js_string_literal(const gchar *text) {
+    JsonNode *node = json_node_new(JSON_NODE_VALUE);
+    json_node_set_string(node, text ? text : "");
+    gchar *literal = json_to_string(node, FALSE);
+    json_node_unref(node);
+    return literal;
+}
+
+/* Unique id for a draft element in the composer */
+static gchar*
+llm_extension_new_draft_id(void) {
+    static guint draft_serial = 0;
+    return g_strdup_printf("llm-draft-%u", ++draft_serial);
+}
+
+/* Insert a provisional draft, visually marked, in place of the selection */
+static void
+llm_extension_insert_draft(ELLMExtension *extension, const gchar *draft_id, const gchar *text) {
+    EHTMLEditor *html_editor = e_msg_composer_get_editor(extension->priv->current_composer);
+    if (!html_editor) return;
+
+    EContentEditor *content_editor = e_html_editor_get_content_editor(html_editor);
+    if (!content_editor) return;
+
+    gchar *escaped = g_markup_escape_text(text, -1);
+    gchar **lines = g_strsplit(escaped, "\n", -1);
+    gchar *body = g_strjoinv("<br>", lines);
+    gchar *html = g_strdup_printf(
+        "<span id=\"%s\" style=\"color:#888888;font-style:italic;\">%s</span>",
+        draft_id, body);
+
+    e_content_editor_insert_content(content_editor, html, E_CONTENT_EDITOR_INSERT_TEXT_HTML);
+
+    g_free(html);
+    g_free(body);
+    g_strfreev(lines);
+    g_free(escaped);
+}
+
+/* Replace the provisional draft element with the final plain text */
+static void
+llm_extension_replace_draft(WebKitWebView *web_view, const gchar *draft_id, const gchar *text) {
+    gchar *id_literal = js_string_literal(draft_id);
+    gchar *text_literal = js_string_literal(text);
+    gchar *js_code = g_strdup_printf(
+        "(function(id, text) {"
+        "  var el = document.getElementById(id);"
+        "  if (!el) return false;"
+        "  var frag = document.createDocumentFragment();"
+        "  var lines = text.split('\\n');"
+        "  for (var i = 0; i < lines.length; i++) {"
+        "    if (i > 0) frag.appendChild(document.createElement('br'));"
+        "    frag.appendChild(document.createTextNode(lines[i]));"
+        "  }"
+        "  el.parentNode.replaceChild(frag, el);"
+        "  return true;"
+        "})(%s, %s);",
+        id_literal, text_literal);
+
+    webkit_web_view_evaluate_javascript(web_view, js_code, -1, NULL, NULL, NULL, NULL, NULL);
+
+    g_free(js_code);
+    g_free(text_literal);
+    g_free(id_literal);
+}
+
+/* Append streamed text to the draft element, replacing its content on the first batch */
+static void
+llm_extension_append_to_draft(WebKitWebView *web_view, const gchar *draft_id, const gchar *text, gboolean reset) {
+    gchar *id_literal = js_string_literal(draft_id);
+    gchar *text_literal = js_string_literal(text);
+    gchar *js_code = g_strdup_printf(
+        "(function(id, text, reset) {"
+        "  var el = document.getElementById(id);"
+        "  if (!el) return false;"
+        "  if (reset) el.textContent = '';"
+        "  var lines = text.split('\\n');"
+        "  for (var i = 0; i < lines.length; i++) {"
+        "    if (i > 0) el.appendChild(document.createElement('br'));"
+        "    if (lines[i]) el.appendChild(document.createTextNode(lines[i]));"
+        "  }"
+        "  return true;"
+        "})(%s, %s, %s);",
+        id_literal, text_literal, reset ? "true" : "false");
+
+    webkit_web_view_evaluate_javascript(web_view, js_code, -1, NULL, NULL, NULL, NULL, NULL);
+
+    g_free(js_code);
+    g_free(text_literal);
+    g_free(id_literal);
+}
+
+/* Benchmark mode (tools/llm-ui-bench.sh): the composer puts the benchmark
+ * text back, selects it and activates the hotkey action once per run */
+typedef struct {
+    ELLMExtension *extension;
+    LLMBenchMark mark;
+} LLMBenchPing;
+
+static gboolean
+on_bench_hotkey(gpointer user_data) {
+    ELLMExtension *extension = E_LLM_EXTENSION(user_data);
+    EHTMLEditor *html_editor = e_msg_composer_get_editor(extension->priv->current_composer);
+    EUIAction *action = e_ui_manager_get_action(e_html_editor_get_ui_manager(html_editor),
+                                                "llm-generate-response");
+
+    extension->priv->bench_timeout_id = 0;
+    llm_bench_start_run();
+    g_action_activate(G_ACTION(action), NULL);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+on_bench_composer_opened(GObject *source G_GNUC_UNUSED, GAsyncResult *result, gpointer user_data) {
+    ELLMExtension *extension = E_LLM_EXTENSION(user_data);
+    GError *error = NULL;
+    EMsgComposer *composer = e_msg_composer_new_finish(result, &error);
+
+    if (composer) {
+        gtk_widget_destroy(GTK_WIDGET(composer));
+        extension->priv->bench_opened++;
+    } else {
+        g_warning("LLM Bench: Cannot open a composer: %s", error ? error->message : "unknown error");
+        g_clear_error(&error);
+        extension->priv->bench_opened = llm_bench_get_opens();
+    }
+
+    llm_extension_bench_next_run(extension, llm_bench_get_runs());
+    g_object_unref(extension);
+}
+
+static void
+llm_extension_bench_next_run(ELLMExtension *extension, guint finished) {
+    if (!extension->priv->bench_active || !extension->priv->current_composer) return;
+
+    if (finished >= llm_bench_get_runs() && extension->priv->bench_opened < llm_bench_get_opens()) {
+        /* Then the cost of opening a composer, one at a time */
+        e_msg_composer_new(e_msg_composer_get_shell(extension->priv->current_composer),
+                           on_bench_composer_opened, g_object_ref(extension));
+        return;
+    }
+
+    if (finished >= llm_bench_get_runs()) {
+        GError *error = NULL;
+        if (!llm_bench_write_report(&error)) {
+            g_warning("LLM Bench: Cannot write the report: %s", error->message);
+            g_error_free(error);
+        }
+        extension->priv->bench_active = FALSE;
+        return;
+    }
+
+    EHTMLEditor *html_editor = e_msg_composer_get_editor(extension->priv->current_composer);
+    EContentEditor *content_editor = e_html_editor_get_content_editor(html_editor);
+
+    e_content_editor_insert_content(content_editor, llm_bench_get_text(),
+                                    E_CONTENT_EDITOR_INSERT_REPLACE_ALL | E_CONTENT_EDITOR_INSERT_TEXT_PLAIN);
+    e_content_editor_select_all(content_editor);
+    extension->priv->bench_timeout_id = g_timeout_add(BENCH_SETTLE_MS, on_bench_hotkey, extension);
+}
+
+static void
+on_bench_editor_ready(EContentEditor *content_editor, ELLMExtension *extension) {
+    g_signal_handlers_disconnect_by_func(content_editor, on_bench_editor_ready, extension);
+    llm_extension_bench_next_run(extension, 0);
+}
+
+static void
+on_bench_ping_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    LLMBenchPing *ping = user_data;
+    JSCValue *value = webkit_web_view_evaluate_javascript_finish(WEBKIT_WEB_VIEW(source), result, NULL);
+    if (value) g_object_unref(value);
+
+    llm_bench_mark(ping->mark);
+    if (ping->mark == LLM_BENCH_COMPLETE) {
+        llm_extension_bench_next_run(ping->extension, llm_bench_finish_run(TRUE));
+    }
+
+    g_object_unref(ping->extension);
+    g_free(ping);
+}
+
+/* Mark a benchmark point once the web process has applied every change
+ * made so far; scripts run in order, so an empty one finishes after them */
+static void
+llm_extension_bench_mark_applied(ELLMExtension *extension, WebKitWebView *web_view, LLMBenchMark mark) {
+    if (!extension->priv->bench_active || !web_view) return;
+
+    LLMBenchPing *ping = g_new0(LLMBenchPing, 1);
+    ping->extension = g_object_ref(extension);
+    ping->mark = mark;
+    webkit_web_view_evaluate_javascript(web_view, "0", -1, NULL, NULL, NULL, on_bench_ping_done, ping);
+}
+
+/* Domain of the first To: recipient, i.e. the sender of the mail being answered */
+static gchar*
+llm_extension_get_reply_domain(ELLMExtension *extension) {
+    EComposerHeaderTable *table = e_msg_composer_get_header_table(extension->priv->current_composer);
+    EDestination **destinations = e_composer_header_table_get_destinations_to(table);
+    gchar *domain = NULL;
+
+    for (gint i = 0; destinations && destinations[i] && !domain; i++) {
+        domain = llm_boilerplate_domain_from_address(e_destination_get_email(destinations[i]));
+    }
+    e_destination_freev(destinations);
+
+    return domain;
+}
+
+/* Drop the correspondent's recurring footers from the text, then learn
+ * from the mail being answered */
+static gchar*
+llm_extension_strip_boilerplate(ELLMExtension *extension, const gchar *text) {
+    gchar *domain = llm_extension_get_reply_domain(extension);
+    if (!domain) return g_strdup(text);
+
+    LLMBoilerplate *boilerplate = llm_boilerplate_get_default();
+    guint lines_removed = 0;
+
+    gchar *stripped = llm_boilerplate_strip(boilerplate, domain, text,
+                                            extension->priv->config->boilerplate_min_messages,
+                                            &lines_removed);
+
+    /* A selection that is nothing but footer is left as it is */
+    if (!*g_strstrip(stripped)) {
+        g_free(stripped);
+        stripped = g_strdup(text);
+        lines_removed = 0;
+    }
+
+    if (lines_removed > 0) {
+        llm_metrics_add(LLM_METRIC_BOILERPLATE_BYTES_REMOVED, strlen(text) - strlen(stripped));
+        g_print("LLM Assistant: Stripped %u boilerplate lines for %s\n", lines_removed, domain);
+    }
+
+    /* Each received mail counts once, however often it is answered; without
+     * a source message the selection itself identifies it */
+    gchar *folder_uri = NULL;
+    gchar *message_uid = NULL;
+    CamelMessageFlags flags = 0;
+    gchar *message_key;
+
+    if (e_msg_composer_get_source_headers(extension->priv->current_composer,
+                                          &folder_uri, &message_uid, &flags)) {
+        message_key = g_strconcat(folder_uri, "\n", message_uid, NULL);
+    } else {
+        message_key = g_compute_checksum_for_string(G_CHECKSUM_SHA256, text, -1);
+    }
+
+    if (llm_boilerplate_learn(boilerplate, domain, message_key, text)) {
+        llm_boilerplate_save_in_background(boilerplate);
+    }
+
+    g_free(message_key);
+    g_free(folder_uri);
+    g_free(message_uid);
+    g_free(domain);
+    return stripped;
+}
+
+/* Ask before generating for mail the triage classifier considers routine */
+static gboolean
+llm_extension_confirm_triage(ELLMExtension *extension, const gchar *text) {
+    PluginConfig *config = extension->priv->config;
+
+    if (!extension->priv->triage_model) {
+        gchar *path = llm_triage_get_model_path();
+        if (g_file_test(path, G_FILE_TEST_EXISTS)) {
+            GError *error = NULL;
+            extension->priv->triage_model = llm_triage_model_load(path, &error);
+            if (error) {
+                g_warning("LLM Assistant: %s", error->message);
+                g_error_free(error);
+            }
+        }
+        g_free(path);
+    }
+
+    if (!extension->priv->triage_model) return TRUE;
+
+    gdouble confidence = 0.0;
+    const gchar *label = llm_triage_model_classify(extension->priv->triage_model, text, &confidence);
+    g_print("LLM Assistant: Triage label '%s' (%.2f)\n", label, confidence);
+
+    if (llm_triage_label_wants_reply(label, confidence,
+                                     config->triage_reply_label, config->triage_min_confidence)) {
+        return TRUE;
+    }
+
+    GtkWidget *dialog = gtk_message_dialog_new(
+        GTK_WINDOW(extension->priv->current_composer),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_QUESTION,
+        GTK_BUTTONS_YES_NO,
+        "This looks like \"%s\" mail (%.0f%% sure). Generate a response anyway?",
+        label, confidence * 100.0);
+    gboolean generate = gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_YES;
+    gtk_widget_destroy(dialog);
+
+    return generate;
+}
+
+/* Offer a matching canned answer; returns TRUE if it was inserted */
+static gboolean
+llm_extension_offer_canned_answer(ELLMExtension *extension, const LLMCannedMatch *match) {
+    GtkWidget *dialog = gtk_message_dialog_new(
+        GTK_WINDOW(extension->priv->current_composer),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_QUESTION,
+        GTK_BUTTONS_NONE,
+        "A canned answer matches the selected text: \"%s\"",
+        match->title);
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s", match->answer);
+    gtk_dialog_add_buttons(GTK_DIALOG(dialog),
+                           "_Ask the Model", GTK_RESPONSE_NO,
+                           "_Use Canned Answer", GTK_RESPONSE_YES,
+                           NULL);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_YES);
+
+    gboolean use_canned = gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_YES;
+    gtk_widget_destroy(dialog);
+
+    if (!use_canned) return FALSE;
+
+    EHTMLEditor *html_editor = e_msg_composer_get_editor(extension->priv->current_composer);
+    if (html_editor) {
+        EContentEditor *content_editor = e_html_editor_get_content_editor(html_editor);
+        if (content_editor) {
+            e_content_editor_insert_content(content_editor, match->answer,
+                E_CONTENT_EDITOR_INSERT_TEXT_PLAIN);
+            g_print("LLM Assistant: Canned answer inserted\n");
+        }
+    }
+
+    return TRUE;
+}
+
+/* Called on the main thread with every batch of streamed tokens */
+static void
+on_stream_tokens(const gchar *text, gsize length, gboolean finished G_GNUC_UNUSED, gpointer user_data) {
+    LLMProcessData *data = (LLMProcessData *)user_data;
+
+    if (length == 0 || !data->draft_id) return;
+
+    llm_extension_append_to_draft(data->web_view, data->draft_id, text, !data->streaming_started);
+    if (!data->streaming_started) {
+        llm_extension_bench_mark_applied(data->extension, data->web_view, LLM_BENCH_FIRST_TEXT);
+    }
+    data->streaming_started = TRUE;
+}
+
+static void
+llm_extension_add_to_history(LLMRequest *request) {
+    LLMHistoryRecord record = {
+        .timestamp = g_get_real_time() / G_USEC_PER_SEC,
+        .model = request->model,
+        .prompt = request->prompt,
+        .response = request->response,
+        .latency_ms = request->latency_ms,
+        .prompt_tokens = request->prompt_tokens,
+        .completion_tokens = request->completion_tokens,
+    };
+    llm_history_add(llm_history_get_default(), &record);
+}
+
+/* Keep the finished draft as the answer and stop waiting for the final one */
+static void
+on_refine_dialog_response(GtkDialog *dialog, gint response_id, LLMProcessData *data) {
+    if (response_id == LLM_RESPONSE_KEEP_DRAFT && !data->final_done) {
+        data->draft_kept = TRUE;
+        llm_extension_replace_draft(data->web_view, data->draft_id, data->draft_request->response);
+        llm_extension_add_to_history(data->draft_request);
+        g_cancellable_cancel(data->cancellable);
+        g_print("LLM Assistant: Draft kept\n");
+    }
+
+    gtk_widget_destroy(GTK_WIDGET(dialog));
+}
+
+/* Callback when the fast draft model finished */
+static void
+on_draft_response_ready(GObject *source G_GNUC_UNUSED, GAsyncResult *result, gpointer user_data) {
+    LLMProcessData *data = (LLMProcessData *)user_data;
+    ELLMExtension *extension = data->extension;
+    GError *error = NULL;
+
+    gboolean success = llm_client_generate_response_finish(result, &error);
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+        !extension->priv->current_composer || data->final_done) {
+        g_clear_error(&error);
+        llm_process_data_release(data);
+        return;
+    }
+    g_clear_error(&error);
+
+    if (!success || !data->draft_request->response || !data->draft_id) {
+        g_warning("LLM Assistant: Draft generation failed, waiting for the final response");
+        llm_process_data_release(data);
+        return;
+    }
+
+    g_print("LLM Assistant: Draft ready after %" G_GINT64_FORMAT " ms\n", data->draft_request->latency_ms);
+    data->draft_ready = TRUE;
+
+    /* Show the complete draft, including tokens the stream source had not drained yet */
+    if (data->stream_source) {
+        g_source_destroy(data->stream_source);
+    }
+    llm_extension_append_to_draft(data->web_view, data->draft_id, data->draft_request->response, TRUE);
+    data->streaming_started = TRUE;
+
+    data->progress_dialog = gtk_message_dialog_new(
+        GTK_WINDOW(extension->priv->current_composer),
+        GTK_DIALOG_DESTROY_WITH_PARENT,
+        GTK_MESSAGE_INFO,
+        GTK_BUTTONS_NONE,
+        "Draft ready. Refining it with %s...",
+        data->request->model);
+    gtk_dialog_add_button(GTK_DIALOG(data->progress_dialog), "Keep Draft", LLM_RESPONSE_KEEP_DRAFT);
+    g_object_add_weak_pointer(G_OBJECT(data->progress_dialog),
+                              (gpointer *)&data->progress_dialog);
+    g_signal_connect(data->progress_dialog, "response",
+                     G_CALLBACK(on_refine_dialog_response), data);
+    gtk_widget_show(data->progress_dialog);
+
+    llm_process_data_release(data);
+}
+
+/* Callback when the worker thread finished generating a response */
+static void
+on_generate_response_ready(GObject *source G_GNUC_UNUSED, GAsyncResult *result, gpointer user_data) {
+    LLMProcessData *data = (LLMProcessData *)user_data;
+    ELLMExtension *extension = data->extension;
+    LLMRequest *request = data->request;
+    GError *error = NULL;
+
+    gboolean success = llm_client_generate_response_finish(result, &error);
+
+    g_print("LLM Assistant: API call result: %s\n", success ? "SUCCESS" : "FAILED");
+
+    /* A draft still being written is no longer needed */
+    data->final_done = TRUE;
+    if (data->draft_cancellable) {
+        g_cancellable_cancel(data->draft_cancellable);
+    }
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+        !extension->priv->current_composer) {
+        g_clear_error(&error);
+        llm_process_data_release(data);
+        return;
+    }
+    g_clear_error(&error);
+
+    /* The final response replaces whatever was streamed so far */
+    if (data->stream_source) {
+        g_source_destroy(data->stream_source);
+    }
+
+    if (data->progress_dialog) {
+        g_object_remove_weak_pointer(G_OBJECT(data->progress_dialog),
+                                     (gpointer *)&data->progress_dialog);
+        gtk_widget_destroy(data->progress_dialog);
+        data->progress_dialog = NULL;
+    }
+
+    if (success && request->response) {
+        g_print("LLM Assistant: Generated response: %s\n", request->response);
+
+        llm_cache_store(extension->priv->cache, request->model, request->prompt, request->response);
+        llm_extension_add_to_history(request);
+
+        if (data->draft_id) {
+            /* Swap the provisional draft for the fresh answer in place */
+            llm_extension_replace_draft(data->web_view, data->draft_id, request->response);
+            g_print("LLM Assistant: Draft replaced\n");
+        } else {
+            /* Get content editor to insert response */
+            EHTMLEditor *html_editor = e_msg_composer_get_editor(extension->priv->current_composer);
+            if (html_editor) {
+                EContentEditor *content_editor = e_html_editor_get_content_editor(html_editor);
+                if (content_editor) {
+                    /* Insert response - it will replace the selection */
+                    e_content_editor_insert_content(content_editor, request->response,
+                        E_CONTENT_EDITOR_INSERT_TEXT_PLAIN);
+                    g_print("LLM Assistant: Response inserted\n");
+                }
+            }
+        }
+
+        llm_extension_bench_mark_applied(extension, data->web_view, LLM_BENCH_FIRST_TEXT);
+        llm_extension_bench_mark_applied(extension, data->web_view, LLM_BENCH_COMPLETE);
+    } else if (extension->priv->bench_active) {
+        /* A benchmark counts failures and goes on instead of waiting for a click */
+        llm_extension_bench_next_run(extension, llm_bench_finish_run(FALSE));
+    } else {
+        gboolean keep_draft = (data->draft_from_cache && !data->streaming_started) || data->draft_ready;
+
+        if (data->draft_ready) {
+            /* The finished draft becomes the answer */
+            llm_extension_replace_draft(data->web_view, data->draft_id, data->draft_request->response);
+        } else if (data->draft_id && !keep_draft) {
+            /* Partial streamed text or the placeholder would look like an answer */
+            llm_extension_replace_draft(data->web_view, data->draft_id, "");
+        }
+
+        GtkWidget *error_dialog = gtk_message_dialog_new(
+            GTK_WINDOW(extension->priv->current_composer),
+            GTK_DIALOG_MODAL,
+            GTK_MESSAGE_ERROR,
+            GTK_BUTTONS_OK,
+            keep_draft ?
+                "Failed to generate response. The draft was left in place." :
+                "Failed to generate response. Please check your internet connection and API key.");
+        gtk_dialog_run(GTK_DIALOG(error_dialog));
+        gtk_widget_destroy(error_dialog);
+    }
+
+    llm_process_data_release(data);
+}
+
+/* Cancelling the extension's generations cancels both requests of this one */
+static void
+on_generation_cancelled(GCancellable *cancellable G_GNUC_UNUSED, LLMProcessData *data) {
+    g_cancellable_cancel(data->cancellable);
+    if (data->draft_cancellable) {
+        g_cancellable_cancel(data->draft_cancellable);
+    }
+}
+
+static void
+llm_extension_start_generation(LLMProcessData *data) {
+    ELLMExtension *extension = data->extension;
+
+    g_print("LLM Assistant: Sending request to OpenAI...\n");
+    llm_bench_mark(LLM_BENCH_REQUEST);
+
+    data->pending++;
+    llm_client_generate_response_async(extension->priv->llm_client,
+                                       data->request,
+                                       data->cancellable,
+                                       on_generate_response_ready,
+                                       data);
+}
+
+/* Generation goes ahead without attachments if they cannot be read; a
+ * cancelled extraction is reported by the cancelled generation */
+static void
+on_attachments_ready(GObject *source G_GNUC_UNUSED, GAsyncResult *result, gpointer user_data) {
+    LLMProcessData *data = (LLMProcessData *)user_data;
+    GError *error = NULL;
+
+    data->request->attachments = llm_attachment_extract_finish(result, &error);
+
+    if (error) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("LLM Assistant: Cannot read attachments: %s", error->message);
+        }
+        g_error_free(error);
+    } else if (data->request->attachments) {
+        g_print("LLM Assistant: Added %" G_GSIZE_FORMAT " bytes of attachment text\n",
+                strlen(data->request->attachments));
+    }
+
+    llm_extension_start_generation(data);
+    llm_process_data_release(data);
+}
+
+/* Callback when all paragraphs of a rewrite have come back or failed */
+static void
+on_rewrite_ready(GObject *source G_GNUC_UNUSED, GAsyncResult *result, gpointer user_data) {
+    LLMProcessData *data = (LLMProcessData *)user_data;
+    ELLMExtension *extension = data->extension;
+    GError *error = NULL;
+
+    gboolean success = llm_rewrite_job_run_finish(result, &error);
+
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+        !extension->priv->current_composer) {
+        g_clear_error(&error);
+        llm_process_data_free(data);
+        return;
+    }
+
+    if (data->progress_dialog) {
+        g_object_remove_weak_pointer(G_OBJECT(data->progress_dialog),
+                                     (gpointer *)&data->progress_dialog);
+        gtk_widget_destroy(data->progress_dialog);
+        data->progress_dialog = NULL;
+    }
+
+    if (success) {
+        gchar *text = llm_rewrite_job_get_text(data->rewrite_job);
+        EHTMLEditor *html_editor = e_msg_composer_get_editor(extension->priv->current_composer);
+        EContentEditor *content_editor = html_editor ? e_html_editor_get_content_editor(html_editor) : NULL;
+
+        if (content_editor) {
+            /* Replaces the selection, as a generated reply does */
+            e_content_editor_insert_content(content_editor, text, E_CONTENT_EDITOR_INSERT_TEXT_PLAIN);
+            g_print("LLM Assistant: Rewrite inserted\n");
+        }
+        g_free(text);
+    } else {
+        g_warning("LLM Assistant: Rewrite failed: %s", error ? error->message : "unknown error");
+
+        GtkWidget *error_dialog = gtk_message_dialog_new(
+            GTK_WINDOW(extension->priv->current_composer),
+            GTK_DIALOG_MODAL,
+            GTK_MESSAGE_ERROR,
+            GTK_BUTTONS_OK,
+            "Failed to rewrite %u of %u paragraphs. The selection was left unchanged.",
+            llm_rewrite_job_get_n_missing(data->rewrite_job),
+            llm_rewrite_job_get_n_paragraphs(data->rewrite_job));
+        gtk_dialog_run(GTK_DIALOG(error_dialog));
+        gtk_widget_destroy(error_dialog);
+    }
+
+    g_clear_error(&error);
+    llm_process_data_free(data);
+}
+
+/* Rewrite the selection paragraph by paragraph; paragraphs unchanged since
+ * an earlier rewrite with the same instruction come from the cache */
+static void
+llm_extension_start_rewrite(LLMProcessData *data, const gchar *instruction, const gchar *text) {
+    ELLMExtension *extension = data->extension;
+
+    data->rewrite_job = llm_rewrite_job_new(llm_rewrite_get_default(),
+                                            extension->priv->config->model,
+                                            instruction, text);
+
+    g_print("LLM Assistant: Rewriting %u paragraphs (%u not cached): %s\n",
+            llm_rewrite_job_get_n_paragraphs(data->rewrite_job),
+            llm_rewrite_job_get_n_missing(data->rewrite_job),
+            instruction);
+
+    if (llm_rewrite_job_get_n_missing(data->rewrite_job) > 0) {
+        data->progress_dialog = gtk_message_dialog_new(
+            GTK_WINDOW(extension->priv->current_composer),
+            GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+            GTK_MESSAGE_INFO,
+            GTK_BUTTONS_NONE,
+            "Rewriting %u of %u paragraphs...",
+            llm_rewrite_job_get_n_missing(data->rewrite_job),
+            llm_rewrite_job_get_n_paragraphs(data->rewrite_job));
+        g_object_add_weak_pointer(G_OBJECT(data->progress_dialog),
+                                  (gpointer *)&data->progress_dialog);
+        gtk_widget_show(data->progress_dialog);
+    }
+
+    if (!extension->priv->cancellable) {
+        extension->priv->cancellable = g_cancellable_new();
+    }
+
+    llm_rewrite_job_run_async(data->rewrite_job,
+                              extension->priv->llm_client,
+                              extension->priv->cancellable,
+                              on_rewrite_ready,
+                              data);
+}
+
 /* Callback when JavaScript to get selection completes */
 static void
 on_js_selection_result(GObject *source, GAsyncResult *result, gpointer user_data) {
@@ -202,6 +1242,7 @@ on_js_selection_result(GObject *source, GAsyncResult *result, gpointer user_data
 
     /* Use new API: webkit_web_view_evaluate_javascript_finish */
     JSCValue *value = webkit_web_view_evaluate_javascript_finish(web_view, result, &error);
+    llm_bench_mark(LLM_BENCH_SELECTION);
 
     if (error) {
         g_warning("JavaScript error: %s", error->message);
@@ -218,7 +1259,16 @@ on_js_selection_result(GObject *source, GAsyncResult *result, gpointer user_data
         return;
     }
 
-    gchar *selected_text = jsc_value_to_string(value);
+    /* The selection arrives as HTML so quoted HTML mail keeps its structure */
+    gchar *selected_html = jsc_value_to_string(value);
+    gint64 start_time = g_get_monotonic_time();
+    gchar *selected_text = selected_html ? llm_html_to_text(selected_html, -1) : NULL;
+
+    if (selected_html) {
+        llm_metrics_add(LLM_METRIC_HTML_BYTES_IN, strlen(selected_html));
+        llm_metrics_add(LLM_METRIC_HTML_TIME_US, g_get_monotonic_time() - start_time);
+        g_free(selected_html);
+    }
 
     if (!selected_text || strlen(selected_text) == 0 || g_strcmp0(selected_text, "") == 0) {
         GtkWidget *dialog = gtk_message_dialog_new(
@@ -236,58 +1286,202 @@ on_js_selection_result(GObject *source, GAsyncResult *result, gpointer user_data
 
     g_print("LLM Assistant: Selected text: %s\n", selected_text);
 
-    /* Create progress dialog */
-    GtkWidget *progress_dialog = gtk_message_dialog_new(
-        GTK_WINDOW(data->extension->priv->current_composer),
-        GTK_DIALOG_MODAL,
-        GTK_MESSAGE_INFO,
-        GTK_BUTTONS_NONE,
-        "Generating response...");
-    gtk_widget_show(progress_dialog);
+    ELLMExtension *extension = data->extension;
+    PluginConfig *config = extension->priv->config;
+
+    /* A "/rw: <instruction>" line asks to rewrite the rest of the selection
+     * instead of answering it */
+    gchar *instruction = NULL;
+    gchar *body = NULL;
+    if (llm_rewrite_parse(selected_text, &instruction, &body)) {
+        llm_extension_start_rewrite(data, instruction, body);
+        g_free(instruction);
+        g_free(body);
+        g_free(selected_text);
+        return;
+    }
 
-    while (gtk_events_pending()) {
-        gtk_main_iteration();
+    /* Signatures and disclaimers go before anything else looks at the text */
+    if (config->boilerplate_enabled) {
+        gchar *stripped = llm_extension_strip_boilerplate(extension, selected_text);
+        g_free(selected_text);
+        selected_text = stripped;
     }
 
-    /* Send to OpenAI */
-    LLMRequest *request = llm_request_new();
-    request->prompt = g_strdup(selected_text);
+    data->request = llm_request_new();
+    data->request->prompt = g_strdup(selected_text);
+    data->request->model = g_strdup(config->model);
+    data->web_view = g_object_ref(web_view);
 
-    g_print("LLM Assistant: Sending request to OpenAI...\n");
+    /* Routine mail (out-of-office replies, newsletters, ...) is not worth a generation */
+    if (config->triage_enabled && !llm_extension_confirm_triage(extension, selected_text)) {
+        g_free(selected_text);
+        llm_process_data_free(data);
+        return;
+    }
 
-    gboolean success = llm_client_generate_response(data->extension->priv->llm_client, request);
+    /* A strong canned-answer match is offered without calling the model;
+     * a weaker one is passed along as grounding */
+    if (config->canned_dir && !extension->priv->canned_index) {
+        extension->priv->canned_index = llm_canned_index_new(config->canned_dir);
+    }
 
-    g_print("LLM Assistant: API call result: %s\n", success ? "SUCCESS" : "FAILED");
+    LLMCannedMatch match;
+    if (llm_canned_index_search(extension->priv->canned_index, selected_text, &match)) {
+        g_print("LLM Assistant: Canned answer '%s' scored %.2f\n", match.title, match.score);
 
-    gtk_widget_destroy(progress_dialog);
+        if (match.score >= config->canned_instant_score && match.covers_key_terms &&
+            llm_extension_offer_canned_answer(extension, &match)) {
+            g_free(selected_text);
+            llm_process_data_free(data);
+            return;
+        }
 
-    if (success && request->response) {
-        g_print("LLM Assistant: Generated response: %s\n", request->response);
+        if (match.score >= config->canned_grounding_score) {
+            data->request->grounding = g_strdup(match.answer);
+        }
+    }
 
-        /* Get content editor to insert response */
-        EHTMLEditor *html_editor = e_msg_composer_get_editor(data->extension->priv->current_composer);
-        if (html_editor) {
-            EContentEditor *content_editor = e_html_editor_get_content_editor(html_editor);
-            if (content_editor) {
-                /* Insert response - it will replace the selection */
-                e_content_editor_insert_content(content_editor, request->response,
-                    E_CONTENT_EDITOR_INSERT_TEXT_PLAIN);
-                g_print("LLM Assistant: Response inserted\n");
-            }
+    /* Prune filler from long mails; cache and history stay keyed on the full text */
+    if (config->compression_enabled) {
+        LLMCompressStats stats;
+        gchar *compressed = llm_compress_text(selected_text, config->compression_ratio,
+                                              llm_history_get_default(), &stats);
+
+        llm_metrics_add(LLM_METRIC_COMPRESSION_WORDS_IN, stats.words_in);
+        llm_metrics_add(LLM_METRIC_COMPRESSION_WORDS_SAVED, stats.words_in - stats.words_out);
+        llm_metrics_add(LLM_METRIC_COMPRESSION_TIME_US, stats.time_us);
+
+        if (stats.words_out < stats.words_in) {
+            g_print("LLM Assistant: Compressed prompt %u -> %u words (%.0f%% saved) in %" G_GINT64_FORMAT " us\n",
+                    stats.words_in, stats.words_out,
+                    100.0 * (stats.words_in - stats.words_out) / stats.words_in,
+                    stats.time_us);
+            data->request->compressed_prompt = compressed;
+        } else {
+            g_free(compressed);
+        }
+    }
+
+    /* Stale-while-revalidate: show the closest cached answer as a marked,
+     * provisional draft right away; the fresh response replaces it below */
+    if (config->stale_while_revalidate && extension->priv->cache) {
+        data->request->cache_status = LLM_PERF_CACHE_MISS;
+        llm_metrics_add(LLM_METRIC_CACHE_LOOKUPS, 1);
+        gdouble similarity = 1.0;
+        gchar *draft = llm_cache_lookup(extension->priv->cache, data->request->model, selected_text);
+        if (!draft) {
+            draft = llm_cache_lookup_closest(extension->priv->cache,
+                                             data->request->model,
+                                             selected_text,
+                                             config->swr_min_similarity,
+                                             &similarity);
         }
+        if (draft) {
+            data->draft_id = llm_extension_new_draft_id();
+            data->draft_from_cache = TRUE;
+            data->request->cache_status = LLM_PERF_CACHE_STALE;
+            llm_metrics_add(LLM_METRIC_CACHE_HITS, 1);
+            llm_extension_insert_draft(extension, data->draft_id, draft);
+            g_print("LLM Assistant: Showing cached draft (similarity %.2f)\n", similarity);
+            g_free(draft);
+        }
+    }
+
+    /* Draft-then-refine: a fast model streams a first draft that the
+     * configured model's answer replaces when it is done. The draft is
+     * extra spend, so it goes first when a budget runs low. */
+    if (config->draft_model && *config->draft_model && !data->draft_id &&
+        g_strcmp0(config->draft_model, data->request->model) != 0 &&
+        llm_budget_get_level(llm_budget_get_default(), config) == LLM_BUDGET_OK) {
+        data->draft_request = llm_request_new();
+        data->draft_request->work_class = LLM_WORK_SPECULATIVE;
+        data->draft_request->prompt = g_strdup(data->request->prompt);
+        data->draft_request->compressed_prompt = g_strdup(data->request->compressed_prompt);
+        data->draft_request->grounding = g_strdup(data->request->grounding);
+        data->draft_request->model = g_strdup(config->draft_model);
+    }
+
+    /* Streamed text goes into a draft element as it arrives; without a
+     * cached draft a placeholder marks where it will appear. With a draft
+     * model only the draft is streamed. */
+    if (config->stream_responses || data->draft_request) {
+        data->token_queue = llm_token_queue_new();
+    }
+
+    if (data->token_queue) {
+        if (!data->draft_id) {
+            data->draft_id = llm_extension_new_draft_id();
+            llm_extension_insert_draft(extension, data->draft_id, "\u2026");
+        }
+
+        (data->draft_request ? data->draft_request : data->request)->token_queue = data->token_queue;
+        data->stream_source = llm_token_queue_source_new(data->token_queue);
+        g_source_set_callback(data->stream_source,
+                              (GSourceFunc)(void (*)(void))on_stream_tokens,
+                              data, NULL);
+        g_source_attach(data->stream_source, NULL);
+    }
+
+    if (!data->draft_id) {
+        data->progress_dialog = gtk_message_dialog_new(
+            GTK_WINDOW(extension->priv->current_composer),
+            GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+            GTK_MESSAGE_INFO,
+            GTK_BUTTONS_NONE,
+            "Generating response...");
+        g_object_add_weak_pointer(G_OBJECT(data->progress_dialog),
+                                  (gpointer *)&data->progress_dialog);
+        gtk_widget_show(data->progress_dialog);
+    }
+
+    if (!extension->priv->cancellable) {
+        extension->priv->cancellable = g_cancellable_new();
+    }
+
+    data->cancellable = g_cancellable_new();
+    if (data->draft_request) {
+        data->draft_cancellable = g_cancellable_new();
+    }
+    data->parent_cancellable = g_object_ref(extension->priv->cancellable);
+    data->parent_handler = g_cancellable_connect(data->parent_cancellable,
+                                                 G_CALLBACK(on_generation_cancelled),
+                                                 data, NULL);
+
+    if (data->draft_request) {
+        g_print("LLM Assistant: Streaming a draft from %s\n", data->draft_request->model);
+        data->pending++;
+        llm_client_generate_response_async(extension->priv->llm_client,
+                                           data->draft_request,
+                                           data->draft_cancellable,
+                                           on_draft_response_ready,
+                                           data);
+    }
+
+    /* Files attached to the message being answered are added as context */
+    gchar *folder_uri = NULL;
+    gchar *message_uid = NULL;
+    CamelMessageFlags flags = 0;
+
+    if (config->attachments_enabled && config->attachment_max_tokens > 0 &&
+        e_msg_composer_get_source_headers(extension->priv->current_composer,
+                                          &folder_uri, &message_uid, &flags)) {
+        CamelSession *session = e_msg_composer_ref_session(extension->priv->current_composer);
+
+        data->pending++;
+        llm_attachment_extract_async(session, folder_uri, message_uid,
+                                     config->attachment_max_tokens,
+                                     extension->priv->cancellable,
+                                     on_attachments_ready,
+                                     data);
+        g_object_unref(session);
     } else {
-        GtkWidget *error_dialog = gtk_message_dialog_new(
-            GTK_WINDOW(data->extension->priv->current_composer),
-            GTK_DIALOG_MODAL,
-            GTK_MESSAGE_ERROR,
-            GTK_BUTTONS_OK,
-            "Failed to generate response. Please check your internet connection and API key.");
-        gtk_dialog_run(GTK_DIALOG(error_dialog));
-        gtk_widget_destroy(error_dialog);
+        llm_extension_start_generation(data);
     }
 
-    llm_request_free(request);
-    llm_process_data_free(data);
+    g_free(folder_uri);
+    g_free(message_uid);
+    g_free(selected_text);
 }
 
 /* Recursively search for WebKitWebView in the widget tree */
@@ -357,12 +1551,20 @@ llm_extension_process_prompt(ELLMExtension *extension) {
         return;
     }
 
+    llm_bench_mark(LLM_BENCH_WEB_VIEW);
     g_print("LLM Assistant: Found WebKitWebView, getting selection...\n");
 
     LLMProcessData *data = llm_process_data_new(extension);
 
     /* Use new API: webkit_web_view_evaluate_javascript */
-    const gchar *js_code = "window.getSelection().toString();";
+    const gchar *js_code =
+        "(function() {"
+        "  var selection = window.getSelection();"
+        "  var container = document.createElement('div');"
+        "  for (var i = 0; i < selection.rangeCount; i++)"
+        "    container.appendChild(selection.getRangeAt(i).cloneContents());"
+        "  return container.innerHTML;"
+        "})();";
     webkit_web_view_evaluate_javascript(
         web_view,
         js_code,
@@ -384,6 +1586,11 @@ llm_extension_constructed(GObject *object) {
 
     if (E_IS_MSG_COMPOSER(extensible)) {
         llm_extension_setup_composer(extension, E_MSG_COMPOSER(extensible));
+        extension->priv->init_idle_id = g_idle_add_full(G_PRIORITY_LOW, on_init_idle, extension, NULL);
+    }
+
+    if (llm_bench_get_runs() > 0) {
+        llm_bench_record_open(g_get_monotonic_time() - extension->priv->open_start);
     }
 }
 
@@ -399,6 +1606,18 @@ llm_extension_dispose(GObject *object) {
         extension->priv->llm_client = NULL;
     }
 
+    extension->priv->cache = NULL;
+
+    if (extension->priv->canned_index) {
+        llm_canned_index_free(extension->priv->canned_index);
+        extension->priv->canned_index = NULL;
+    }
+
+    if (extension->priv->triage_model) {
+        llm_triage_model_free(extension->priv->triage_model);
+        extension->priv->triage_model = NULL;
+    }
+
     if (extension->priv->config) {
         config_free(extension->priv->config);
         extension->priv->config = NULL;
@@ -427,11 +1646,7 @@ e_llm_extension_class_finalize(ELLMExtensionClass *class G_GNUC_UNUSED) {
 static void
 e_llm_extension_init(ELLMExtension *extension) {
     extension->priv = e_llm_extension_get_instance_private(extension);
-
-    extension->priv->config = config_load();
-    if (extension->priv->config) {
-        extension->priv->llm_client = llm_client_new(extension->priv->config);
-    }
+    extension->priv->open_start = g_get_monotonic_time();
 }
 
 void
@@ -442,6 +1657,7 @@ e_llm_extension_type_register(GTypeModule *type_module) {
 G_MODULE_EXPORT void
 e_module_load(GTypeModule *type_module) {
     e_llm_extension_type_register(type_module);
+    e_llm_reader_extension_type_register(type_module);
 }
 
 G_MODULE_EXPORT void
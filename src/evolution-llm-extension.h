@@ -21,6 +21,11 @@
 #include <gtk/gtk.h>
 
 #include "llm_client.h"
+#include "llm_cache.h"
+#include "llm_canned.h"
+#include "llm_triage.h"
+#include "llm_history.h"
+#include "llm_review.h"
 #include "../config/config.h"
 
 #define E_TYPE_LLM_EXTENSION \
@@ -57,7 +62,23 @@ struct _ELLMExtensionClass {
 struct _ELLMExtensionPrivate {
     PluginConfig *config;
     LLMClient *llm_client;
+    LLMCache *cache;           /* shared by all composers, not owned */
+    LLMCannedIndex *canned_index; /* built on first use */
+    LLMTriageModel *triage_model; /* loaded on first use */
     EMsgComposer *current_composer;
+    GCancellable *cancellable; /* cancels in-flight generations on composer close */
+    gboolean initialized;      /* config, client and cache are loaded */
+    guint init_idle_id;        /* pending idle-time initialization */
+    gint64 open_start;         /* when the composer began creating the extension */
+    gboolean bench_active;     /* this composer runs the LLM_ASSISTANT_BENCH benchmark */
+    guint bench_timeout_id;    /* pending hotkey of the next benchmark run */
+    guint bench_opened;        /* composers opened after the benchmark runs */
+    guint review_timeout_id;   /* periodic look at the draft for the pre-send review */
+    gboolean review_reading;   /* the draft is being read from the editor */
+    WebKitWebView *review_web_view; /* editor view, looked up once per composer (weak) */
+    gchar *review_text;        /* draft as seen at the last look */
+    LLMReviewDraft *review_draft; /* the same, split into paragraphs */
+    gboolean review_submitted; /* review_draft was handed to the review */
 };
 
 GType e_llm_extension_get_type(void) G_GNUC_CONST;
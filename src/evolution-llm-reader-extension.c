@@ -0,0 +1,342 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Reader extension that shows suggested replies above the selected message.
+ * Clicking one opens a reply composer and fills in the full reply written
+ * from that suggestion.
+ */
+
+#include "evolution-llm-reader-extension.h"
+#include "llm_smart_reply.h"
+#include "../config/config.h"
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED(ELLMReaderExtension, e_llm_reader_extension, E_TYPE_EXTENSION, 0,
+    G_ADD_PRIVATE_DYNAMIC(ELLMReaderExtension))
+
+#define LLM_INTENT_KEY "llm-smart-reply-intent"
+
+typedef struct {
+    gchar *message_id;        /* of the message the reply answers */
+    EMsgComposer *composer;   /* weak */
+    gchar *text;
+    gboolean waiting_composer;
+    gboolean waiting_text;
+} LLMReplyData;
+
+/* Free the reply data once both the composer and the reply are known */
+static void
+llm_reply_data_release(LLMReplyData *data) {
+    if (data->waiting_composer || data->waiting_text) return;
+
+    if (data->composer) {
+        g_object_remove_weak_pointer(G_OBJECT(data->composer), (gpointer *)&data->composer);
+    }
+    g_free(data->message_id);
+    g_free(data->text);
+    g_free(data);
+}
+
+static void
+on_editor_load_finished(EContentEditor *content_editor, gchar *text) {
+    g_signal_handlers_disconnect_by_func(content_editor, on_editor_load_finished, text);
+    e_content_editor_insert_content(content_editor, text, E_CONTENT_EDITOR_INSERT_TEXT_PLAIN);
+    g_free(text);
+}
+
+/* Insert the reply, waiting for the editor to load the quoted message first */
+static void
+llm_reader_extension_insert_reply(EMsgComposer *composer, const gchar *text) {
+    EHTMLEditor *html_editor = e_msg_composer_get_editor(composer);
+    EContentEditor *content_editor = html_editor ? e_html_editor_get_content_editor(html_editor) : NULL;
+    if (!content_editor) {
+        g_warning("LLM Smart Reply: Could not get content editor");
+        return;
+    }
+
+    if (e_content_editor_is_ready(content_editor)) {
+        e_content_editor_insert_content(content_editor, text, E_CONTENT_EDITOR_INSERT_TEXT_PLAIN);
+    } else {
+        g_signal_connect(content_editor, "load-finished",
+                         G_CALLBACK(on_editor_load_finished), g_strdup(text));
+    }
+    g_print("LLM Smart Reply: Reply inserted\n");
+}
+
+static void
+llm_reply_data_try_insert(LLMReplyData *data) {
+    if (data->waiting_composer || data->waiting_text) return;
+
+    if (data->composer && data->text) {
+        llm_reader_extension_insert_reply(data->composer, data->text);
+    }
+    llm_reply_data_release(data);
+}
+
+/* Stop waiting for a composer; the reply is dropped when it arrives */
+static void
+llm_reader_extension_detach_reply(ELLMReaderExtension *extension) {
+    LLMReplyData *data = extension->priv->pending_reply;
+    if (!data) return;
+
+    extension->priv->pending_reply = NULL;
+    data->waiting_composer = FALSE;
+    llm_reply_data_try_insert(data);
+}
+
+static void
+on_reply_generated(GObject *source G_GNUC_UNUSED, GAsyncResult *result, gpointer user_data) {
+    LLMReplyData *data = user_data;
+    GError *error = NULL;
+
+    data->text = llm_smart_reply_generate_finish(result, &error);
+    data->waiting_text = FALSE;
+
+    if (error) {
+        g_warning("LLM Smart Reply: %s", error->message);
+        g_error_free(error);
+    }
+
+    llm_reply_data_try_insert(data);
+}
+
+/* Only the composer replying to the clicked message gets the reply; one
+ * opened for another message, e.g. after the selection moved on, does not */
+static void
+on_composer_created(EMailReader *reader G_GNUC_UNUSED,
+                    EMsgComposer *composer,
+                    CamelMimeMessage *message,
+                    ELLMReaderExtension *extension) {
+    LLMReplyData *data = extension->priv->pending_reply;
+    if (!data) return;
+
+    const gchar *message_id = message ? camel_mime_message_get_message_id(message) : NULL;
+    if (message_id && g_strcmp0(message_id, data->message_id) != 0) return;
+
+    extension->priv->pending_reply = NULL;
+    data->composer = composer;
+    g_object_add_weak_pointer(G_OBJECT(composer), (gpointer *)&data->composer);
+    data->waiting_composer = FALSE;
+    llm_reply_data_try_insert(data);
+}
+
+/* Start writing the full reply and open the composer it will go into */
+static void
+on_chip_clicked(GtkButton *button, ELLMReaderExtension *extension) {
+    const gchar *intent = g_object_get_data(G_OBJECT(button), LLM_INTENT_KEY);
+    EExtensible *extensible = e_extension_get_extensible(E_EXTENSION(extension));
+
+    if (!extension->priv->message_id) return;
+
+    g_print("LLM Smart Reply: Replying with \"%s\"\n", intent);
+
+    llm_reader_extension_detach_reply(extension);
+
+    LLMReplyData *data = g_new0(LLMReplyData, 1);
+    data->message_id = g_strdup(extension->priv->message_id);
+    data->waiting_composer = TRUE;
+    data->waiting_text = TRUE;
+    extension->priv->pending_reply = data;
+
+    llm_smart_reply_generate_async(llm_smart_reply_get_default(),
+                                   extension->priv->message_id,
+                                   extension->priv->message,
+                                   intent,
+                                   NULL,
+                                   on_reply_generated,
+                                   data);
+
+    e_mail_reader_reply_to_message(E_MAIL_READER(extensible), NULL, E_MAIL_REPLY_TO_SENDER);
+}
+
+static void
+llm_reader_extension_clear_chips(ELLMReaderExtension *extension) {
+    if (!extension->priv->chips) return;
+
+    GList *children = gtk_container_get_children(GTK_CONTAINER(extension->priv->chips));
+    for (GList *l = children; l != NULL; l = l->next) {
+        if (GTK_IS_BUTTON(l->data)) {
+            gtk_widget_destroy(GTK_WIDGET(l->data));
+        }
+    }
+    g_list_free(children);
+
+    gtk_widget_hide(extension->priv->chips);
+}
+
+/* Create the row of suggestions at the top of the preview pane */
+static gboolean
+llm_reader_extension_ensure_chips(ELLMReaderExtension *extension) {
+    if (extension->priv->chips) return TRUE;
+
+    EExtensible *extensible = e_extension_get_extensible(E_EXTENSION(extension));
+    GtkWidget *preview_pane = e_mail_reader_get_preview_pane(E_MAIL_READER(extensible));
+    if (!GTK_IS_BOX(preview_pane)) {
+        g_warning("LLM Smart Reply: Reader has no preview pane");
+        return FALSE;
+    }
+
+    GtkWidget *chips = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_widget_set_margin_start(chips, 6);
+    gtk_widget_set_margin_end(chips, 6);
+    gtk_widget_set_margin_top(chips, 4);
+    gtk_widget_set_margin_bottom(chips, 4);
+    gtk_box_pack_start(GTK_BOX(chips), gtk_label_new("Reply:"), FALSE, FALSE, 0);
+    gtk_widget_show_all(chips);
+    gtk_widget_set_no_show_all(chips, TRUE);
+
+    gtk_box_pack_start(GTK_BOX(preview_pane), chips, FALSE, FALSE, 0);
+    gtk_box_reorder_child(GTK_BOX(preview_pane), chips, 0);
+
+    extension->priv->chips = chips;
+    g_object_add_weak_pointer(G_OBJECT(chips), (gpointer *)&extension->priv->chips);
+    return TRUE;
+}
+
+static void
+on_intents_ready(GObject *source G_GNUC_UNUSED, GAsyncResult *result, gpointer user_data) {
+    ELLMReaderExtension *extension = E_LLM_READER_EXTENSION(user_data);
+    GError *error = NULL;
+
+    gchar **intents = llm_smart_reply_intents_finish(result, &error);
+    if (!intents) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+            !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+            g_print("LLM Smart Reply: No suggestions: %s\n", error->message);
+        }
+        g_error_free(error);
+        g_object_unref(extension);
+        return;
+    }
+
+    if (llm_reader_extension_ensure_chips(extension)) {
+        for (guint i = 0; intents[i]; i++) {
+            GtkWidget *button = gtk_button_new_with_label(intents[i]);
+            gtk_button_set_relief(GTK_BUTTON(button), GTK_RELIEF_NONE);
+            gtk_widget_set_tooltip_text(button, "Open a reply written from this suggestion");
+            g_object_set_data_full(G_OBJECT(button), LLM_INTENT_KEY, g_strdup(intents[i]), g_free);
+            g_signal_connect(button, "clicked", G_CALLBACK(on_chip_clicked), extension);
+
+            gtk_box_pack_start(GTK_BOX(extension->priv->chips), button, FALSE, FALSE, 0);
+            gtk_widget_show(button);
+        }
+        gtk_widget_show(extension->priv->chips);
+    }
+
+    g_strfreev(intents);
+    g_object_unref(extension);
+}
+
+/* Ask for suggestions for the message that was just shown */
+static void
+on_message_loaded(EMailReader *reader G_GNUC_UNUSED,
+                  const gchar *message_uid,
+                  CamelMimeMessage *message,
+                  ELLMReaderExtension *extension) {
+    if (extension->priv->cancellable) {
+        g_cancellable_cancel(extension->priv->cancellable);
+        g_clear_object(&extension->priv->cancellable);
+    }
+    llm_reader_extension_clear_chips(extension);
+
+    g_clear_pointer(&extension->priv->message_id, g_free);
+    g_clear_object(&extension->priv->message);
+
+    if (!message) return;
+
+    /* The text is read by the smart-reply worker, not here */
+    const gchar *message_id = camel_mime_message_get_message_id(message);
+    extension->priv->message_id = g_strdup(message_id ? message_id : message_uid);
+    extension->priv->message = g_object_ref(message);
+    extension->priv->cancellable = g_cancellable_new();
+
+    llm_smart_reply_intents_async(llm_smart_reply_get_default(),
+                                  extension->priv->message_id,
+                                  extension->priv->message,
+                                  extension->priv->cancellable,
+                                  on_intents_ready,
+                                  g_object_ref(extension));
+}
+
+/* GObject lifecycle methods */
+static void
+llm_reader_extension_constructed(GObject *object) {
+    ELLMReaderExtension *extension = E_LLM_READER_EXTENSION(object);
+
+    G_OBJECT_CLASS(e_llm_reader_extension_parent_class)->constructed(object);
+
+    EExtensible *extensible = e_extension_get_extensible(E_EXTENSION(extension));
+
+    /* The setting is read once per reader window */
+    PluginConfig *config = config_load();
+    gboolean enabled = config && config->smart_reply_enabled;
+    config_free(config);
+
+    if (!enabled) return;
+
+    g_signal_connect(extensible, "message-loaded", G_CALLBACK(on_message_loaded), extension);
+    g_signal_connect(extensible, "composer-created", G_CALLBACK(on_composer_created), extension);
+}
+
+/* GObject dispose method */
+static void
+llm_reader_extension_dispose(GObject *object) {
+    ELLMReaderExtension *extension = E_LLM_READER_EXTENSION(object);
+    EExtensible *extensible = e_extension_get_extensible(E_EXTENSION(extension));
+
+    if (extensible) {
+        g_signal_handlers_disconnect_by_data(extensible, extension);
+    }
+
+    if (extension->priv->cancellable) {
+        g_cancellable_cancel(extension->priv->cancellable);
+        g_clear_object(&extension->priv->cancellable);
+    }
+
+    llm_reader_extension_detach_reply(extension);
+
+    if (extension->priv->chips) {
+        g_object_remove_weak_pointer(G_OBJECT(extension->priv->chips),
+                                     (gpointer *)&extension->priv->chips);
+        gtk_widget_destroy(extension->priv->chips);
+        extension->priv->chips = NULL;
+    }
+
+    g_clear_pointer(&extension->priv->message_id, g_free);
+    g_clear_object(&extension->priv->message);
+
+    G_OBJECT_CLASS(e_llm_reader_extension_parent_class)->dispose(object);
+}
+
+/* Class initialization */
+
+static void
+e_llm_reader_extension_class_init(ELLMReaderExtensionClass *class) {
+    GObjectClass *object_class = G_OBJECT_CLASS(class);
+    EExtensionClass *extension_class = E_EXTENSION_CLASS(class);
+
+    object_class->constructed = llm_reader_extension_constructed;
+    object_class->dispose = llm_reader_extension_dispose;
+
+    extension_class->extensible_type = E_TYPE_MAIL_READER;
+}
+
+static void
+e_llm_reader_extension_class_finalize(ELLMReaderExtensionClass *class G_GNUC_UNUSED) {
+}
+
+static void
+e_llm_reader_extension_init(ELLMReaderExtension *extension) {
+    extension->priv = e_llm_reader_extension_get_instance_private(extension);
+}
+
+void
+e_llm_reader_extension_type_register(GTypeModule *type_module) {
+    e_llm_reader_extension_register_type(type_module);
+}
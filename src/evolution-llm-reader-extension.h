@@ -0,0 +1,63 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef EVOLUTION_LLM_READER_EXTENSION_H
+#define EVOLUTION_LLM_READER_EXTENSION_H
+
+#include <glib-object.h>
+#include <composer/e-msg-composer.h>
+#include <mail/e-mail-reader.h>
+#include <e-util/e-util.h>
+#include <gtk/gtk.h>
+
+#define E_TYPE_LLM_READER_EXTENSION \
+    (e_llm_reader_extension_get_type())
+#define E_LLM_READER_EXTENSION(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), E_TYPE_LLM_READER_EXTENSION, ELLMReaderExtension))
+#define E_LLM_READER_EXTENSION_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), E_TYPE_LLM_READER_EXTENSION, ELLMReaderExtensionClass))
+#define E_IS_LLM_READER_EXTENSION(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), E_TYPE_LLM_READER_EXTENSION))
+#define E_IS_LLM_READER_EXTENSION_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), E_TYPE_LLM_READER_EXTENSION))
+#define E_LLM_READER_EXTENSION_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), E_TYPE_LLM_READER_EXTENSION, ELLMReaderExtensionClass))
+
+typedef struct _ELLMReaderExtension ELLMReaderExtension;
+typedef struct _ELLMReaderExtensionClass ELLMReaderExtensionClass;
+typedef struct _ELLMReaderExtensionPrivate ELLMReaderExtensionPrivate;
+
+struct _ELLMReaderExtension {
+    EExtension parent;
+    ELLMReaderExtensionPrivate *priv;
+};
+
+struct _ELLMReaderExtensionClass {
+    EExtensionClass parent_class;
+};
+
+struct _ELLMReaderExtensionPrivate {
+    GtkWidget *chips;          /* row of suggested replies above the message, created on first use */
+    gchar *message_id;         /* of the message shown in the reader */
+    CamelMimeMessage *message;
+    GCancellable *cancellable; /* cancels the intents request of the previous message */
+    gpointer pending_reply;    /* clicked suggestion waiting for its composer */
+};
+
+GType e_llm_reader_extension_get_type(void) G_GNUC_CONST;
+void e_llm_reader_extension_type_register(GTypeModule *type_module);
+
+#endif /* EVOLUTION_LLM_READER_EXTENSION_H */
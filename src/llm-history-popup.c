@@ -0,0 +1,176 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Search popup over the generation history, used to reinsert a past
+ * response into the composer without calling the model again.
+ */
+
+#include "llm-history-popup.h"
+#include <string.h>
+
+typedef struct {
+    GtkWidget *window;
+    GtkWidget *search_entry;
+    GtkWidget *list_box;
+
+    LLMHistory *history;
+    LLMHistoryPickCallback pick_callback;
+    gpointer user_data;
+} LLMHistoryPopup;
+
+/**
+ * Free the popup structure when its window goes away
+ */
+static void
+on_popup_destroy(GtkWidget *window G_GNUC_UNUSED, LLMHistoryPopup *popup) {
+    g_free(popup);
+}
+
+/**
+ * Build the list row for one history record
+ */
+static GtkWidget*
+create_record_row(const LLMHistoryRecord *record) {
+    gchar *title = g_strndup(record->prompt, strcspn(record->prompt, "\n"));
+    GDateTime *time = g_date_time_new_from_unix_local(record->timestamp);
+    gchar *date = time ? g_date_time_format(time, "%Y-%m-%d %H:%M") : g_strdup("");
+    gchar *markup = g_markup_printf_escaped(
+        "<b>%s</b>\n<small>%s · %s · %.1f s · %d tokens</small>\n%s",
+        title, date, record->model,
+        record->latency_ms / 1000.0,
+        record->prompt_tokens + record->completion_tokens,
+        record->response);
+
+    GtkWidget *label = gtk_label_new(NULL);
+    gtk_label_set_markup(GTK_LABEL(label), markup);
+    gtk_label_set_xalign(GTK_LABEL(label), 0.0);
+    gtk_label_set_ellipsize(GTK_LABEL(label), PANGO_ELLIPSIZE_END);
+    gtk_label_set_lines(GTK_LABEL(label), 4);
+    gtk_label_set_line_wrap(GTK_LABEL(label), TRUE);
+    gtk_widget_set_margin_start(label, 6);
+    gtk_widget_set_margin_end(label, 6);
+    gtk_widget_set_margin_top(label, 4);
+    gtk_widget_set_margin_bottom(label, 4);
+
+    GtkWidget *row = gtk_list_box_row_new();
+    gtk_container_add(GTK_CONTAINER(row), label);
+    /* Records are never removed from the history, so the pointer stays valid */
+    g_object_set_data(G_OBJECT(row), "llm-history-record", (gpointer)record);
+
+    g_free(markup);
+    g_free(date);
+    if (time) g_date_time_unref(time);
+    g_free(title);
+
+    return row;
+}
+
+/**
+ * Refill the result list for the current search text
+ */
+static void
+on_search_changed(GtkSearchEntry *entry, LLMHistoryPopup *popup) {
+    GList *children = gtk_container_get_children(GTK_CONTAINER(popup->list_box));
+    for (GList *l = children; l; l = l->next) {
+        gtk_widget_destroy(GTK_WIDGET(l->data));
+    }
+    g_list_free(children);
+
+    GPtrArray *results = llm_history_search(popup->history,
+                                            gtk_entry_get_text(GTK_ENTRY(entry)),
+                                            HISTORY_SEARCH_LIMIT);
+    for (guint i = 0; i < results->len; i++) {
+        gtk_container_add(GTK_CONTAINER(popup->list_box),
+                          create_record_row(g_ptr_array_index(results, i)));
+    }
+    g_ptr_array_unref(results);
+
+    gtk_widget_show_all(popup->list_box);
+}
+
+/**
+ * Hand the chosen response to the caller and close the popup
+ */
+static void
+on_row_activated(GtkListBox *list_box G_GNUC_UNUSED, GtkListBoxRow *row, LLMHistoryPopup *popup) {
+    const LLMHistoryRecord *record = g_object_get_data(G_OBJECT(row), "llm-history-record");
+
+    if (record && popup->pick_callback) {
+        popup->pick_callback(record->response, popup->user_data);
+    }
+
+    gtk_widget_destroy(popup->window);
+}
+
+/**
+ * Enter in the search entry picks the newest match
+ */
+static void
+on_search_activate(GtkEntry *entry G_GNUC_UNUSED, LLMHistoryPopup *popup) {
+    GtkListBoxRow *row = gtk_list_box_get_row_at_index(GTK_LIST_BOX(popup->list_box), 0);
+    if (row) on_row_activated(GTK_LIST_BOX(popup->list_box), row, popup);
+}
+
+/**
+ * Escape closes the popup
+ */
+static void
+on_stop_search(GtkSearchEntry *entry G_GNUC_UNUSED, LLMHistoryPopup *popup) {
+    gtk_widget_destroy(popup->window);
+}
+
+void
+llm_history_popup_show(GtkWindow *parent_window,
+                       LLMHistory *history,
+                       LLMHistoryPickCallback pick_callback,
+                       gpointer user_data) {
+    LLMHistoryPopup *popup = g_new0(LLMHistoryPopup, 1);
+    popup->history = history;
+    popup->pick_callback = pick_callback;
+    popup->user_data = user_data;
+
+    popup->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(popup->window), "LLM Assistant History");
+    gtk_window_set_default_size(GTK_WINDOW(popup->window), 600, 450);
+    gtk_window_set_modal(GTK_WINDOW(popup->window), TRUE);
+    gtk_window_set_destroy_with_parent(GTK_WINDOW(popup->window), TRUE);
+    if (parent_window) {
+        gtk_window_set_transient_for(GTK_WINDOW(popup->window), parent_window);
+        gtk_window_set_position(GTK_WINDOW(popup->window), GTK_WIN_POS_CENTER_ON_PARENT);
+    }
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    gtk_container_set_border_width(GTK_CONTAINER(box), 6);
+    gtk_container_add(GTK_CONTAINER(popup->window), box);
+
+    popup->search_entry = gtk_search_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(popup->search_entry), "Search past responses");
+    gtk_box_pack_start(GTK_BOX(box), popup->search_entry, FALSE, FALSE, 0);
+
+    GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
+                                   GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_box_pack_start(GTK_BOX(box), scrolled, TRUE, TRUE, 0);
+
+    popup->list_box = gtk_list_box_new();
+    gtk_list_box_set_activate_on_single_click(GTK_LIST_BOX(popup->list_box), FALSE);
+    gtk_container_add(GTK_CONTAINER(scrolled), popup->list_box);
+
+    g_signal_connect(popup->search_entry, "search-changed", G_CALLBACK(on_search_changed), popup);
+    g_signal_connect(popup->search_entry, "activate", G_CALLBACK(on_search_activate), popup);
+    g_signal_connect(popup->search_entry, "stop-search", G_CALLBACK(on_stop_search), popup);
+    g_signal_connect(popup->list_box, "row-activated", G_CALLBACK(on_row_activated), popup);
+    g_signal_connect(popup->window, "destroy", G_CALLBACK(on_popup_destroy), popup);
+
+    on_search_changed(GTK_SEARCH_ENTRY(popup->search_entry), popup);
+
+    gtk_widget_show_all(popup->window);
+    gtk_widget_grab_focus(popup->search_entry);
+}
@@ -0,0 +1,46 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_HISTORY_POPUP_H
+#define LLM_HISTORY_POPUP_H
+
+#include <gtk/gtk.h>
+#include "llm_history.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Callback function type called when the user picks a past response
+ *
+ * @param response The chosen response text
+ * @param user_data User data passed to callback
+ */
+typedef void (*LLMHistoryPickCallback)(const gchar *response, gpointer user_data);
+
+/**
+ * Show a search popup over the generation history
+ *
+ * The list follows the search entry as the user types. Activating a row
+ * calls pick_callback and closes the popup.
+ *
+ * @param parent_window Optional parent window
+ * @param history The generation history to search
+ * @param pick_callback Callback function called with the chosen response
+ * @param user_data User data passed to callback
+ */
+void llm_history_popup_show(GtkWindow *parent_window,
+                            LLMHistory *history,
+                            LLMHistoryPickCallback pick_callback,
+                            gpointer user_data);
+
+G_END_DECLS
+
+#endif /* LLM_HISTORY_POPUP_H */
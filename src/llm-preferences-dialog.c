@@ -13,6 +13,9 @@
  */
 
 #include "llm-preferences-dialog.h"
+#include "llm_cache_pack.h"
+#include "llm_catalog.h"
+#include "llm_triage.h"
 #include <string.h>
 
 struct _LLMPreferencesDialog {
@@ -20,24 +23,16 @@ struct _LLMPreferencesDialog {
     GtkWidget *api_key_entry;
     GtkWidget *model_combo;
     GtkWidget *system_prompt_text;
+    GtkWidget *pack_dir_chooser;
+    GtkWidget *triage_dir_chooser;
+    GtkWidget *triage_train_button;
 
     PluginConfig *config;
+    LLMCache *cache;
     LLMPreferencesSaveCallback save_callback;
     gpointer user_data;
 };
 
-/* Available OpenAI models */
-static const struct {
-    const gchar *id;
-    const gchar *display_name;
-} available_models[] = {
-    { "gpt-4o", "GPT-4o (Most capable, expensive)" },
-    { "gpt-4o-mini", "GPT-4o Mini (Recommended, balanced)" },
-    { "gpt-4-turbo", "GPT-4 Turbo (Fast, capable)" },
-    { "gpt-4", "GPT-4 (Capable, slower)" },
-    { "gpt-3.5-turbo", "GPT-3.5 Turbo (Fast, affordable)" },
-};
-
 /**
  * Free the preferences dialog structure
  */
@@ -47,6 +42,150 @@ llm_preferences_dialog_free(LLMPreferencesDialog *prefs) {
     g_free(prefs);
 }
 
+/**
+ * Show the outcome of a pack export or import
+ */
+static void
+show_pack_result(LLMPreferencesDialog *prefs, GtkMessageType type, const gchar *message) {
+    GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(prefs->dialog),
+                                               GTK_DIALOG_MODAL,
+                                               type,
+                                               GTK_BUTTONS_OK,
+                                               "%s", message);
+    gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+}
+
+/**
+ * Export the personal response cache as a shareable pack file
+ */
+static void
+on_export_pack_clicked(GtkButton *button G_GNUC_UNUSED, LLMPreferencesDialog *prefs) {
+    GtkWidget *chooser = gtk_file_chooser_dialog_new("Export Cache Pack",
+                                                     GTK_WINDOW(prefs->dialog),
+                                                     GTK_FILE_CHOOSER_ACTION_SAVE,
+                                                     "_Cancel", GTK_RESPONSE_CANCEL,
+                                                     "_Export", GTK_RESPONSE_ACCEPT,
+                                                     NULL);
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(chooser), TRUE);
+    gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(chooser), "responses" CACHE_PACK_SUFFIX);
+
+    if (gtk_dialog_run(GTK_DIALOG(chooser)) == GTK_RESPONSE_ACCEPT) {
+        gchar *path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(chooser));
+        GError *error = NULL;
+
+        if (llm_cache_export_pack(prefs->cache, path, &error)) {
+            show_pack_result(prefs, GTK_MESSAGE_INFO, "Cache pack exported.");
+        } else {
+            show_pack_result(prefs, GTK_MESSAGE_ERROR, error ? error->message : "Export failed.");
+            g_clear_error(&error);
+        }
+        g_free(path);
+    }
+
+    gtk_widget_destroy(chooser);
+}
+
+/**
+ * Copy the entries of a pack file into the personal response cache
+ */
+static void
+on_import_pack_clicked(GtkButton *button G_GNUC_UNUSED, LLMPreferencesDialog *prefs) {
+    GtkWidget *chooser = gtk_file_chooser_dialog_new("Import Cache Pack",
+                                                     GTK_WINDOW(prefs->dialog),
+                                                     GTK_FILE_CHOOSER_ACTION_OPEN,
+                                                     "_Cancel", GTK_RESPONSE_CANCEL,
+                                                     "_Import", GTK_RESPONSE_ACCEPT,
+                                                     NULL);
+    GtkFileFilter *filter = gtk_file_filter_new();
+    gtk_file_filter_set_name(filter, "Cache packs");
+    gtk_file_filter_add_pattern(filter, "*" CACHE_PACK_SUFFIX);
+    gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(chooser), filter);
+
+    if (gtk_dialog_run(GTK_DIALOG(chooser)) == GTK_RESPONSE_ACCEPT) {
+        gchar *path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(chooser));
+        GError *error = NULL;
+        gint imported = llm_cache_import_pack(prefs->cache, path, &error);
+
+        if (imported >= 0) {
+            gchar *message = g_strdup_printf("Imported %d cached responses.", imported);
+            show_pack_result(prefs, GTK_MESSAGE_INFO, message);
+            g_free(message);
+        } else {
+            show_pack_result(prefs, GTK_MESSAGE_ERROR, error ? error->message : "Import failed.");
+            g_clear_error(&error);
+        }
+        g_free(path);
+    }
+
+    gtk_widget_destroy(chooser);
+}
+
+/**
+ * Train the triage classifier in a worker thread
+ */
+static void
+train_triage_thread(GTask *task,
+                    gpointer source_object G_GNUC_UNUSED,
+                    gpointer task_data,
+                    GCancellable *cancellable G_GNUC_UNUSED) {
+    const gchar *training_dir = task_data;
+    GError *error = NULL;
+    LLMTriageModel *model = llm_triage_model_train(training_dir, &error);
+
+    if (model) {
+        gchar *path = llm_triage_get_model_path();
+        llm_triage_model_save(model, path, &error);
+        llm_triage_model_free(model);
+        g_free(path);
+    }
+
+    if (error) {
+        g_task_return_error(task, error);
+    } else {
+        g_task_return_boolean(task, TRUE);
+    }
+}
+
+/**
+ * Report the training outcome, unless the dialog was closed meanwhile
+ */
+static void
+on_train_triage_done(GObject *source, GAsyncResult *result, gpointer user_data G_GNUC_UNUSED) {
+    GtkWidget *dialog = GTK_WIDGET(source);
+    GError *error = NULL;
+    gboolean trained = g_task_propagate_boolean(G_TASK(result), &error);
+
+    g_print("LLM Preferences: Triage training %s\n", trained ? "finished" : "failed");
+
+    if (gtk_widget_get_visible(dialog)) {
+        LLMPreferencesDialog *prefs = g_object_get_data(G_OBJECT(dialog), "llm-preferences");
+        gtk_widget_set_sensitive(prefs->triage_train_button, TRUE);
+        show_pack_result(prefs, trained ? GTK_MESSAGE_INFO : GTK_MESSAGE_ERROR,
+                         trained ? "Triage model trained." :
+                                   (error ? error->message : "Training failed."));
+    }
+
+    g_clear_error(&error);
+}
+
+static void
+on_train_triage_clicked(GtkButton *button G_GNUC_UNUSED, LLMPreferencesDialog *prefs) {
+    gchar *training_dir = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(prefs->triage_dir_chooser));
+
+    if (!training_dir) {
+        show_pack_result(prefs, GTK_MESSAGE_WARNING, "Select the folder with labelled mail first.");
+        return;
+    }
+
+    gtk_widget_set_sensitive(prefs->triage_train_button, FALSE);
+
+    GTask *task = g_task_new(prefs->dialog, NULL, on_train_triage_done, NULL);
+    g_task_set_task_data(task, training_dir, g_free);
+    g_task_run_in_thread(task, train_triage_thread);
+    g_object_unref(task);
+}
+
 /**
  * Handle dialog response (OK or Cancel)
  */
@@ -63,12 +202,8 @@ on_preferences_response(GtkDialog *dialog, gint response_id, LLMPreferencesDialo
             g_strdup(gtk_entry_get_text(GTK_ENTRY(prefs->api_key_entry)));
 
         /* Get selected model from combo box */
-        gint active_index = gtk_combo_box_get_active(GTK_COMBO_BOX(prefs->model_combo));
-        if (active_index >= 0 && active_index < (gint)(sizeof(available_models) / sizeof(available_models[0]))) {
-            prefs->config->model = g_strdup(available_models[active_index].id);
-        } else {
-            prefs->config->model = g_strdup("gpt-4o-mini"); /* fallback */
-        }
+        const gchar *model_id = gtk_combo_box_get_active_id(GTK_COMBO_BOX(prefs->model_combo));
+        prefs->config->model = g_strdup(model_id ? model_id : DEFAULT_MODEL);
 
         /* Get system prompt from text view */
         GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(prefs->system_prompt_text));
@@ -77,6 +212,16 @@ on_preferences_response(GtkDialog *dialog, gint response_id, LLMPreferencesDialo
         prefs->config->system_prompt =
             gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
 
+        /* Get shared pack directory from folder chooser */
+        g_free(prefs->config->cache_pack_dir);
+        prefs->config->cache_pack_dir =
+            gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(prefs->pack_dir_chooser));
+
+        /* Get triage training folder from folder chooser */
+        g_free(prefs->config->triage_training_dir);
+        prefs->config->triage_training_dir =
+            gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(prefs->triage_dir_chooser));
+
         /* Call the save callback if provided */
         if (prefs->save_callback) {
             prefs->save_callback(prefs->config, prefs->user_data);
@@ -93,12 +238,14 @@ on_preferences_response(GtkDialog *dialog, gint response_id, LLMPreferencesDialo
  *
  * @param parent_window Optional parent window for modal dialog
  * @param config Current configuration to display
+ * @param cache Response cache for pack export/import (may be NULL)
  * @param save_callback Callback function called when user saves preferences
  * @param user_data User data passed to callback
  */
 void
 llm_preferences_dialog_show(GtkWindow *parent_window,
                              PluginConfig *config,
+                             LLMCache *cache,
                              LLMPreferencesSaveCallback save_callback,
                              gpointer user_data)
 {
@@ -110,6 +257,7 @@ llm_preferences_dialog_show(GtkWindow *parent_window,
     /* Allocate dialog structure */
     LLMPreferencesDialog *prefs = g_new0(LLMPreferencesDialog, 1);
     prefs->config = config;
+    prefs->cache = cache;
     prefs->save_callback = save_callback;
     prefs->user_data = user_data;
 
@@ -155,53 +303,57 @@ llm_preferences_dialog_show(GtkWindow *parent_window,
     gtk_widget_set_halign(model_label, GTK_ALIGN_START);
 
     prefs->model_combo = gtk_combo_box_text_new();
-    gint selected_index = -1;
-
-    /* Try to fetch models from OpenAI API */
-    gchar **fetched_models = NULL;
-    if (config->openai_api_key && strlen(config->openai_api_key) > 10) {
-        g_print("LLM Preferences: Fetching available models from OpenAI...\n");
-        fetched_models = llm_client_fetch_available_models(config->openai_api_key);
+    const gchar *current_model = config->model ? config->model : DEFAULT_MODEL;
+    gboolean current_listed = FALSE;
+
+    /* Refresh the shared model catalog if it is older than a day */
+    LLMCatalog *catalog = llm_catalog_get_default();
+    if (llm_catalog_is_stale(catalog) && (config_is_valid(config) || config->model_endpoints)) {
+        g_print("LLM Preferences: Refreshing the model catalog...\n");
+        llm_catalog_refresh(catalog, config);
     }
 
-    if (fetched_models && fetched_models[0]) {
-        /* Use fetched models */
-        g_print("LLM Preferences: Using %d models from API\n", g_strv_length(fetched_models));
-        for (gsize i = 0; fetched_models[i] != NULL; i++) {
-            gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(prefs->model_combo),
-                                      fetched_models[i],
-                                      fetched_models[i]);
-            /* Check if this is the current model */
-            if (config->model && g_strcmp0(config->model, fetched_models[i]) == 0) {
-                selected_index = i;
-            }
+    GPtrArray *models = llm_catalog_list(catalog);
+    g_print("LLM Preferences: Listing %u models from the catalog\n", models->len);
+    for (guint i = 0; i < models->len; i++) {
+        LLMModelInfo *info = g_ptr_array_index(models, i);
+        GString *label = g_string_new(info->id);
+
+        if (g_strcmp0(info->endpoint, OPENAI_API_BASE) != 0) {
+            g_string_append_printf(label, " @ %s", info->endpoint);
         }
-        g_strfreev(fetched_models);
-    } else {
-        /* Fallback to hardcoded models */
-        g_print("LLM Preferences: Using hardcoded models (API fetch failed or no API key)\n");
-        for (gsize i = 0; i < sizeof(available_models) / sizeof(available_models[0]); i++) {
-            gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(prefs->model_combo),
-                                      available_models[i].id,
-                                      available_models[i].display_name);
-            /* Check if this is the current model */
-            if (config->model && g_strcmp0(config->model, available_models[i].id) == 0) {
-                selected_index = i;
+        if (info->context_length > 0) {
+            g_string_append_printf(label, " (%dk context", info->context_length / 1000);
+            if (info->tokens_per_second > 0.0) {
+                g_string_append_printf(label, ", %.0f tok/s", info->tokens_per_second);
             }
+            g_string_append_c(label, ')');
+        } else if (info->tokens_per_second > 0.0) {
+            g_string_append_printf(label, " (%.0f tok/s)", info->tokens_per_second);
         }
+
+        gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(prefs->model_combo), info->id, label->str);
+        current_listed |= g_strcmp0(info->id, current_model) == 0;
+        g_string_free(label, TRUE);
     }
 
-    /* Set default selection if current model not found */
-    if (selected_index < 0) {
-        selected_index = 1; /* default to second item (gpt-4o-mini in hardcoded list) */
+    /* Keep the configured model selectable even if no endpoint lists it */
+    if (!current_listed) {
+        gtk_combo_box_text_prepend(GTK_COMBO_BOX_TEXT(prefs->model_combo), current_model, current_model);
+    }
+    if (models->len == 0 && g_strcmp0(current_model, DEFAULT_MODEL) != 0) {
+        gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(prefs->model_combo), DEFAULT_MODEL, DEFAULT_MODEL);
     }
-    gtk_combo_box_set_active(GTK_COMBO_BOX(prefs->model_combo), selected_index);
+    gtk_combo_box_set_active_id(GTK_COMBO_BOX(prefs->model_combo), current_model);
     gtk_widget_set_hexpand(prefs->model_combo, TRUE);
 
     /* Model hint label */
-    GtkWidget *model_hint = gtk_label_new("Recommended: gpt-4o-mini (best balance of speed, quality, and cost)");
+    GtkWidget *model_hint = gtk_label_new(models->len > 0
+        ? "Recommended: gpt-4o-mini (best balance of speed, quality, and cost)"
+        : "No model list available yet; enter an API key and reopen this dialog to see all models");
     gtk_widget_set_margin_bottom(model_hint, 6);
     gtk_widget_set_halign(model_hint, GTK_ALIGN_START);
+    g_ptr_array_unref(models);
 
     /* System Prompt field */
     GtkWidget *system_prompt_label = gtk_label_new("System Prompt:");
@@ -238,6 +390,59 @@ llm_preferences_dialog_show(GtkWindow *parent_window,
     gtk_widget_set_margin_bottom(system_prompt_hint, 6);
     gtk_widget_set_halign(system_prompt_hint, GTK_ALIGN_START);
 
+    /* Shared cache pack directory */
+    GtkWidget *pack_dir_label = gtk_label_new("Team Cache Packs:");
+    gtk_widget_set_halign(pack_dir_label, GTK_ALIGN_START);
+
+    prefs->pack_dir_chooser = gtk_file_chooser_button_new("Select Cache Pack Directory",
+                                                          GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER);
+    if (config->cache_pack_dir) {
+        gtk_file_chooser_set_filename(GTK_FILE_CHOOSER(prefs->pack_dir_chooser),
+                                      config->cache_pack_dir);
+    }
+    gtk_widget_set_hexpand(prefs->pack_dir_chooser, TRUE);
+
+    /* Export/import buttons */
+    GtkWidget *pack_buttons = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget *export_button = gtk_button_new_with_label("Export Pack...");
+    GtkWidget *import_button = gtk_button_new_with_label("Import Pack...");
+    gtk_box_pack_start(GTK_BOX(pack_buttons), export_button, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(pack_buttons), import_button, FALSE, FALSE, 0);
+    gtk_widget_set_sensitive(pack_buttons, cache != NULL);
+
+    g_signal_connect(export_button, "clicked", G_CALLBACK(on_export_pack_clicked), prefs);
+    g_signal_connect(import_button, "clicked", G_CALLBACK(on_import_pack_clicked), prefs);
+
+    /* Cache pack hint label */
+    GtkWidget *pack_hint = gtk_label_new(
+        "Packs (*.llmpack) in this directory are shared read-only below your own cache.\n"
+        "Export your cached responses as a pack to publish them for your team.");
+    gtk_widget_set_margin_bottom(pack_hint, 6);
+    gtk_widget_set_halign(pack_hint, GTK_ALIGN_START);
+
+    /* Triage classifier training folder */
+    GtkWidget *triage_label = gtk_label_new("Triage Training Mail:");
+    gtk_widget_set_halign(triage_label, GTK_ALIGN_START);
+
+    GtkWidget *triage_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    prefs->triage_dir_chooser = gtk_file_chooser_button_new("Select Labelled Mail Directory",
+                                                            GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER);
+    if (config->triage_training_dir) {
+        gtk_file_chooser_set_filename(GTK_FILE_CHOOSER(prefs->triage_dir_chooser),
+                                      config->triage_training_dir);
+    }
+    prefs->triage_train_button = gtk_button_new_with_label("Train");
+    gtk_box_pack_start(GTK_BOX(triage_box), prefs->triage_dir_chooser, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(triage_box), prefs->triage_train_button, FALSE, FALSE, 0);
+
+    g_signal_connect(prefs->triage_train_button, "clicked", G_CALLBACK(on_train_triage_clicked), prefs);
+
+    /* Triage hint label */
+    GtkWidget *triage_hint = gtk_label_new(
+        "One subfolder per label (e.g. reply, newsletter, out-of-office), holding\n"
+        "exported messages. Mail not labelled 'reply' is skipped before generating.");
+    gtk_widget_set_margin_bottom(triage_hint, 6);
+    gtk_widget_set_halign(triage_hint, GTK_ALIGN_START);
 
     /* Add widgets to grid */
     gtk_grid_attach(GTK_GRID(grid), api_key_label, 0, 0, 1, 1);
@@ -249,10 +454,19 @@ llm_preferences_dialog_show(GtkWindow *parent_window,
     gtk_grid_attach(GTK_GRID(grid), system_prompt_label, 0, 4, 1, 1);
     gtk_grid_attach(GTK_GRID(grid), scrolled, 1, 4, 1, 1);
     gtk_grid_attach(GTK_GRID(grid), system_prompt_hint, 1, 5, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), pack_dir_label, 0, 6, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), prefs->pack_dir_chooser, 1, 6, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), pack_buttons, 1, 7, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), pack_hint, 1, 8, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), triage_label, 0, 9, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), triage_box, 1, 9, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), triage_hint, 1, 10, 1, 1);
 
     /* Add grid to dialog content area */
     gtk_container_add(GTK_CONTAINER(content_area), grid);
 
+    g_object_set_data(G_OBJECT(prefs->dialog), "llm-preferences", prefs);
+
     /* Connect response signal */
     g_signal_connect(prefs->dialog, "response",
                      G_CALLBACK(on_preferences_response), prefs);
@@ -15,6 +15,7 @@
 #include <gtk/gtk.h>
 #include "../config/config.h"
 #include "llm_client.h"
+#include "llm_cache.h"
 
 G_BEGIN_DECLS
 
@@ -33,11 +34,13 @@ typedef void (*LLMPreferencesSaveCallback)(PluginConfig *config, gpointer user_d
  *
  * @param parent_window Optional parent window for modal dialog
  * @param config Current configuration to display
+ * @param cache Response cache for pack export/import (may be NULL)
  * @param save_callback Callback function called when user saves preferences
  * @param user_data User data passed to callback
  */
 void llm_preferences_dialog_show(GtkWindow *parent_window,
                                   PluginConfig *config,
+                                  LLMCache *cache,
                                   LLMPreferencesSaveCallback save_callback,
                                   gpointer user_data);
 
@@ -0,0 +1,439 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Attachment text extraction. Textual MIME parts of the replied-to message
+ * are decoded into a bounded buffer, converted once and cached on disk by
+ * content checksum. The cache is kept below ATTACHMENT_CACHE_MAX_BYTES by
+ * deleting the files that were used least recently.
+ */
+
+#include "llm_attachment.h"
+#include "llm_html.h"
+#include "llm_metrics.h"
+#include "../config/config.h"
+#include <libemail-engine/libemail-engine.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+typedef struct {
+    gchar *path;
+    gint64 mtime; /* touched on every hit, so the oldest was used least recently */
+    gint64 size;
+} CacheFile;
+
+/* Total size of the cache directory, -1 until it was first measured */
+static GMutex cache_mutex;
+static gint64 cache_bytes = -1;
+
+typedef struct {
+    CamelSession *session;
+    gchar *folder_uri;
+    gchar *message_uid;
+    gint max_tokens;
+} ExtractData;
+
+static const gchar *text_application_types[] = {
+    "json", "xml", "javascript", "x-yaml", "yaml", "x-sh", "x-shellscript", "sql", "csv", NULL
+};
+
+/* Some clients send logs and CSV files as application/octet-stream */
+static const gchar *text_file_suffixes[] = {
+    ".txt", ".log", ".csv", ".tsv", ".md", ".json", ".xml", ".yaml", ".yml", ".ini", ".conf", NULL
+};
+
+static gboolean is_text_part(CamelContentType *content_type, const gchar *filename) {
+    if (camel_content_type_is(content_type, "text", "*")) return TRUE;
+
+    if (camel_content_type_is(content_type, "application", "*")) {
+        for (guint i = 0; text_application_types[i]; i++) {
+            if (camel_content_type_is(content_type, "application", text_application_types[i])) return TRUE;
+        }
+    }
+
+    if (filename) {
+        gchar *lower = g_ascii_strdown(filename, -1);
+        gboolean matches = FALSE;
+        for (guint i = 0; text_file_suffixes[i] && !matches; i++) {
+            matches = g_str_has_suffix(lower, text_file_suffixes[i]);
+        }
+        g_free(lower);
+        return matches;
+    }
+
+    return FALSE;
+}
+
+/* Decode a part into a fixed-size buffer; longer content is cut off */
+static GBytes* decode_part(CamelMimePart *part, GCancellable *cancellable) {
+    CamelDataWrapper *content = camel_medium_get_content(CAMEL_MEDIUM(part));
+    if (!content) return NULL;
+
+    GOutputStream *stream = g_memory_output_stream_new(g_malloc(ATTACHMENT_MAX_BYTES),
+                                                       ATTACHMENT_MAX_BYTES, NULL, g_free);
+    GError *error = NULL;
+
+    camel_data_wrapper_decode_to_output_stream_sync(content, stream, cancellable, &error);
+
+    /* A full buffer only means the part is longer than we read */
+    if (error && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_NO_SPACE)) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("LLM Attachment: Cannot decode '%s': %s",
+                      camel_mime_part_get_filename(part), error->message);
+        }
+        g_error_free(error);
+        g_object_unref(stream);
+        return NULL;
+    }
+    g_clear_error(&error);
+
+    g_output_stream_close(stream, NULL, NULL);
+    GBytes *bytes = g_memory_output_stream_steal_as_bytes(G_MEMORY_OUTPUT_STREAM(stream));
+    g_object_unref(stream);
+
+    return bytes;
+}
+
+static gchar* convert_part(GBytes *bytes, CamelContentType *content_type) {
+    gsize length = 0;
+    const gchar *data = g_bytes_get_data(bytes, &length);
+    const gchar *charset = camel_content_type_param(content_type, "charset");
+    gchar *utf8 = NULL;
+
+    /* NUL bytes mean the part is binary whatever it claims to be */
+    if (memchr(data, '\0', MIN(length, 1024))) return NULL;
+
+    if (charset && g_ascii_strcasecmp(charset, "utf-8") != 0 && g_ascii_strcasecmp(charset, "us-ascii") != 0) {
+        utf8 = g_convert_with_fallback(data, length, "UTF-8", charset, "?", NULL, NULL, NULL);
+    }
+    if (!utf8) utf8 = g_utf8_make_valid(data, length);
+
+    if (camel_content_type_is(content_type, "text", "html")) {
+        gchar *text = llm_html_to_text(utf8, -1);
+        g_free(utf8);
+        return text;
+    }
+
+    return utf8;
+}
+
+static gchar* get_cache_path(const gchar *checksum) {
+    gchar *file_name = g_strconcat(checksum, ".txt", NULL);
+    gchar *path = g_build_filename(g_get_user_cache_dir(), CONFIG_DIR_NAME,
+                                   ATTACHMENT_CACHE_DIR_NAME, file_name, NULL);
+    g_free(file_name);
+    return path;
+}
+
+static void cache_file_free(CacheFile *file) {
+    g_free(file->path);
+    g_free(file);
+}
+
+static gint compare_cache_files_by_mtime(gconstpointer a, gconstpointer b) {
+    const CacheFile *x = *(const CacheFile * const *)a;
+    const CacheFile *y = *(const CacheFile * const *)b;
+
+    if (x->mtime != y->mtime) return x->mtime < y->mtime ? -1 : 1;
+    return 0;
+}
+
+/* Measure the cache and, when it is over the limit, delete the least
+ * recently used files until a quarter of the limit is free again, so the
+ * directory is not listed on every write */
+static void prune_cache_locked(const gchar *dir_path) {
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    if (!dir) {
+        cache_bytes = 0;
+        return;
+    }
+
+    GPtrArray *files = g_ptr_array_new_with_free_func((GDestroyNotify)cache_file_free);
+    gint64 total = 0;
+    const gchar *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        gchar *path = g_build_filename(dir_path, name, NULL);
+        GStatBuf st;
+
+        if (g_stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            CacheFile *file = g_new0(CacheFile, 1);
+            file->path = g_steal_pointer(&path);
+            file->mtime = st.st_mtime;
+            file->size = st.st_size;
+            total += file->size;
+            g_ptr_array_add(files, file);
+        }
+        g_free(path);
+    }
+    g_dir_close(dir);
+
+    if (total > ATTACHMENT_CACHE_MAX_BYTES) {
+        guint removed = 0;
+
+        g_ptr_array_sort(files, compare_cache_files_by_mtime);
+        for (guint i = 0; i < files->len && total > ATTACHMENT_CACHE_MAX_BYTES / 4 * 3; i++) {
+            CacheFile *file = g_ptr_array_index(files, i);
+            if (g_unlink(file->path) == 0) {
+                total -= file->size;
+                removed++;
+            }
+        }
+        g_print("LLM Attachment: Removed %u cached files, %" G_GINT64_FORMAT " bytes left\n", removed, total);
+    }
+
+    cache_bytes = total;
+    g_ptr_array_unref(files);
+}
+
+/* Count a newly written file against the cache limit */
+static void account_cache_write(const gchar *dir_path, gsize written) {
+    g_mutex_lock(&cache_mutex);
+    if (cache_bytes >= 0) {
+        cache_bytes += written;
+    }
+    if (cache_bytes < 0 || cache_bytes > ATTACHMENT_CACHE_MAX_BYTES) {
+        prune_cache_locked(dir_path);
+    }
+    g_mutex_unlock(&cache_mutex);
+}
+
+/* Text of one part, from the cache when the same content was seen before */
+static gchar* get_part_text(CamelMimePart *part, CamelContentType *content_type, GCancellable *cancellable) {
+    GBytes *bytes = decode_part(part, cancellable);
+    if (!bytes || g_bytes_get_size(bytes) == 0) {
+        if (bytes) g_bytes_unref(bytes);
+        return NULL;
+    }
+
+    gsize length = 0;
+    const guchar *data = g_bytes_get_data(bytes, &length);
+    gchar *checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA256, data, length);
+    gchar *path = get_cache_path(checksum);
+    gchar *text = NULL;
+
+    if (g_file_get_contents(path, &text, NULL, NULL)) {
+        llm_metrics_add(LLM_METRIC_ATTACHMENT_CACHE_HITS, 1);
+        g_utime(path, NULL); /* mark as recently used */
+    } else {
+        text = convert_part(bytes, content_type);
+        llm_metrics_add(LLM_METRIC_ATTACHMENT_BYTES_IN, length);
+
+        /* Binary parts are cached as empty text so they are not decoded again */
+        gchar *dir = g_path_get_dirname(path);
+        GError *error = NULL;
+        g_mkdir_with_parents(dir, 0700);
+        if (g_file_set_contents(path, text ? text : "", -1, &error)) {
+            account_cache_write(dir, text ? strlen(text) : 0);
+        } else {
+            g_warning("LLM Attachment: Cannot cache text: %s", error->message);
+            g_error_free(error);
+        }
+        g_free(dir);
+    }
+
+    g_free(path);
+    g_free(checksum);
+    g_bytes_unref(bytes);
+
+    if (text && !*g_strstrip(text)) g_clear_pointer(&text, g_free);
+    return text;
+}
+
+/* Append text up to the remaining budget, cut at a character boundary */
+static void append_within_budget(GString *out, const gchar *text, gsize *remaining) {
+    gsize length = strlen(text);
+
+    if (length <= *remaining) {
+        g_string_append(out, text);
+        *remaining -= length;
+        return;
+    }
+
+    const gchar *end = text + *remaining;
+    if (!g_utf8_validate(text, *remaining, NULL)) end = g_utf8_find_prev_char(text, end);
+    if (end) g_string_append_len(out, text, end - text);
+    g_string_append(out, "\n[truncated]");
+    *remaining = 0;
+}
+
+static void collect_parts(CamelMimePart *part, GString *out, gsize *remaining, GCancellable *cancellable) {
+    if (*remaining == 0 || g_cancellable_is_cancelled(cancellable)) return;
+
+    CamelDataWrapper *content = camel_medium_get_content(CAMEL_MEDIUM(part));
+    if (!content) return;
+
+    if (CAMEL_IS_MULTIPART(content)) {
+        CamelMultipart *multipart = CAMEL_MULTIPART(content);
+        guint n_parts = camel_multipart_get_number(multipart);
+        for (guint i = 0; i < n_parts; i++) {
+            collect_parts(camel_multipart_get_part(multipart, i), out, remaining, cancellable);
+        }
+        return;
+    }
+
+    /* Forwarded messages carry their own attachments */
+    if (CAMEL_IS_MIME_MESSAGE(content)) {
+        collect_parts(CAMEL_MIME_PART(content), out, remaining, cancellable);
+        return;
+    }
+
+    /* The message body is what the user selected; only files are added */
+    const gchar *filename = camel_mime_part_get_filename(part);
+    const gchar *disposition = camel_mime_part_get_disposition(part);
+    if (!filename && g_strcmp0(disposition, "attachment") != 0) return;
+
+    CamelContentType *content_type = camel_mime_part_get_content_type(part);
+    if (!is_text_part(content_type, filename)) return;
+
+    gchar *text = get_part_text(part, content_type, cancellable);
+    if (!text) return;
+
+    gchar *header = g_strdup_printf("%s[%s]\n", out->len > 0 ? "\n\n" : "",
+                                    filename ? filename : "attachment");
+    append_within_budget(out, header, remaining);
+    append_within_budget(out, text, remaining);
+
+    g_free(header);
+    g_free(text);
+}
+
+gchar* llm_attachment_extract_text(CamelMimeMessage *message,
+                                   gint max_tokens,
+                                   GCancellable *cancellable) {
+    g_return_val_if_fail(CAMEL_IS_MIME_MESSAGE(message), NULL);
+    if (max_tokens <= 0) return NULL;
+
+    GString *out = g_string_new(NULL);
+    gsize remaining = (gsize)max_tokens * ATTACHMENT_BYTES_PER_TOKEN;
+
+    collect_parts(CAMEL_MIME_PART(message), out, &remaining, cancellable);
+
+    if (out->len == 0) {
+        g_string_free(out, TRUE);
+        return NULL;
+    }
+
+    return g_string_free(out, FALSE);
+}
+
+/* First inline text part; in multipart/alternative the plain text comes first */
+static CamelMimePart* find_body_part(CamelMimePart *part) {
+    CamelDataWrapper *content = camel_medium_get_content(CAMEL_MEDIUM(part));
+    if (!content) return NULL;
+
+    if (CAMEL_IS_MULTIPART(content)) {
+        CamelMultipart *multipart = CAMEL_MULTIPART(content);
+        guint n_parts = camel_multipart_get_number(multipart);
+        for (guint i = 0; i < n_parts; i++) {
+            CamelMimePart *body = find_body_part(camel_multipart_get_part(multipart, i));
+            if (body) return body;
+        }
+        return NULL;
+    }
+
+    if (camel_mime_part_get_filename(part) ||
+        g_strcmp0(camel_mime_part_get_disposition(part), "attachment") == 0) {
+        return NULL;
+    }
+
+    CamelContentType *content_type = camel_mime_part_get_content_type(part);
+    return camel_content_type_is(content_type, "text", "plain") ||
+           camel_content_type_is(content_type, "text", "html") ? part : NULL;
+}
+
+gchar* llm_attachment_extract_body(CamelMimeMessage *message,
+                                   gsize max_bytes,
+                                   GCancellable *cancellable) {
+    g_return_val_if_fail(CAMEL_IS_MIME_MESSAGE(message), NULL);
+
+    CamelMimePart *part = find_body_part(CAMEL_MIME_PART(message));
+    if (!part) return NULL;
+
+    GBytes *bytes = decode_part(part, cancellable);
+    if (!bytes) return NULL;
+
+    gchar *text = convert_part(bytes, camel_mime_part_get_content_type(part));
+    g_bytes_unref(bytes);
+
+    if (!text || !*g_strstrip(text)) {
+        g_free(text);
+        return NULL;
+    }
+
+    gsize remaining = max_bytes;
+    GString *out = g_string_new(NULL);
+    append_within_budget(out, text, &remaining);
+    g_free(text);
+
+    return g_string_free(out, FALSE);
+}
+
+static void extract_data_free(ExtractData *data) {
+    g_object_unref(data->session);
+    g_free(data->folder_uri);
+    g_free(data->message_uid);
+    g_free(data);
+}
+
+static void extract_thread(GTask *task,
+                           gpointer source_object G_GNUC_UNUSED,
+                           gpointer task_data,
+                           GCancellable *cancellable) {
+    ExtractData *data = task_data;
+    GError *error = NULL;
+
+    CamelFolder *folder = e_mail_session_uri_to_folder_sync(E_MAIL_SESSION(data->session),
+                                                            data->folder_uri, 0,
+                                                            cancellable, &error);
+    if (!folder) {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    CamelMimeMessage *message = camel_folder_get_message_sync(folder, data->message_uid,
+                                                              cancellable, &error);
+    g_object_unref(folder);
+    if (!message) {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    gchar *text = llm_attachment_extract_text(message, data->max_tokens, cancellable);
+    g_object_unref(message);
+
+    if (g_task_return_error_if_cancelled(task)) {
+        g_free(text);
+        return;
+    }
+
+    g_task_return_pointer(task, text, g_free);
+}
+
+void llm_attachment_extract_async(CamelSession *session,
+                                  const gchar *folder_uri,
+                                  const gchar *message_uid,
+                                  gint max_tokens,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data) {
+    ExtractData *data = g_new0(ExtractData, 1);
+    data->session = g_object_ref(session);
+    data->folder_uri = g_strdup(folder_uri);
+    data->message_uid = g_strdup(message_uid);
+    data->max_tokens = max_tokens;
+
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, data, (GDestroyNotify)extract_data_free);
+    g_task_run_in_thread(task, extract_thread);
+    g_object_unref(task);
+}
+
+gchar* llm_attachment_extract_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
@@ -0,0 +1,76 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_ATTACHMENT_H
+#define LLM_ATTACHMENT_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <camel/camel.h>
+
+#define ATTACHMENT_CACHE_DIR_NAME "attachments"
+#define ATTACHMENT_MAX_BYTES (512 * 1024) /* decoded bytes read from one part */
+#define ATTACHMENT_BYTES_PER_TOKEN 4
+#define ATTACHMENT_CACHE_MAX_BYTES (64 * 1024 * 1024) /* least recently used text is deleted above this */
+
+/**
+ * Collect the text of a message's attachments
+ *
+ * Text and HTML parts and textual application types (JSON, XML, logs, ...)
+ * are decoded, converted to UTF-8 plain text and concatenated with a header
+ * per file until the budget is spent. Other parts are skipped.
+ *
+ * The converted text is cached in ~/.cache/evolution-llm-assistant/attachments/
+ * under the SHA-256 of the decoded content, so a file is converted once no
+ * matter how many messages carry it. The least recently used files are
+ * deleted once the cache grows beyond ATTACHMENT_CACHE_MAX_BYTES.
+ *
+ * @param max_tokens Budget for the returned text, at ATTACHMENT_BYTES_PER_TOKEN bytes per token
+ * @return Newly allocated text, or NULL if the message has no usable attachment
+ */
+gchar* llm_attachment_extract_text(CamelMimeMessage *message,
+                                   gint max_tokens,
+                                   GCancellable *cancellable);
+
+/**
+ * Get the text of a message's body, i.e. its first inline text part
+ *
+ * HTML bodies are converted to plain text. Not cached.
+ *
+ * @param max_bytes Longer text is cut off and marked as truncated
+ * @return Newly allocated text, or NULL if the message has no text body
+ */
+gchar* llm_attachment_extract_body(CamelMimeMessage *message,
+                                   gsize max_bytes,
+                                   GCancellable *cancellable);
+
+/**
+ * Load a message from its folder and run llm_attachment_extract_text() in a worker thread
+ *
+ * @param session The mail session the composer belongs to
+ * @param folder_uri Folder URI as stored in the composer's source headers
+ * @param message_uid UID of the message in that folder
+ * @param callback Called on the main context when done
+ */
+void llm_attachment_extract_async(CamelSession *session,
+                                  const gchar *folder_uri,
+                                  const gchar *message_uid,
+                                  gint max_tokens,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data);
+
+/**
+ * @return Newly allocated text, or NULL with error unset if there was nothing to extract
+ */
+gchar* llm_attachment_extract_finish(GAsyncResult *result, GError **error);
+
+#endif /* LLM_ATTACHMENT_H */
@@ -0,0 +1,155 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Timing of the composer's hotkey path for tools/llm-ui-bench.sh. The
+ * extension marks each point of a generation; this file keeps the times
+ * relative to the hotkey and reports their percentiles over all runs.
+ */
+
+#include "llm_bench.h"
+#include <stdlib.h>
+
+#define BENCH_DEFAULT_TEXT \
+    "Hi,\n\n" \
+    "Could you send me the updated figures for the third quarter by Friday? " \
+    "The client asked whether we can move the review meeting to next Tuesday " \
+    "afternoon, and legal still needs to sign off on the revised contract.\n\n" \
+    "Thanks,\nAnna\n\n" \
+    "/aw: Confirm Tuesday, say the figures follow on Thursday."
+
+static const gchar *mark_names[] = {
+    [LLM_BENCH_WEB_VIEW] = "web-view",
+    [LLM_BENCH_SELECTION] = "selection",
+    [LLM_BENCH_REQUEST] = "request",
+    [LLM_BENCH_FIRST_TEXT] = "first-text",
+    [LLM_BENCH_COMPLETE] = "complete",
+};
+
+static struct {
+    gint64 run_start;
+    gint64 marks[LLM_BENCH_MARK_COUNT];
+    GArray *samples[LLM_BENCH_MARK_COUNT]; /* gdouble ms after the hotkey */
+    guint finished;
+    guint failed;
+    GArray *opens; /* gdouble microseconds per composer open */
+} bench;
+
+guint llm_bench_get_runs(void) {
+    const gchar *runs = g_getenv(BENCH_ENV);
+    return runs ? (guint)CLAMP(atoi(runs), 0, 100000) : 0;
+}
+
+guint llm_bench_get_opens(void) {
+    const gchar *opens = g_getenv(BENCH_OPENS_ENV);
+    return opens ? (guint)CLAMP(atoi(opens), 0, 100000) : 0;
+}
+
+const gchar* llm_bench_get_text(void) {
+    static gchar *text = NULL;
+
+    if (!text) {
+        const gchar *path = g_getenv(BENCH_TEXT_ENV);
+        if (!path || !g_file_get_contents(path, &text, NULL, NULL)) {
+            text = g_strdup(BENCH_DEFAULT_TEXT);
+        }
+    }
+    return text;
+}
+
+void llm_bench_start_run(void) {
+    if (!bench.samples[0]) {
+        for (guint i = 0; i < LLM_BENCH_MARK_COUNT; i++) {
+            bench.samples[i] = g_array_new(FALSE, FALSE, sizeof(gdouble));
+        }
+    }
+
+    bench.run_start = g_get_monotonic_time();
+    for (guint i = 0; i < LLM_BENCH_MARK_COUNT; i++) bench.marks[i] = 0;
+}
+
+void llm_bench_mark(LLMBenchMark mark) {
+    if (!bench.run_start || bench.marks[mark]) return;
+    bench.marks[mark] = g_get_monotonic_time();
+}
+
+guint llm_bench_finish_run(gboolean success) {
+    if (!bench.run_start) return bench.finished;
+
+    if (success) {
+        for (guint i = 0; i < LLM_BENCH_MARK_COUNT; i++) {
+            if (!bench.marks[i]) continue;
+            gdouble ms = (bench.marks[i] - bench.run_start) / 1000.0;
+            g_array_append_val(bench.samples[i], ms);
+        }
+    } else {
+        bench.failed++;
+    }
+
+    g_print("LLM Bench: Run %u %s after %.1f ms\n", bench.finished + 1, success ? "done" : "failed",
+            (g_get_monotonic_time() - bench.run_start) / 1000.0);
+    bench.run_start = 0;
+    return ++bench.finished;
+}
+
+void llm_bench_record_open(gint64 us) {
+    gdouble value = (gdouble)us;
+
+    if (!bench.opens) bench.opens = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    g_array_append_val(bench.opens, value);
+}
+
+static gint compare_doubles(gconstpointer a, gconstpointer b) {
+    gdouble x = *(const gdouble *)a, y = *(const gdouble *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted array */
+static gdouble percentile(GArray *sorted, gdouble p) {
+    if (sorted->len == 0) return 0.0;
+
+    guint rank = (guint)(p / 100.0 * sorted->len + 0.999999);
+    rank = CLAMP(rank, 1, sorted->len);
+    return g_array_index(sorted, gdouble, rank - 1);
+}
+
+gboolean llm_bench_write_report(GError **error) {
+    GString *report = g_string_new(NULL);
+    g_string_append_printf(report, "# LLM Assistant composer benchmark: %u runs, %u failed\n",
+                           bench.finished, bench.failed);
+    g_string_append_printf(report, "%-12s %8s %8s %8s %8s %8s  (ms after the hotkey)\n",
+                           "point", "runs", "p50", "p90", "p99", "max");
+
+    for (guint i = 0; i < LLM_BENCH_MARK_COUNT && bench.samples[0]; i++) {
+        GArray *samples = bench.samples[i];
+        g_array_sort(samples, compare_doubles);
+        g_string_append_printf(report, "%-12s %8u %8.1f %8.1f %8.1f %8.1f\n", mark_names[i], samples->len,
+                               percentile(samples, 50), percentile(samples, 90), percentile(samples, 99),
+                               percentile(samples, 100));
+    }
+
+    if (bench.opens) {
+        g_array_sort(bench.opens, compare_doubles);
+        g_string_append_printf(report, "%-12s %8u %8.0f %8.0f %8.0f %8.0f  (us of module setup)\n",
+                               "composer-open", bench.opens->len, percentile(bench.opens, 50),
+                               percentile(bench.opens, 90), percentile(bench.opens, 99),
+                               percentile(bench.opens, 100));
+    }
+
+    const gchar *path = g_getenv(BENCH_OUTPUT_ENV);
+    gboolean success = TRUE;
+    if (path && *path) {
+        success = g_file_set_contents(path, report->str, report->len, error);
+    } else {
+        g_print("%s", report->str);
+    }
+
+    g_string_free(report, TRUE);
+    return success;
+}
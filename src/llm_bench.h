@@ -0,0 +1,83 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_BENCH_H
+#define LLM_BENCH_H
+
+#include <glib.h>
+
+/* Set to a number of runs to benchmark the first composer that opens */
+#define BENCH_ENV "LLM_ASSISTANT_BENCH"
+/* Optional file the report is written to; it is printed otherwise */
+#define BENCH_OUTPUT_ENV "LLM_ASSISTANT_BENCH_OUTPUT"
+/* Optional file with the text that is selected before every run */
+#define BENCH_TEXT_ENV "LLM_ASSISTANT_BENCH_TEXT"
+/* Optional number of composers to open and close after the runs */
+#define BENCH_OPENS_ENV "LLM_ASSISTANT_BENCH_OPENS"
+#define BENCH_SETTLE_MS 500 /* between resetting the composer and the next hotkey */
+
+/* Points of a run, in the order they are reached */
+typedef enum {
+    LLM_BENCH_WEB_VIEW,   /* web view found in the editor's widget tree */
+    LLM_BENCH_SELECTION,  /* selection returned by the web process */
+    LLM_BENCH_REQUEST,    /* request handed to the client */
+    LLM_BENCH_FIRST_TEXT, /* first generated text applied to the document */
+    LLM_BENCH_COMPLETE,   /* whole answer applied to the document */
+    LLM_BENCH_MARK_COUNT
+} LLMBenchMark;
+
+/**
+ * Number of runs asked for with LLM_ASSISTANT_BENCH, 0 when not benchmarking
+ */
+guint llm_bench_get_runs(void);
+
+/**
+ * Text to select before every run: LLM_ASSISTANT_BENCH_TEXT or a built-in mail
+ */
+const gchar* llm_bench_get_text(void);
+
+/**
+ * Number of composers to open with LLM_ASSISTANT_BENCH_OPENS, 0 by default
+ */
+guint llm_bench_get_opens(void);
+
+/**
+ * Start timing a run; call right before the hotkey action is activated.
+ * All llm_bench_* calls belong to the main thread.
+ */
+void llm_bench_start_run(void);
+
+/**
+ * Record when a run reached a point; only the first time per run counts
+ */
+void llm_bench_mark(LLMBenchMark mark);
+
+/**
+ * End the current run. Failed runs are counted but not timed.
+ *
+ * @return Number of runs finished so far
+ */
+guint llm_bench_finish_run(gboolean success);
+
+/**
+ * Record how long the extension held up the opening of a composer
+ *
+ * @param us Microseconds from creating the extension to the end of its setup
+ */
+void llm_bench_record_open(gint64 us);
+
+/**
+ * Write percentiles of every point, in milliseconds after the hotkey, and
+ * of the composer opens to LLM_ASSISTANT_BENCH_OUTPUT or print them
+ */
+gboolean llm_bench_write_report(GError **error);
+
+#endif /* LLM_BENCH_H */
@@ -0,0 +1,449 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Boilerplate detector. Signatures and disclaimers repeat in every quoted
+ * message of a thread; this learns them per sender domain from rolling-hash
+ * block frequencies and strips them before the text is sent to the model.
+ */
+
+#include "llm_boilerplate.h"
+#include "../config/config.h"
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define BOILERPLATE_MAGIC "LLMBOIL2"
+#define BOILERPLATE_MAGIC_V1 "LLMBOIL1" /* without the learned messages */
+#define ROLLING_BASE G_GUINT64_CONSTANT(1099511628211)
+#define LONG_LINE_SALT G_GUINT64_CONSTANT(0x9e3779b97f4a7c15)
+
+typedef struct {
+    guint64 hash;
+    guint32 count; /* messages the block was seen in */
+} BlockCount;
+
+typedef struct {
+    guint64 hash;
+    guint first; /* index into the non-empty lines */
+    guint span;  /* number of non-empty lines covered */
+} Block;
+
+typedef struct {
+    guint line; /* index into the original lines */
+    guint64 hash;
+    gsize length;
+} NormalizedLine;
+
+struct _LLMBoilerplate {
+    gchar *path;
+    GHashTable *domains; /* domain -> GArray of BlockCount sorted by hash */
+    GArray *learned;     /* hashes of the messages learned from, oldest first */
+    GHashTable *learned_set; /* the same hashes, for lookups */
+};
+
+static guint64 hash_line(const gchar *line, gsize *normalized_length) {
+    guint64 hash = G_GUINT64_CONSTANT(0xcbf29ce484222325) /* FNV-1a offset basis */;
+    gboolean pending_space = FALSE;
+    gsize length = 0;
+
+    /* Quote markers and leading whitespace are not part of the content */
+    while (*line == '>' || g_ascii_isspace(*line)) line++;
+
+    for (const gchar *p = line; *p; p++) {
+        if (g_ascii_isspace(*p)) {
+            pending_space = length > 0;
+            continue;
+        }
+        if (pending_space) {
+            hash = (hash ^ ' ') * ROLLING_BASE;
+            length++;
+            pending_space = FALSE;
+        }
+        hash = (hash ^ (guchar)g_ascii_tolower(*p)) * ROLLING_BASE;
+        length++;
+    }
+
+    *normalized_length = length;
+    return hash;
+}
+
+static guint64 hash_message(const gchar *domain, const gchar *message_key) {
+    guint64 hash = G_GUINT64_CONSTANT(0xcbf29ce484222325) /* FNV-1a offset basis */;
+
+    for (const gchar *p = domain; *p; p++) hash = (hash ^ (guchar)*p) * ROLLING_BASE;
+    hash = (hash ^ '\n') * ROLLING_BASE;
+    for (const gchar *p = message_key; *p; p++) hash = (hash ^ (guchar)*p) * ROLLING_BASE;
+
+    return hash;
+}
+
+static void add_learned(LLMBoilerplate *boilerplate, guint64 hash) {
+    g_array_append_val(boilerplate->learned, hash);
+    guint64 *key = g_new(guint64, 1);
+    *key = hash;
+    g_hash_table_add(boilerplate->learned_set, key);
+
+    if (boilerplate->learned->len > BOILERPLATE_MAX_MESSAGES) {
+        guint excess = boilerplate->learned->len - BOILERPLATE_MAX_MESSAGES;
+        for (guint i = 0; i < excess; i++) {
+            g_hash_table_remove(boilerplate->learned_set, &g_array_index(boilerplate->learned, guint64, i));
+        }
+        g_array_remove_range(boilerplate->learned, 0, excess);
+    }
+}
+
+static GArray* normalize_lines(gchar **lines) {
+    GArray *normalized = g_array_new(FALSE, FALSE, sizeof(NormalizedLine));
+
+    for (guint i = 0; lines[i]; i++) {
+        NormalizedLine line = { i, 0, 0 };
+        line.hash = hash_line(lines[i], &line.length);
+        if (line.length >= 2) g_array_append_val(normalized, line);
+    }
+
+    return normalized;
+}
+
+/* Rolling hash over every window of consecutive lines, plus long single lines */
+static GArray* compute_blocks(GArray *normalized) {
+    GArray *blocks = g_array_new(FALSE, FALSE, sizeof(Block));
+    guint n = normalized->len;
+
+    if (n >= BOILERPLATE_WINDOW) {
+        guint64 top_power = 1;
+        for (guint k = 1; k < BOILERPLATE_WINDOW; k++) top_power *= ROLLING_BASE;
+
+        guint64 rolling = 0;
+        for (guint i = 0; i < n; i++) {
+            guint64 line_hash = g_array_index(normalized, NormalizedLine, i).hash;
+
+            if (i >= BOILERPLATE_WINDOW) {
+                guint64 leaving = g_array_index(normalized, NormalizedLine, i - BOILERPLATE_WINDOW).hash;
+                rolling -= leaving * top_power;
+            }
+            rolling = rolling * ROLLING_BASE + line_hash;
+
+            if (i + 1 >= BOILERPLATE_WINDOW) {
+                Block block = { rolling, i + 1 - BOILERPLATE_WINDOW, BOILERPLATE_WINDOW };
+                g_array_append_val(blocks, block);
+            }
+        }
+    }
+
+    for (guint i = 0; i < n; i++) {
+        NormalizedLine *line = &g_array_index(normalized, NormalizedLine, i);
+        if (line->length >= BOILERPLATE_LONG_LINE) {
+            Block block = { line->hash ^ LONG_LINE_SALT, i, 1 };
+            g_array_append_val(blocks, block);
+        }
+    }
+
+    return blocks;
+}
+
+static gint compare_guint64(gconstpointer a, gconstpointer b) {
+    guint64 x = *(const guint64 *)a;
+    guint64 y = *(const guint64 *)b;
+    return (x > y) - (x < y);
+}
+
+/* Position of hash in a sorted BlockCount array, or where it would go */
+static guint find_block(GArray *counts, guint64 hash, gboolean *found) {
+    guint low = 0, high = counts->len;
+
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        guint64 mid_hash = g_array_index(counts, BlockCount, mid).hash;
+        if (mid_hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    *found = low < counts->len && g_array_index(counts, BlockCount, low).hash == hash;
+    return low;
+}
+
+/* Forget the rarest blocks until the domain fits again */
+static void prune_domain(GArray *counts) {
+    for (guint32 threshold = 1; counts->len > BOILERPLATE_MAX_BLOCKS; threshold++) {
+        guint kept = 0;
+        for (guint i = 0; i < counts->len; i++) {
+            BlockCount *entry = &g_array_index(counts, BlockCount, i);
+            if (entry->count > threshold) g_array_index(counts, BlockCount, kept++) = *entry;
+        }
+        g_array_set_size(counts, kept);
+    }
+}
+
+static void load_boilerplate(LLMBoilerplate *boilerplate) {
+    gchar *contents = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents(boilerplate->path, &contents, &length, NULL)) return;
+
+    const gchar *p = contents;
+    const gchar *end = contents + length;
+    guint32 n_domains = 0;
+    gboolean has_learned = length >= 8 && memcmp(p, BOILERPLATE_MAGIC, 8) == 0;
+
+    if (length < 12 || (!has_learned && memcmp(p, BOILERPLATE_MAGIC_V1, 8) != 0)) goto invalid;
+    p += 8;
+    memcpy(&n_domains, p, sizeof(n_domains));
+    p += sizeof(n_domains);
+
+    for (guint32 d = 0; d < n_domains; d++) {
+        guint32 domain_length, n_blocks;
+
+        if ((gsize)(end - p) < sizeof(domain_length)) goto invalid;
+        memcpy(&domain_length, p, sizeof(domain_length));
+        p += sizeof(domain_length);
+        if ((gsize)(end - p) < domain_length + sizeof(n_blocks)) goto invalid;
+        gchar *domain = g_strndup(p, domain_length);
+        p += domain_length;
+        memcpy(&n_blocks, p, sizeof(n_blocks));
+        p += sizeof(n_blocks);
+
+        if ((gsize)(end - p) / sizeof(BlockCount) < n_blocks) {
+            g_free(domain);
+            goto invalid;
+        }
+
+        GArray *counts = g_array_sized_new(FALSE, FALSE, sizeof(BlockCount), n_blocks);
+        g_array_append_vals(counts, p, n_blocks);
+        p += (gsize)n_blocks * sizeof(BlockCount);
+        g_hash_table_replace(boilerplate->domains, domain, counts);
+    }
+
+    if (has_learned) {
+        guint32 n_learned;
+
+        if ((gsize)(end - p) < sizeof(n_learned)) goto invalid;
+        memcpy(&n_learned, p, sizeof(n_learned));
+        p += sizeof(n_learned);
+        if ((gsize)(end - p) / sizeof(guint64) < n_learned) goto invalid;
+
+        for (guint32 i = 0; i < n_learned; i++) {
+            guint64 hash;
+            memcpy(&hash, p, sizeof(hash));
+            p += sizeof(hash);
+            add_learned(boilerplate, hash);
+        }
+    }
+
+    g_free(contents);
+    return;
+
+invalid:
+    g_warning("LLM Boilerplate: Ignoring invalid %s", boilerplate->path);
+    g_hash_table_remove_all(boilerplate->domains);
+    g_hash_table_remove_all(boilerplate->learned_set);
+    g_array_set_size(boilerplate->learned, 0);
+    g_free(contents);
+}
+
+LLMBoilerplate* llm_boilerplate_get_default(void) {
+    static LLMBoilerplate *boilerplate = NULL;
+
+    if (!boilerplate) {
+        boilerplate = g_new0(LLMBoilerplate, 1);
+        boilerplate->path = g_build_filename(g_get_user_cache_dir(), CONFIG_DIR_NAME,
+                                             BOILERPLATE_FILE_NAME, NULL);
+        boilerplate->domains = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                     (GDestroyNotify)g_array_unref);
+        boilerplate->learned = g_array_new(FALSE, FALSE, sizeof(guint64));
+        boilerplate->learned_set = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+        load_boilerplate(boilerplate);
+    }
+
+    return boilerplate;
+}
+
+gboolean llm_boilerplate_learn(LLMBoilerplate *boilerplate,
+                               const gchar *domain,
+                               const gchar *message_key,
+                               const gchar *text) {
+    if (!boilerplate || !domain || !message_key || !text) return FALSE;
+
+    /* Generating twice for the same mail must not make its body a footer */
+    guint64 message_hash = hash_message(domain, message_key);
+    if (g_hash_table_contains(boilerplate->learned_set, &message_hash)) return FALSE;
+    add_learned(boilerplate, message_hash);
+
+    gchar **lines = g_strsplit(text, "\n", -1);
+    GArray *normalized = normalize_lines(lines);
+    GArray *blocks = compute_blocks(normalized);
+
+    /* A footer quoted five times in one thread still counts as one message */
+    GArray *hashes = g_array_sized_new(FALSE, FALSE, sizeof(guint64), blocks->len);
+    for (guint i = 0; i < blocks->len; i++) {
+        g_array_append_val(hashes, g_array_index(blocks, Block, i).hash);
+    }
+    g_array_sort(hashes, compare_guint64);
+
+    GArray *counts = g_hash_table_lookup(boilerplate->domains, domain);
+    if (!counts) {
+        counts = g_array_new(FALSE, FALSE, sizeof(BlockCount));
+        g_hash_table_insert(boilerplate->domains, g_strdup(domain), counts);
+    }
+
+    for (guint i = 0; i < hashes->len; i++) {
+        guint64 hash = g_array_index(hashes, guint64, i);
+        if (i > 0 && hash == g_array_index(hashes, guint64, i - 1)) continue;
+
+        gboolean found;
+        guint position = find_block(counts, hash, &found);
+        if (found) {
+            g_array_index(counts, BlockCount, position).count++;
+        } else {
+            BlockCount entry = { hash, 1 };
+            g_array_insert_val(counts, position, entry);
+        }
+    }
+
+    prune_domain(counts);
+
+    g_array_unref(hashes);
+    g_array_unref(blocks);
+    g_array_unref(normalized);
+    g_strfreev(lines);
+
+    return TRUE;
+}
+
+gchar* llm_boilerplate_strip(LLMBoilerplate *boilerplate,
+                             const gchar *domain,
+                             const gchar *text,
+                             guint min_messages,
+                             guint *lines_removed) {
+    if (lines_removed) *lines_removed = 0;
+    if (!text) return NULL;
+
+    GArray *counts = boilerplate && domain ? g_hash_table_lookup(boilerplate->domains, domain) : NULL;
+    if (!counts) return g_strdup(text);
+
+    gchar **lines = g_strsplit(text, "\n", -1);
+    guint n_lines = g_strv_length(lines);
+    GArray *normalized = normalize_lines(lines);
+    GArray *blocks = compute_blocks(normalized);
+    gboolean *remove = g_new0(gboolean, n_lines);
+
+    for (guint i = 0; i < blocks->len; i++) {
+        Block *block = &g_array_index(blocks, Block, i);
+        gboolean found;
+        guint position = find_block(counts, block->hash, &found);
+
+        if (found && g_array_index(counts, BlockCount, position).count >= min_messages) {
+            for (guint k = 0; k < block->span; k++) {
+                remove[g_array_index(normalized, NormalizedLine, block->first + k).line] = TRUE;
+            }
+        }
+    }
+
+    GString *result = g_string_sized_new(strlen(text));
+    guint removed = 0;
+    for (guint i = 0; i < n_lines; i++) {
+        if (remove[i]) {
+            removed++;
+            continue;
+        }
+        if (i > removed) g_string_append_c(result, '\n');
+        g_string_append(result, lines[i]);
+    }
+
+    if (lines_removed) *lines_removed = removed;
+
+    g_free(remove);
+    g_array_unref(blocks);
+    g_array_unref(normalized);
+    g_strfreev(lines);
+
+    return g_string_free(result, FALSE);
+}
+
+static GBytes* serialize(LLMBoilerplate *boilerplate) {
+    GByteArray *data = g_byte_array_new();
+    guint32 n_domains = g_hash_table_size(boilerplate->domains);
+
+    g_byte_array_append(data, (const guint8 *)BOILERPLATE_MAGIC, 8);
+    g_byte_array_append(data, (const guint8 *)&n_domains, sizeof(n_domains));
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, boilerplate->domains);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GArray *counts = value;
+        guint32 domain_length = strlen(key);
+        guint32 n_blocks = counts->len;
+
+        g_byte_array_append(data, (const guint8 *)&domain_length, sizeof(domain_length));
+        g_byte_array_append(data, (const guint8 *)key, domain_length);
+        g_byte_array_append(data, (const guint8 *)&n_blocks, sizeof(n_blocks));
+        g_byte_array_append(data, (const guint8 *)counts->data, n_blocks * sizeof(BlockCount));
+    }
+
+    guint32 n_learned = boilerplate->learned->len;
+    g_byte_array_append(data, (const guint8 *)&n_learned, sizeof(n_learned));
+    g_byte_array_append(data, (const guint8 *)boilerplate->learned->data, n_learned * sizeof(guint64));
+
+    return g_byte_array_free_to_bytes(data);
+}
+
+gboolean llm_boilerplate_save(LLMBoilerplate *boilerplate, GError **error) {
+    g_return_val_if_fail(boilerplate != NULL, FALSE);
+
+    GBytes *data = serialize(boilerplate);
+    gchar *dir = g_path_get_dirname(boilerplate->path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    gboolean result = g_file_set_contents(boilerplate->path, g_bytes_get_data(data, NULL),
+                                          g_bytes_get_size(data), error);
+    g_bytes_unref(data);
+
+    return result;
+}
+
+static void on_saved(GObject *source, GAsyncResult *result, gpointer user_data G_GNUC_UNUSED) {
+    GError *error = NULL;
+
+    if (!g_file_replace_contents_finish(G_FILE(source), result, NULL, &error)) {
+        g_warning("LLM Boilerplate: Cannot save statistics: %s", error->message);
+        g_error_free(error);
+    }
+}
+
+void llm_boilerplate_save_in_background(LLMBoilerplate *boilerplate) {
+    g_return_if_fail(boilerplate != NULL);
+
+    /* The snapshot is taken here; only the write leaves the main thread */
+    GBytes *data = serialize(boilerplate);
+    gchar *dir = g_path_get_dirname(boilerplate->path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    GFile *file = g_file_new_for_path(boilerplate->path);
+    g_file_replace_contents_bytes_async(file, data, NULL, FALSE, G_FILE_CREATE_PRIVATE,
+                                        NULL, on_saved, NULL);
+    g_object_unref(file);
+    g_bytes_unref(data);
+}
+
+gchar* llm_boilerplate_domain_from_address(const gchar *address) {
+    const gchar *at = address ? strrchr(address, '@') : NULL;
+    if (!at || !at[1]) return NULL;
+
+    gchar *domain = g_ascii_strdown(at + 1, -1);
+    g_strstrip(domain);
+    g_strdelimit(domain, ">", '\0');
+
+    return domain;
+}
@@ -0,0 +1,76 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_BOILERPLATE_H
+#define LLM_BOILERPLATE_H
+
+#include <glib.h>
+
+#define BOILERPLATE_FILE_NAME "boilerplate.bin"
+#define BOILERPLATE_WINDOW 3          /* lines per rolling-hash block */
+#define BOILERPLATE_LONG_LINE 60      /* a line this long is a block on its own */
+#define BOILERPLATE_MAX_BLOCKS 8192   /* per domain */
+#define BOILERPLATE_MAX_MESSAGES 4096 /* learned messages remembered, so none counts twice */
+
+typedef struct _LLMBoilerplate LLMBoilerplate;
+
+/**
+ * Get the footer statistics shared by all composer windows
+ *
+ * Loaded from ~/.cache/evolution-llm-assistant/ on first use.
+ *
+ * @return The shared instance, owned by the plugin
+ */
+LLMBoilerplate* llm_boilerplate_get_default(void);
+
+/**
+ * Count the blocks of a message towards its sender domain
+ *
+ * Every window of BOILERPLATE_WINDOW consecutive non-empty lines, and
+ * every long line, is hashed; each distinct hash counts once per message.
+ * Quote markers and whitespace are ignored. A message is only counted the
+ * first time its key is seen.
+ *
+ * @param message_key Identifies the received message, e.g. its folder and UID
+ * @return TRUE if the statistics changed
+ */
+gboolean llm_boilerplate_learn(LLMBoilerplate *boilerplate,
+                               const gchar *domain,
+                               const gchar *message_key,
+                               const gchar *text);
+
+/**
+ * Remove lines covered by blocks seen in at least min_messages messages
+ *
+ * @param lines_removed Optional return location for the number of removed lines
+ * @return Newly allocated text
+ */
+gchar* llm_boilerplate_strip(LLMBoilerplate *boilerplate,
+                             const gchar *domain,
+                             const gchar *text,
+                             guint min_messages,
+                             guint *lines_removed);
+
+gboolean llm_boilerplate_save(LLMBoilerplate *boilerplate, GError **error);
+
+/**
+ * Write the statistics from a worker thread; failures are only logged
+ */
+void llm_boilerplate_save_in_background(LLMBoilerplate *boilerplate);
+
+/**
+ * Lower-cased domain part of an e-mail address
+ *
+ * @return Newly allocated domain, or NULL if the address has none
+ */
+gchar* llm_boilerplate_domain_from_address(const gchar *address);
+
+#endif /* LLM_BOILERPLATE_H */
@@ -0,0 +1,377 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Token and cost accounting. Every request's usage is added up per day and
+ * model, priced by the OpenAI list prices below and kept across sessions.
+ * The client asks it before each request whether the daily and monthly
+ * budgets still allow the request, and on which model. The totals in memory
+ * are always current; the file is written back BUDGET_SAVE_DELAY_S after a
+ * request by a writer thread.
+ */
+
+#include "llm_budget.h"
+#include "llm_catalog.h"
+#include "llm_metrics.h"
+#include <json-glib/json-glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+typedef struct {
+    const gchar *prefix;
+    gdouble input;  /* US dollars per million tokens */
+    gdouble cached_input;
+    gdouble output;
+} ModelPrice;
+
+/* The first matching prefix wins, so longer prefixes come first. Models
+ * that are not listed are counted without a cost. */
+static const ModelPrice model_prices[] = {
+    { "gpt-5-nano", 0.05, 0.005, 0.40 },
+    { "gpt-5-mini", 0.25, 0.025, 2.00 },
+    { "gpt-5", 1.25, 0.125, 10.00 },
+    { "gpt-4.1-nano", 0.10, 0.025, 0.40 },
+    { "gpt-4.1-mini", 0.40, 0.10, 1.60 },
+    { "gpt-4.1", 2.00, 0.50, 8.00 },
+    { "gpt-4o-mini-realtime", 0.60, 0.30, 2.40 },
+    { "gpt-4o-realtime", 5.00, 2.50, 20.00 },
+    { "gpt-4o-mini", 0.15, 0.075, 0.60 },
+    { "gpt-4o", 2.50, 1.25, 10.00 },
+    { "chatgpt-4o", 5.00, 5.00, 15.00 },
+    { "gpt-4-turbo", 10.00, 10.00, 30.00 },
+    { "gpt-4", 30.00, 30.00, 60.00 },
+    { "gpt-3.5-turbo", 0.50, 0.50, 1.50 },
+    { "o1-mini", 1.10, 0.55, 4.40 },
+    { "o1", 15.00, 7.50, 60.00 },
+    { "o3-mini", 1.10, 0.55, 4.40 },
+    { "o3", 2.00, 0.50, 8.00 },
+    { "o4-mini", 1.10, 0.275, 4.40 },
+};
+
+struct _LLMBudget {
+    GMutex mutex;
+    gchar *path;
+    GHashTable *days;     /* "YYYY-MM-DD" -> (model -> LLMUsage) */
+    guint save_source_id; /* pending deferred save */
+    GThreadPool *writer;  /* one thread, so snapshots are written in order */
+};
+
+typedef struct {
+    gchar *path;
+    gchar *contents;
+} BudgetSnapshot;
+
+static const ModelPrice* find_price(const gchar *model) {
+    for (gsize i = 0; i < G_N_ELEMENTS(model_prices); i++) {
+        if (g_str_has_prefix(model, model_prices[i].prefix)) return &model_prices[i];
+    }
+    return NULL;
+}
+
+/* Models on other endpoints are local or someone else's bill */
+static gboolean is_billed(const gchar *model) {
+    LLMModelInfo *info = llm_catalog_lookup(llm_catalog_get_default(), model);
+    gboolean billed = !info || g_strcmp0(info->endpoint, OPENAI_API_BASE) == 0;
+    llm_model_info_free(info);
+    return billed;
+}
+
+static gchar* format_today(const gchar *format) {
+    GDateTime *now = g_date_time_new_now_local();
+    gchar *text = g_date_time_format(now, format);
+    g_date_time_unref(now);
+    return text;
+}
+
+static GHashTable* get_day_locked(LLMBudget *budget, const gchar *day) {
+    GHashTable *models = g_hash_table_lookup(budget->days, day);
+
+    if (!models) {
+        models = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+        g_hash_table_insert(budget->days, g_strdup(day), models);
+    }
+    return models;
+}
+
+static gchar* budget_serialize_locked(LLMBudget *budget) {
+    /* ISO dates compare like strings */
+    GDateTime *now = g_date_time_new_now_local();
+    GDateTime *cutoff_time = g_date_time_add_days(now, -BUDGET_KEEP_DAYS);
+    gchar *cutoff = g_date_time_format(cutoff_time, "%Y-%m-%d");
+    g_date_time_unref(cutoff_time);
+    g_date_time_unref(now);
+
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "days");
+    json_builder_begin_object(builder);
+
+    GHashTableIter day_iter;
+    gpointer day, models;
+    g_hash_table_iter_init(&day_iter, budget->days);
+    while (g_hash_table_iter_next(&day_iter, &day, &models)) {
+        if (strcmp(day, cutoff) < 0) {
+            g_hash_table_iter_remove(&day_iter);
+            continue;
+        }
+
+        json_builder_set_member_name(builder, day);
+        json_builder_begin_object(builder);
+
+        GHashTableIter model_iter;
+        gpointer model, value;
+        g_hash_table_iter_init(&model_iter, models);
+        while (g_hash_table_iter_next(&model_iter, &model, &value)) {
+            LLMUsage *usage = value;
+
+            json_builder_set_member_name(builder, model);
+            json_builder_begin_object(builder);
+            json_builder_set_member_name(builder, "prompt_tokens");
+            json_builder_add_int_value(builder, usage->prompt_tokens);
+            json_builder_set_member_name(builder, "cached_tokens");
+            json_builder_add_int_value(builder, usage->cached_tokens);
+            json_builder_set_member_name(builder, "completion_tokens");
+            json_builder_add_int_value(builder, usage->completion_tokens);
+            json_builder_set_member_name(builder, "cost");
+            json_builder_add_double_value(builder, usage->cost);
+            json_builder_end_object(builder);
+        }
+
+        json_builder_end_object(builder);
+    }
+
+    json_builder_end_object(builder);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    gchar *contents = json_generator_to_data(generator, NULL);
+
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+    g_free(cutoff);
+
+    return contents;
+}
+
+/* Runs in the writer thread */
+static void write_snapshot(gpointer data, gpointer user_data G_GNUC_UNUSED) {
+    BudgetSnapshot *snapshot = data;
+    GError *error = NULL;
+
+    gchar *data_dir = g_path_get_dirname(snapshot->path);
+    g_mkdir_with_parents(data_dir, 0700);
+    g_free(data_dir);
+
+    if (!g_file_set_contents(snapshot->path, snapshot->contents, -1, &error)) {
+        g_warning("LLM Budget: Failed to write %s: %s", snapshot->path, error->message);
+        g_error_free(error);
+    }
+
+    g_free(snapshot->path);
+    g_free(snapshot->contents);
+    g_free(snapshot);
+}
+
+static gboolean on_save_timeout(gpointer user_data) {
+    LLMBudget *budget = user_data;
+    BudgetSnapshot *snapshot = g_new0(BudgetSnapshot, 1);
+
+    g_mutex_lock(&budget->mutex);
+    budget->save_source_id = 0;
+    snapshot->path = g_strdup(budget->path);
+    snapshot->contents = budget_serialize_locked(budget);
+    g_mutex_unlock(&budget->mutex);
+
+    g_thread_pool_push(budget->writer, snapshot, NULL);
+    return G_SOURCE_REMOVE;
+}
+
+/* Responses arrive on worker threads; the timeout runs on the main loop */
+static void schedule_save_locked(LLMBudget *budget) {
+    if (!budget->save_source_id) {
+        budget->save_source_id = g_timeout_add_seconds(BUDGET_SAVE_DELAY_S, on_save_timeout, budget);
+    }
+}
+
+static void budget_load(LLMBudget *budget) {
+    if (!g_file_test(budget->path, G_FILE_TEST_EXISTS)) return;
+
+    JsonParser *parser = json_parser_new();
+    GError *error = NULL;
+
+    if (json_parser_load_from_file(parser, budget->path, &error)) {
+        JsonObject *root_obj = json_node_get_object(json_parser_get_root(parser));
+        JsonObject *days = root_obj && json_object_has_member(root_obj, "days")
+            ? json_object_get_object_member(root_obj, "days") : NULL;
+        GList *day_names = days ? json_object_get_members(days) : NULL;
+
+        for (GList *d = day_names; d; d = d->next) {
+            JsonObject *day = json_object_get_object_member(days, d->data);
+            GList *model_names = day ? json_object_get_members(day) : NULL;
+            GHashTable *models = get_day_locked(budget, d->data);
+
+            for (GList *m = model_names; m; m = m->next) {
+                JsonObject *entry = json_object_get_object_member(day, m->data);
+                if (!entry) continue;
+
+                LLMUsage *usage = g_new0(LLMUsage, 1);
+                usage->prompt_tokens = json_object_get_int_member_with_default(entry, "prompt_tokens", 0);
+                usage->cached_tokens = json_object_get_int_member_with_default(entry, "cached_tokens", 0);
+                usage->completion_tokens = json_object_get_int_member_with_default(entry, "completion_tokens", 0);
+                usage->cost = json_object_get_double_member_with_default(entry, "cost", 0.0);
+                g_hash_table_replace(models, g_strdup(m->data), usage);
+            }
+            g_list_free(model_names);
+        }
+        g_list_free(day_names);
+    } else {
+        g_warning("LLM Budget: Failed to parse %s: %s", budget->path, error->message);
+        g_error_free(error);
+    }
+
+    g_object_unref(parser);
+}
+
+LLMBudget* llm_budget_get_default(void) {
+    static LLMBudget *budget = NULL;
+
+    if (g_once_init_enter(&budget)) {
+        LLMBudget *instance = g_new0(LLMBudget, 1);
+        g_mutex_init(&instance->mutex);
+        instance->path = g_build_filename(g_get_user_data_dir(), CONFIG_DIR_NAME, BUDGET_FILE_NAME, NULL);
+        instance->days = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify)g_hash_table_unref);
+        instance->writer = g_thread_pool_new(write_snapshot, NULL, 1, FALSE, NULL);
+        budget_load(instance);
+
+        g_once_init_leave(&budget, instance);
+    }
+
+    return budget;
+}
+
+void llm_budget_record(LLMBudget *budget,
+                       const gchar *model,
+                       gint prompt_tokens,
+                       gint cached_tokens,
+                       gint completion_tokens) {
+    if (!budget || !model || (prompt_tokens <= 0 && completion_tokens <= 0)) return;
+
+    prompt_tokens = MAX(prompt_tokens, 0);
+    cached_tokens = CLAMP(cached_tokens, 0, prompt_tokens);
+    completion_tokens = MAX(completion_tokens, 0);
+
+    const ModelPrice *price = find_price(model);
+    gdouble cost = 0.0;
+    if (price && is_billed(model)) {
+        cost = ((prompt_tokens - cached_tokens) * price->input + cached_tokens * price->cached_input +
+                completion_tokens * price->output) / 1e6;
+    }
+
+    gchar *day = format_today("%Y-%m-%d");
+
+    g_mutex_lock(&budget->mutex);
+    GHashTable *models = get_day_locked(budget, day);
+    LLMUsage *usage = g_hash_table_lookup(models, model);
+    if (!usage) {
+        usage = g_new0(LLMUsage, 1);
+        g_hash_table_insert(models, g_strdup(model), usage);
+    }
+    usage->prompt_tokens += prompt_tokens;
+    usage->cached_tokens += cached_tokens;
+    usage->completion_tokens += completion_tokens;
+    usage->cost += cost;
+    schedule_save_locked(budget);
+    g_mutex_unlock(&budget->mutex);
+
+    g_free(day);
+}
+
+LLMUsage llm_budget_get_usage(LLMBudget *budget, gboolean month) {
+    LLMUsage total = {0};
+    if (!budget) return total;
+
+    gchar *prefix = format_today(month ? "%Y-%m-" : "%Y-%m-%d");
+
+    g_mutex_lock(&budget->mutex);
+    GHashTableIter day_iter;
+    gpointer day, models;
+    g_hash_table_iter_init(&day_iter, budget->days);
+    while (g_hash_table_iter_next(&day_iter, &day, &models)) {
+        if (!g_str_has_prefix(day, prefix)) continue;
+
+        GHashTableIter model_iter;
+        gpointer value;
+        g_hash_table_iter_init(&model_iter, models);
+        while (g_hash_table_iter_next(&model_iter, NULL, &value)) {
+            LLMUsage *usage = value;
+            total.prompt_tokens += usage->prompt_tokens;
+            total.cached_tokens += usage->cached_tokens;
+            total.completion_tokens += usage->completion_tokens;
+            total.cost += usage->cost;
+        }
+    }
+    g_mutex_unlock(&budget->mutex);
+
+    g_free(prefix);
+    return total;
+}
+
+LLMBudgetLevel llm_budget_get_level(LLMBudget *budget, PluginConfig *config) {
+    if (!budget || !config || (config->budget_daily <= 0 && config->budget_monthly <= 0)) {
+        return LLM_BUDGET_OK;
+    }
+
+    gdouble spent = 0.0;
+    if (config->budget_daily > 0) {
+        spent = MAX(spent, llm_budget_get_usage(budget, FALSE).cost / config->budget_daily);
+    }
+    if (config->budget_monthly > 0) {
+        spent = MAX(spent, llm_budget_get_usage(budget, TRUE).cost / config->budget_monthly);
+    }
+
+    if (spent >= 1.0) return LLM_BUDGET_EXHAUSTED;
+    if (spent >= BUDGET_DOWNGRADE_RATIO) return LLM_BUDGET_DOWNGRADE;
+    if (spent >= BUDGET_SHED_RATIO) return LLM_BUDGET_SHED;
+    return LLM_BUDGET_OK;
+}
+
+gboolean llm_budget_admit(LLMBudget *budget,
+                          PluginConfig *config,
+                          LLMWorkClass work_class,
+                          const gchar **model) {
+    LLMBudgetLevel level = llm_budget_get_level(budget, config);
+    if (level == LLM_BUDGET_OK) return TRUE;
+
+    /* Interactive latency is protected by giving up everything else first;
+     * work on models that cost nothing does not touch the budget */
+    if (work_class != LLM_WORK_INTERACTIVE && is_billed(*model)) {
+        g_print("LLM Budget: Budget nearly spent, skipping a background request to %s\n", *model);
+        llm_metrics_add(LLM_METRIC_BUDGET_REFUSED, 1);
+        return FALSE;
+    }
+
+    const gchar *fallback = config->budget_fallback_model;
+    if (level >= LLM_BUDGET_DOWNGRADE && fallback && *fallback && g_strcmp0(*model, fallback) != 0) {
+        g_print("LLM Budget: Budget nearly spent, using %s instead of %s\n", fallback, *model);
+        llm_metrics_add(LLM_METRIC_BUDGET_DOWNGRADES, 1);
+        *model = fallback;
+    }
+
+    if (level == LLM_BUDGET_EXHAUSTED && is_billed(*model)) {
+        g_warning("LLM Budget: Budget spent, not sending a request to %s", *model);
+        llm_metrics_add(LLM_METRIC_BUDGET_REFUSED, 1);
+        return FALSE;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,97 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_BUDGET_H
+#define LLM_BUDGET_H
+
+#include <glib.h>
+#include "../config/config.h"
+
+#define BUDGET_FILE_NAME "usage.json"
+#define BUDGET_KEEP_DAYS 400          /* days of usage kept in the file */
+#define BUDGET_SAVE_DELAY_S 5         /* requests within this time are written back together */
+#define BUDGET_SHED_RATIO 0.8         /* of a budget spent: billed speculative and batch work stops */
+#define BUDGET_DOWNGRADE_RATIO 0.95   /* of a budget spent: interactive work uses the fallback model */
+
+/* What a request is for; cheaper classes are given up first */
+typedef enum {
+    LLM_WORK_INTERACTIVE, /* the user waits for it */
+    LLM_WORK_SPECULATIVE, /* may be thrown away, e.g. a draft the answer replaces */
+    LLM_WORK_BATCH        /* background work nobody waits for */
+} LLMWorkClass;
+
+typedef enum {
+    LLM_BUDGET_OK,
+    LLM_BUDGET_SHED,      /* past BUDGET_SHED_RATIO of the daily or monthly budget */
+    LLM_BUDGET_DOWNGRADE, /* past BUDGET_DOWNGRADE_RATIO */
+    LLM_BUDGET_EXHAUSTED  /* the budget is spent; only unbilled models may be used */
+} LLMBudgetLevel;
+
+typedef struct {
+    gint64 prompt_tokens;     /* including the cached ones */
+    gint64 cached_tokens;
+    gint64 completion_tokens;
+    gdouble cost;             /* US dollars */
+} LLMUsage;
+
+typedef struct _LLMBudget LLMBudget;
+
+/**
+ * Get the usage accounting shared by all requests
+ *
+ * Loaded from ~/.local/share/evolution-llm-assistant/usage.json on first
+ * use and written back BUDGET_SAVE_DELAY_S after a request, together with
+ * any that finish in the meantime. All functions are safe to call from any
+ * thread.
+ *
+ * @return The shared instance, owned by the plugin
+ */
+LLMBudget* llm_budget_get_default(void);
+
+/**
+ * Add the tokens of a finished request to today's usage of a model
+ *
+ * Only models served by OpenAI are charged; the rest is counted at no cost.
+ */
+void llm_budget_record(LLMBudget *budget,
+                       const gchar *model,
+                       gint prompt_tokens,
+                       gint cached_tokens,
+                       gint completion_tokens);
+
+/**
+ * Usage of all models today or in the current calendar month, local time
+ */
+LLMUsage llm_budget_get_usage(LLMBudget *budget, gboolean month);
+
+/**
+ * @return How close the spend is to the tighter of the configured budgets
+ */
+LLMBudgetLevel llm_budget_get_level(LLMBudget *budget, PluginConfig *config);
+
+/**
+ * Decide whether a request may be sent and on which model
+ *
+ * Speculative and batch work on billed models is refused from
+ * LLM_BUDGET_SHED on.
+ * Interactive work moves to config->budget_fallback_model from
+ * LLM_BUDGET_DOWNGRADE on, and is refused once the budget is exhausted
+ * unless that model is not billed.
+ *
+ * @param model In: the model asked for; out: the model to use
+ * @return FALSE if the request must not be sent
+ */
+gboolean llm_budget_admit(LLMBudget *budget,
+                          PluginConfig *config,
+                          LLMWorkClass work_class,
+                          const gchar **model);
+
+#endif /* LLM_BUDGET_H */
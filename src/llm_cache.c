@@ -0,0 +1,556 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Response cache. Keeps previously generated responses on disk so a similar
+ * prompt can be answered with a provisional draft while the real request runs.
+ * Read-only team packs (see llm_cache_pack.c) form a lower tier beneath the
+ * personal cache. Stores are written back a few seconds later by a writer
+ * thread, so answers arriving close together cost one write and none of
+ * them blocks the caller on disk I/O.
+ */
+
+#include "llm_cache.h"
+#include "llm_cache_pack.h"
+#include "../config/config.h"
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+#include <string.h>
+
+typedef struct {
+    gchar *model;
+    gchar *prompt;
+    gchar *response;
+    gint64 last_used;
+    GArray *signature; /* sorted, unique guint32 word hashes of the prompt */
+} LLMCacheEntry;
+
+struct _LLMCache {
+    GMutex mutex;
+    gchar *path;
+    GHashTable *entries;   /* "model\nprompt" -> LLMCacheEntry */
+    GPtrArray *packs;      /* LLMCachePack, read-only lower tier */
+    GHashTable *pack_dirs; /* directories whose packs are mapped */
+    guint save_source_id;  /* pending deferred save */
+    GThreadPool *writer;   /* one thread, so snapshots are written in order */
+};
+
+typedef struct {
+    gchar *path;
+    gchar *contents;
+} CacheSnapshot;
+
+static void llm_cache_entry_free(LLMCacheEntry *entry) {
+    if (!entry) return;
+
+    g_free(entry->model);
+    g_free(entry->prompt);
+    g_free(entry->response);
+    g_array_unref(entry->signature);
+    g_free(entry);
+}
+
+static gchar* make_key(const gchar *model, const gchar *prompt) {
+    return g_strdup_printf("%s\n%s", model ? model : "", prompt);
+}
+
+static gint compare_guint32(gconstpointer a, gconstpointer b) {
+    guint32 x = *(const guint32 *)a;
+    guint32 y = *(const guint32 *)b;
+    return (x > y) - (x < y);
+}
+
+GArray* llm_cache_compute_signature(const gchar *prompt) {
+    GArray *signature = g_array_new(FALSE, FALSE, sizeof(guint32));
+    GString *word = g_string_new(NULL);
+
+    for (const gchar *p = prompt; ; p = g_utf8_next_char(p)) {
+        gunichar c = *p ? g_utf8_get_char(p) : 0;
+
+        if (c && g_unichar_isalnum(c)) {
+            g_string_append_unichar(word, g_unichar_tolower(c));
+        } else if (word->len > 0) {
+            guint32 hash = g_str_hash(word->str);
+            g_array_append_val(signature, hash);
+            g_string_truncate(word, 0);
+        }
+
+        if (!c) break;
+    }
+    g_string_free(word, TRUE);
+
+    g_array_sort(signature, compare_guint32);
+
+    /* Drop duplicates */
+    guint out = 0;
+    for (guint i = 0; i < signature->len; i++) {
+        if (out == 0 || g_array_index(signature, guint32, out - 1) != g_array_index(signature, guint32, i)) {
+            g_array_index(signature, guint32, out++) = g_array_index(signature, guint32, i);
+        }
+    }
+    g_array_set_size(signature, out);
+
+    return signature;
+}
+
+gdouble llm_cache_signature_similarity(const guint32 *a, guint a_len,
+                                       const guint32 *b, guint b_len) {
+    guint i = 0, j = 0, common = 0;
+
+    if (a_len == 0 || b_len == 0) return 0.0;
+
+    while (i < a_len && j < b_len) {
+        guint32 x = a[i];
+        guint32 y = b[j];
+
+        if (x == y) {
+            common++;
+            i++;
+            j++;
+        } else if (x < y) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+
+    return (gdouble)common / (gdouble)(a_len + b_len - common);
+}
+
+static void insert_entry(LLMCache *cache, const gchar *model, const gchar *prompt,
+                         const gchar *response, gint64 last_used) {
+    LLMCacheEntry *entry = g_new0(LLMCacheEntry, 1);
+    entry->model = g_strdup(model ? model : "");
+    entry->prompt = g_strdup(prompt);
+    entry->response = g_strdup(response);
+    entry->last_used = last_used;
+    entry->signature = llm_cache_compute_signature(prompt);
+
+    g_hash_table_replace(cache->entries, make_key(model, prompt), entry);
+}
+
+static void evict_least_recently_used(LLMCache *cache) {
+    GHashTableIter iter;
+    gpointer key, value;
+    gpointer oldest_key = NULL;
+    gint64 oldest = G_MAXINT64;
+
+    g_hash_table_iter_init(&iter, cache->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        LLMCacheEntry *entry = value;
+        if (entry->last_used < oldest) {
+            oldest = entry->last_used;
+            oldest_key = key;
+        }
+    }
+
+    if (oldest_key) {
+        g_hash_table_remove(cache->entries, oldest_key);
+    }
+}
+
+static void load_from_file(LLMCache *cache) {
+    if (!g_file_test(cache->path, G_FILE_TEST_EXISTS)) return;
+
+    JsonParser *parser = json_parser_new();
+    GError *error = NULL;
+
+    if (json_parser_load_from_file(parser, cache->path, &error)) {
+        JsonNode *root_node = json_parser_get_root(parser);
+
+        if (root_node && JSON_NODE_HOLDS_OBJECT(root_node)) {
+            JsonObject *root_obj = json_node_get_object(root_node);
+
+            if (json_object_has_member(root_obj, "entries")) {
+                JsonArray *entries = json_object_get_array_member(root_obj, "entries");
+                guint length = json_array_get_length(entries);
+
+                for (guint i = 0; i < length; i++) {
+                    JsonObject *entry = json_array_get_object_element(entries, i);
+                    const gchar *model = json_object_get_string_member_with_default(entry, "model", "");
+                    const gchar *prompt = json_object_get_string_member_with_default(entry, "prompt", NULL);
+                    const gchar *response = json_object_get_string_member_with_default(entry, "response", NULL);
+                    gint64 last_used = json_object_get_int_member_with_default(entry, "last_used", 0);
+
+                    if (prompt && response) {
+                        insert_entry(cache, model, prompt, response, last_used);
+                    }
+                }
+            }
+        }
+    } else {
+        g_warning("LLM Cache: Failed to parse %s: %s", cache->path, error->message);
+        g_error_free(error);
+    }
+
+    g_object_unref(parser);
+}
+
+/* Runs in the writer thread */
+static void write_snapshot(gpointer data, gpointer user_data G_GNUC_UNUSED) {
+    CacheSnapshot *snapshot = data;
+    GError *error = NULL;
+
+    gchar *cache_dir = g_path_get_dirname(snapshot->path);
+    g_mkdir_with_parents(cache_dir, 0700);
+    g_free(cache_dir);
+
+    if (!g_file_set_contents(snapshot->path, snapshot->contents, -1, &error)) {
+        g_warning("LLM Cache: Failed to write %s: %s", snapshot->path, error->message);
+        g_error_free(error);
+    }
+
+    g_free(snapshot->path);
+    g_free(snapshot->contents);
+    g_free(snapshot);
+}
+
+LLMCache* llm_cache_new(void) {
+    LLMCache *cache = g_new0(LLMCache, 1);
+    g_mutex_init(&cache->mutex);
+    cache->path = g_build_filename(g_get_user_cache_dir(), CONFIG_DIR_NAME, CACHE_FILE_NAME, NULL);
+    cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify)llm_cache_entry_free);
+    cache->packs = g_ptr_array_new_with_free_func((GDestroyNotify)llm_cache_pack_free);
+    cache->pack_dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    cache->writer = g_thread_pool_new(write_snapshot, NULL, 1, FALSE, NULL);
+
+    load_from_file(cache);
+
+    return cache;
+}
+
+LLMCache* llm_cache_get_default(void) {
+    static LLMCache *cache = NULL;
+
+    if (g_once_init_enter(&cache)) {
+        g_once_init_leave(&cache, llm_cache_new());
+    }
+
+    return cache;
+}
+
+void llm_cache_free(LLMCache *cache) {
+    if (!cache) return;
+
+    /* A store still waiting for its save is written now */
+    if (cache->save_source_id) {
+        g_source_remove(cache->save_source_id);
+        cache->save_source_id = 0;
+        llm_cache_save(cache);
+    }
+    g_thread_pool_free(cache->writer, FALSE, TRUE);
+
+    g_hash_table_destroy(cache->entries);
+    g_ptr_array_unref(cache->packs);
+    g_hash_table_destroy(cache->pack_dirs);
+    g_free(cache->path);
+    g_mutex_clear(&cache->mutex);
+    g_free(cache);
+}
+
+gchar* llm_cache_lookup(LLMCache *cache, const gchar *model, const gchar *prompt) {
+    if (!cache || !prompt) return NULL;
+
+    gchar *key = make_key(model, prompt);
+    gchar *response = NULL;
+
+    g_mutex_lock(&cache->mutex);
+    LLMCacheEntry *entry = g_hash_table_lookup(cache->entries, key);
+    if (entry) {
+        entry->last_used = g_get_real_time() / G_USEC_PER_SEC;
+        response = g_strdup(entry->response);
+    }
+
+    for (guint i = 0; !response && i < cache->packs->len; i++) {
+        response = llm_cache_pack_lookup(g_ptr_array_index(cache->packs, i), model, prompt);
+    }
+    g_mutex_unlock(&cache->mutex);
+
+    g_free(key);
+    return response;
+}
+
+gchar* llm_cache_lookup_closest(LLMCache *cache,
+                                const gchar *model,
+                                const gchar *prompt,
+                                gdouble min_similarity,
+                                gdouble *similarity) {
+    if (!cache || !prompt) return NULL;
+
+    GArray *signature = llm_cache_compute_signature(prompt);
+    LLMCacheEntry *best = NULL;
+    gdouble best_score = 0.0;
+    gchar *response = NULL;
+    GHashTableIter iter;
+    gpointer value;
+
+    g_mutex_lock(&cache->mutex);
+
+    g_hash_table_iter_init(&iter, cache->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        LLMCacheEntry *entry = value;
+
+        if (g_strcmp0(entry->model, model ? model : "") != 0) continue;
+
+        gdouble score = llm_cache_signature_similarity(
+            (const guint32 *)signature->data, signature->len,
+            (const guint32 *)entry->signature->data, entry->signature->len);
+        if (score > best_score) {
+            best_score = score;
+            best = entry;
+        }
+    }
+
+    /* Packs only win with a strictly better match than the personal cache */
+    LLMCachePack *best_pack = NULL;
+    gint best_pack_index = -1;
+    for (guint i = 0; i < cache->packs->len; i++) {
+        LLMCachePack *pack = g_ptr_array_index(cache->packs, i);
+        gdouble score = 0.0;
+        gint index = llm_cache_pack_find_closest(pack, model, signature, &score);
+
+        if (index >= 0 && score > best_score) {
+            best_score = score;
+            best_pack = pack;
+            best_pack_index = index;
+        }
+    }
+    g_array_unref(signature);
+
+    if (best_score >= min_similarity && best_pack) {
+        llm_cache_pack_get_entry(best_pack, best_pack_index, NULL, NULL, &response);
+    } else if (best_score >= min_similarity && best) {
+        best->last_used = g_get_real_time() / G_USEC_PER_SEC;
+        response = g_strdup(best->response);
+    }
+
+    g_mutex_unlock(&cache->mutex);
+
+    if (response && similarity) *similarity = best_score;
+    return response;
+}
+
+static gchar* serialize_locked(LLMCache *cache) {
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "entries");
+    json_builder_begin_array(builder);
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, cache->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        LLMCacheEntry *entry = value;
+
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "model");
+        json_builder_add_string_value(builder, entry->model);
+        json_builder_set_member_name(builder, "prompt");
+        json_builder_add_string_value(builder, entry->prompt);
+        json_builder_set_member_name(builder, "response");
+        json_builder_add_string_value(builder, entry->response);
+        json_builder_set_member_name(builder, "last_used");
+        json_builder_add_int_value(builder, entry->last_used);
+        json_builder_end_object(builder);
+    }
+
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    gchar *contents = json_generator_to_data(generator, NULL);
+
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+
+    return contents;
+}
+
+/* Hand the writer thread the entries as they are now */
+static void queue_snapshot_locked(LLMCache *cache) {
+    CacheSnapshot *snapshot = g_new0(CacheSnapshot, 1);
+    snapshot->path = g_strdup(cache->path);
+    snapshot->contents = serialize_locked(cache);
+    g_thread_pool_push(cache->writer, snapshot, NULL);
+}
+
+static gboolean on_save_timeout(gpointer user_data) {
+    LLMCache *cache = user_data;
+
+    g_mutex_lock(&cache->mutex);
+    cache->save_source_id = 0;
+    queue_snapshot_locked(cache);
+    g_mutex_unlock(&cache->mutex);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_save_locked(LLMCache *cache) {
+    if (!cache->save_source_id) {
+        cache->save_source_id = g_timeout_add_seconds(CACHE_SAVE_DELAY_S, on_save_timeout, cache);
+    }
+}
+
+void llm_cache_store(LLMCache *cache,
+                     const gchar *model,
+                     const gchar *prompt,
+                     const gchar *response) {
+    if (!cache || !prompt || !response) return;
+
+    gchar *key = make_key(model, prompt);
+
+    g_mutex_lock(&cache->mutex);
+    if (!g_hash_table_contains(cache->entries, key) &&
+        g_hash_table_size(cache->entries) >= CACHE_MAX_ENTRIES) {
+        evict_least_recently_used(cache);
+    }
+
+    insert_entry(cache, model, prompt, response, g_get_real_time() / G_USEC_PER_SEC);
+    schedule_save_locked(cache);
+    g_mutex_unlock(&cache->mutex);
+
+    g_free(key);
+}
+
+gboolean llm_cache_save(LLMCache *cache) {
+    if (!cache) return FALSE;
+
+    g_mutex_lock(&cache->mutex);
+    gchar *contents = serialize_locked(cache);
+    g_mutex_unlock(&cache->mutex);
+
+    gchar *cache_dir = g_path_get_dirname(cache->path);
+    g_mkdir_with_parents(cache_dir, 0700);
+    g_free(cache_dir);
+
+    GError *error = NULL;
+    gboolean result = g_file_set_contents(cache->path, contents, -1, &error);
+    if (!result) {
+        g_warning("LLM Cache: Failed to write %s: %s", cache->path, error->message);
+        g_error_free(error);
+    }
+
+    g_free(contents);
+    return result;
+}
+
+guint llm_cache_add_pack_dir(LLMCache *cache, const gchar *dir_path) {
+    if (!cache || !dir_path || !*dir_path) return 0;
+
+    g_mutex_lock(&cache->mutex);
+    gboolean mapped = !g_hash_table_add(cache->pack_dirs, g_strdup(dir_path));
+    g_mutex_unlock(&cache->mutex);
+    if (mapped) return 0;
+
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    if (!dir) {
+        g_warning("LLM Cache: Cannot open pack directory %s", dir_path);
+        return 0;
+    }
+
+    guint added = 0;
+    const gchar *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (!g_str_has_suffix(name, CACHE_PACK_SUFFIX)) continue;
+
+        gchar *path = g_build_filename(dir_path, name, NULL);
+        GError *error = NULL;
+        LLMCachePack *pack = llm_cache_pack_open(path, &error);
+
+        if (pack) {
+            g_mutex_lock(&cache->mutex);
+            g_ptr_array_add(cache->packs, pack);
+            g_mutex_unlock(&cache->mutex);
+            added++;
+            g_print("LLM Cache: Mapped pack %s (%u entries)\n", path, llm_cache_pack_get_n_entries(pack));
+        } else {
+            g_warning("LLM Cache: Skipping pack %s: %s", path, error ? error->message : "unknown error");
+            g_clear_error(&error);
+        }
+        g_free(path);
+    }
+    g_dir_close(dir);
+
+    return added;
+}
+
+static gint compare_entries_by_recency(gconstpointer a, gconstpointer b) {
+    const LLMCacheEntry *x = *(const LLMCacheEntry * const *)a;
+    const LLMCacheEntry *y = *(const LLMCacheEntry * const *)b;
+    return (x->last_used < y->last_used) - (x->last_used > y->last_used);
+}
+
+gboolean llm_cache_export_pack(LLMCache *cache, const gchar *path, GError **error) {
+    g_return_val_if_fail(cache != NULL, FALSE);
+
+    g_mutex_lock(&cache->mutex);
+
+    /* Most recently used first, so it wins when several models answered a prompt */
+    GPtrArray *entries = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, cache->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(entries, value);
+    }
+    g_ptr_array_sort(entries, compare_entries_by_recency);
+
+    GPtrArray *items = g_ptr_array_new_with_free_func(g_free);
+    for (guint i = 0; i < entries->len; i++) {
+        LLMCacheEntry *entry = g_ptr_array_index(entries, i);
+        LLMCachePackItem *item = g_new0(LLMCachePackItem, 1);
+        item->model = entry->model;
+        item->prompt = entry->prompt;
+        item->response = entry->response;
+        g_ptr_array_add(items, item);
+    }
+
+    gboolean result = llm_cache_pack_write(path, items, error);
+
+    g_ptr_array_unref(items);
+    g_ptr_array_unref(entries);
+
+    g_mutex_unlock(&cache->mutex);
+
+    return result;
+}
+
+gint llm_cache_import_pack(LLMCache *cache, const gchar *path, GError **error) {
+    g_return_val_if_fail(cache != NULL, -1);
+
+    LLMCachePack *pack = llm_cache_pack_open(path, error);
+    if (!pack) return -1;
+
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    guint n_entries = llm_cache_pack_get_n_entries(pack);
+
+    g_mutex_lock(&cache->mutex);
+    for (guint i = 0; i < n_entries; i++) {
+        gchar *model = NULL, *prompt = NULL, *response = NULL;
+        llm_cache_pack_get_entry(pack, i, &model, &prompt, &response);
+        insert_entry(cache, model, prompt, response, now);
+        g_free(model);
+        g_free(prompt);
+        g_free(response);
+    }
+
+    while (g_hash_table_size(cache->entries) > CACHE_MAX_ENTRIES) {
+        evict_least_recently_used(cache);
+    }
+    schedule_save_locked(cache);
+    g_mutex_unlock(&cache->mutex);
+
+    llm_cache_pack_free(pack);
+
+    return n_entries;
+}
\ No newline at end of file
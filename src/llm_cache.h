@@ -0,0 +1,115 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_CACHE_H
+#define LLM_CACHE_H
+
+#include <glib.h>
+
+#define CACHE_FILE_NAME "responses.json"
+#define CACHE_MAX_ENTRIES 500
+#define CACHE_SAVE_DELAY_S 5 /* stores within this time are written back together */
+
+typedef struct _LLMCache LLMCache;
+
+/**
+ * Load the response cache from ~/.cache/evolution-llm-assistant/
+ *
+ * All functions of a cache are safe to call from any thread.
+ *
+ * @return A new cache (empty if no cache file exists yet). Free with
+ *         llm_cache_free(), which writes back pending stores.
+ */
+LLMCache* llm_cache_new(void);
+void llm_cache_free(LLMCache *cache);
+
+/**
+ * Get the response cache shared by all composer windows
+ *
+ * @return The shared instance, owned by the plugin
+ */
+LLMCache* llm_cache_get_default(void);
+
+/**
+ * Look up the cached response for exactly this model and prompt
+ *
+ * @return Newly allocated response, or NULL on a miss
+ */
+gchar* llm_cache_lookup(LLMCache *cache, const gchar *model, const gchar *prompt);
+
+/**
+ * Find the cached response whose prompt is most similar to the given one
+ *
+ * Similarity is the Jaccard index of the word sets of both prompts.
+ *
+ * @param min_similarity Entries scoring below this (0.0 - 1.0) are ignored
+ * @param similarity Optional return location for the score of the match
+ * @return Newly allocated response, or NULL if nothing is similar enough
+ */
+gchar* llm_cache_lookup_closest(LLMCache *cache,
+                                const gchar *model,
+                                const gchar *prompt,
+                                gdouble min_similarity,
+                                gdouble *similarity);
+
+/**
+ * Store a response
+ *
+ * The least recently used entry is evicted once CACHE_MAX_ENTRIES is reached.
+ * The cache is written back by a writer thread CACHE_SAVE_DELAY_S later,
+ * from the default main context.
+ */
+void llm_cache_store(LLMCache *cache,
+                     const gchar *model,
+                     const gchar *prompt,
+                     const gchar *response);
+
+/**
+ * Write the cache back to disk now, blocking until it is written
+ */
+gboolean llm_cache_save(LLMCache *cache);
+
+/**
+ * Map every *.llmpack file in a directory as a read-only lower cache tier
+ *
+ * Packs are consulted after the personal cache and are never written to.
+ * A directory that is already mapped is skipped.
+ *
+ * @return Number of packs mapped
+ */
+guint llm_cache_add_pack_dir(LLMCache *cache, const gchar *dir_path);
+
+/**
+ * Export the personal cache as an immutable pack file for sharing
+ */
+gboolean llm_cache_export_pack(LLMCache *cache, const gchar *path, GError **error);
+
+/**
+ * Copy all entries of a pack file into the personal cache
+ *
+ * @return Number of imported entries, or -1 on error
+ */
+gint llm_cache_import_pack(LLMCache *cache, const gchar *path, GError **error);
+
+/**
+ * Hash every lower-cased alphanumeric word of a prompt into a sorted set
+ *
+ * @return Array of unique guint32 hashes in ascending order
+ */
+GArray* llm_cache_compute_signature(const gchar *prompt);
+
+/**
+ * Jaccard index of two sorted word-hash sets
+ */
+gdouble llm_cache_signature_similarity(const guint32 *a, guint a_len,
+                                       const guint32 *b, guint b_len);
+
+#endif /* LLM_CACHE_H */
@@ -0,0 +1,432 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Read-only cache packs. A pack is an immutable file of prompt/response pairs
+ * that a whole team can map from a shared directory as a lower cache tier.
+ *
+ * Layout (host byte order, all sections 8-byte aligned):
+ *
+ *   PackHeader
+ *   guint32 buckets[n_buckets]     hash-and-displace seeds
+ *   guint32 slots[n_entries]       perfect hash slot -> entry index
+ *   PackEntry entries[n_entries]   sorted by prompt
+ *   guint32 signatures[]           word-hash sets for similarity lookups
+ *   gchar strings[]                NUL-terminated prompts, models, responses
+ */
+
+#include "llm_cache_pack.h"
+#include "llm_cache.h"
+#include <gio/gio.h>
+#include <string.h>
+
+#define PACK_MAGIC "LLMPACK\0"
+#define PACK_VERSION 1
+#define PACK_DIRECT_SLOT 0x80000000u
+#define PACK_MAX_SEED 0x100000u
+
+typedef struct {
+    gchar magic[8];
+    guint32 version;
+    guint32 n_entries;
+    guint32 n_buckets;
+    guint32 reserved;
+    guint64 buckets_offset;
+    guint64 slots_offset;
+    guint64 entries_offset;
+    guint64 signatures_offset;
+    guint64 signatures_count;
+    guint64 strings_offset;
+    guint64 strings_size;
+} PackHeader;
+
+typedef struct {
+    guint32 prompt_offset;
+    guint32 prompt_length;
+    guint32 model_offset;
+    guint32 model_length;
+    guint32 response_offset;
+    guint32 response_length;
+    guint32 signature_offset;
+    guint32 signature_length;
+} PackEntry;
+
+struct _LLMCachePack {
+    GMappedFile *file;
+    const PackHeader *header;
+    const guint32 *buckets;
+    const guint32 *slots;
+    const PackEntry *entries;
+    const guint32 *signatures;
+    const gchar *strings;
+};
+
+/* Seeded FNV-1a with a murmur3 finalizer */
+static guint32 pack_hash(const gchar *data, gsize length, guint32 seed) {
+    guint32 h = 0x811c9dc5u ^ (seed * 0x9e3779b9u);
+
+    for (gsize i = 0; i < length; i++) {
+        h ^= (guchar)data[i];
+        h *= 0x01000193u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+static gsize align8(gsize value) {
+    return (value + 7) & ~(gsize)7;
+}
+
+static gint compare_items_by_prompt(gconstpointer a, gconstpointer b) {
+    const LLMCachePackItem *x = *(const LLMCachePackItem * const *)a;
+    const LLMCachePackItem *y = *(const LLMCachePackItem * const *)b;
+    return strcmp(x->prompt, y->prompt);
+}
+
+static guint32 append_string(GByteArray *strings, const gchar *value) {
+    guint32 offset = strings->len;
+    g_byte_array_append(strings, (const guint8 *)value, strlen(value) + 1);
+    return offset;
+}
+
+typedef struct {
+    guint32 bucket;
+    GArray *keys; /* entry indexes */
+} PackBucket;
+
+static gint compare_buckets_by_size(gconstpointer a, gconstpointer b) {
+    const PackBucket *x = a;
+    const PackBucket *y = b;
+    return (gint)y->keys->len - (gint)x->keys->len;
+}
+
+/*
+ * Build a minimal perfect hash with hash-and-displace: keys are grouped into
+ * buckets, and for every bucket (largest first) a seed is searched that moves
+ * all of its keys into free slots. Single-key buckets store their slot directly.
+ */
+static gboolean build_perfect_hash(GPtrArray *items, guint32 n_buckets,
+                                   guint32 *buckets, guint32 *slots, GError **error) {
+    guint32 n = items->len;
+    PackBucket *groups = g_new0(PackBucket, n_buckets);
+    gboolean *taken = g_new0(gboolean, n);
+    guint32 *positions = g_new(guint32, n);
+    gboolean success = TRUE;
+
+    for (guint32 b = 0; b < n_buckets; b++) {
+        groups[b].bucket = b;
+        groups[b].keys = g_array_new(FALSE, FALSE, sizeof(guint32));
+    }
+
+    for (guint32 i = 0; i < n; i++) {
+        const LLMCachePackItem *item = g_ptr_array_index(items, i);
+        guint32 b = pack_hash(item->prompt, strlen(item->prompt), 0) % n_buckets;
+        g_array_append_val(groups[b].keys, i);
+    }
+
+    qsort(groups, n_buckets, sizeof(PackBucket), compare_buckets_by_size);
+
+    guint32 next_free = 0;
+    for (guint32 g = 0; g < n_buckets && success; g++) {
+        PackBucket *group = &groups[g];
+        guint size = group->keys->len;
+
+        if (size == 0) {
+            buckets[group->bucket] = 0;
+            continue;
+        }
+
+        if (size == 1) {
+            while (taken[next_free]) next_free++;
+            taken[next_free] = TRUE;
+            slots[next_free] = g_array_index(group->keys, guint32, 0);
+            buckets[group->bucket] = PACK_DIRECT_SLOT | next_free;
+            continue;
+        }
+
+        guint32 seed;
+        for (seed = 1; seed < PACK_MAX_SEED; seed++) {
+            guint k;
+            for (k = 0; k < size; k++) {
+                const LLMCachePackItem *item =
+                    g_ptr_array_index(items, g_array_index(group->keys, guint32, k));
+                guint32 slot = pack_hash(item->prompt, strlen(item->prompt), seed) % n;
+
+                if (taken[slot]) break;
+
+                /* Keys of the same bucket must not collide with each other */
+                guint j;
+                for (j = 0; j < k && positions[j] != slot; j++);
+                if (j < k) break;
+
+                positions[k] = slot;
+            }
+            if (k == size) break;
+        }
+
+        if (seed == PACK_MAX_SEED) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                        "Could not build the pack index");
+            success = FALSE;
+            break;
+        }
+
+        for (guint k = 0; k < size; k++) {
+            taken[positions[k]] = TRUE;
+            slots[positions[k]] = g_array_index(group->keys, guint32, k);
+        }
+        buckets[group->bucket] = seed;
+    }
+
+    for (guint32 b = 0; b < n_buckets; b++) {
+        g_array_unref(groups[b].keys);
+    }
+    g_free(groups);
+    g_free(taken);
+    g_free(positions);
+
+    return success;
+}
+
+gboolean llm_cache_pack_write(const gchar *path, GPtrArray *items, GError **error) {
+    g_return_val_if_fail(path != NULL, FALSE);
+    g_return_val_if_fail(items != NULL, FALSE);
+
+    /* Drop duplicate prompts, keeping the first one, then sort by prompt */
+    GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray *unique = g_ptr_array_new();
+    for (guint i = 0; i < items->len; i++) {
+        LLMCachePackItem *item = g_ptr_array_index(items, i);
+        if (item->prompt && item->response && g_hash_table_add(seen, (gpointer)item->prompt)) {
+            g_ptr_array_add(unique, item);
+        }
+    }
+    g_hash_table_destroy(seen);
+    g_ptr_array_sort(unique, compare_items_by_prompt);
+
+    guint32 n = unique->len;
+    guint32 n_buckets = MAX(1, (n + 3) / 4);
+    PackEntry *entries = g_new0(PackEntry, MAX(n, 1));
+    GByteArray *strings = g_byte_array_new();
+    GArray *signatures = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+    for (guint32 i = 0; i < n; i++) {
+        const LLMCachePackItem *item = g_ptr_array_index(unique, i);
+        GArray *signature = llm_cache_compute_signature(item->prompt);
+
+        entries[i].prompt_offset = append_string(strings, item->prompt);
+        entries[i].prompt_length = strlen(item->prompt);
+        entries[i].model_offset = append_string(strings, item->model ? item->model : "");
+        entries[i].model_length = item->model ? strlen(item->model) : 0;
+        entries[i].response_offset = append_string(strings, item->response);
+        entries[i].response_length = strlen(item->response);
+        entries[i].signature_offset = signatures->len;
+        entries[i].signature_length = signature->len;
+        g_array_append_vals(signatures, signature->data, signature->len);
+
+        g_array_unref(signature);
+    }
+
+    guint32 *buckets = g_new0(guint32, n_buckets);
+    guint32 *slots = g_new0(guint32, MAX(n, 1));
+    gboolean success = (n == 0) || build_perfect_hash(unique, n_buckets, buckets, slots, error);
+
+    if (success) {
+        PackHeader header = { 0 };
+        memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+        header.version = PACK_VERSION;
+        header.n_entries = n;
+        header.n_buckets = n_buckets;
+        header.buckets_offset = align8(sizeof(PackHeader));
+        header.slots_offset = align8(header.buckets_offset + n_buckets * sizeof(guint32));
+        header.entries_offset = align8(header.slots_offset + n * sizeof(guint32));
+        header.signatures_offset = align8(header.entries_offset + n * sizeof(PackEntry));
+        header.signatures_count = signatures->len;
+        header.strings_offset = align8(header.signatures_offset + signatures->len * sizeof(guint32));
+        header.strings_size = strings->len;
+
+        gsize total = header.strings_offset + header.strings_size;
+        gchar *buffer = g_malloc0(total);
+        memcpy(buffer, &header, sizeof(header));
+        memcpy(buffer + header.buckets_offset, buckets, n_buckets * sizeof(guint32));
+        memcpy(buffer + header.slots_offset, slots, n * sizeof(guint32));
+        memcpy(buffer + header.entries_offset, entries, n * sizeof(PackEntry));
+        memcpy(buffer + header.signatures_offset, signatures->data, signatures->len * sizeof(guint32));
+        memcpy(buffer + header.strings_offset, strings->data, strings->len);
+
+        success = g_file_set_contents(path, buffer, total, error);
+        g_free(buffer);
+    }
+
+    g_free(buckets);
+    g_free(slots);
+    g_free(entries);
+    g_byte_array_unref(strings);
+    g_array_unref(signatures);
+    g_ptr_array_unref(unique);
+
+    return success;
+}
+
+static gboolean section_fits(guint64 offset, guint64 size, gsize file_size) {
+    return offset <= file_size && size <= file_size - offset;
+}
+
+/* Check every offset in the file once so lookups can trust the mapping */
+static gboolean validate_pack(LLMCachePack *pack, gsize file_size) {
+    const PackHeader *h = pack->header;
+
+    if (file_size < sizeof(PackHeader)) return FALSE;
+    if (memcmp(h->magic, PACK_MAGIC, sizeof(h->magic)) != 0) return FALSE;
+    if (h->version != PACK_VERSION || h->n_buckets == 0) return FALSE;
+
+    if (!section_fits(h->buckets_offset, (guint64)h->n_buckets * sizeof(guint32), file_size) ||
+        !section_fits(h->slots_offset, (guint64)h->n_entries * sizeof(guint32), file_size) ||
+        !section_fits(h->entries_offset, (guint64)h->n_entries * sizeof(PackEntry), file_size) ||
+        !section_fits(h->signatures_offset, h->signatures_count * sizeof(guint32), file_size) ||
+        !section_fits(h->strings_offset, h->strings_size, file_size)) {
+        return FALSE;
+    }
+
+    if ((h->buckets_offset | h->slots_offset | h->entries_offset | h->signatures_offset) & 7) {
+        return FALSE;
+    }
+
+    const gchar *base = (const gchar *)h;
+    pack->buckets = (const guint32 *)(base + h->buckets_offset);
+    pack->slots = (const guint32 *)(base + h->slots_offset);
+    pack->entries = (const PackEntry *)(base + h->entries_offset);
+    pack->signatures = (const guint32 *)(base + h->signatures_offset);
+    pack->strings = base + h->strings_offset;
+
+    for (guint32 i = 0; i < h->n_buckets; i++) {
+        if ((pack->buckets[i] & PACK_DIRECT_SLOT) &&
+            (pack->buckets[i] & ~PACK_DIRECT_SLOT) >= h->n_entries) return FALSE;
+    }
+
+    for (guint32 i = 0; i < h->n_entries; i++) {
+        const PackEntry *e = &pack->entries[i];
+
+        if (pack->slots[i] >= h->n_entries) return FALSE;
+        if ((guint64)e->prompt_offset + e->prompt_length >= h->strings_size ||
+            (guint64)e->model_offset + e->model_length >= h->strings_size ||
+            (guint64)e->response_offset + e->response_length >= h->strings_size ||
+            (guint64)e->signature_offset + e->signature_length > h->signatures_count) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+LLMCachePack* llm_cache_pack_open(const gchar *path, GError **error) {
+    g_return_val_if_fail(path != NULL, NULL);
+
+    GMappedFile *file = g_mapped_file_new(path, FALSE, error);
+    if (!file) return NULL;
+
+    LLMCachePack *pack = g_new0(LLMCachePack, 1);
+    pack->file = file;
+    pack->header = (const PackHeader *)g_mapped_file_get_contents(file);
+
+    if (!pack->header || !validate_pack(pack, g_mapped_file_get_length(file))) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "%s is not a valid cache pack", path);
+        llm_cache_pack_free(pack);
+        return NULL;
+    }
+
+    return pack;
+}
+
+void llm_cache_pack_free(LLMCachePack *pack) {
+    if (!pack) return;
+
+    if (pack->file) g_mapped_file_unref(pack->file);
+    g_free(pack);
+}
+
+guint llm_cache_pack_get_n_entries(LLMCachePack *pack) {
+    return pack ? pack->header->n_entries : 0;
+}
+
+void llm_cache_pack_get_entry(LLMCachePack *pack,
+                              guint index,
+                              gchar **model,
+                              gchar **prompt,
+                              gchar **response) {
+    g_return_if_fail(pack != NULL);
+    g_return_if_fail(index < pack->header->n_entries);
+
+    const PackEntry *e = &pack->entries[index];
+
+    if (model) *model = g_strndup(pack->strings + e->model_offset, e->model_length);
+    if (prompt) *prompt = g_strndup(pack->strings + e->prompt_offset, e->prompt_length);
+    if (response) *response = g_strndup(pack->strings + e->response_offset, e->response_length);
+}
+
+/* Entries without a model are curated answers and serve every model */
+static gboolean entry_matches_model(LLMCachePack *pack, const PackEntry *e, const gchar *model) {
+    if (e->model_length == 0 || !model || !*model) return TRUE;
+
+    return e->model_length == strlen(model) &&
+           memcmp(pack->strings + e->model_offset, model, e->model_length) == 0;
+}
+
+gchar* llm_cache_pack_lookup(LLMCachePack *pack, const gchar *model, const gchar *prompt) {
+    if (!pack || !prompt || pack->header->n_entries == 0) return NULL;
+
+    const PackHeader *h = pack->header;
+    gsize length = strlen(prompt);
+    guint32 seed = pack->buckets[pack_hash(prompt, length, 0) % h->n_buckets];
+    guint32 slot = (seed & PACK_DIRECT_SLOT) ?
+                   (seed & ~PACK_DIRECT_SLOT) :
+                   pack_hash(prompt, length, seed) % h->n_entries;
+
+    const PackEntry *e = &pack->entries[pack->slots[slot]];
+    if (e->prompt_length != length ||
+        memcmp(pack->strings + e->prompt_offset, prompt, length) != 0 ||
+        !entry_matches_model(pack, e, model)) {
+        return NULL;
+    }
+
+    return g_strndup(pack->strings + e->response_offset, e->response_length);
+}
+
+gint llm_cache_pack_find_closest(LLMCachePack *pack, const gchar *model,
+                                 GArray *signature, gdouble *similarity) {
+    gint best = -1;
+    gdouble best_score = 0.0;
+
+    if (pack && signature) {
+        for (guint32 i = 0; i < pack->header->n_entries; i++) {
+            const PackEntry *e = &pack->entries[i];
+
+            if (!entry_matches_model(pack, e, model)) continue;
+
+            gdouble score = llm_cache_signature_similarity(
+                (const guint32 *)signature->data, signature->len,
+                pack->signatures + e->signature_offset, e->signature_length);
+
+            if (score > best_score) {
+                best_score = score;
+                best = i;
+            }
+        }
+    }
+
+    if (similarity) *similarity = best_score;
+    return best;
+}
@@ -0,0 +1,81 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_CACHE_PACK_H
+#define LLM_CACHE_PACK_H
+
+#include <glib.h>
+
+#define CACHE_PACK_SUFFIX ".llmpack"
+
+typedef struct _LLMCachePack LLMCachePack;
+
+typedef struct {
+    const gchar *model;
+    const gchar *prompt;
+    const gchar *response;
+} LLMCachePackItem;
+
+/**
+ * Write an immutable cache pack
+ *
+ * Entries are sorted by prompt and indexed with a minimal perfect hash.
+ * Duplicate prompts keep the first item. The file is replaced atomically,
+ * so clients that still have the previous pack mapped are unaffected.
+ *
+ * @param path Destination file
+ * @param items Array of LLMCachePackItem pointers
+ * @param error Return location for an error
+ */
+gboolean llm_cache_pack_write(const gchar *path, GPtrArray *items, GError **error);
+
+/**
+ * Map a cache pack read-only
+ *
+ * @return The pack, or NULL if the file is missing or malformed
+ */
+LLMCachePack* llm_cache_pack_open(const gchar *path, GError **error);
+void llm_cache_pack_free(LLMCachePack *pack);
+
+guint llm_cache_pack_get_n_entries(LLMCachePack *pack);
+
+/**
+ * Get entry @index (in prompt order). Returned strings are newly allocated.
+ */
+void llm_cache_pack_get_entry(LLMCachePack *pack,
+                              guint index,
+                              gchar **model,
+                              gchar **prompt,
+                              gchar **response);
+
+/**
+ * Look up the response for exactly this prompt in O(1) through the
+ * perfect hash
+ *
+ * Entries written by another model are a miss; entries without a model
+ * match any model.
+ *
+ * @return Newly allocated response, or NULL on a miss
+ */
+gchar* llm_cache_pack_lookup(LLMCachePack *pack, const gchar *model, const gchar *prompt);
+
+/**
+ * Find the entry with the most similar prompt signature among those that
+ * llm_cache_pack_lookup() would return for @model
+ *
+ * @param signature Sorted word-hash set, see llm_cache_compute_signature()
+ * @param similarity Return location for the best score (0.0 if no entry)
+ * @return Index of the best entry, or -1 if the pack is empty
+ */
+gint llm_cache_pack_find_closest(LLMCachePack *pack, const gchar *model,
+                                 GArray *signature, gdouble *similarity);
+
+#endif /* LLM_CACHE_PACK_H */
@@ -0,0 +1,317 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Canned-answer matcher. A BM25 inverted index over a directory of FAQ
+ * answers, so routine questions can be answered without an API call or be
+ * grounded with the closest known answer.
+ */
+
+#include "llm_canned.h"
+#include "llm_text.h"
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define BM25_K1 1.2
+#define BM25_B 0.75
+#define KEY_TERMS 3
+
+typedef struct {
+    gchar *title;
+    gchar *answer;
+    guint length; /* in tokens */
+} CannedDoc;
+
+typedef struct {
+    GArray *docs; /* ascending guint32 doc ids */
+    GArray *tfs;  /* guint32 term frequency, parallel to docs */
+} Posting;
+
+struct _LLMCannedIndex {
+    GPtrArray *docs;     /* CannedDoc */
+    GHashTable *postings; /* term -> Posting */
+    gdouble avg_length;
+};
+
+static void canned_doc_free(CannedDoc *doc) {
+    g_free(doc->title);
+    g_free(doc->answer);
+    g_free(doc);
+}
+
+static void posting_free(Posting *posting) {
+    g_array_unref(posting->docs);
+    g_array_unref(posting->tfs);
+    g_free(posting);
+}
+
+static gchar* title_from_filename(const gchar *name) {
+    gchar *title = g_strdup(name);
+    gchar *dot = strrchr(title, '.');
+    if (dot && dot != title) *dot = '\0';
+    g_strdelimit(title, "-_", ' ');
+    return title;
+}
+
+static gint compare_names(gconstpointer a, gconstpointer b) {
+    return g_strcmp0(*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+static void add_document(LLMCannedIndex *index, gchar *title, gchar *answer) {
+    guint32 doc_id = index->docs->len;
+    gchar *indexed_text = g_strconcat(title, "\n", answer, NULL);
+    GPtrArray *tokens = llm_text_tokenize(indexed_text, TRUE);
+    GHashTable *tf = g_hash_table_new(g_str_hash, g_str_equal);
+
+    for (guint i = 0; i < tokens->len; i++) {
+        gpointer term = g_ptr_array_index(tokens, i);
+        g_hash_table_insert(tf, term, GUINT_TO_POINTER(GPOINTER_TO_UINT(g_hash_table_lookup(tf, term)) + 1));
+    }
+
+    /* Documents are added in id order, so every posting list stays sorted */
+    GHashTableIter iter;
+    gpointer term, count;
+    g_hash_table_iter_init(&iter, tf);
+    while (g_hash_table_iter_next(&iter, &term, &count)) {
+        Posting *posting = g_hash_table_lookup(index->postings, term);
+        guint32 frequency = GPOINTER_TO_UINT(count);
+
+        if (!posting) {
+            posting = g_new0(Posting, 1);
+            posting->docs = g_array_new(FALSE, FALSE, sizeof(guint32));
+            posting->tfs = g_array_new(FALSE, FALSE, sizeof(guint32));
+            g_hash_table_insert(index->postings, g_strdup(term), posting);
+        }
+        g_array_append_val(posting->docs, doc_id);
+        g_array_append_val(posting->tfs, frequency);
+    }
+
+    CannedDoc *doc = g_new0(CannedDoc, 1);
+    doc->title = title;
+    doc->answer = answer;
+    doc->length = tokens->len;
+    g_ptr_array_add(index->docs, doc);
+
+    g_hash_table_destroy(tf);
+    g_ptr_array_unref(tokens);
+    g_free(indexed_text);
+}
+
+LLMCannedIndex* llm_canned_index_new(const gchar *dir_path) {
+    if (!dir_path || !*dir_path) return NULL;
+
+    GError *error = NULL;
+    GDir *dir = g_dir_open(dir_path, 0, &error);
+    if (!dir) {
+        g_warning("LLM Canned: Cannot open %s: %s", dir_path, error->message);
+        g_error_free(error);
+        return NULL;
+    }
+
+    LLMCannedIndex *index = g_new0(LLMCannedIndex, 1);
+    index->docs = g_ptr_array_new_with_free_func((GDestroyNotify)canned_doc_free);
+    index->postings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                            (GDestroyNotify)posting_free);
+
+    /* Sort file names so document ids are stable between runs */
+    GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+    const gchar *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (name[0] != '.') g_ptr_array_add(names, g_strdup(name));
+    }
+    g_dir_close(dir);
+    g_ptr_array_sort(names, compare_names);
+
+    guint64 total_length = 0;
+    for (guint i = 0; i < names->len; i++) {
+        const gchar *file_name = g_ptr_array_index(names, i);
+        gchar *path = g_build_filename(dir_path, file_name, NULL);
+        gchar *contents = NULL;
+
+        if (g_file_test(path, G_FILE_TEST_IS_REGULAR) &&
+            g_file_get_contents(path, &contents, NULL, NULL) &&
+            g_utf8_validate(contents, -1, NULL)) {
+            g_strstrip(contents);
+            if (*contents) {
+                add_document(index, title_from_filename(file_name), contents);
+                total_length += ((CannedDoc *)g_ptr_array_index(index->docs, index->docs->len - 1))->length;
+                contents = NULL;
+            }
+        }
+
+        g_free(contents);
+        g_free(path);
+    }
+    g_ptr_array_unref(names);
+
+    index->avg_length = index->docs->len ? (gdouble)total_length / index->docs->len : 0.0;
+    g_print("LLM Canned: Indexed %u answers from %s\n", index->docs->len, dir_path);
+
+    return index;
+}
+
+void llm_canned_index_free(LLMCannedIndex *index) {
+    if (!index) return;
+
+    g_ptr_array_unref(index->docs);
+    g_hash_table_destroy(index->postings);
+    g_free(index);
+}
+
+guint llm_canned_index_get_n_answers(LLMCannedIndex *index) {
+    return index ? index->docs->len : 0;
+}
+
+gsize llm_canned_intersect(const guint32 *a, gsize a_len,
+                           const guint32 *b, gsize b_len,
+                           guint32 *out) {
+    gsize i = 0, j = 0, n = 0;
+
+#ifdef __SSE2__
+    /* Compare a block of four ids from each list against all rotations of
+     * the other block, then advance whichever block ends lower */
+    while (i + 4 <= a_len && j + 4 <= b_len) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+        __m128i eq = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        gint mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+
+        for (gint k = 0; k < 4; k++) {
+            if (mask & (1 << k)) out[n++] = a[i + k];
+        }
+
+        guint32 a_max = a[i + 3];
+        guint32 b_max = b[j + 3];
+        if (a_max <= b_max) i += 4;
+        if (b_max <= a_max) j += 4;
+    }
+#endif
+
+    while (i < a_len && j < b_len) {
+        if (a[i] == b[j]) {
+            out[n++] = a[i];
+            i++;
+            j++;
+        } else if (a[i] < b[j]) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+
+    return n;
+}
+
+static gdouble idf(LLMCannedIndex *index, Posting *posting) {
+    gdouble n = index->docs->len;
+    gdouble df = posting->docs->len;
+    return log(1.0 + (n - df + 0.5) / (df + 0.5));
+}
+
+static gint compare_postings_by_length(gconstpointer a, gconstpointer b) {
+    const Posting *x = *(const Posting * const *)a;
+    const Posting *y = *(const Posting * const *)b;
+    return (gint)x->docs->len - (gint)y->docs->len;
+}
+
+/* Does the document contain every one of the query's rarest terms? */
+static gboolean covers_key_terms(GPtrArray *postings, guint32 doc_id) {
+    guint count = MIN(postings->len, KEY_TERMS);
+    if (count == 0) return FALSE;
+
+    Posting *first = g_ptr_array_index(postings, 0);
+    GArray *candidates = g_array_sized_new(FALSE, FALSE, sizeof(guint32), first->docs->len);
+    g_array_append_vals(candidates, first->docs->data, first->docs->len);
+
+    for (guint t = 1; t < count && candidates->len > 0; t++) {
+        Posting *posting = g_ptr_array_index(postings, t);
+        guint32 *out = g_new(guint32, MIN(candidates->len, posting->docs->len) + 1);
+        gsize n = llm_canned_intersect((const guint32 *)candidates->data, candidates->len,
+                                       (const guint32 *)posting->docs->data, posting->docs->len,
+                                       out);
+        g_array_set_size(candidates, 0);
+        g_array_append_vals(candidates, out, n);
+        g_free(out);
+    }
+
+    gboolean found = FALSE;
+    for (guint i = 0; i < candidates->len && !found; i++) {
+        found = g_array_index(candidates, guint32, i) == doc_id;
+    }
+    g_array_unref(candidates);
+
+    return found;
+}
+
+gboolean llm_canned_index_search(LLMCannedIndex *index, const gchar *query, LLMCannedMatch *match) {
+    g_return_val_if_fail(match != NULL, FALSE);
+    memset(match, 0, sizeof(*match));
+
+    if (!index || index->docs->len == 0 || !query) return FALSE;
+
+    GPtrArray *tokens = llm_text_tokenize(query, TRUE);
+    GHashTable *unique = g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray *postings = g_ptr_array_new();
+    gdouble *scores = g_new0(gdouble, index->docs->len);
+    gdouble max_score = 0.0;
+
+    for (guint i = 0; i < tokens->len; i++) {
+        const gchar *term = g_ptr_array_index(tokens, i);
+        if (!g_hash_table_add(unique, (gpointer)term)) continue;
+
+        Posting *posting = g_hash_table_lookup(index->postings, term);
+        gdouble term_idf = posting ? idf(index, posting) : log(1.0 + (index->docs->len + 0.5) / 0.5);
+
+        /* Reference score: an average-length answer containing each query
+         * term once. Used to normalize, so thresholds work for any query. */
+        max_score += term_idf;
+
+        if (!posting) continue;
+        g_ptr_array_add(postings, posting);
+
+        for (guint p = 0; p < posting->docs->len; p++) {
+            guint32 doc_id = g_array_index(posting->docs, guint32, p);
+            gdouble tf = g_array_index(posting->tfs, guint32, p);
+            CannedDoc *doc = g_ptr_array_index(index->docs, doc_id);
+            gdouble norm = 1.0 - BM25_B + BM25_B * doc->length / MAX(index->avg_length, 1.0);
+
+            scores[doc_id] += term_idf * tf * (BM25_K1 + 1.0) / (tf + BM25_K1 * norm);
+        }
+    }
+
+    gint best = -1;
+    for (guint d = 0; d < index->docs->len; d++) {
+        if (scores[d] > 0.0 && (best < 0 || scores[d] > scores[best])) best = d;
+    }
+
+    if (best >= 0) {
+        CannedDoc *doc = g_ptr_array_index(index->docs, best);
+        g_ptr_array_sort(postings, compare_postings_by_length);
+
+        match->title = doc->title;
+        match->answer = doc->answer;
+        match->score = max_score > 0.0 ? MIN(scores[best] / max_score, 1.0) : 0.0;
+        match->covers_key_terms = covers_key_terms(postings, best);
+    }
+
+    g_free(scores);
+    g_ptr_array_unref(postings);
+    g_hash_table_destroy(unique);
+    g_ptr_array_unref(tokens);
+
+    return best >= 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_CANNED_H
+#define LLM_CANNED_H
+
+#include <glib.h>
+
+typedef struct _LLMCannedIndex LLMCannedIndex;
+
+typedef struct {
+    const gchar *title;  /* owned by the index */
+    const gchar *answer; /* owned by the index */
+    gdouble score;       /* BM25 score normalized to 0.0 - 1.0 */
+    gboolean covers_key_terms; /* answer contains all of the query's rarest terms */
+} LLMCannedMatch;
+
+/**
+ * Build an inverted index over every regular file in a directory
+ *
+ * Each file is one canned answer; its name (without extension) is the title.
+ *
+ * @return The index, or NULL if the directory cannot be read
+ */
+LLMCannedIndex* llm_canned_index_new(const gchar *dir_path);
+void llm_canned_index_free(LLMCannedIndex *index);
+
+guint llm_canned_index_get_n_answers(LLMCannedIndex *index);
+
+/**
+ * Rank the canned answers against a query with BM25
+ *
+ * @param match Filled in with the best answer
+ * @return TRUE if any answer shares a term with the query
+ */
+gboolean llm_canned_index_search(LLMCannedIndex *index, const gchar *query, LLMCannedMatch *match);
+
+/**
+ * Intersect two ascending lists of unique document ids
+ *
+ * Uses SSE2 block comparisons when available.
+ *
+ * @param out Must have room for MIN(a_len, b_len) ids; may be a itself
+ * @return Number of ids written to out
+ */
+gsize llm_canned_intersect(const guint32 *a, gsize a_len,
+                           const guint32 *b, gsize b_len,
+                           guint32 *out);
+
+#endif /* LLM_CANNED_H */
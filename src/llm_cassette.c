@@ -0,0 +1,198 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Cassettes of recorded model exchanges. Each line of a cassette is a JSON
+ * object holding one request and its response body, split into the chunks
+ * it arrived in and timed from the moment the request was sent, so
+ * tools/llm-replay-server can play streaming responses back as they came.
+ */
+
+#include "llm_cassette.h"
+#include <json-glib/json-glib.h>
+#include <gio/gio.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static GMutex cassette_mutex;
+
+static void cassette_chunk_free(LLMCassetteChunk *chunk) {
+    g_bytes_unref(chunk->data);
+    g_free(chunk);
+}
+
+static LLMCassetteExchange* exchange_alloc(void) {
+    LLMCassetteExchange *exchange = g_new0(LLMCassetteExchange, 1);
+    exchange->chunks = g_ptr_array_new_with_free_func((GDestroyNotify)cassette_chunk_free);
+    return exchange;
+}
+
+gboolean llm_cassette_is_recording(void) {
+    const gchar *path = g_getenv(CASSETTE_ENV);
+    return path && *path;
+}
+
+LLMCassetteExchange* llm_cassette_exchange_new(const gchar *url, const gchar *model, const gchar *request_body) {
+    LLMCassetteExchange *exchange = exchange_alloc();
+
+    /* Drop scheme and host; the replay server answers on its own address */
+    const gchar *path = strstr(url, "://");
+    path = path ? strchr(path + 3, '/') : url;
+
+    exchange->path = g_strdup(path ? path : "/");
+    exchange->model = g_strdup(model ? model : "");
+    exchange->request_body = g_strdup(request_body ? request_body : "");
+    exchange->start_time = g_get_monotonic_time();
+    return exchange;
+}
+
+void llm_cassette_exchange_add_chunk(LLMCassetteExchange *exchange, const void *data, gsize length) {
+    LLMCassetteChunk *chunk = g_new0(LLMCassetteChunk, 1);
+    chunk->offset_us = g_get_monotonic_time() - exchange->start_time;
+    chunk->data = g_bytes_new(data, length);
+    g_ptr_array_add(exchange->chunks, chunk);
+}
+
+static gchar* exchange_to_json(LLMCassetteExchange *exchange) {
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "path");
+    json_builder_add_string_value(builder, exchange->path);
+    json_builder_set_member_name(builder, "model");
+    json_builder_add_string_value(builder, exchange->model);
+    json_builder_set_member_name(builder, "request");
+    json_builder_add_string_value(builder, exchange->request_body);
+    json_builder_set_member_name(builder, "status");
+    json_builder_add_int_value(builder, exchange->status);
+    json_builder_set_member_name(builder, "content_type");
+    json_builder_add_string_value(builder, exchange->content_type ? exchange->content_type : "");
+
+    json_builder_set_member_name(builder, "chunks");
+    json_builder_begin_array(builder);
+    for (guint i = 0; i < exchange->chunks->len; i++) {
+        LLMCassetteChunk *chunk = g_ptr_array_index(exchange->chunks, i);
+        gsize length = 0;
+        const guchar *data = g_bytes_get_data(chunk->data, &length);
+        gchar *encoded = g_base64_encode(data, length);
+
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "offset_us");
+        json_builder_add_int_value(builder, chunk->offset_us);
+        json_builder_set_member_name(builder, "data");
+        json_builder_add_string_value(builder, encoded);
+        json_builder_end_object(builder);
+
+        g_free(encoded);
+    }
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    gchar *line = json_generator_to_data(generator, NULL);
+
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+    return line;
+}
+
+void llm_cassette_exchange_finish(LLMCassetteExchange *exchange, guint status, const gchar *content_type) {
+    const gchar *path = g_getenv(CASSETTE_ENV);
+
+    exchange->status = status;
+    exchange->content_type = g_strdup(content_type);
+
+    if (path && *path) {
+        gchar *line = exchange_to_json(exchange);
+
+        g_mutex_lock(&cassette_mutex);
+        /* The cassette holds whole prompts, so only the user may read it */
+        int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        FILE *file = fd >= 0 ? fdopen(fd, "a") : NULL;
+        if (!file && fd >= 0) close(fd);
+        if (file) {
+            fprintf(file, "%s\n", line);
+            fclose(file);
+        } else {
+            g_warning("LLM Cassette: Failed to append to %s", path);
+        }
+        g_mutex_unlock(&cassette_mutex);
+
+        g_free(line);
+    }
+
+    llm_cassette_exchange_free(exchange);
+}
+
+void llm_cassette_exchange_free(LLMCassetteExchange *exchange) {
+    if (!exchange) return;
+
+    g_free(exchange->path);
+    g_free(exchange->model);
+    g_free(exchange->request_body);
+    g_free(exchange->content_type);
+    g_ptr_array_unref(exchange->chunks);
+    g_free(exchange);
+}
+
+static LLMCassetteExchange* exchange_from_json(JsonObject *obj) {
+    LLMCassetteExchange *exchange = exchange_alloc();
+    exchange->path = g_strdup(json_object_get_string_member_with_default(obj, "path", "/"));
+    exchange->model = g_strdup(json_object_get_string_member_with_default(obj, "model", ""));
+    exchange->request_body = g_strdup(json_object_get_string_member_with_default(obj, "request", ""));
+    exchange->status = json_object_get_int_member_with_default(obj, "status", 200);
+    exchange->content_type = g_strdup(json_object_get_string_member_with_default(obj, "content_type", ""));
+
+    JsonArray *chunks = json_object_has_member(obj, "chunks")
+        ? json_object_get_array_member(obj, "chunks") : NULL;
+    for (guint i = 0; chunks && i < json_array_get_length(chunks); i++) {
+        JsonObject *chunk_obj = json_array_get_object_element(chunks, i);
+        gsize length = 0;
+        guchar *data = g_base64_decode(json_object_get_string_member_with_default(chunk_obj, "data", ""), &length);
+
+        LLMCassetteChunk *chunk = g_new0(LLMCassetteChunk, 1);
+        chunk->offset_us = json_object_get_int_member_with_default(chunk_obj, "offset_us", 0);
+        chunk->data = g_bytes_new_take(data, length);
+        g_ptr_array_add(exchange->chunks, chunk);
+    }
+
+    return exchange;
+}
+
+GPtrArray* llm_cassette_load(const gchar *path, GError **error) {
+    gchar *contents = NULL;
+    if (!g_file_get_contents(path, &contents, NULL, error)) return NULL;
+
+    GPtrArray *exchanges = g_ptr_array_new_with_free_func((GDestroyNotify)llm_cassette_exchange_free);
+    JsonParser *parser = json_parser_new();
+    gchar **lines = g_strsplit(contents, "\n", -1);
+
+    for (guint i = 0; lines[i]; i++) {
+        if (!*g_strstrip(lines[i])) continue;
+
+        if (!json_parser_load_from_data(parser, lines[i], -1, NULL) ||
+            !JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser))) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s:%u: not a recorded exchange", path, i + 1);
+            g_ptr_array_unref(exchanges);
+            exchanges = NULL;
+            break;
+        }
+
+        g_ptr_array_add(exchanges, exchange_from_json(json_node_get_object(json_parser_get_root(parser))));
+    }
+
+    g_strfreev(lines);
+    g_object_unref(parser);
+    g_free(contents);
+    return exchanges;
+}
@@ -0,0 +1,69 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_CASSETTE_H
+#define LLM_CASSETTE_H
+
+#include <glib.h>
+
+/* Set to a file name to record every HTTP exchange with a model into it */
+#define CASSETTE_ENV "LLM_ASSISTANT_CASSETTE"
+
+typedef struct {
+    gint64 offset_us; /* since the request was sent */
+    GBytes *data;     /* exactly as received, including partial SSE frames */
+} LLMCassetteChunk;
+
+typedef struct {
+    gchar *path;         /* URL path without scheme and host, e.g. /v1/chat/completions */
+    gchar *model;
+    gchar *request_body;
+    guint status;
+    gchar *content_type;
+    GPtrArray *chunks;   /* LLMCassetteChunk */
+    gint64 start_time;   /* monotonic, while recording */
+} LLMCassetteExchange;
+
+/**
+ * Whether exchanges are recorded, i.e. LLM_ASSISTANT_CASSETTE is set
+ */
+gboolean llm_cassette_is_recording(void);
+
+/**
+ * Start recording an exchange; call right before the request is sent
+ *
+ * Only the URL path, the model and the request body are kept. Headers,
+ * which carry the API key, are never recorded.
+ */
+LLMCassetteExchange* llm_cassette_exchange_new(const gchar *url, const gchar *model, const gchar *request_body);
+
+/**
+ * Record a piece of the response body as it arrives. Not thread-safe;
+ * an exchange belongs to the thread that sends the request.
+ */
+void llm_cassette_exchange_add_chunk(LLMCassetteExchange *exchange, const void *data, gsize length);
+
+/**
+ * Append the exchange to the cassette file and free it. Safe to call
+ * from any thread.
+ */
+void llm_cassette_exchange_finish(LLMCassetteExchange *exchange, guint status, const gchar *content_type);
+
+void llm_cassette_exchange_free(LLMCassetteExchange *exchange);
+
+/**
+ * Load every exchange of a cassette, in recording order
+ *
+ * @return Array of LLMCassetteExchange, or NULL on error; free with g_ptr_array_unref()
+ */
+GPtrArray* llm_cassette_load(const gchar *path, GError **error);
+
+#endif /* LLM_CASSETTE_H */
@@ -0,0 +1,573 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Model catalog. Merges the model lists of OpenAI and any configured
+ * OpenAI-compatible endpoints, fetched in parallel, with what is known about
+ * each model and the speed observed when it was used. The client routes
+ * requests by it and the preferences dialog lists it. Observations are
+ * written back CATALOG_SAVE_DELAY_S later by a writer thread, together with
+ * any that arrive in the meantime.
+ */
+
+#include "llm_catalog.h"
+#include "llm_client.h"
+#include <curl/curl.h>
+#include <json-glib/json-glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+typedef struct {
+    const gchar *prefix;
+    gint context_length;
+    gboolean supports_prediction;
+} KnownModel;
+
+/* Context windows of OpenAI models, whose listing does not include them.
+ * The first matching prefix wins, so longer prefixes come first. */
+static const KnownModel known_models[] = {
+    { "gpt-5", 400000, FALSE },
+    { "gpt-4.1", 1047576, TRUE },
+    { "gpt-4o", 128000, TRUE },
+    { "chatgpt-4o", 128000, FALSE },
+    { "gpt-4-turbo", 128000, FALSE },
+    { "gpt-4-1106", 128000, FALSE },
+    { "gpt-4-0125", 128000, FALSE },
+    { "gpt-4", 8192, FALSE },
+    { "gpt-3.5-turbo", 16385, FALSE },
+    { "o1", 200000, FALSE },
+    { "o3", 200000, FALSE },
+    { "o4", 200000, FALSE },
+};
+
+/* OpenAI lists every model of the account; these cannot chat */
+static const gchar *non_chat_markers[] = {
+    "embedding", "tts", "whisper", "dall-e", "moderation", "davinci", "babbage",
+    "realtime", "audio", "transcribe", "image", "search", "computer-use",
+};
+
+/* Members servers use for the context window in their model listing */
+static const gchar *context_length_members[] = {
+    "context_length", "context_window", "max_model_len", "max_context_length",
+};
+
+struct _LLMCatalog {
+    GMutex mutex;
+    gchar *path;
+    GHashTable *models; /* id -> LLMModelInfo */
+    gint64 fetched_at;  /* seconds since the epoch */
+    gint refreshing;    /* a background refresh is running */
+    guint save_source_id; /* pending deferred save */
+    GThreadPool *writer;  /* one thread, so snapshots are written in order */
+};
+
+typedef struct {
+    gchar *path;
+    gchar *contents;
+} CatalogSnapshot;
+
+typedef struct {
+    gchar *endpoint;
+    CURL *curl;
+    struct curl_slist *headers;
+    GString *body;
+    gboolean complete; /* transfer finished with HTTP 200 */
+    gboolean answered; /* the body was a model listing */
+} CatalogFetch;
+
+static LLMModelInfo* model_info_copy(const LLMModelInfo *info) {
+    LLMModelInfo *copy = g_new(LLMModelInfo, 1);
+    *copy = *info;
+    copy->id = g_strdup(info->id);
+    copy->endpoint = g_strdup(info->endpoint);
+    return copy;
+}
+
+void llm_model_info_free(LLMModelInfo *info) {
+    if (!info) return;
+
+    g_free(info->id);
+    g_free(info->endpoint);
+    g_free(info);
+}
+
+static const KnownModel* find_known_model(const gchar *id) {
+    for (gsize i = 0; i < G_N_ELEMENTS(known_models); i++) {
+        if (g_str_has_prefix(id, known_models[i].prefix)) return &known_models[i];
+    }
+    return NULL;
+}
+
+static gboolean is_openai_chat_model(const gchar *id) {
+    if (!g_str_has_prefix(id, "gpt-") && !g_str_has_prefix(id, "chatgpt-") &&
+        !g_str_has_prefix(id, "o1") && !g_str_has_prefix(id, "o3") && !g_str_has_prefix(id, "o4")) {
+        return FALSE;
+    }
+
+    for (gsize i = 0; i < G_N_ELEMENTS(non_chat_markers); i++) {
+        if (strstr(id, non_chat_markers[i])) return FALSE;
+    }
+    return !g_str_has_suffix(id, "-instruct");
+}
+
+static gchar* catalog_serialize_locked(LLMCatalog *catalog) {
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "fetched_at");
+    json_builder_add_int_value(builder, catalog->fetched_at);
+    json_builder_set_member_name(builder, "models");
+    json_builder_begin_array(builder);
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, catalog->models);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        LLMModelInfo *info = value;
+
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "id");
+        json_builder_add_string_value(builder, info->id);
+        json_builder_set_member_name(builder, "endpoint");
+        json_builder_add_string_value(builder, info->endpoint);
+        json_builder_set_member_name(builder, "context_length");
+        json_builder_add_int_value(builder, info->context_length);
+        json_builder_set_member_name(builder, "streaming");
+        json_builder_add_boolean_value(builder, info->supports_streaming);
+        json_builder_set_member_name(builder, "prediction");
+        json_builder_add_boolean_value(builder, info->supports_prediction);
+        json_builder_set_member_name(builder, "tokens_per_second");
+        json_builder_add_double_value(builder, info->tokens_per_second);
+        json_builder_set_member_name(builder, "ttfb_ms");
+        json_builder_add_double_value(builder, info->ttfb_ms);
+        json_builder_set_member_name(builder, "samples");
+        json_builder_add_int_value(builder, info->samples);
+        json_builder_end_object(builder);
+    }
+
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    gchar *contents = json_generator_to_data(generator, NULL);
+
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+
+    return contents;
+}
+
+/* Runs in the writer thread */
+static void write_snapshot(gpointer data, gpointer user_data G_GNUC_UNUSED) {
+    CatalogSnapshot *snapshot = data;
+    GError *error = NULL;
+
+    gchar *cache_dir = g_path_get_dirname(snapshot->path);
+    g_mkdir_with_parents(cache_dir, 0700);
+    g_free(cache_dir);
+
+    if (!g_file_set_contents(snapshot->path, snapshot->contents, -1, &error)) {
+        g_warning("LLM Catalog: Failed to write %s: %s", snapshot->path, error->message);
+        g_error_free(error);
+    }
+
+    g_free(snapshot->path);
+    g_free(snapshot->contents);
+    g_free(snapshot);
+}
+
+/* Hand the writer thread the catalog as it is now */
+static void queue_snapshot_locked(LLMCatalog *catalog) {
+    CatalogSnapshot *snapshot = g_new0(CatalogSnapshot, 1);
+    snapshot->path = g_strdup(catalog->path);
+    snapshot->contents = catalog_serialize_locked(catalog);
+    g_thread_pool_push(catalog->writer, snapshot, NULL);
+}
+
+static gboolean on_save_timeout(gpointer user_data) {
+    LLMCatalog *catalog = user_data;
+
+    g_mutex_lock(&catalog->mutex);
+    catalog->save_source_id = 0;
+    queue_snapshot_locked(catalog);
+    g_mutex_unlock(&catalog->mutex);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Requests finish on worker threads; the timeout runs on the main loop */
+static void schedule_save_locked(LLMCatalog *catalog) {
+    if (!catalog->save_source_id) {
+        catalog->save_source_id = g_timeout_add_seconds(CATALOG_SAVE_DELAY_S, on_save_timeout, catalog);
+    }
+}
+
+static void catalog_load(LLMCatalog *catalog) {
+    if (!g_file_test(catalog->path, G_FILE_TEST_EXISTS)) return;
+
+    JsonParser *parser = json_parser_new();
+    GError *error = NULL;
+
+    if (json_parser_load_from_file(parser, catalog->path, &error)) {
+        JsonObject *root_obj = json_node_get_object(json_parser_get_root(parser));
+
+        if (root_obj && json_object_has_member(root_obj, "models")) {
+            catalog->fetched_at = json_object_get_int_member_with_default(root_obj, "fetched_at", 0);
+
+            JsonArray *models = json_object_get_array_member(root_obj, "models");
+            for (guint i = 0; i < json_array_get_length(models); i++) {
+                JsonObject *model = json_array_get_object_element(models, i);
+                const gchar *id = json_object_get_string_member_with_default(model, "id", NULL);
+                const gchar *endpoint = json_object_get_string_member_with_default(model, "endpoint", NULL);
+                if (!id || !endpoint) continue;
+
+                LLMModelInfo *info = g_new0(LLMModelInfo, 1);
+                info->id = g_strdup(id);
+                info->endpoint = g_strdup(endpoint);
+                info->context_length = json_object_get_int_member_with_default(model, "context_length", 0);
+                info->supports_streaming = json_object_get_boolean_member_with_default(model, "streaming", TRUE);
+                info->supports_prediction = json_object_get_boolean_member_with_default(model, "prediction", FALSE);
+                info->tokens_per_second = json_object_get_double_member_with_default(model, "tokens_per_second", 0.0);
+                info->ttfb_ms = json_object_get_double_member_with_default(model, "ttfb_ms", 0.0);
+                info->samples = json_object_get_int_member_with_default(model, "samples", 0);
+                g_hash_table_replace(catalog->models, info->id, info);
+            }
+        }
+    } else {
+        g_warning("LLM Catalog: Failed to parse %s: %s", catalog->path, error->message);
+        g_error_free(error);
+    }
+
+    g_object_unref(parser);
+}
+
+LLMCatalog* llm_catalog_get_default(void) {
+    static LLMCatalog *catalog = NULL;
+
+    if (g_once_init_enter(&catalog)) {
+        LLMCatalog *instance = g_new0(LLMCatalog, 1);
+        g_mutex_init(&instance->mutex);
+        instance->path = g_build_filename(g_get_user_cache_dir(), CONFIG_DIR_NAME, CATALOG_FILE_NAME, NULL);
+        instance->models = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                                 (GDestroyNotify)llm_model_info_free);
+        instance->writer = g_thread_pool_new(write_snapshot, NULL, 1, FALSE, NULL);
+        catalog_load(instance);
+
+        g_once_init_leave(&catalog, instance);
+    }
+
+    return catalog;
+}
+
+static size_t fetch_write_callback(void *contents, size_t size, size_t nmemb, GString *body) {
+    g_string_append_len(body, contents, size * nmemb);
+    return size * nmemb;
+}
+
+static CatalogFetch* catalog_fetch_new(const gchar *endpoint, const gchar *api_key) {
+    CatalogFetch *fetch = g_new0(CatalogFetch, 1);
+    llm_client_global_init();
+    fetch->curl = curl_easy_init();
+    if (!fetch->curl) {
+        g_free(fetch);
+        return NULL;
+    }
+
+    /* Tolerate a trailing slash in configured endpoints */
+    fetch->endpoint = g_strdup(endpoint);
+    gsize length = strlen(fetch->endpoint);
+    while (length > 0 && fetch->endpoint[length - 1] == '/') fetch->endpoint[--length] = '\0';
+
+    fetch->body = g_string_new(NULL);
+    if (api_key) {
+        gchar *auth_header = g_strdup_printf("Authorization: Bearer %s", api_key);
+        fetch->headers = curl_slist_append(fetch->headers, auth_header);
+        g_free(auth_header);
+    }
+
+    gchar *url = g_strdup_printf("%s/models", fetch->endpoint);
+    curl_easy_setopt(fetch->curl, CURLOPT_URL, url);
+    curl_easy_setopt(fetch->curl, CURLOPT_HTTPHEADER, fetch->headers);
+    curl_easy_setopt(fetch->curl, CURLOPT_WRITEFUNCTION, fetch_write_callback);
+    curl_easy_setopt(fetch->curl, CURLOPT_WRITEDATA, fetch->body);
+    curl_easy_setopt(fetch->curl, CURLOPT_TIMEOUT, (long)CATALOG_FETCH_TIMEOUT_S);
+    curl_easy_setopt(fetch->curl, CURLOPT_PRIVATE, fetch);
+    g_free(url);
+
+    return fetch;
+}
+
+static void catalog_fetch_free(CatalogFetch *fetch) {
+    curl_easy_cleanup(fetch->curl);
+    curl_slist_free_all(fetch->headers);
+    g_string_free(fetch->body, TRUE);
+    g_free(fetch->endpoint);
+    g_free(fetch);
+}
+
+/* Parse a /models listing into new entries of models */
+static void parse_listing(CatalogFetch *fetch, GHashTable *models) {
+    gboolean is_openai = g_strcmp0(fetch->endpoint, OPENAI_API_BASE) == 0;
+    JsonParser *parser = json_parser_new();
+    GError *error = NULL;
+
+    if (!json_parser_load_from_data(parser, fetch->body->str, fetch->body->len, &error)) {
+        g_warning("LLM Catalog: Failed to parse models of %s: %s", fetch->endpoint, error->message);
+        g_error_free(error);
+        g_object_unref(parser);
+        return;
+    }
+
+    JsonObject *root_obj = json_node_get_object(json_parser_get_root(parser));
+    if (!root_obj || !json_object_has_member(root_obj, "data")) {
+        g_object_unref(parser);
+        return;
+    }
+
+    fetch->answered = TRUE;
+
+    JsonArray *data = json_object_get_array_member(root_obj, "data");
+    for (guint i = 0; i < json_array_get_length(data); i++) {
+        JsonObject *model = json_array_get_object_element(data, i);
+        const gchar *id = model ? json_object_get_string_member_with_default(model, "id", NULL) : NULL;
+
+        if (!id || g_hash_table_contains(models, id)) continue;
+        if (is_openai ? !is_openai_chat_model(id) : strstr(id, "embed") != NULL) continue;
+
+        LLMModelInfo *info = g_new0(LLMModelInfo, 1);
+        info->id = g_strdup(id);
+        info->endpoint = g_strdup(fetch->endpoint);
+        info->supports_streaming = TRUE;
+
+        for (gsize m = 0; m < G_N_ELEMENTS(context_length_members) && !info->context_length; m++) {
+            info->context_length = json_object_get_int_member_with_default(model, context_length_members[m], 0);
+        }
+
+        const KnownModel *known = find_known_model(id);
+        if (known && !info->context_length) info->context_length = known->context_length;
+        info->supports_prediction = is_openai && known && known->supports_prediction;
+
+        g_hash_table_replace(models, info->id, info);
+    }
+
+    g_object_unref(parser);
+}
+
+gboolean llm_catalog_refresh(LLMCatalog *catalog, PluginConfig *config) {
+    if (!catalog || !config) return FALSE;
+
+    llm_client_global_init();
+    CURLM *multi = curl_multi_init();
+    if (!multi) return FALSE;
+
+    GPtrArray *fetches = g_ptr_array_new_with_free_func((GDestroyNotify)catalog_fetch_free);
+    CatalogFetch *fetch;
+
+    if (config_is_valid(config) && (fetch = catalog_fetch_new(OPENAI_API_BASE, config->openai_api_key))) {
+        g_ptr_array_add(fetches, fetch);
+    }
+    for (guint i = 0; config->model_endpoints && config->model_endpoints[i]; i++) {
+        if (*config->model_endpoints[i] && (fetch = catalog_fetch_new(config->model_endpoints[i], NULL))) {
+            g_ptr_array_add(fetches, fetch);
+        }
+    }
+
+    for (guint i = 0; i < fetches->len; i++) {
+        curl_multi_add_handle(multi, ((CatalogFetch *)g_ptr_array_index(fetches, i))->curl);
+    }
+
+    int running = 0;
+    do {
+        if (curl_multi_perform(multi, &running) != CURLM_OK) break;
+        if (running > 0) curl_multi_poll(multi, NULL, 0, 1000, NULL);
+    } while (running > 0);
+
+    /* Parse only complete, successful responses */
+    GHashTable *models = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                               (GDestroyNotify)llm_model_info_free);
+    CURLMsg *message;
+    int queued;
+    while ((message = curl_multi_info_read(multi, &queued))) {
+        if (message->msg != CURLMSG_DONE) continue;
+
+        curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char **)&fetch);
+        long status = 0;
+        curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE, &status);
+
+        if (message->data.result == CURLE_OK && status == 200) {
+            fetch->complete = TRUE;
+            continue;
+        }
+        g_warning("LLM Catalog: Listing models of %s failed: %s (HTTP %ld)", fetch->endpoint,
+                  curl_easy_strerror(message->data.result), status);
+    }
+
+    /* Configured endpoints are parsed before OpenAI, so a model one of them
+     * serves, e.g. a local server or the replay server, is sent there */
+    gboolean answered = FALSE;
+    for (guint pass = 0; pass < 2; pass++) {
+        for (guint i = 0; i < fetches->len; i++) {
+            fetch = g_ptr_array_index(fetches, i);
+            if ((g_strcmp0(fetch->endpoint, OPENAI_API_BASE) == 0) != (pass == 1)) continue;
+
+            curl_multi_remove_handle(multi, fetch->curl);
+            if (fetch->complete) parse_listing(fetch, models);
+            answered |= fetch->answered;
+        }
+    }
+
+    if (answered) {
+        g_mutex_lock(&catalog->mutex);
+
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, catalog->models);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            LLMModelInfo *old = value;
+            LLMModelInfo *info = g_hash_table_lookup(models, old->id);
+
+            if (info) {
+                info->tokens_per_second = old->tokens_per_second;
+                info->ttfb_ms = old->ttfb_ms;
+                info->samples = old->samples;
+                continue;
+            }
+
+            /* Keep the models of endpoints that did not answer this time,
+             * unless the endpoint was removed from the configuration */
+            gboolean endpoint_configured = g_strcmp0(old->endpoint, OPENAI_API_BASE) == 0;
+            gboolean endpoint_answered = FALSE;
+            for (guint i = 0; i < fetches->len; i++) {
+                fetch = g_ptr_array_index(fetches, i);
+                if (g_strcmp0(fetch->endpoint, old->endpoint) == 0) {
+                    endpoint_configured = TRUE;
+                    endpoint_answered |= fetch->answered;
+                }
+            }
+            if (endpoint_configured && !endpoint_answered) {
+                g_hash_table_iter_steal(&iter);
+                g_hash_table_replace(models, old->id, old);
+            }
+        }
+
+        g_hash_table_unref(catalog->models);
+        catalog->models = models;
+        models = NULL;
+        catalog->fetched_at = g_get_real_time() / G_USEC_PER_SEC;
+        g_print("LLM Catalog: %u models from %u endpoints\n",
+                g_hash_table_size(catalog->models), fetches->len);
+        queue_snapshot_locked(catalog);
+
+        g_mutex_unlock(&catalog->mutex);
+    }
+
+    if (models) g_hash_table_unref(models);
+    g_ptr_array_unref(fetches);
+    curl_multi_cleanup(multi);
+
+    return answered;
+}
+
+static gpointer refresh_thread(gpointer user_data) {
+    PluginConfig *config = user_data;
+
+    LLMCatalog *catalog = llm_catalog_get_default();
+
+    llm_catalog_refresh(catalog, config);
+    config_free(config);
+    g_atomic_int_set(&catalog->refreshing, 0);
+
+    return NULL;
+}
+
+void llm_catalog_refresh_in_background(PluginConfig *config) {
+    if (!config) return;
+    if (!g_atomic_int_compare_and_exchange(&llm_catalog_get_default()->refreshing, 0, 1)) return;
+
+    /* The thread may outlive the caller's configuration */
+    PluginConfig *copy = g_new0(PluginConfig, 1);
+    copy->openai_api_key = g_strdup(config->openai_api_key);
+    copy->model_endpoints = g_strdupv(config->model_endpoints);
+
+    g_thread_unref(g_thread_new("llm-catalog", refresh_thread, copy));
+}
+
+gboolean llm_catalog_is_stale(LLMCatalog *catalog) {
+    if (!catalog) return TRUE;
+
+    g_mutex_lock(&catalog->mutex);
+    gboolean stale = g_hash_table_size(catalog->models) == 0 ||
+                     g_get_real_time() / G_USEC_PER_SEC - catalog->fetched_at > CATALOG_MAX_AGE_S;
+    g_mutex_unlock(&catalog->mutex);
+
+    return stale;
+}
+
+static gint compare_model_ids(gconstpointer a, gconstpointer b) {
+    const LLMModelInfo *info_a = *(LLMModelInfo * const *)a;
+    const LLMModelInfo *info_b = *(LLMModelInfo * const *)b;
+    return g_strcmp0(info_a->id, info_b->id);
+}
+
+GPtrArray* llm_catalog_list(LLMCatalog *catalog) {
+    GPtrArray *list = g_ptr_array_new_with_free_func((GDestroyNotify)llm_model_info_free);
+    if (!catalog) return list;
+
+    g_mutex_lock(&catalog->mutex);
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, catalog->models);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(list, model_info_copy(value));
+    }
+    g_mutex_unlock(&catalog->mutex);
+
+    g_ptr_array_sort(list, compare_model_ids);
+    return list;
+}
+
+LLMModelInfo* llm_catalog_lookup(LLMCatalog *catalog, const gchar *model) {
+    if (!catalog || !model) return NULL;
+
+    g_mutex_lock(&catalog->mutex);
+    LLMModelInfo *info = g_hash_table_lookup(catalog->models, model);
+    LLMModelInfo *copy = info ? model_info_copy(info) : NULL;
+    g_mutex_unlock(&catalog->mutex);
+
+    return copy;
+}
+
+void llm_catalog_record(LLMCatalog *catalog,
+                        const gchar *model,
+                        gint64 ttfb_ms,
+                        gint64 generation_ms,
+                        gint completion_tokens) {
+    if (!catalog || !model) return;
+
+    g_mutex_lock(&catalog->mutex);
+
+    LLMModelInfo *info = g_hash_table_lookup(catalog->models, model);
+    if (info) {
+        gdouble weight = info->samples > 0 ? CATALOG_SPEED_WEIGHT : 1.0;
+        info->ttfb_ms += weight * (ttfb_ms - info->ttfb_ms);
+
+        if (generation_ms > 0 && completion_tokens > 0) {
+            gdouble tokens_per_second = completion_tokens * 1000.0 / generation_ms;
+            if (info->tokens_per_second <= 0.0) weight = 1.0;
+            info->tokens_per_second += weight * (tokens_per_second - info->tokens_per_second);
+        }
+
+        info->samples++;
+        schedule_save_locked(catalog);
+    }
+
+    g_mutex_unlock(&catalog->mutex);
+}
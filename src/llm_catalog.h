@@ -0,0 +1,97 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_CATALOG_H
+#define LLM_CATALOG_H
+
+#include <glib.h>
+#include "../config/config.h"
+
+#define CATALOG_FILE_NAME "models.json"
+#define CATALOG_MAX_AGE_S (24 * 60 * 60)
+#define CATALOG_FETCH_TIMEOUT_S 10
+#define CATALOG_SPEED_WEIGHT 0.2 /* weight of a new observation in the moving averages */
+#define CATALOG_SAVE_DELAY_S 10   /* observations within this time are written back together */
+
+typedef struct {
+    gchar *id;
+    gchar *endpoint;             /* API base URL serving the model */
+    gint context_length;         /* tokens; 0 if unknown */
+    gboolean supports_streaming;
+    gboolean supports_prediction; /* accepts predicted outputs */
+    gdouble tokens_per_second;   /* observed; 0 until the model was used */
+    gdouble ttfb_ms;             /* observed time to first byte */
+    guint samples;               /* number of observations */
+} LLMModelInfo;
+
+typedef struct _LLMCatalog LLMCatalog;
+
+/**
+ * Get the model catalog shared by the client and the preferences dialog
+ *
+ * Loaded from ~/.cache/evolution-llm-assistant/models.json on first use.
+ * All functions are safe to call from any thread.
+ *
+ * @return The shared instance, owned by the plugin
+ */
+LLMCatalog* llm_catalog_get_default(void);
+
+/**
+ * Fetch the model lists of OpenAI and every [models] endpoint in parallel
+ *
+ * Blocks for at most CATALOG_FETCH_TIMEOUT_S. Models of endpoints that do
+ * not answer are kept from the previous catalog while the endpoint is still
+ * configured; observations of models that are still listed are preserved.
+ * A model listed by a configured endpoint and by OpenAI goes to the endpoint.
+ *
+ * @return TRUE if at least one endpoint answered
+ */
+gboolean llm_catalog_refresh(LLMCatalog *catalog, PluginConfig *config);
+
+/**
+ * Run llm_catalog_refresh() on the default catalog in a worker thread
+ */
+void llm_catalog_refresh_in_background(PluginConfig *config);
+
+/**
+ * @return TRUE if the catalog is empty or older than CATALOG_MAX_AGE_S
+ */
+gboolean llm_catalog_is_stale(LLMCatalog *catalog);
+
+/**
+ * @return Copies of all entries sorted by id; free with g_ptr_array_unref()
+ */
+GPtrArray* llm_catalog_list(LLMCatalog *catalog);
+
+/**
+ * @return Copy of the entry for a model, or NULL if it is not in the catalog
+ */
+LLMModelInfo* llm_catalog_lookup(LLMCatalog *catalog, const gchar *model);
+
+void llm_model_info_free(LLMModelInfo *info);
+
+/**
+ * Fold a finished request into the model's speed statistics
+ *
+ * The file is written back CATALOG_SAVE_DELAY_S later from the main loop,
+ * not on every request.
+ *
+ * @param ttfb_ms Time until the first byte of the response
+ * @param generation_ms Time spent generating after the first byte
+ * @param completion_tokens Tokens generated
+ */
+void llm_catalog_record(LLMCatalog *catalog,
+                        const gchar *model,
+                        gint64 ttfb_ms,
+                        gint64 generation_ms,
+                        gint completion_tokens);
+
+#endif /* LLM_CATALOG_H */
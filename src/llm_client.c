@@ -8,11 +8,16 @@
  * Evolution LLM Assistant is free software: you can redistribute it and/or modify
  * it under the terms of the MIT License as published in the LICENSE file.
  *
- * OpenAI API client implementation. Handles communication with OpenAI's
- * chat completion and model listing endpoints.
+ * OpenAI API client implementation. Sends chat completions to the endpoint
+ * the model catalog lists for the model, OpenAI by default.
  */
 
 #include "llm_client.h"
+#include "llm_cassette.h"
+#include "llm_catalog.h"
+#include "llm_metrics.h"
+#include "llm_realtime.h"
+#include "llm_tools.h"
 #include <curl/curl.h>
 #include <json-glib/json-glib.h>
 #include <string.h>
@@ -20,10 +25,13 @@
 typedef struct {
     gchar *data;
     size_t size;
+    LLMCassetteExchange *exchange; /* records the body when set */
 } HTTPResponse;
 
 static size_t write_callback(void *contents, size_t size, size_t nmemb, HTTPResponse *response) {
     size_t total_size = size * nmemb;
+    if (response->exchange) llm_cassette_exchange_add_chunk(response->exchange, contents, total_size);
+
     response->data = g_realloc(response->data, response->size + total_size + 1);
 
     if (response->data) {
@@ -35,23 +43,35 @@ static size_t write_callback(void *contents, size_t size, size_t nmemb, HTTPResp
     return total_size;
 }
 
+void llm_client_global_init(void) {
+    static gsize initialized = 0;
+
+    if (g_once_init_enter(&initialized)) {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
 LLMClient* llm_client_new(PluginConfig *config) {
     if (!config_is_valid(config)) {
         return NULL;
     }
 
     LLMClient *client = g_new0(LLMClient, 1);
-    client->config = config;
-
-    curl_global_init(CURL_GLOBAL_DEFAULT);
+    client->config = config_copy(config);
+    client->ref_count = 1;
+    return client;
+}
 
+LLMClient* llm_client_ref(LLMClient *client) {
+    g_atomic_int_inc(&client->ref_count);
     return client;
 }
 
 void llm_client_free(LLMClient *client) {
-    if (!client) return;
+    if (!client || !g_atomic_int_dec_and_test(&client->ref_count)) return;
 
-    curl_global_cleanup();
+    config_free(client->config);
     g_free(client);
 }
 
@@ -67,6 +87,11 @@ void llm_request_free(LLMRequest *request) {
     g_free(request->sender_email);
     g_free(request->prompt);
     g_free(request->response);
+    g_free(request->model);
+    g_free(request->grounding);
+    g_free(request->compressed_prompt);
+    g_free(request->attachments);
+    g_free(request->system_prompt);
     g_free(request);
 }
 
@@ -142,139 +167,413 @@ void llm_client_extract_sender_info(const gchar *email_headers,
 }
 
 static gchar* build_user_prompt(LLMRequest *request, PluginConfig *config G_GNUC_UNUSED) {
-    /* Simply return the selected text without any prefixes */
-    return g_strdup(request->prompt);
+    const gchar *prompt = request->compressed_prompt ? request->compressed_prompt : request->prompt;
+
+    /* Without grounding or attachments, simply return the selected text without any prefixes */
+    if (!request->grounding && !request->attachments) {
+        return g_strdup(prompt);
+    }
+
+    GString *text = g_string_new(NULL);
+
+    if (request->grounding) {
+        g_string_append_printf(text, "Reference answer from our knowledge base "
+                                     "(use it only if it is relevant):\n"
+                                     "---\n%s\n---\n\n",
+                               request->grounding);
+    }
+
+    if (request->attachments) {
+        g_string_append_printf(text, "Attachments of the message being answered:\n"
+                                     "---\n%s\n---\n\n",
+                               request->attachments);
+    }
+
+    g_string_append(text, prompt);
+    return g_string_free(text, FALSE);
 }
 
-/**
- * Fetch available models from OpenAI API
- *
- * @param api_key OpenAI API key
- * @return NULL-terminated array of model IDs, or NULL on error. Caller must free with g_strfreev()
- */
-gchar** llm_client_fetch_available_models(const gchar *api_key) {
-    if (!api_key || strlen(api_key) < 10) {
-        return NULL;
+/* Incremental parser for a server-sent events response */
+typedef struct {
+    LLMRequest *request;
+    JsonParser *parser;
+    GString *pending; /* bytes of an incomplete line */
+    GString *content; /* the response so far */
+    GPtrArray *tool_calls; /* LLMToolCall, assembled from deltas */
+    HTTPResponse raw; /* start of the body, for error reporting */
+    LLMCassetteExchange *exchange; /* records the body when set */
+} StreamState;
+
+static void add_tool_calls(GPtrArray *tool_calls, JsonArray *calls) {
+    for (guint i = 0; i < json_array_get_length(calls); i++) {
+        JsonObject *call = json_array_get_object_element(calls, i);
+        JsonObject *function = call ? json_object_get_object_member(call, "function") : NULL;
+        if (!function) continue;
+
+        g_ptr_array_add(tool_calls, llm_tool_call_new(
+            json_object_get_string_member_with_default(call, "id", NULL),
+            json_object_get_string_member_with_default(function, "name", NULL),
+            json_object_get_string_member_with_default(function, "arguments", NULL)));
     }
+}
 
-    CURL *curl = curl_easy_init();
-    if (!curl) return NULL;
+/* Tool rounds each report their own usage, so it is summed */
+static void add_usage(LLMRequest *request, JsonObject *usage) {
+    request->prompt_tokens += json_object_get_int_member_with_default(usage, "prompt_tokens", 0);
+    request->completion_tokens += json_object_get_int_member_with_default(usage, "completion_tokens", 0);
 
-    HTTPResponse response = {0};
-    struct curl_slist *headers = NULL;
+    if (json_object_has_member(usage, "prompt_tokens_details") &&
+        JSON_NODE_HOLDS_OBJECT(json_object_get_member(usage, "prompt_tokens_details"))) {
+        JsonObject *details = json_object_get_object_member(usage, "prompt_tokens_details");
+        request->cached_tokens += json_object_get_int_member_with_default(details, "cached_tokens", 0);
+    }
+}
 
-    gchar *auth_header = g_strdup_printf("Authorization: Bearer %s", api_key);
-    headers = curl_slist_append(headers, auth_header);
+/* Streamed tool calls arrive in pieces keyed by index; the first piece has
+ * the id and name, the arguments are split over the rest */
+static void stream_add_tool_call_deltas(StreamState *state, JsonArray *deltas) {
+    for (guint i = 0; i < json_array_get_length(deltas); i++) {
+        JsonObject *delta = json_array_get_object_element(deltas, i);
+        if (!delta) continue;
+
+        guint index = json_object_get_int_member_with_default(delta, "index", 0);
+        JsonObject *function = json_object_has_member(delta, "function")
+            ? json_object_get_object_member(delta, "function") : NULL;
+        const gchar *arguments = function
+            ? json_object_get_string_member_with_default(function, "arguments", NULL) : NULL;
+
+        if (index >= state->tool_calls->len) {
+            if (index > state->tool_calls->len) continue; /* a gap; the server skipped an index */
+            g_ptr_array_add(state->tool_calls, llm_tool_call_new(
+                json_object_get_string_member_with_default(delta, "id", NULL),
+                function ? json_object_get_string_member_with_default(function, "name", NULL) : NULL,
+                arguments));
+        } else if (arguments) {
+            LLMToolCall *call = g_ptr_array_index(state->tool_calls, index);
+            gchar *joined = g_strconcat(call->arguments, arguments, NULL);
+            g_free(call->arguments);
+            call->arguments = joined;
+        }
+    }
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, "https://api.openai.com/v1/models");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-
-    CURLcode res = curl_easy_perform(curl);
-    gchar **models = NULL;
-
-    if (res == CURLE_OK && response.data) {
-        JsonParser *parser = json_parser_new();
-        GError *error = NULL;
-
-        if (json_parser_load_from_data(parser, response.data, -1, &error)) {
-            JsonNode *root_node = json_parser_get_root(parser);
-            JsonObject *root_obj = json_node_get_object(root_node);
-
-            if (json_object_has_member(root_obj, "data")) {
-                JsonArray *data = json_object_get_array_member(root_obj, "data");
-                guint length = json_array_get_length(data);
-
-                /* Filter for GPT models only */
-                GPtrArray *gpt_models = g_ptr_array_new();
-
-                for (guint i = 0; i < length; i++) {
-                    JsonObject *model = json_array_get_object_element(data, i);
-                    const gchar *model_id = json_object_get_string_member(model, "id");
-
-                    /* Only include GPT chat models */
-                    if (model_id && (g_str_has_prefix(model_id, "gpt-4") ||
-                                     g_str_has_prefix(model_id, "gpt-3.5"))) {
-                        /* Filter out specific variants we don't want */
-                        if (!g_str_has_suffix(model_id, "-vision") &&
-                            !g_str_has_suffix(model_id, "-instruct") &&
-                            !g_str_has_suffix(model_id, "-audio-preview")) {
-                            g_ptr_array_add(gpt_models, g_strdup(model_id));
-                        }
-                    }
-                }
+static void stream_handle_event(StreamState *state, const gchar *data) {
+    if (g_strcmp0(data, "[DONE]") == 0) return;
+    if (!json_parser_load_from_data(state->parser, data, -1, NULL)) return;
+
+    JsonObject *root_obj = json_node_get_object(json_parser_get_root(state->parser));
+    if (!root_obj) return;
+
+    if (json_object_has_member(root_obj, "choices")) {
+        JsonArray *choices = json_object_get_array_member(root_obj, "choices");
+        if (choices && json_array_get_length(choices) > 0) {
+            JsonObject *choice = json_array_get_object_element(choices, 0);
+            JsonObject *delta = json_object_get_object_member(choice, "delta");
+            const gchar *content = delta ? json_object_get_string_member_with_default(delta, "content", NULL) : NULL;
 
-                /* Convert to NULL-terminated array */
-                g_ptr_array_add(gpt_models, NULL);
-                models = (gchar **)g_ptr_array_free(gpt_models, FALSE);
+            if (content && *content) {
+                g_string_append(state->content, content);
+                llm_token_queue_push(state->request->token_queue, content, strlen(content));
+            }
+
+            if (delta && json_object_has_member(delta, "tool_calls") &&
+                JSON_NODE_HOLDS_ARRAY(json_object_get_member(delta, "tool_calls"))) {
+                stream_add_tool_call_deltas(state, json_object_get_array_member(delta, "tool_calls"));
             }
-        } else {
-            g_warning("Failed to parse models JSON: %s", error ? error->message : "unknown error");
-            if (error) g_error_free(error);
         }
+    }
 
-        g_object_unref(parser);
+    /* Sent in a final chunk because of stream_options.include_usage */
+    if (json_object_has_member(root_obj, "usage") &&
+        JSON_NODE_HOLDS_OBJECT(json_object_get_member(root_obj, "usage"))) {
+        add_usage(state->request, json_object_get_object_member(root_obj, "usage"));
     }
+}
 
-    g_free(response.data);
-    g_free(auth_header);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+static size_t stream_write_callback(void *contents, size_t size, size_t nmemb, StreamState *state) {
+    size_t total_size = size * nmemb;
+    if (state->exchange) llm_cassette_exchange_add_chunk(state->exchange, contents, total_size);
+
+    if (state->raw.size < 4096) {
+        write_callback(contents, size, nmemb, &state->raw);
+    }
+
+    g_string_append_len(state->pending, contents, total_size);
 
-    return models;
+    gchar *line_start = state->pending->str;
+    gchar *newline;
+    while ((newline = memchr(line_start, '\n', state->pending->str + state->pending->len - line_start))) {
+        *newline = '\0';
+        if (newline > line_start && newline[-1] == '\r') newline[-1] = '\0';
+
+        if (g_str_has_prefix(line_start, "data:")) {
+            const gchar *data = line_start + 5;
+            while (*data == ' ') data++;
+            stream_handle_event(state, data);
+        }
+        line_start = newline + 1;
+    }
+    g_string_erase(state->pending, 0, line_start - state->pending->str);
+
+    return total_size;
 }
 
-gboolean llm_client_generate_response(LLMClient *client, LLMRequest *request) {
-    if (!client || !request || !request->prompt) return FALSE;
+/* Abort the transfer once the request's GCancellable is cancelled */
+static int progress_callback(void *clientp,
+                             curl_off_t dltotal G_GNUC_UNUSED, curl_off_t dlnow G_GNUC_UNUSED,
+                             curl_off_t ultotal G_GNUC_UNUSED, curl_off_t ulnow G_GNUC_UNUSED) {
+    return g_cancellable_is_cancelled(G_CANCELLABLE(clientp)) ? 1 : 0;
+}
 
-    CURL *curl = curl_easy_init();
-    if (!curl) return FALSE;
+static const gchar* get_system_prompt(LLMRequest *request, PluginConfig *config) {
+    if (request->system_prompt) return request->system_prompt;
+    return config->system_prompt ? config->system_prompt : "You are a helpful email writing assistant.";
+}
 
-    HTTPResponse response = {0};
-    struct curl_slist *headers = NULL;
+static gint get_max_tokens(LLMRequest *request, PluginConfig *config) {
+    if (request->max_tokens > 0) return request->max_tokens;
+    return config->max_tokens > 0 ? config->max_tokens : DEFAULT_MAX_TOKENS;
+}
 
-    gchar *auth_header = g_strdup_printf("Authorization: Bearer %s", client->config->openai_api_key);
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, auth_header);
+static void record_request_metrics(LLMRequest *request) {
+    llm_metrics_add(LLM_METRIC_REQUESTS, 1);
+    llm_metrics_add(LLM_METRIC_REQUEST_LATENCY_MS, request->latency_ms);
+    llm_metrics_observe(LLM_HISTOGRAM_REQUEST_LATENCY, request->latency_ms);
+    if (request->compressed_prompt) {
+        llm_metrics_add(LLM_METRIC_COMPRESSED_REQUESTS, 1);
+        llm_metrics_add(LLM_METRIC_COMPRESSED_REQUEST_LATENCY_MS, request->latency_ms);
+    }
+}
+
+/* Fill in what every transport knows, count it and append the record
+ * to the performance log */
+static void record_request_outcome(LLMPerfRecord *record, LLMRequest *request,
+                                   const gchar *model, const gchar *endpoint) {
+    record->total_ms = (guint32)MIN(request->latency_ms, G_MAXUINT32);
+    record->prompt_tokens = MAX(request->prompt_tokens, 0);
+    record->completion_tokens = MAX(request->completion_tokens, 0);
+    record->cache = request->cache_status;
+    g_strlcpy(record->model, model ? model : "", sizeof(record->model));
+    g_strlcpy(record->endpoint, endpoint ? endpoint : "", sizeof(record->endpoint));
+    llm_perflog_append(record);
+
+    llm_metrics_add(LLM_METRIC_BYTES_SENT, record->bytes_sent);
+    llm_metrics_add(LLM_METRIC_BYTES_RECEIVED, record->bytes_received);
+    llm_metrics_add(LLM_METRIC_PROMPT_TOKENS, record->prompt_tokens);
+    llm_metrics_add(LLM_METRIC_COMPLETION_TOKENS, record->completion_tokens);
+    llm_metrics_add(LLM_METRIC_CACHED_TOKENS, MAX(request->cached_tokens, 0));
+    llm_budget_record(llm_budget_get_default(), model, request->prompt_tokens, request->cached_tokens,
+                      request->completion_tokens);
+    if (record->error != LLM_PERF_ERROR_NONE) llm_metrics_add(LLM_METRIC_REQUEST_ERRORS, 1);
+    if (record->http_status == 429) llm_metrics_add(LLM_METRIC_HTTP_RATE_LIMITED, 1);
+}
+
+static LLMPerfError classify_error(CURLcode res, long http_status, gboolean success,
+                                   GCancellable *cancellable) {
+    if (success) return LLM_PERF_ERROR_NONE;
+    if (g_cancellable_is_cancelled(cancellable)) return LLM_PERF_ERROR_CANCELLED;
+
+    switch (res) {
+    case CURLE_OK:
+        return http_status >= 400 ? LLM_PERF_ERROR_HTTP : LLM_PERF_ERROR_RESPONSE;
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_RESOLVE_PROXY:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_SSL_CONNECT_ERROR:
+        return LLM_PERF_ERROR_CONNECT;
+    case CURLE_OPERATION_TIMEDOUT:
+        return LLM_PERF_ERROR_TIMEOUT;
+    default:
+        return LLM_PERF_ERROR_OTHER;
+    }
+}
+
+static gint requests_in_flight; /* sent and not yet answered, over any transport */
+
+/* Deadlines start when a request is handed to the client, so the time it
+ * waits for a worker thread counts against them */
+static void ensure_deadline(LLMRequest *request) {
+    if (request->deadline) return;
+
+    switch (request->work_class) {
+    case LLM_WORK_SPECULATIVE:
+        /* Lives until its caller cancels it, e.g. when the composer closes */
+        request->deadline = LLM_DEADLINE_NONE;
+        break;
+    case LLM_WORK_BATCH:
+        request->deadline = g_get_monotonic_time() + (gint64)CLIENT_BATCH_DEADLINE_S * G_USEC_PER_SEC;
+        break;
+    default:
+        request->deadline = g_get_monotonic_time() + (gint64)CLIENT_INTERACTIVE_DEADLINE_S * G_USEC_PER_SEC;
+        break;
+    }
+}
+
+static gint64 remaining_ms(LLMRequest *request) {
+    if (request->deadline == LLM_DEADLINE_NONE) return G_MAXINT64;
+    return (request->deadline - g_get_monotonic_time()) / 1000;
+}
+
+/* Time a model is expected to need for an answer, from the speed observed
+ * in earlier requests; -1 if it was not used yet */
+static gint64 estimate_ms(const gchar *model) {
+    LLMModelInfo *info = llm_catalog_lookup(llm_catalog_get_default(), model);
+    gint64 estimate = -1;
+
+    if (info && info->samples > 0 && info->tokens_per_second > 0) {
+        estimate = (gint64)(info->ttfb_ms + CLIENT_EXPECTED_TOKENS * 1000.0 / info->tokens_per_second);
+    }
+
+    llm_model_info_free(info);
+    return estimate;
+}
+
+/* Failures another attempt may not run into: no connection, a dropped
+ * connection, rate limiting and server errors. Timeouts are not, since
+ * they mean the deadline is reached. */
+static gboolean is_transient_failure(CURLcode res, long http_status) {
+    switch (res) {
+    case CURLE_OK:
+        return http_status == 429 || http_status >= 500;
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_GOT_NOTHING:
+    case CURLE_PARTIAL_FILE:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
 
+/* Back off before another attempt if the deadline leaves room for the
+ * wait and for the model's usual answer time after it
+ *
+ * @return FALSE if there is no time for another attempt or it was cancelled */
+static gboolean wait_before_retry(LLMRequest *request, const gchar *model, guint attempt,
+                                  GCancellable *cancellable) {
+    gint64 delay_ms = (gint64)CLIENT_RETRY_DELAY_MS << attempt;
+    gint64 estimate = estimate_ms(model);
+    if (remaining_ms(request) < delay_ms + MAX(estimate, 0)) return FALSE;
+
+    GPollFD pollfd;
+    if (cancellable && g_cancellable_make_pollfd(cancellable, &pollfd)) {
+        g_poll(&pollfd, 1, (gint)delay_ms);
+        g_cancellable_release_fd(cancellable);
+    } else {
+        g_usleep(delay_ms * 1000);
+    }
+
+    return !g_cancellable_is_cancelled(cancellable);
+}
+
+/* Generate over the persistent realtime session. A request that fails
+ * there before producing any text is sent over HTTP instead. */
+static gboolean generate_response_realtime(LLMClient *client, LLMRequest *request,
+                                           GCancellable *cancellable, gboolean *fall_back) {
     gchar *user_prompt = build_user_prompt(request, client->config);
+    gboolean started = FALSE;
+
+    LLMPerfRecord record = { .start_us = g_get_real_time(), .transport = LLM_PERF_TRANSPORT_REALTIME,
+                             .rounds = 1, .bytes_sent = strlen(user_prompt) };
+    gint64 start_time = g_get_monotonic_time();
+    gint64 ttfb_ms = 0;
+    gboolean success = llm_realtime_generate(llm_realtime_get_default(), client->config, request,
+                                             get_system_prompt(request, client->config), user_prompt,
+                                             get_max_tokens(request, client->config),
+                                             cancellable, &started, &ttfb_ms);
+    g_free(user_prompt);
+
+    *fall_back = !success && !started && !g_cancellable_is_cancelled(cancellable);
+    if (*fall_back) {
+        g_print("LLM Client: Realtime session unavailable, using HTTP\n");
+        return FALSE;
+    }
+
+    request->latency_ms = (g_get_monotonic_time() - start_time) / 1000;
+    record_request_metrics(request);
+
+    record.ttfb_ms = ttfb_ms;
+    record.bytes_received = request->response ? strlen(request->response) : 0;
+    record.error = success ? LLM_PERF_ERROR_NONE :
+                   g_cancellable_is_cancelled(cancellable) ? LLM_PERF_ERROR_CANCELLED : LLM_PERF_ERROR_RESPONSE;
+    record_request_outcome(&record, request, client->config->realtime_model, client->config->realtime_url);
 
+    if (request->token_queue) llm_token_queue_close(request->token_queue);
+    return success;
+}
+
+static JsonObject* append_message(JsonArray *messages, const gchar *role, const gchar *content) {
+    JsonObject *message = json_object_new();
+    json_object_set_string_member(message, "role", role);
+    json_object_set_string_member(message, "content", content ? content : "");
+    json_array_add_object_element(messages, message);
+    return message;
+}
+
+/* The assistant turn that requested the tools precedes their results */
+static void append_tool_calls(JsonArray *messages, GPtrArray *tool_calls) {
+    JsonObject *message = json_object_new();
+    JsonArray *calls = json_array_new();
+
+    for (guint i = 0; i < tool_calls->len; i++) {
+        LLMToolCall *call = g_ptr_array_index(tool_calls, i);
+        JsonObject *function = json_object_new();
+        json_object_set_string_member(function, "name", call->name ? call->name : "");
+        json_object_set_string_member(function, "arguments", call->arguments);
+
+        JsonObject *entry = json_object_new();
+        json_object_set_string_member(entry, "id", call->id ? call->id : "");
+        json_object_set_string_member(entry, "type", "function");
+        json_object_set_object_member(entry, "function", function);
+        json_array_add_object_element(calls, entry);
+    }
+
+    json_object_set_string_member(message, "role", "assistant");
+    json_object_set_array_member(message, "tool_calls", calls);
+    json_array_add_object_element(messages, message);
+}
+
+static gchar* build_request_body(const gchar *model, JsonArray *messages, JsonNode *tools,
+                                 gint max_tokens, gboolean stream, gboolean json_output) {
     JsonBuilder *builder = json_builder_new();
     json_builder_begin_object(builder);
 
     json_builder_set_member_name(builder, "model");
-    json_builder_add_string_value(builder, client->config->model);
+    json_builder_add_string_value(builder, model);
 
     json_builder_set_member_name(builder, "messages");
-    json_builder_begin_array(builder);
-
-    /* System message */
-    json_builder_begin_object(builder);
-    json_builder_set_member_name(builder, "role");
-    json_builder_add_string_value(builder, "system");
-    json_builder_set_member_name(builder, "content");
-    json_builder_add_string_value(builder,
-                                   client->config->system_prompt ? client->config->system_prompt : "You are a helpful email writing assistant.");
-    json_builder_end_object(builder);
+    json_builder_add_value(builder, json_node_init_array(json_node_alloc(), messages));
 
-    /* User message */
-    json_builder_begin_object(builder);
-    json_builder_set_member_name(builder, "role");
-    json_builder_add_string_value(builder, "user");
-    json_builder_set_member_name(builder, "content");
-    json_builder_add_string_value(builder, user_prompt);
-    json_builder_end_object(builder);
-
-    json_builder_end_array(builder);
+    if (tools) {
+        json_builder_set_member_name(builder, "tools");
+        json_builder_add_value(builder, json_node_copy(tools));
+    }
 
     json_builder_set_member_name(builder, "max_tokens");
-    json_builder_add_int_value(builder, 500);
+    json_builder_add_int_value(builder, max_tokens);
 
     json_builder_set_member_name(builder, "temperature");
     json_builder_add_double_value(builder, 0.7);
 
+    if (json_output) {
+        json_builder_set_member_name(builder, "response_format");
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "type");
+        json_builder_add_string_value(builder, "json_object");
+        json_builder_end_object(builder);
+    }
+
+    if (stream) {
+        json_builder_set_member_name(builder, "stream");
+        json_builder_add_boolean_value(builder, TRUE);
+        json_builder_set_member_name(builder, "stream_options");
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "include_usage");
+        json_builder_add_boolean_value(builder, TRUE);
+        json_builder_end_object(builder);
+    }
+
     json_builder_end_object(builder);
 
     JsonGenerator *generator = json_generator_new();
@@ -282,63 +581,381 @@ gboolean llm_client_generate_response(LLMClient *client, LLMRequest *request) {
     json_generator_set_root(generator, root);
     gchar *json_data = json_generator_to_data(generator, NULL);
 
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+
+    return json_data;
+}
+
+/* Parse a non-streamed completion; returns TRUE if it had content */
+static gboolean parse_completion(const gchar *data, LLMRequest *request, GPtrArray *tool_calls) {
+    JsonParser *parser = json_parser_new();
+    GError *error = NULL;
+    gboolean success = FALSE;
+
+    if (json_parser_load_from_data(parser, data, -1, &error)) {
+        JsonNode *root_node = json_parser_get_root(parser);
+        JsonObject *root_obj = json_node_get_object(root_node);
+
+        if (json_object_has_member(root_obj, "choices")) {
+            JsonArray *choices = json_object_get_array_member(root_obj, "choices");
+            if (json_array_get_length(choices) > 0) {
+                JsonObject *choice = json_array_get_object_element(choices, 0);
+                JsonObject *message = json_object_get_object_member(choice, "message");
+                const gchar *content = json_object_get_string_member_with_default(message, "content", NULL);
+
+                if (content) {
+                    g_free(request->response);
+                    request->response = g_strdup(content);
+                    g_strstrip(request->response);
+                    success = TRUE;
+                }
+
+                if (json_object_has_member(message, "tool_calls") &&
+                    JSON_NODE_HOLDS_ARRAY(json_object_get_member(message, "tool_calls"))) {
+                    add_tool_calls(tool_calls, json_object_get_array_member(message, "tool_calls"));
+                }
+            }
+        }
+
+        if (json_object_has_member(root_obj, "usage") &&
+            JSON_NODE_HOLDS_OBJECT(json_object_get_member(root_obj, "usage"))) {
+            add_usage(request, json_object_get_object_member(root_obj, "usage"));
+        }
+    } else {
+        g_warning("JSON parse error: %s", error->message);
+        g_error_free(error);
+    }
+
+    g_object_unref(parser);
+    return success;
+}
+
+/* Send a request that was admitted, over the realtime session if allowed
+ * and over HTTP otherwise */
+static gboolean send_request(LLMClient *client, LLMRequest *request, const gchar *model,
+                             gboolean allow_realtime, GCancellable *cancellable) {
+    /* The realtime session has no JSON response format */
+    if (allow_realtime && client->config->realtime_enabled && !request->json_output) {
+        gboolean fall_back = FALSE;
+        gboolean success = generate_response_realtime(client, request, cancellable, &fall_back);
+        if (!fall_back) return success;
+        llm_metrics_add(LLM_METRIC_RETRIES, 1);
+    }
+
+    LLMModelInfo *info = llm_catalog_lookup(llm_catalog_get_default(), model);
+    const gchar *endpoint = info ? info->endpoint : OPENAI_API_BASE;
+    gboolean stream = request->token_queue && (!info || info->supports_streaming);
+
+    llm_client_global_init();
+    CURL *curl = curl_easy_init();
+    if (!curl) {
+        llm_model_info_free(info);
+        return FALSE;
+    }
+
+    struct curl_slist *headers = NULL;
+    gchar *auth_header = NULL;
+
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    /* Only OpenAI gets the key; other endpoints are local or keyless servers */
+    if (g_strcmp0(endpoint, OPENAI_API_BASE) == 0) {
+        auth_header = g_strdup_printf("Authorization: Bearer %s", client->config->openai_api_key);
+        headers = curl_slist_append(headers, auth_header);
+    }
+
+    gchar *user_prompt = build_user_prompt(request, client->config);
+    gchar *url = g_strdup_printf("%s/chat/completions", endpoint);
+
     /* Debug: Print the request being sent */
     g_print("\n=== LLM Request Debug ===\n");
-    g_print("Model: %s\n", client->config->model);
-    g_print("System Prompt: %s\n", client->config->system_prompt ? client->config->system_prompt : "You are a helpful email writing assistant.");
+    g_print("Model: %s (%s)\n", model, endpoint);
+    g_print("System Prompt: %s\n", get_system_prompt(request, client->config));
     g_print("User Prompt: %s\n", user_prompt);
-    g_print("Full JSON payload:\n%s\n", json_data);
-    g_print("========================\n\n");
 
-    curl_easy_setopt(curl, CURLOPT_URL, "https://api.openai.com/v1/chat/completions");
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data);
+    /* The conversation grows by the tool calls and their results each round */
+    JsonArray *messages = json_array_new();
+    append_message(messages, "system", get_system_prompt(request, client->config));
+    append_message(messages, "user", user_prompt);
+
+    /* Structured answers are parsed by the caller and have no use for tools */
+    JsonNode *tools = client->config->tools_enabled && !request->json_output ? llm_tools_get_definitions() : NULL;
+    GPtrArray *tool_calls = g_ptr_array_new_with_free_func((GDestroyNotify)llm_tool_call_free);
+
+    /* Every round reuses the handle, and with it the connection */
+    curl_easy_setopt(curl, CURLOPT_URL, url);
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
 
-    CURLcode res = curl_easy_perform(curl);
+    /* A transfer that stalls is given up even without a deadline, so
+     * speculative work on a dead connection does not hold its thread */
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)CLIENT_STALL_TIMEOUT_S);
+
+    if (cancellable) {
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progress_callback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, cancellable);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    }
+
+    LLMPerfRecord record = { .start_us = g_get_real_time(), .transport = LLM_PERF_TRANSPORT_HTTP };
+    gint64 start_time = g_get_monotonic_time();
     gboolean success = FALSE;
+    curl_off_t ttfb_us = 0;
+    CURLcode res = CURLE_OK;
+    long http_status = 0;
+    guint round = 0;
+    guint attempt = 0;
+
+    for (;;) {
+        /* Every transfer gets the time that is left, not a fixed timeout */
+        gint64 left_ms = remaining_ms(request);
+        if (left_ms <= 0) {
+            res = CURLE_OPERATION_TIMEDOUT;
+            break;
+        }
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS,
+                         request->deadline == LLM_DEADLINE_NONE ? 0L : (long)MIN(left_ms, G_MAXLONG));
+
+        gboolean offer_tools = tools && round < TOOLS_MAX_ROUNDS;
+        gchar *json_data = build_request_body(model, messages, offer_tools ? tools : NULL,
+                                             get_max_tokens(request, client->config), stream,
+                                             request->json_output);
+
+        g_print("Full JSON payload:\n%s\n", json_data);
+        g_print("========================\n\n");
+
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data);
+
+        HTTPResponse response = {0};
+        StreamState stream_state = {0};
+        LLMCassetteExchange *exchange = llm_cassette_is_recording()
+            ? llm_cassette_exchange_new(url, model, json_data) : NULL;
+        if (stream) {
+            stream_state.exchange = exchange;
+            stream_state.request = request;
+            stream_state.parser = json_parser_new();
+            stream_state.pending = g_string_new(NULL);
+            stream_state.content = g_string_new(NULL);
+            stream_state.tool_calls = tool_calls;
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_write_callback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &stream_state);
+        } else {
+            response.exchange = exchange;
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+        }
 
-    if (res == CURLE_OK && response.data) {
-        JsonParser *parser = json_parser_new();
-        GError *error = NULL;
-
-        if (json_parser_load_from_data(parser, response.data, -1, &error)) {
-            JsonNode *root_node = json_parser_get_root(parser);
-            JsonObject *root_obj = json_node_get_object(root_node);
-
-            if (json_object_has_member(root_obj, "choices")) {
-                JsonArray *choices = json_object_get_array_member(root_obj, "choices");
-                if (json_array_get_length(choices) > 0) {
-                    JsonObject *choice = json_array_get_object_element(choices, 0);
-                    JsonObject *message = json_object_get_object_member(choice, "message");
-                    const gchar *content = json_object_get_string_member(message, "content");
-
-                    if (content) {
-                        request->response = g_strdup(content);
-                        g_strstrip(request->response);
-                        success = TRUE;
-                    }
-                }
-            }
+        res = curl_easy_perform(curl);
+
+        if (round == 0 && res == CURLE_OK &&
+            curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb_us) == CURLE_OK) {
+            llm_metrics_add(LLM_METRIC_HTTP_REQUESTS, 1);
+            llm_metrics_add(LLM_METRIC_HTTP_TTFB_MS, ttfb_us / 1000);
+            llm_metrics_observe(LLM_HISTOGRAM_TTFB, ttfb_us / 1000);
+        }
+
+        curl_off_t bytes_sent = 0, bytes_received = 0;
+        curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &bytes_sent);
+        curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes_received);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_status);
+        record.bytes_sent += bytes_sent;
+        record.bytes_received += bytes_received;
+
+        if (exchange && res == CURLE_OK) {
+            const gchar *content_type = NULL;
+            curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &content_type);
+            llm_cassette_exchange_finish(exchange, http_status, content_type);
         } else {
-            g_warning("JSON parse error: %s", error->message);
-            g_error_free(error);
+            llm_cassette_exchange_free(exchange);
         }
 
-        g_object_unref(parser);
+        gboolean streamed = FALSE;
+        if (stream) {
+            streamed = stream_state.content->len > 0;
+            if (res == CURLE_OK && stream_state.content->len > 0) {
+                g_free(request->response);
+                request->response = g_strdup(stream_state.content->str);
+                g_strstrip(request->response);
+                success = TRUE;
+            } else if (res == CURLE_OK && stream_state.raw.data && tool_calls->len == 0) {
+                g_warning("LLM stream returned no content: %s", stream_state.raw.data);
+            }
+
+            g_object_unref(stream_state.parser);
+            g_string_free(stream_state.pending, TRUE);
+            g_string_free(stream_state.content, TRUE);
+            g_free(stream_state.raw.data);
+        } else if (res == CURLE_OK && response.data) {
+            success = parse_completion(response.data, request, tool_calls) || success;
+        }
+
+        g_free(response.data);
+        g_free(json_data);
+
+        /* Only a first round that showed nothing yet can be sent again
+         * without the user seeing text twice */
+        if (!success && !streamed && round == 0 && tool_calls->len == 0 &&
+            attempt + 1 < CLIENT_MAX_ATTEMPTS && is_transient_failure(res, http_status) &&
+            wait_before_retry(request, model, attempt, cancellable)) {
+            g_print("LLM Client: Attempt %u failed (%s, HTTP %ld), retrying\n", attempt + 1,
+                    curl_easy_strerror(res), http_status);
+            llm_metrics_add(LLM_METRIC_RETRIES, 1);
+            attempt++;
+            continue;
+        }
+
+        if (res != CURLE_OK || !offer_tools || tool_calls->len == 0) break;
+
+        /* Run the requested tools locally and send their results back */
+        append_tool_calls(messages, tool_calls);
+        llm_tools_execute(tool_calls, MAX(client->config->tools_cache_ttl, 0), cancellable);
+        for (guint i = 0; i < tool_calls->len; i++) {
+            LLMToolCall *call = g_ptr_array_index(tool_calls, i);
+            JsonObject *message = append_message(messages, "tool", call->result);
+            json_object_set_string_member(message, "tool_call_id", call->id ? call->id : "");
+        }
+        g_ptr_array_set_size(tool_calls, 0);
+
+        if (g_cancellable_is_cancelled(cancellable)) break;
+        round++;
+    }
+
+    request->latency_ms = (g_get_monotonic_time() - start_time) / 1000;
+    record_request_metrics(request);
+
+    record.ttfb_ms = ttfb_us / 1000;
+    record.http_status = http_status;
+    record.rounds = round + 1;
+    record.error = classify_error(res, http_status, success, cancellable);
+    record_request_outcome(&record, request, model, endpoint);
+
+    /* A model that cannot stream delivers its answer to the queue in one piece */
+    if (request->token_queue) {
+        if (!stream && success) {
+            llm_token_queue_push(request->token_queue, request->response, strlen(request->response));
+        }
+        llm_token_queue_close(request->token_queue);
+    }
+
+    /* Tool rounds would skew the model's speed statistics */
+    curl_off_t total_us = 0;
+    if (success && round == 0 && ttfb_us > 0 &&
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total_us) == CURLE_OK) {
+        llm_catalog_record(llm_catalog_get_default(), model, ttfb_us / 1000,
+                           (total_us - ttfb_us) / 1000, request->completion_tokens);
     }
 
-    g_free(response.data);
     g_free(auth_header);
+    g_free(url);
     g_free(user_prompt);
-    g_free(json_data);
-    json_node_free(root);
-    g_object_unref(generator);
-    g_object_unref(builder);
+    json_array_unref(messages);
+    if (tools) json_node_free(tools);
+    g_ptr_array_unref(tool_calls);
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
+    llm_model_info_free(info);
+
+    return success;
+}
+
+/* Give up on a request without sending it */
+static gboolean drop_request(LLMRequest *request, const gchar *reason) {
+    g_print("LLM Client: Dropping a request: %s\n", reason);
+    llm_metrics_add(LLM_METRIC_DEADLINE_DROPPED, 1);
+    if (request->token_queue) llm_token_queue_close(request->token_queue);
+    return FALSE;
+}
+
+static gboolean generate_response(LLMClient *client, LLMRequest *request, GCancellable *cancellable) {
+    if (!client || !request || !request->prompt) return FALSE;
+
+    ensure_deadline(request);
+    gint64 left_ms = remaining_ms(request);
+    if (left_ms <= 0) return drop_request(request, "its deadline passed while it waited");
 
+    /* Under overload, work whose answer may be thrown away goes first */
+    if (request->work_class == LLM_WORK_SPECULATIVE &&
+        g_atomic_int_get(&requests_in_flight) >= CLIENT_OVERLOAD_IN_FLIGHT) {
+        return drop_request(request, "too many requests in flight for speculative work");
+    }
+
+    const gchar *requested = request->model ? request->model : client->config->model;
+    const gchar *model = requested;
+    LLMBudget *budget = llm_budget_get_default();
+    if (!llm_budget_admit(budget, client->config, request->work_class, &model)) {
+        if (request->token_queue) llm_token_queue_close(request->token_queue);
+        return FALSE;
+    }
+
+    /* A model that is not expected to answer in the time left hands over
+     * to the fallback model if that one is; background work that cannot
+     * make it at all is not sent */
+    gint64 estimate = estimate_ms(model);
+    if (estimate > left_ms) {
+        const gchar *fallback = client->config->budget_fallback_model;
+        gint64 fallback_estimate = fallback && g_strcmp0(fallback, model) != 0 ? estimate_ms(fallback) : -1;
+
+        if (fallback_estimate >= 0 && fallback_estimate <= left_ms) {
+            g_print("LLM Client: %s needs about %" G_GINT64_FORMAT " ms of %" G_GINT64_FORMAT
+                    " ms left, using %s\n", model, estimate, left_ms, fallback);
+            llm_metrics_add(LLM_METRIC_DEADLINE_DOWNGRADES, 1);
+            model = fallback;
+        } else if (request->work_class != LLM_WORK_INTERACTIVE) {
+            return drop_request(request, "no model can answer before its deadline");
+        }
+    }
+
+    /* The realtime session has its own model. It stands in for the default
+     * model or answers requests for itself, but not for a model chosen on
+     * purpose (a draft model, say) or one the request was moved to, and it
+     * is kept free of speculative work that would queue ahead of the user. */
+    gboolean allow_realtime = g_strcmp0(model, requested) == 0 &&
+                              (g_strcmp0(model, client->config->realtime_model) == 0 ||
+                               g_strcmp0(model, client->config->model) == 0) &&
+                              request->work_class != LLM_WORK_SPECULATIVE &&
+                              llm_budget_get_level(budget, client->config) < LLM_BUDGET_DOWNGRADE;
+
+    g_atomic_int_inc(&requests_in_flight);
+    gboolean success = send_request(client, request, model, allow_realtime, cancellable);
+    g_atomic_int_add(&requests_in_flight, -1);
     return success;
+}
+
+gboolean llm_client_generate_response(LLMClient *client, LLMRequest *request) {
+    return generate_response(client, request, NULL);
+}
+
+static void generate_response_thread(GTask *task,
+                                     gpointer source_object G_GNUC_UNUSED,
+                                     gpointer task_data,
+                                     GCancellable *cancellable) {
+    LLMClient *client = g_object_get_data(G_OBJECT(task), "llm-client");
+    LLMRequest *request = task_data;
+
+    if (generate_response(client, request, cancellable)) {
+        g_task_return_boolean(task, TRUE);
+    } else if (g_cancellable_is_cancelled(cancellable)) {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Request cancelled");
+    } else {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to generate response");
+    }
+}
+
+void llm_client_generate_response_async(LLMClient *client,
+                                        LLMRequest *request,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data) {
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    ensure_deadline(request);
+    g_task_set_task_data(task, request, NULL);
+    g_object_set_data_full(G_OBJECT(task), "llm-client", llm_client_ref(client),
+                           (GDestroyNotify)llm_client_free);
+    g_task_run_in_thread(task, generate_response_thread);
+    g_object_unref(task);
+}
+
+gboolean llm_client_generate_response_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_boolean(G_TASK(result), error);
 }
\ No newline at end of file
@@ -13,9 +13,21 @@
 #define LLM_CLIENT_H
 
 #include <glib.h>
+#include <gio/gio.h>
 #include "../config/config.h"
+#include "llm_stream.h"
+#include "llm_perflog.h"
+#include "llm_budget.h"
 
 #define PROMPT_PREFIX "/aw:"
+#define CLIENT_INTERACTIVE_DEADLINE_S 30          /* the user is waiting for it */
+#define CLIENT_BATCH_DEADLINE_S (4 * 60 * 60)
+#define CLIENT_MAX_ATTEMPTS 3                     /* of an HTTP request that failed transiently */
+#define CLIENT_RETRY_DELAY_MS 250                 /* before the first retry; doubles for each further one */
+#define CLIENT_EXPECTED_TOKENS 300                /* answer length assumed when estimating a model's time */
+#define CLIENT_OVERLOAD_IN_FLIGHT 8               /* requests in flight from which speculative work is dropped */
+#define CLIENT_STALL_TIMEOUT_S 120                /* without a byte received, a transfer is given up */
+#define LLM_DEADLINE_NONE G_MAXINT64              /* only cancellation or a stall ends the request */
 
 typedef struct {
     gchar *original_email;
@@ -23,32 +35,97 @@ typedef struct {
     gchar *sender_email;
     gchar *prompt;
     gchar *response;
+    gchar *model; /* overrides config->model when set */
+    gchar *grounding; /* optional reference answer the model may draw on */
+    gchar *compressed_prompt; /* sent instead of prompt when set */
+    gchar *attachments; /* optional text of the replied-to message's attachments */
+    gchar *system_prompt; /* overrides config->system_prompt when set */
+    gboolean json_output; /* ask for a JSON object instead of prose */
+    gint max_tokens; /* longest answer; 0 for config->max_tokens */
+    gint64 latency_ms; /* set by the client: time spent on the HTTP request */
+    gint prompt_tokens; /* set by the client from the response's usage */
+    gint completion_tokens;
+    gint cached_tokens; /* of prompt_tokens, read from the provider's prompt cache */
+    LLMWorkClass work_class; /* what the budget gives up first; interactive by default */
+    gint64 deadline; /* monotonic time after which the answer is of no use; 0 for the class's default */
+    LLMPerfCache cache_status; /* set by the caller for the performance log */
+    LLMTokenQueue *token_queue; /* optional: stream the response into it; not owned */
 } LLMRequest;
 
 typedef struct {
-    PluginConfig *config;
+    PluginConfig *config; /* the client's own copy; never changes */
+    gint ref_count;
 } LLMClient;
 
+/**
+ * Initialize libcurl once for the whole process
+ *
+ * curl_global_init() is not thread-safe and must not be undone while any
+ * thread may still use curl, so everything in the module that creates a
+ * curl handle calls this first and nothing calls curl_global_cleanup().
+ */
+void llm_client_global_init(void);
+
+/**
+ * Create a client for a snapshot of the configuration
+ *
+ * The client copies the configuration, so the caller may change or free
+ * its own afterwards; a client for the new settings is made with another
+ * call. Asynchronous calls hold a reference to the client until they are
+ * done, so it may be released while they run.
+ *
+ * @return The client, or NULL if the configuration has no usable API key
+ */
 LLMClient* llm_client_new(PluginConfig *config);
+LLMClient* llm_client_ref(LLMClient *client);
+
+/**
+ * Release a reference; the last one frees the client
+ */
 void llm_client_free(LLMClient *client);
 
 LLMRequest* llm_request_new(void);
 void llm_request_free(LLMRequest *request);
 
 gboolean llm_client_parse_prompt(const gchar *text, gchar **prompt);
+
+/**
+ * Generate a response, blocking until it is done
+ *
+ * A request without a deadline gets its work class's: seconds for
+ * interactive work, hours for batch work, none for speculative work.
+ * Transient HTTP failures are retried while the deadline leaves room.
+ * A request whose deadline has passed, or that its model is not expected
+ * to meet, is moved to the fallback model or not sent at all.
+ *
+ * @return TRUE if request->response was set
+ */
 gboolean llm_client_generate_response(LLMClient *client, LLMRequest *request);
 
+/**
+ * Run llm_client_generate_response() in a worker thread
+ *
+ * The deadline is set here, so the time the request waits for a thread
+ * counts against it.
+ * The request must stay alive until the callback has run. Cancelling
+ * aborts the HTTP transfer.
+ *
+ * @param client The LLM client
+ * @param request Request to fill in; request->response is set on success
+ * @param cancellable Optional GCancellable
+ * @param callback Called on the main context when the request finished
+ * @param user_data User data passed to callback
+ */
+void llm_client_generate_response_async(LLMClient *client,
+                                        LLMRequest *request,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data);
+gboolean llm_client_generate_response_finish(GAsyncResult *result, GError **error);
+
 gchar* llm_client_extract_original_email(const gchar *compose_text);
 void llm_client_extract_sender_info(const gchar *email_headers,
                                     gchar **sender_name,
                                     gchar **sender_email);
 
-/**
- * Fetch available models from OpenAI API
- *
- * @param api_key OpenAI API key
- * @return NULL-terminated array of model IDs, or NULL on error. Caller must free with g_strfreev()
- */
-gchar** llm_client_fetch_available_models(const gchar *api_key);
-
 #endif /* LLM_CLIENT_H */
\ No newline at end of file
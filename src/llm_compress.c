@@ -0,0 +1,246 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Prompt compression. Long customer mails carry a lot of filler; this drops
+ * the sentences and words that carry the least information, judged by
+ * TF-IDF against the user's own generation history, before the text is sent.
+ */
+
+#include "llm_compress.h"
+#include "llm_text.h"
+#include <math.h>
+#include <string.h>
+
+#define COMPRESS_MAX_RATIO 0.9
+
+/* Words that can go without changing what a sentence says: articles and
+ * intensifiers. Unlike the search stopwords this never holds negations,
+ * conditionals or modals, since dropping "not" or "if" inverts a request. */
+static const gchar * const filler_words[] = {
+    "a", "an", "the", "just", "really", "very", "quite", "actually", "basically",
+    "de", "het", "een", "gewoon", "echt", "eigenlijk", "heel",
+    NULL
+};
+
+typedef struct {
+    const gchar *start;
+    gsize length;
+    guint index;
+    guint words;
+    gdouble score;      /* mean IDF weight per word */
+    gboolean protected; /* question, name, number or address */
+    gboolean dropped;
+    GString *trimmed;   /* replacement text once filler words were removed */
+} Segment;
+
+static void segment_free(Segment *segment) {
+    if (segment->trimmed) g_string_free(segment->trimmed, TRUE);
+    g_free(segment);
+}
+
+static void add_segment(GPtrArray *segments, const gchar *start, const gchar *end) {
+    Segment *segment = g_new0(Segment, 1);
+    segment->start = start;
+    segment->length = end - start;
+    segment->index = segments->len;
+    g_ptr_array_add(segments, segment);
+}
+
+/* Split into sentences and lines, keeping every byte of the input */
+static GPtrArray* split_segments(const gchar *text) {
+    GPtrArray *segments = g_ptr_array_new_with_free_func((GDestroyNotify)segment_free);
+    const gchar *segment_start = text;
+    const gchar *p = text;
+
+    while (*p) {
+        if (*p == '\n') {
+            p++;
+            add_segment(segments, segment_start, p);
+            segment_start = p;
+        } else if ((*p == '.' || *p == '!' || *p == '?') && (p[1] == ' ' || p[1] == '\t')) {
+            p++;
+            while (*p == ' ' || *p == '\t') p++;
+            add_segment(segments, segment_start, p);
+            segment_start = p;
+        } else {
+            p++;
+        }
+    }
+
+    if (p > segment_start) add_segment(segments, segment_start, p);
+
+    return segments;
+}
+
+/* Is the word made of letters only, and a filler word? */
+static gboolean is_filler_word(const gchar *word) {
+    for (const gchar *p = word; *p; p = g_utf8_next_char(p)) {
+        if (!g_unichar_isalpha(g_utf8_get_char(p))) return FALSE;
+    }
+
+    gchar *lower = g_utf8_strdown(word, -1);
+    gboolean filler = g_strv_contains(filler_words, lower);
+    g_free(lower);
+
+    return filler;
+}
+
+/* A capitalized word in the middle of a sentence is most likely a name */
+static gboolean looks_like_name(const gchar *word) {
+    if (!g_unichar_isupper(g_utf8_get_char(word)) || g_utf8_strlen(word, -1) < 2) return FALSE;
+
+    gchar *lower = g_utf8_strdown(word, -1);
+    g_strstrip(lower);
+    gboolean name = !llm_text_is_stopword(lower);
+    g_free(lower);
+
+    return name;
+}
+
+static gdouble term_idf(LLMHistory *corpus, guint n_docs, const gchar *term) {
+    guint df = llm_history_get_document_frequency(corpus, term);
+    return log((n_docs + 1.0) / (df + 1.0)) + 1.0;
+}
+
+static void analyze_segment(Segment *segment, LLMHistory *corpus, guint n_docs) {
+    gchar *copy = g_strndup(segment->start, segment->length);
+    gchar **words = g_strsplit_set(copy, " \t\r\n", -1);
+
+    segment->protected = strpbrk(copy, "?@0123456789") != NULL;
+
+    for (gchar **word = words; *word; word++) {
+        if (!**word) continue;
+        if (segment->words > 0 && looks_like_name(*word)) segment->protected = TRUE;
+        segment->words++;
+    }
+
+    /* Filler words add length but no weight, so chatty sentences score low */
+    GPtrArray *tokens = llm_text_tokenize(copy, TRUE);
+    gdouble weight = 0.0;
+    for (guint i = 0; i < tokens->len; i++) {
+        weight += term_idf(corpus, n_docs, g_ptr_array_index(tokens, i));
+    }
+    segment->score = weight / MAX(segment->words, 1);
+
+    g_ptr_array_unref(tokens);
+    g_strfreev(words);
+    g_free(copy);
+}
+
+static gint compare_segments_by_score(gconstpointer a, gconstpointer b) {
+    const Segment *x = *(const Segment * const *)a;
+    const Segment *y = *(const Segment * const *)b;
+
+    if (x->score != y->score) return x->score < y->score ? -1 : 1;
+    return (gint)x->index - (gint)y->index;
+}
+
+/* Rebuild a segment without filler words, as far as the budget allows */
+static guint trim_segment(Segment *segment, guint budget) {
+    gchar *copy = g_strndup(segment->start, segment->length);
+    gchar **words = g_strsplit_set(copy, " \t\r\n", -1);
+    guint removed = 0;
+
+    segment->trimmed = g_string_new(NULL);
+    for (gchar **word = words; *word; word++) {
+        if (!**word) continue;
+
+        if (removed < budget && is_filler_word(*word)) {
+            removed++;
+            continue;
+        }
+
+        if (segment->trimmed->len > 0) g_string_append_c(segment->trimmed, ' ');
+        g_string_append(segment->trimmed, *word);
+    }
+
+    if (segment->trimmed->len > 0) {
+        g_string_append_c(segment->trimmed, strchr(copy, '\n') ? '\n' : ' ');
+    } else if (strchr(copy, '\n')) {
+        g_string_append_c(segment->trimmed, '\n');
+    }
+
+    g_strfreev(words);
+    g_free(copy);
+
+    return removed;
+}
+
+gchar* llm_compress_text(const gchar *text,
+                         gdouble target_ratio,
+                         LLMHistory *corpus,
+                         LLMCompressStats *stats) {
+    g_return_val_if_fail(text != NULL, NULL);
+
+    gint64 start_time = g_get_monotonic_time();
+    guint n_docs = llm_history_get_n_records(corpus);
+    GPtrArray *segments = split_segments(text);
+    GPtrArray *candidates = g_ptr_array_new();
+    guint words_in = 0;
+
+    for (guint i = 0; i < segments->len; i++) {
+        Segment *segment = g_ptr_array_index(segments, i);
+        analyze_segment(segment, corpus, n_docs);
+        words_in += segment->words;
+
+        if (!segment->protected && segment->words > 0) g_ptr_array_add(candidates, segment);
+    }
+
+    guint budget = 0;
+    if (words_in >= COMPRESS_MIN_WORDS) {
+        budget = (guint)(words_in * CLAMP(target_ratio, 0.0, COMPRESS_MAX_RATIO));
+    }
+    guint saved = 0;
+
+    g_ptr_array_sort(candidates, compare_segments_by_score);
+
+    /* Whole low-value sentences first */
+    for (guint i = 0; i < candidates->len && saved < budget; i++) {
+        Segment *segment = g_ptr_array_index(candidates, i);
+        if (saved + segment->words <= budget) {
+            segment->dropped = TRUE;
+            saved += segment->words;
+        }
+    }
+
+    /* Then filler words inside the weakest remaining sentences */
+    for (guint i = 0; i < candidates->len && saved < budget; i++) {
+        Segment *segment = g_ptr_array_index(candidates, i);
+        if (!segment->dropped) saved += trim_segment(segment, budget - saved);
+    }
+
+    GString *result = g_string_sized_new(strlen(text));
+    for (guint i = 0; i < segments->len; i++) {
+        Segment *segment = g_ptr_array_index(segments, i);
+
+        if (segment->dropped) {
+            /* Keep line structure, but do not create empty lines */
+            if (segment->start[segment->length - 1] == '\n' &&
+                result->len > 0 && result->str[result->len - 1] != '\n') {
+                g_string_append_c(result, '\n');
+            }
+        } else if (segment->trimmed) {
+            g_string_append_len(result, segment->trimmed->str, segment->trimmed->len);
+        } else {
+            g_string_append_len(result, segment->start, segment->length);
+        }
+    }
+
+    if (stats) {
+        stats->words_in = words_in;
+        stats->words_out = words_in - saved;
+        stats->time_us = g_get_monotonic_time() - start_time;
+    }
+
+    g_ptr_array_unref(candidates);
+    g_ptr_array_unref(segments);
+
+    return g_string_free(result, FALSE);
+}
@@ -0,0 +1,47 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_COMPRESS_H
+#define LLM_COMPRESS_H
+
+#include <glib.h>
+#include "llm_history.h"
+
+#define COMPRESS_MIN_WORDS 120 /* shorter text is left alone */
+
+typedef struct {
+    guint words_in;
+    guint words_out;
+    gint64 time_us;
+} LLMCompressStats;
+
+/**
+ * Drop low-information sentences and filler words from a prompt
+ *
+ * Sentences are scored by the mean TF-IDF weight of their words, with
+ * document frequencies taken from the generation history. The lowest
+ * scoring sentences are dropped first, then articles and intensifiers inside
+ * the remaining low scorers, until target_ratio of the words is gone.
+ * Negations, conditionals and modals are never removed from a sentence. Questions and
+ * sentences with names, numbers or addresses are never touched.
+ *
+ * @param text Text to compress
+ * @param target_ratio Fraction of words to remove at most (0.0 - 0.9)
+ * @param corpus History used for document frequencies (may be NULL)
+ * @param stats Optional return location for word counts and time taken
+ * @return Newly allocated compressed text
+ */
+gchar* llm_compress_text(const gchar *text,
+                         gdouble target_ratio,
+                         LLMHistory *corpus,
+                         LLMCompressStats *stats);
+
+#endif /* LLM_COMPRESS_H */
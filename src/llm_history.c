@@ -0,0 +1,289 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Generation history. Every generated response is appended as one JSON line
+ * to a history file and added to an in-memory inverted index, so past
+ * answers can be searched and reinserted instead of regenerated.
+ */
+
+#include "llm_history.h"
+#include "llm_canned.h"
+#include "llm_text.h"
+#include "../config/config.h"
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+#include <stdio.h>
+#include <string.h>
+
+struct _LLMHistory {
+    gchar *path;
+    GPtrArray *records;   /* LLMHistoryRecord, oldest first; the index is the record id */
+    GHashTable *postings; /* term -> GArray of ascending guint32 record ids */
+};
+
+static void history_record_free(LLMHistoryRecord *record) {
+    if (!record) return;
+
+    g_free(record->model);
+    g_free(record->prompt);
+    g_free(record->response);
+    g_free(record);
+}
+
+static void index_record(LLMHistory *history, guint32 record_id) {
+    LLMHistoryRecord *record = g_ptr_array_index(history->records, record_id);
+    gchar *text = g_strconcat(record->prompt, "\n", record->response, NULL);
+    GPtrArray *tokens = llm_text_tokenize(text, TRUE);
+
+    /* Records are indexed in id order, so appending keeps every list sorted */
+    for (guint i = 0; i < tokens->len; i++) {
+        const gchar *term = g_ptr_array_index(tokens, i);
+        GArray *ids = g_hash_table_lookup(history->postings, term);
+
+        if (!ids) {
+            ids = g_array_new(FALSE, FALSE, sizeof(guint32));
+            g_hash_table_insert(history->postings, g_strdup(term), ids);
+        }
+        if (ids->len == 0 || g_array_index(ids, guint32, ids->len - 1) != record_id) {
+            g_array_append_val(ids, record_id);
+        }
+    }
+
+    g_ptr_array_unref(tokens);
+    g_free(text);
+}
+
+static void append_record(LLMHistory *history, LLMHistoryRecord *record) {
+    g_ptr_array_add(history->records, record);
+    index_record(history, history->records->len - 1);
+}
+
+static void load_history(LLMHistory *history) {
+    gchar *contents = NULL;
+    if (!g_file_get_contents(history->path, &contents, NULL, NULL)) return;
+
+    JsonParser *parser = json_parser_new();
+    gchar **lines = g_strsplit(contents, "\n", -1);
+
+    for (gchar **line = lines; *line; line++) {
+        if (!**line) continue;
+
+        /* A partially written last line is skipped, not fatal */
+        if (!json_parser_load_from_data(parser, *line, -1, NULL)) continue;
+
+        JsonNode *root = json_parser_get_root(parser);
+        if (!JSON_NODE_HOLDS_OBJECT(root)) continue;
+
+        JsonObject *obj = json_node_get_object(root);
+        const gchar *prompt = json_object_get_string_member_with_default(obj, "prompt", NULL);
+        const gchar *response = json_object_get_string_member_with_default(obj, "response", NULL);
+        if (!prompt || !response) continue;
+
+        LLMHistoryRecord *record = g_new0(LLMHistoryRecord, 1);
+        record->timestamp = json_object_get_int_member_with_default(obj, "timestamp", 0);
+        record->model = g_strdup(json_object_get_string_member_with_default(obj, "model", ""));
+        record->prompt = g_strdup(prompt);
+        record->response = g_strdup(response);
+        record->latency_ms = json_object_get_int_member_with_default(obj, "latency_ms", 0);
+        record->prompt_tokens = json_object_get_int_member_with_default(obj, "prompt_tokens", 0);
+        record->completion_tokens = json_object_get_int_member_with_default(obj, "completion_tokens", 0);
+        append_record(history, record);
+    }
+
+    g_strfreev(lines);
+    g_object_unref(parser);
+    g_free(contents);
+}
+
+LLMHistory* llm_history_get_default(void) {
+    static LLMHistory *history = NULL;
+
+    if (!history) {
+        history = g_new0(LLMHistory, 1);
+        history->path = g_build_filename(g_get_user_data_dir(), CONFIG_DIR_NAME, HISTORY_FILE_NAME, NULL);
+        history->records = g_ptr_array_new_with_free_func((GDestroyNotify)history_record_free);
+        history->postings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                  (GDestroyNotify)g_array_unref);
+
+        load_history(history);
+        g_print("LLM History: Loaded %u records from %s\n", history->records->len, history->path);
+    }
+
+    return history;
+}
+
+guint llm_history_get_n_records(LLMHistory *history) {
+    return history ? history->records->len : 0;
+}
+
+guint llm_history_get_document_frequency(LLMHistory *history, const gchar *term) {
+    if (!history || !term) return 0;
+
+    GArray *ids = g_hash_table_lookup(history->postings, term);
+    return ids ? ids->len : 0;
+}
+
+static gchar* record_to_json_line(const LLMHistoryRecord *record) {
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "timestamp");
+    json_builder_add_int_value(builder, record->timestamp);
+    json_builder_set_member_name(builder, "model");
+    json_builder_add_string_value(builder, record->model ? record->model : "");
+    json_builder_set_member_name(builder, "prompt");
+    json_builder_add_string_value(builder, record->prompt);
+    json_builder_set_member_name(builder, "response");
+    json_builder_add_string_value(builder, record->response);
+    json_builder_set_member_name(builder, "latency_ms");
+    json_builder_add_int_value(builder, record->latency_ms);
+    json_builder_set_member_name(builder, "prompt_tokens");
+    json_builder_add_int_value(builder, record->prompt_tokens);
+    json_builder_set_member_name(builder, "completion_tokens");
+    json_builder_add_int_value(builder, record->completion_tokens);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    gchar *line = json_generator_to_data(generator, NULL);
+
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+
+    return line;
+}
+
+void llm_history_add(LLMHistory *history, const LLMHistoryRecord *record) {
+    if (!history || !record || !record->prompt || !record->response) return;
+
+    LLMHistoryRecord *copy = g_new0(LLMHistoryRecord, 1);
+    *copy = *record;
+    copy->model = g_strdup(record->model ? record->model : "");
+    copy->prompt = g_strdup(record->prompt);
+    copy->response = g_strdup(record->response);
+    append_record(history, copy);
+
+    /* Append only: the file never has to be rewritten */
+    gchar *dir = g_path_get_dirname(history->path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    FILE *file = g_fopen(history->path, "a");
+    if (!file) {
+        g_warning("LLM History: Cannot open %s for writing", history->path);
+        return;
+    }
+
+    gchar *line = record_to_json_line(copy);
+    fprintf(file, "%s\n", line);
+    fclose(file);
+    g_free(line);
+}
+
+static gint compare_guint32(gconstpointer a, gconstpointer b) {
+    guint32 x = *(const guint32 *)a;
+    guint32 y = *(const guint32 *)b;
+    return (x > y) - (x < y);
+}
+
+/* Union of the posting lists of every term starting with prefix */
+static GArray* prefix_postings(LLMHistory *history, const gchar *prefix) {
+    GArray *ids = g_array_new(FALSE, FALSE, sizeof(guint32));
+    GHashTableIter iter;
+    gpointer term, term_ids;
+    guint n_terms = 0;
+
+    g_hash_table_iter_init(&iter, history->postings);
+    while (g_hash_table_iter_next(&iter, &term, &term_ids)) {
+        if (g_str_has_prefix(term, prefix)) {
+            g_array_append_vals(ids, ((GArray *)term_ids)->data, ((GArray *)term_ids)->len);
+            n_terms++;
+        }
+    }
+
+    if (n_terms > 1) {
+        g_array_sort(ids, compare_guint32);
+
+        guint unique = 0;
+        for (guint i = 0; i < ids->len; i++) {
+            if (unique == 0 || g_array_index(ids, guint32, i) != g_array_index(ids, guint32, unique - 1)) {
+                g_array_index(ids, guint32, unique++) = g_array_index(ids, guint32, i);
+            }
+        }
+        g_array_set_size(ids, unique);
+    }
+
+    return ids;
+}
+
+static gint compare_arrays_by_length(gconstpointer a, gconstpointer b) {
+    const GArray *x = *(const GArray * const *)a;
+    const GArray *y = *(const GArray * const *)b;
+    return (gint)x->len - (gint)y->len;
+}
+
+GPtrArray* llm_history_search(LLMHistory *history, const gchar *query, guint limit) {
+    GPtrArray *results = g_ptr_array_new();
+    if (!history || limit == 0) return results;
+
+    GPtrArray *tokens = llm_text_tokenize(query ? query : "", TRUE);
+
+    if (tokens->len == 0) {
+        for (guint i = history->records->len; i > 0 && results->len < limit; i--) {
+            g_ptr_array_add(results, g_ptr_array_index(history->records, i - 1));
+        }
+        g_ptr_array_unref(tokens);
+        return results;
+    }
+
+    /* Exact lists for complete words, a merged list for the word being typed */
+    GPtrArray *lists = g_ptr_array_new();
+    GArray *prefix_ids = prefix_postings(history, g_ptr_array_index(tokens, tokens->len - 1));
+    gboolean missing = prefix_ids->len == 0;
+
+    g_ptr_array_add(lists, prefix_ids);
+    for (guint i = 0; i + 1 < tokens->len && !missing; i++) {
+        GArray *ids = g_hash_table_lookup(history->postings, g_ptr_array_index(tokens, i));
+        if (ids) {
+            g_ptr_array_add(lists, ids);
+        } else {
+            missing = TRUE;
+        }
+    }
+
+    if (!missing) {
+        /* Intersect shortest first so the candidate set shrinks fastest */
+        g_ptr_array_sort(lists, compare_arrays_by_length);
+
+        GArray *first = g_ptr_array_index(lists, 0);
+        guint32 *candidates = g_new(guint32, first->len + 1);
+        gsize n_candidates = first->len;
+        memcpy(candidates, first->data, first->len * sizeof(guint32));
+
+        for (guint l = 1; l < lists->len && n_candidates > 0; l++) {
+            GArray *ids = g_ptr_array_index(lists, l);
+            n_candidates = llm_canned_intersect(candidates, n_candidates,
+                                                (const guint32 *)ids->data, ids->len,
+                                                candidates);
+        }
+
+        for (gsize i = n_candidates; i > 0 && results->len < limit; i--) {
+            g_ptr_array_add(results, g_ptr_array_index(history->records, candidates[i - 1]));
+        }
+        g_free(candidates);
+    }
+
+    g_array_unref(prefix_ids);
+    g_ptr_array_unref(lists);
+    g_ptr_array_unref(tokens);
+
+    return results;
+}
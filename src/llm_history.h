@@ -0,0 +1,69 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_HISTORY_H
+#define LLM_HISTORY_H
+
+#include <glib.h>
+
+#define HISTORY_FILE_NAME "history.jsonl"
+#define HISTORY_SEARCH_LIMIT 50
+
+typedef struct _LLMHistory LLMHistory;
+
+typedef struct {
+    gint64 timestamp; /* seconds since the epoch */
+    gchar *model;
+    gchar *prompt;
+    gchar *response;
+    gint64 latency_ms;
+    gint prompt_tokens;
+    gint completion_tokens;
+} LLMHistoryRecord;
+
+/**
+ * Get the history shared by all composer windows
+ *
+ * The history file in ~/.local/share/evolution-llm-assistant/ is read on
+ * first use.
+ *
+ * @return The shared history, owned by the plugin
+ */
+LLMHistory* llm_history_get_default(void);
+
+guint llm_history_get_n_records(LLMHistory *history);
+
+/**
+ * Number of records whose prompt or response contains a term
+ *
+ * @param term Lower-cased word as produced by llm_text_tokenize()
+ */
+guint llm_history_get_document_frequency(LLMHistory *history, const gchar *term);
+
+/**
+ * Append a generation to the history file and index it
+ *
+ * The record is copied.
+ */
+void llm_history_add(LLMHistory *history, const LLMHistoryRecord *record);
+
+/**
+ * Find past generations whose prompt or response contains every query word
+ *
+ * The last word also matches as a prefix, so results can follow typing.
+ * An empty query returns the most recent generations.
+ *
+ * @param limit Maximum number of results
+ * @return Array of LLMHistoryRecord owned by the history, newest first
+ */
+GPtrArray* llm_history_search(LLMHistory *history, const gchar *query, guint limit);
+
+#endif /* LLM_HISTORY_H */
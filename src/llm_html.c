@@ -0,0 +1,653 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * HTML-to-text converter. A single-pass state machine over the raw bytes,
+ * so HTML mail can be turned into compact, structured text without building
+ * a DOM. Input may arrive in arbitrary chunks.
+ */
+
+#include "llm_html.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define TAG_BUFFER_SIZE 1024
+#define NAME_BUFFER_SIZE 16
+#define HREF_BUFFER_SIZE 512
+#define ENTITY_BUFFER_SIZE 12
+#define LIST_DEPTH_MAX 8
+
+typedef enum {
+    STATE_TEXT,
+    STATE_TAG,
+    STATE_COMMENT,
+    STATE_ENTITY,
+    STATE_RAWTEXT
+} ParserState;
+
+struct _LLMHtmlConverter {
+    GString *out;
+    ParserState state;
+
+    gchar tag[TAG_BUFFER_SIZE]; /* everything between '<' and '>' */
+    gsize tag_length;
+    gchar tag_quote;            /* open quote inside an attribute value */
+    gchar tag_last;             /* last non-space character of the tag */
+
+    gchar entity[ENTITY_BUFFER_SIZE];
+    gsize entity_length;
+
+    guint comment_dashes;
+
+    gchar raw_end[NAME_BUFFER_SIZE + 2]; /* "</script" inside a raw text element */
+    gsize raw_end_length;
+    gsize raw_match;
+    gboolean raw_closing;
+
+    gchar skip_name[NAME_BUFFER_SIZE]; /* element whose content is dropped */
+    guint skip_depth;
+
+    guint pre_depth;
+    guint pending_newlines;
+    gboolean pending_space;
+
+    guint list_depth;
+    gint list_counter[LIST_DEPTH_MAX]; /* -1 for <ul>, next number for <ol> */
+
+    gchar href[HREF_BUFFER_SIZE];
+    gsize link_start; /* output length when the link opened */
+    gboolean in_link;
+};
+
+static const gchar *void_elements[] = {
+    "area", "base", "br", "col", "embed", "hr", "img", "input",
+    "link", "meta", "param", "source", "track", "wbr", NULL
+};
+
+/* Elements whose content never reaches the reader */
+static const gchar *dropped_elements[] = {
+    "head", "template", "svg", "noscript", "object", "iframe", "select", NULL
+};
+
+static const gchar *raw_text_elements[] = {
+    "script", "style", "title", NULL
+};
+
+static const gchar *paragraph_elements[] = {
+    "p", "h1", "h2", "h3", "h4", "h5", "h6", "blockquote", "table", "hr", NULL
+};
+
+static const gchar *line_elements[] = {
+    "div", "tr", "section", "article", "header", "footer", "nav", "aside",
+    "form", "address", "figure", "figcaption", "dl", "dt", "dd", "center", NULL
+};
+
+static const struct {
+    const gchar *name;
+    const gchar *text;
+} named_entities[] = {
+    { "amp", "&" }, { "lt", "<" }, { "gt", ">" }, { "quot", "\"" }, { "apos", "'" },
+    { "nbsp", " " }, { "shy", "" }, { "zwnj", "" }, { "zwj", "" },
+    { "copy", "\xc2\xa9" }, { "reg", "\xc2\xae" }, { "trade", "\xe2\x84\xa2" },
+    { "mdash", "\xe2\x80\x94" }, { "ndash", "\xe2\x80\x93" }, { "hellip", "\xe2\x80\xa6" },
+    { "lsquo", "\xe2\x80\x98" }, { "rsquo", "\xe2\x80\x99" },
+    { "ldquo", "\xe2\x80\x9c" }, { "rdquo", "\xe2\x80\x9d" },
+    { "euro", "\xe2\x82\xac" }, { "pound", "\xc2\xa3" },
+    { "bull", "\xe2\x80\xa2" }, { "middot", "\xc2\xb7" },
+};
+
+static gboolean in_list(const gchar **list, const gchar *name) {
+    for (guint i = 0; list[i]; i++) {
+        if (strcmp(list[i], name) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+/* Write pending line breaks or the collapsed space before new output */
+static void flush_pending(LLMHtmlConverter *converter) {
+    GString *out = converter->out;
+
+    if (out->len > 0) {
+        if (converter->pending_newlines > 0) {
+            guint wanted = MIN(converter->pending_newlines, 2);
+            guint present = 0;
+            while (present < out->len && present < wanted && out->str[out->len - 1 - present] == '\n') present++;
+            for (guint i = present; i < wanted; i++) g_string_append_c(out, '\n');
+        } else if (converter->pending_space && out->str[out->len - 1] != '\n') {
+            g_string_append_c(out, ' ');
+        }
+    }
+
+    converter->pending_newlines = 0;
+    converter->pending_space = FALSE;
+}
+
+static void emit_char(LLMHtmlConverter *converter, gchar c) {
+    if (converter->skip_depth > 0) return;
+
+    if (converter->pre_depth > 0) {
+        if (c == '\r') return;
+        flush_pending(converter);
+        g_string_append_c(converter->out, c);
+    } else if (g_ascii_isspace(c)) {
+        if (converter->out->len > 0 && converter->pending_newlines == 0) converter->pending_space = TRUE;
+    } else {
+        flush_pending(converter);
+        g_string_append_c(converter->out, c);
+    }
+}
+
+static void emit_string(LLMHtmlConverter *converter, const gchar *text) {
+    if (converter->skip_depth > 0 || !*text) return;
+
+    flush_pending(converter);
+    g_string_append(converter->out, text);
+}
+
+static void emit_break(LLMHtmlConverter *converter, guint newlines) {
+    if (converter->skip_depth > 0 || converter->out->len == 0) return;
+
+    converter->pending_newlines = MAX(converter->pending_newlines, newlines);
+    converter->pending_space = FALSE;
+}
+
+static gboolean at_line_start(LLMHtmlConverter *converter) {
+    GString *out = converter->out;
+    return out->len == 0 || converter->pending_newlines > 0 || out->str[out->len - 1] == '\n';
+}
+
+/**
+ * Find an attribute in the raw tag text
+ *
+ * @param value Filled with the (possibly truncated) NUL-terminated value
+ * @return Length of the full value, or -1 if the attribute is absent
+ */
+static gssize get_attribute(const gchar *tag, gsize length, const gchar *name,
+                            gchar *value, gsize value_size) {
+    const gchar *p = tag;
+    const gchar *end = tag + length;
+    gsize name_length = strlen(name);
+
+    if (p < end && *p == '/') p++;
+    while (p < end && !g_ascii_isspace(*p) && *p != '/') p++;
+
+    while (p < end) {
+        while (p < end && (g_ascii_isspace(*p) || *p == '/')) p++;
+
+        const gchar *attribute = p;
+        while (p < end && !g_ascii_isspace(*p) && *p != '=' && *p != '/') p++;
+        gsize attribute_length = p - attribute;
+        if (attribute_length == 0) {
+            if (p < end) p++;
+            continue;
+        }
+
+        while (p < end && g_ascii_isspace(*p)) p++;
+
+        const gchar *attribute_value = p;
+        gsize value_length = 0;
+        if (p < end && *p == '=') {
+            p++;
+            while (p < end && g_ascii_isspace(*p)) p++;
+            if (p < end && (*p == '"' || *p == '\'')) {
+                gchar quote = *p++;
+                attribute_value = p;
+                while (p < end && *p != quote) p++;
+                value_length = p - attribute_value;
+                if (p < end) p++;
+            } else {
+                attribute_value = p;
+                while (p < end && !g_ascii_isspace(*p)) p++;
+                value_length = p - attribute_value;
+            }
+        }
+
+        if (attribute_length == name_length && g_ascii_strncasecmp(attribute, name, name_length) == 0) {
+            if (value_size > 0) {
+                gsize n = MIN(value_length, value_size - 1);
+                memcpy(value, attribute_value, n);
+                value[n] = '\0';
+            }
+            return value_length;
+        }
+    }
+
+    return -1;
+}
+
+/* Lower-case a style attribute and drop its whitespace, for substring tests */
+static void get_normalized_style(const gchar *tag, gsize length, gchar *style, gsize style_size) {
+    gchar raw[256];
+    style[0] = '\0';
+
+    if (get_attribute(tag, length, "style", raw, sizeof(raw)) < 0) return;
+
+    gsize n = 0;
+    for (const gchar *p = raw; *p && n + 1 < style_size; p++) {
+        if (!g_ascii_isspace(*p)) style[n++] = g_ascii_tolower(*p);
+    }
+    style[n] = '\0';
+}
+
+/* Value of one declaration in a normalized style, without "!important";
+ * the property name must match as a whole */
+static gboolean get_style_property(const gchar *style, const gchar *name, gchar *value, gsize value_size) {
+    gsize name_length = strlen(name);
+
+    for (const gchar *declaration = style; *declaration; ) {
+        const gchar *end = strchr(declaration, ';');
+        if (!end) end = declaration + strlen(declaration);
+
+        if ((gsize)(end - declaration) > name_length && strncmp(declaration, name, name_length) == 0 &&
+            declaration[name_length] == ':') {
+            const gchar *start = declaration + name_length + 1;
+            const gchar *bang = memchr(start, '!', end - start);
+            gsize n = MIN((gsize)((bang ? bang : end) - start), value_size - 1);
+
+            memcpy(value, start, n);
+            value[n] = '\0';
+            return TRUE;
+        }
+
+        declaration = *end ? end + 1 : end;
+    }
+
+    return FALSE;
+}
+
+/* Parse a length such as "0", "1px" or "0.875rem"; FALSE unless it starts with a number */
+static gboolean parse_length(const gchar *value, gdouble *number, const gchar **unit) {
+    gchar *rest = NULL;
+
+    if (!g_ascii_isdigit(*value) && *value != '.') return FALSE;
+    *number = g_ascii_strtod(value, &rest);
+    if (rest == value) return FALSE;
+
+    for (const gchar *p = rest; *p; p++) {
+        if (!g_ascii_isalpha(*p) && *p != '%') return FALSE;
+    }
+    *unit = rest;
+    return TRUE;
+}
+
+/* Whether a style property is zero, in whatever unit */
+static gboolean style_is_zero(const gchar *style, const gchar *name) {
+    gchar value[32];
+    gdouble number;
+    const gchar *unit;
+
+    return get_style_property(style, name, value, sizeof(value)) &&
+           parse_length(value, &number, &unit) && number == 0.0;
+}
+
+static gboolean style_equals(const gchar *style, const gchar *name, const gchar *expected) {
+    gchar value[32];
+    return get_style_property(style, name, value, sizeof(value)) && strcmp(value, expected) == 0;
+}
+
+static gboolean is_hidden(const gchar *tag, gsize length) {
+    gchar value[16];
+    gchar style[256];
+
+    if (get_attribute(tag, length, "hidden", NULL, 0) >= 0) return TRUE;
+    if (get_attribute(tag, length, "aria-hidden", value, sizeof(value)) >= 0 &&
+        g_ascii_strcasecmp(value, "true") == 0) return TRUE;
+
+    get_normalized_style(tag, length, style, sizeof(style));
+    return style_equals(style, "display", "none") || style_equals(style, "visibility", "hidden") ||
+           style_equals(style, "mso-hide", "all") || style_is_zero(style, "max-height") ||
+           style_is_zero(style, "font-size");
+}
+
+/* A width or height of at most one pixel; a zero counts in any unit */
+static gboolean is_pixel_size(const gchar *value, gboolean attribute) {
+    gdouble number;
+    const gchar *unit;
+
+    if (!parse_length(value, &number, &unit)) return FALSE;
+    if (number == 0.0) return TRUE;
+    return number <= 1.0 && (g_ascii_strcasecmp(unit, "px") == 0 || (attribute && !*unit));
+}
+
+/* Images of at most one pixel exist only to report that the mail was opened */
+static gboolean is_tracking_pixel(const gchar *tag, gsize length) {
+    gchar value[32];
+    gchar style[256];
+
+    if (get_attribute(tag, length, "width", value, sizeof(value)) >= 0 && is_pixel_size(g_strstrip(value), TRUE)) {
+        return TRUE;
+    }
+    if (get_attribute(tag, length, "height", value, sizeof(value)) >= 0 && is_pixel_size(g_strstrip(value), TRUE)) {
+        return TRUE;
+    }
+
+    get_normalized_style(tag, length, style, sizeof(style));
+    return (get_style_property(style, "width", value, sizeof(value)) && is_pixel_size(value, FALSE)) ||
+           (get_style_property(style, "height", value, sizeof(value)) && is_pixel_size(value, FALSE));
+}
+
+static void decode_attribute_entities(gchar *value) {
+    gchar *amp;
+    while ((amp = strstr(value, "&amp;")) != NULL) {
+        memmove(amp + 1, amp + 5, strlen(amp + 5) + 1);
+        value = amp + 1;
+    }
+}
+
+static void open_link(LLMHtmlConverter *converter, const gchar *tag, gsize length) {
+    gssize href_length = get_attribute(tag, length, "href", converter->href, sizeof(converter->href));
+
+    converter->in_link = FALSE;
+    if (href_length <= 0 || href_length >= HREF_BUFFER_SIZE) return;
+
+    if (!g_str_has_prefix(converter->href, "http://") &&
+        !g_str_has_prefix(converter->href, "https://") &&
+        !g_str_has_prefix(converter->href, "mailto:")) return;
+
+    decode_attribute_entities(converter->href);
+    converter->in_link = TRUE;
+    converter->link_start = converter->out->len;
+}
+
+/* Append the target unless the link text already shows it */
+static void close_link(LLMHtmlConverter *converter) {
+    if (!converter->in_link) return;
+    converter->in_link = FALSE;
+
+    const gchar *target = converter->href;
+    if (g_str_has_prefix(target, "mailto:")) target += 7;
+
+    const gchar *text = converter->out->str + MIN(converter->link_start, converter->out->len);
+    while (*text == ' ' || *text == '\n') text++;
+
+    if (strcmp(text, target) == 0 || strcmp(text, converter->href) == 0) return;
+
+    emit_string(converter, " (");
+    g_string_append(converter->out, target);
+    g_string_append_c(converter->out, ')');
+}
+
+static void open_list_item(LLMHtmlConverter *converter) {
+    emit_break(converter, 1);
+    if (converter->skip_depth > 0) return;
+
+    flush_pending(converter);
+    for (guint i = 1; i < converter->list_depth; i++) g_string_append(converter->out, "  ");
+
+    gint *counter = converter->list_depth > 0 ?
+                    &converter->list_counter[MIN(converter->list_depth, LIST_DEPTH_MAX) - 1] : NULL;
+    if (counter && *counter > 0) {
+        g_string_append_printf(converter->out, "%d. ", (*counter)++);
+    } else {
+        g_string_append(converter->out, "- ");
+    }
+}
+
+static void handle_tag(LLMHtmlConverter *converter) {
+    const gchar *tag = converter->tag;
+    gsize length = converter->tag_length;
+    gboolean closing = FALSE;
+
+    if (length == 0 || tag[0] == '!' || tag[0] == '?') return;
+
+    const gchar *p = tag;
+    if (*p == '/') {
+        closing = TRUE;
+        p++;
+    }
+
+    gchar name[NAME_BUFFER_SIZE];
+    gsize name_length = 0;
+    while (p < tag + length && g_ascii_isalnum(*p) && name_length + 1 < sizeof(name)) {
+        name[name_length++] = g_ascii_tolower(*p++);
+    }
+    name[name_length] = '\0';
+    if (name_length == 0) return;
+
+    gboolean self_closing = tag[length - 1] == '/';
+    gboolean is_void = in_list(void_elements, name);
+
+    if (!closing && in_list(raw_text_elements, name)) {
+        converter->raw_end_length = g_snprintf(converter->raw_end, sizeof(converter->raw_end), "</%s", name);
+        converter->raw_match = 0;
+        converter->raw_closing = FALSE;
+        converter->state = STATE_RAWTEXT;
+        return;
+    }
+
+    /* Inside a dropped element only its own nesting matters */
+    if (converter->skip_depth > 0) {
+        if (strcmp(name, converter->skip_name) == 0 && !is_void && !self_closing) {
+            if (closing) {
+                converter->skip_depth--;
+            } else {
+                converter->skip_depth++;
+            }
+        }
+        return;
+    }
+
+    if (!closing && (in_list(dropped_elements, name) || is_hidden(tag, length))) {
+        if (!is_void && !self_closing) {
+            g_strlcpy(converter->skip_name, name, sizeof(converter->skip_name));
+            converter->skip_depth = 1;
+        }
+        return;
+    }
+
+    if (strcmp(name, "br") == 0) {
+        if (converter->out->len > 0) converter->pending_newlines = MIN(converter->pending_newlines + 1, 2);
+        converter->pending_space = FALSE;
+    } else if (strcmp(name, "li") == 0) {
+        if (!closing) open_list_item(converter);
+    } else if (strcmp(name, "ul") == 0 || strcmp(name, "ol") == 0) {
+        if (closing) {
+            if (converter->list_depth > 0) converter->list_depth--;
+        } else {
+            if (converter->list_depth < LIST_DEPTH_MAX) {
+                converter->list_counter[converter->list_depth] = name[0] == 'o' ? 1 : -1;
+            }
+            converter->list_depth++;
+        }
+        emit_break(converter, converter->list_depth == 0 ? 2 : 1);
+    } else if (strcmp(name, "pre") == 0) {
+        if (closing) {
+            if (converter->pre_depth > 0) converter->pre_depth--;
+        } else {
+            converter->pre_depth++;
+        }
+        emit_break(converter, 2);
+    } else if (strcmp(name, "td") == 0 || strcmp(name, "th") == 0) {
+        if (!closing && !at_line_start(converter)) emit_string(converter, " | ");
+    } else if (strcmp(name, "a") == 0) {
+        if (closing) {
+            close_link(converter);
+        } else {
+            open_link(converter, tag, length);
+        }
+    } else if (strcmp(name, "img") == 0) {
+        gchar alt[128];
+        if (!is_tracking_pixel(tag, length) &&
+            get_attribute(tag, length, "alt", alt, sizeof(alt)) > 0) {
+            g_strstrip(alt);
+            if (*alt) {
+                if (!at_line_start(converter)) converter->pending_space = TRUE;
+                emit_string(converter, "[");
+                emit_string(converter, alt);
+                emit_string(converter, "]");
+            }
+        }
+    } else if (in_list(paragraph_elements, name)) {
+        emit_break(converter, 2);
+    } else if (in_list(line_elements, name)) {
+        emit_break(converter, 1);
+    }
+}
+
+static void decode_entity(LLMHtmlConverter *converter) {
+    const gchar *entity = converter->entity;
+    gchar utf8[8];
+
+    if (entity[0] == '#') {
+        gunichar c = entity[1] == 'x' || entity[1] == 'X' ?
+                     (gunichar)strtoul(entity + 2, NULL, 16) :
+                     (gunichar)strtoul(entity + 1, NULL, 10);
+
+        /* Zero-width characters pad preview text in marketing mail */
+        if (c == 0x00AD || c == 0x034F || (c >= 0x200B && c <= 0x200D) || c == 0xFEFF) return;
+        if (c == 0x00A0 || c == '\t' || c == '\n') {
+            emit_char(converter, ' ');
+            return;
+        }
+        if (c == 0 || !g_unichar_validate(c)) return;
+
+        utf8[g_unichar_to_utf8(c, utf8)] = '\0';
+        emit_string(converter, utf8);
+        return;
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS(named_entities); i++) {
+        if (strcmp(entity, named_entities[i].name) == 0) {
+            if (named_entities[i].text[0] == ' ') {
+                emit_char(converter, ' ');
+            } else {
+                emit_string(converter, named_entities[i].text);
+            }
+            return;
+        }
+    }
+
+    /* Unknown entity: keep it as written */
+    emit_char(converter, '&');
+    emit_string(converter, entity);
+    emit_char(converter, ';');
+}
+
+static void process_char(LLMHtmlConverter *converter, gchar c) {
+    switch (converter->state) {
+    case STATE_TEXT:
+        if (c == '<') {
+            converter->state = STATE_TAG;
+            converter->tag_length = 0;
+            converter->tag_quote = 0;
+            converter->tag_last = 0;
+        } else if (c == '&') {
+            converter->state = STATE_ENTITY;
+            converter->entity_length = 0;
+        } else {
+            emit_char(converter, c);
+        }
+        break;
+
+    case STATE_TAG:
+        /* "a < b" is text, not a tag */
+        if (converter->tag_length == 0 && !g_ascii_isalpha(c) && c != '/' && c != '!' && c != '?') {
+            converter->state = STATE_TEXT;
+            emit_char(converter, '<');
+            process_char(converter, c);
+            break;
+        }
+
+        if (converter->tag_quote) {
+            if (c == converter->tag_quote) converter->tag_quote = 0;
+        } else if ((c == '"' || c == '\'') && converter->tag_last == '=') {
+            converter->tag_quote = c;
+        } else if (c == '>') {
+            converter->state = STATE_TEXT;
+            converter->tag[converter->tag_length] = '\0';
+            handle_tag(converter);
+            break;
+        }
+
+        if (!g_ascii_isspace(c)) converter->tag_last = c;
+        if (converter->tag_length + 1 < TAG_BUFFER_SIZE) converter->tag[converter->tag_length++] = c;
+
+        if (converter->tag_length == 3 && memcmp(converter->tag, "!--", 3) == 0) {
+            converter->state = STATE_COMMENT;
+            converter->comment_dashes = 0;
+        }
+        break;
+
+    case STATE_COMMENT:
+        if (c == '-') {
+            converter->comment_dashes++;
+        } else {
+            if (c == '>' && converter->comment_dashes >= 2) converter->state = STATE_TEXT;
+            converter->comment_dashes = 0;
+        }
+        break;
+
+    case STATE_ENTITY:
+        if (c == ';' && converter->entity_length > 0) {
+            converter->entity[converter->entity_length] = '\0';
+            converter->state = STATE_TEXT;
+            decode_entity(converter);
+        } else if ((g_ascii_isalnum(c) || (c == '#' && converter->entity_length == 0)) &&
+                   converter->entity_length + 1 < ENTITY_BUFFER_SIZE) {
+            converter->entity[converter->entity_length++] = c;
+        } else {
+            /* Not an entity after all: a bare '&' */
+            converter->entity[converter->entity_length] = '\0';
+            converter->state = STATE_TEXT;
+            emit_char(converter, '&');
+            emit_string(converter, converter->entity);
+            process_char(converter, c);
+        }
+        break;
+
+    case STATE_RAWTEXT:
+        if (converter->raw_closing) {
+            if (c == '>') converter->state = STATE_TEXT;
+        } else if (g_ascii_tolower(c) == converter->raw_end[converter->raw_match]) {
+            if (++converter->raw_match == converter->raw_end_length) converter->raw_closing = TRUE;
+        } else {
+            converter->raw_match = c == '<' ? 1 : 0;
+        }
+        break;
+    }
+}
+
+LLMHtmlConverter* llm_html_converter_new(void) {
+    LLMHtmlConverter *converter = g_new0(LLMHtmlConverter, 1);
+    converter->out = g_string_sized_new(4096);
+    converter->state = STATE_TEXT;
+    return converter;
+}
+
+void llm_html_converter_feed(LLMHtmlConverter *converter, const gchar *data, gssize length) {
+    g_return_if_fail(converter != NULL);
+    if (!data) return;
+
+    if (length < 0) length = strlen(data);
+
+    for (gssize i = 0; i < length; i++) {
+        process_char(converter, data[i]);
+    }
+}
+
+gchar* llm_html_converter_finish(LLMHtmlConverter *converter) {
+    g_return_val_if_fail(converter != NULL, NULL);
+
+    if (converter->state == STATE_ENTITY) {
+        converter->entity[converter->entity_length] = '\0';
+        emit_char(converter, '&');
+        emit_string(converter, converter->entity);
+    }
+
+    gchar *text = g_string_free(converter->out, FALSE);
+    g_free(converter);
+
+    return g_strchomp(text);
+}
+
+gchar* llm_html_to_text(const gchar *html, gssize length) {
+    LLMHtmlConverter *converter = llm_html_converter_new();
+    llm_html_converter_feed(converter, html, length);
+    return llm_html_converter_finish(converter);
+}
@@ -0,0 +1,50 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_HTML_H
+#define LLM_HTML_H
+
+#include <glib.h>
+
+typedef struct _LLMHtmlConverter LLMHtmlConverter;
+
+/**
+ * Create a streaming HTML-to-text converter
+ *
+ * Paragraphs, line breaks, headings, lists and table rows become line
+ * structure; links keep their target as "text (url)". Scripts, styles,
+ * comments, hidden elements and tracking pixels are dropped. Apart from the
+ * output buffer the converter does not allocate.
+ */
+LLMHtmlConverter* llm_html_converter_new(void);
+
+/**
+ * Feed the next chunk of HTML. Chunks may split tags and entities anywhere.
+ *
+ * @param length Length of data in bytes, or -1 if NUL-terminated
+ */
+void llm_html_converter_feed(LLMHtmlConverter *converter, const gchar *data, gssize length);
+
+/**
+ * Flush and free the converter
+ *
+ * @return Newly allocated plain text
+ */
+gchar* llm_html_converter_finish(LLMHtmlConverter *converter);
+
+/**
+ * Convert a complete HTML document or fragment
+ *
+ * @return Newly allocated plain text
+ */
+gchar* llm_html_to_text(const gchar *html, gssize length);
+
+#endif /* LLM_HTML_H */
@@ -0,0 +1,254 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Process-wide counters and latency histograms, updated lock-free from the
+ * main thread and the worker threads, and an exporter that writes them for
+ * node_exporter's textfile collector.
+ */
+
+#include "llm_metrics.h"
+#include <gio/gio.h>
+#include <stdatomic.h>
+
+#define METRICS_PREFIX "evolution_llm_"
+
+static _Atomic gint64 counters[LLM_METRIC_COUNT];
+
+static const gchar *metric_names[LLM_METRIC_COUNT] = {
+    [LLM_METRIC_REQUESTS] = "requests",
+    [LLM_METRIC_REQUEST_LATENCY_MS] = "request_latency_ms",
+    [LLM_METRIC_COMPRESSED_REQUESTS] = "compressed_requests",
+    [LLM_METRIC_COMPRESSED_REQUEST_LATENCY_MS] = "compressed_request_latency_ms",
+    [LLM_METRIC_COMPRESSION_WORDS_IN] = "compression_words_in",
+    [LLM_METRIC_COMPRESSION_WORDS_SAVED] = "compression_words_saved",
+    [LLM_METRIC_COMPRESSION_TIME_US] = "compression_time_us",
+    [LLM_METRIC_BOILERPLATE_BYTES_REMOVED] = "boilerplate_bytes_removed",
+    [LLM_METRIC_HTML_BYTES_IN] = "html_bytes_in",
+    [LLM_METRIC_HTML_TIME_US] = "html_time_us",
+    [LLM_METRIC_ATTACHMENT_BYTES_IN] = "attachment_bytes_in",
+    [LLM_METRIC_ATTACHMENT_CACHE_HITS] = "attachment_cache_hits",
+    [LLM_METRIC_HTTP_REQUESTS] = "http_requests",
+    [LLM_METRIC_HTTP_TTFB_MS] = "http_ttfb_ms",
+    [LLM_METRIC_REALTIME_REQUESTS] = "realtime_requests",
+    [LLM_METRIC_REALTIME_TTFB_MS] = "realtime_ttfb_ms",
+    [LLM_METRIC_REALTIME_CONNECTS] = "realtime_connects",
+    [LLM_METRIC_REQUEST_ERRORS] = "request_errors",
+    [LLM_METRIC_RETRIES] = "retries",
+    [LLM_METRIC_DEADLINE_DROPPED] = "deadline_dropped",
+    [LLM_METRIC_DEADLINE_DOWNGRADES] = "deadline_downgrades",
+    [LLM_METRIC_REWRITE_PARAGRAPHS] = "rewrite_paragraphs",
+    [LLM_METRIC_REWRITE_PARAGRAPHS_REUSED] = "rewrite_paragraphs_reused",
+    [LLM_METRIC_REVIEW_PARAGRAPHS] = "review_paragraphs",
+    [LLM_METRIC_REVIEW_PARAGRAPHS_SENT] = "review_paragraphs_sent",
+    [LLM_METRIC_HTTP_RATE_LIMITED] = "http_rate_limited",
+    [LLM_METRIC_BYTES_SENT] = "bytes_sent",
+    [LLM_METRIC_BYTES_RECEIVED] = "bytes_received",
+    [LLM_METRIC_PROMPT_TOKENS] = "prompt_tokens",
+    [LLM_METRIC_COMPLETION_TOKENS] = "completion_tokens",
+    [LLM_METRIC_CACHED_TOKENS] = "cached_tokens",
+    [LLM_METRIC_CACHE_LOOKUPS] = "cache_lookups",
+    [LLM_METRIC_CACHE_HITS] = "cache_hits",
+    [LLM_METRIC_BUDGET_REFUSED] = "budget_refused",
+    [LLM_METRIC_BUDGET_DOWNGRADES] = "budget_downgrades",
+};
+
+static const gchar *metric_help[LLM_METRIC_COUNT] = {
+    [LLM_METRIC_REQUESTS] = "Requests sent to a model.",
+    [LLM_METRIC_REQUEST_LATENCY_MS] = "Total time spent on requests, in milliseconds.",
+    [LLM_METRIC_COMPRESSED_REQUESTS] = "Requests sent with a compressed prompt.",
+    [LLM_METRIC_COMPRESSED_REQUEST_LATENCY_MS] = "Total time spent on requests with a compressed prompt, in milliseconds.",
+    [LLM_METRIC_COMPRESSION_WORDS_IN] = "Words given to prompt compression.",
+    [LLM_METRIC_COMPRESSION_WORDS_SAVED] = "Words removed by prompt compression.",
+    [LLM_METRIC_COMPRESSION_TIME_US] = "Time spent compressing prompts, in microseconds.",
+    [LLM_METRIC_BOILERPLATE_BYTES_REMOVED] = "Bytes of signatures and disclaimers removed from prompts.",
+    [LLM_METRIC_HTML_BYTES_IN] = "Bytes of HTML converted to text.",
+    [LLM_METRIC_HTML_TIME_US] = "Time spent converting HTML, in microseconds.",
+    [LLM_METRIC_ATTACHMENT_BYTES_IN] = "Bytes of attachments read for their text.",
+    [LLM_METRIC_ATTACHMENT_CACHE_HITS] = "Attachments whose text was found in the cache.",
+    [LLM_METRIC_HTTP_REQUESTS] = "Requests that received an HTTP response.",
+    [LLM_METRIC_HTTP_TTFB_MS] = "Total time to the first HTTP response byte, in milliseconds.",
+    [LLM_METRIC_REALTIME_REQUESTS] = "Requests sent over the realtime session.",
+    [LLM_METRIC_REALTIME_TTFB_MS] = "Total time to the first realtime token, in milliseconds.",
+    [LLM_METRIC_REALTIME_CONNECTS] = "Realtime sessions opened.",
+    [LLM_METRIC_REQUEST_ERRORS] = "Requests that failed or were cancelled.",
+    [LLM_METRIC_RETRIES] = "Requests sent again after a failed attempt.",
+    [LLM_METRIC_DEADLINE_DROPPED] = "Requests not sent because they could no longer meet their deadline.",
+    [LLM_METRIC_DEADLINE_DOWNGRADES] = "Requests moved to the fallback model to meet their deadline.",
+    [LLM_METRIC_REWRITE_PARAGRAPHS] = "Paragraphs in selections rewritten with /rw:.",
+    [LLM_METRIC_REWRITE_PARAGRAPHS_REUSED] = "Rewritten paragraphs taken from the cache instead of the model.",
+    [LLM_METRIC_REVIEW_PARAGRAPHS] = "Paragraphs of changed drafts handed to the pre-send review.",
+    [LLM_METRIC_REVIEW_PARAGRAPHS_SENT] = "Changed paragraphs sent to the model for review.",
+    [LLM_METRIC_HTTP_RATE_LIMITED] = "HTTP responses with status 429.",
+    [LLM_METRIC_BYTES_SENT] = "Bytes sent to model endpoints.",
+    [LLM_METRIC_BYTES_RECEIVED] = "Bytes received from model endpoints.",
+    [LLM_METRIC_PROMPT_TOKENS] = "Prompt tokens reported by the models.",
+    [LLM_METRIC_COMPLETION_TOKENS] = "Completion tokens reported by the models.",
+    [LLM_METRIC_CACHED_TOKENS] = "Prompt tokens the models read from their prompt cache.",
+    [LLM_METRIC_CACHE_LOOKUPS] = "Response cache lookups for a draft.",
+    [LLM_METRIC_CACHE_HITS] = "Response cache lookups that found a draft.",
+    [LLM_METRIC_BUDGET_REFUSED] = "Requests not sent because a budget was nearly or fully spent.",
+    [LLM_METRIC_BUDGET_DOWNGRADES] = "Requests moved to the fallback model to stay within a budget.",
+};
+
+/* Upper bounds of the histogram buckets, in milliseconds; the last bucket is +Inf */
+static const gint64 histogram_bounds_ms[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 30000 };
+
+#define HISTOGRAM_BUCKETS (G_N_ELEMENTS(histogram_bounds_ms) + 1)
+
+typedef struct {
+    _Atomic gint64 buckets[HISTOGRAM_BUCKETS]; /* not cumulative */
+    _Atomic gint64 sum_ms;
+} Histogram;
+
+static Histogram histograms[LLM_HISTOGRAM_COUNT];
+
+static const gchar *histogram_names[LLM_HISTOGRAM_COUNT] = {
+    [LLM_HISTOGRAM_REQUEST_LATENCY] = "request_duration_seconds",
+    [LLM_HISTOGRAM_TTFB] = "time_to_first_byte_seconds",
+};
+
+static const gchar *histogram_help[LLM_HISTOGRAM_COUNT] = {
+    [LLM_HISTOGRAM_REQUEST_LATENCY] = "Duration of requests to a model.",
+    [LLM_HISTOGRAM_TTFB] = "Time to the first byte or token of a response.",
+};
+
+typedef struct {
+    gchar *path;
+    guint interval_s;
+    gint writing; /* a write is still running; skip a tick rather than queue up */
+} MetricsExport;
+
+void llm_metrics_add(LLMMetric metric, gint64 value) {
+    g_return_if_fail(metric < LLM_METRIC_COUNT);
+    atomic_fetch_add_explicit(&counters[metric], value, memory_order_relaxed);
+}
+
+gint64 llm_metrics_get(LLMMetric metric) {
+    g_return_val_if_fail(metric < LLM_METRIC_COUNT, 0);
+    return atomic_load_explicit(&counters[metric], memory_order_relaxed);
+}
+
+const gchar* llm_metrics_get_name(LLMMetric metric) {
+    g_return_val_if_fail(metric < LLM_METRIC_COUNT, NULL);
+    return metric_names[metric];
+}
+
+void llm_metrics_observe(LLMHistogram histogram, gint64 value_ms) {
+    g_return_if_fail(histogram < LLM_HISTOGRAM_COUNT);
+
+    guint bucket = 0;
+    while (bucket < G_N_ELEMENTS(histogram_bounds_ms) && value_ms > histogram_bounds_ms[bucket]) {
+        bucket++;
+    }
+
+    atomic_fetch_add_explicit(&histograms[histogram].buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histograms[histogram].sum_ms, value_ms, memory_order_relaxed);
+}
+
+static void format_histogram(GString *out, LLMHistogram histogram) {
+    const gchar *name = histogram_names[histogram];
+    Histogram *h = &histograms[histogram];
+    gint64 cumulative = 0;
+    gchar le[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_string_append_printf(out, "# TYPE " METRICS_PREFIX "%s histogram\n", name);
+    g_string_append_printf(out, "# HELP " METRICS_PREFIX "%s %s\n", name, histogram_help[histogram]);
+
+    for (guint i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        cumulative += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+
+        if (i < G_N_ELEMENTS(histogram_bounds_ms)) {
+            g_ascii_dtostr(le, sizeof(le), histogram_bounds_ms[i] / 1000.0);
+        } else {
+            g_strlcpy(le, "+Inf", sizeof(le));
+        }
+        g_string_append_printf(out, METRICS_PREFIX "%s_bucket{le=\"%s\"} %" G_GINT64_FORMAT "\n",
+                               name, le, cumulative);
+    }
+
+    /* The buckets are read one by one, so the count is taken from them
+     * rather than from a separate counter that could disagree */
+    gchar sum[G_ASCII_DTOSTR_BUF_SIZE];
+    g_ascii_dtostr(sum, sizeof(sum), atomic_load_explicit(&h->sum_ms, memory_order_relaxed) / 1000.0);
+    g_string_append_printf(out, METRICS_PREFIX "%s_sum %s\n", name, sum);
+    g_string_append_printf(out, METRICS_PREFIX "%s_count %" G_GINT64_FORMAT "\n", name, cumulative);
+}
+
+gchar* llm_metrics_format_openmetrics(void) {
+    GString *out = g_string_sized_new(4096);
+
+    for (guint i = 0; i < LLM_METRIC_COUNT; i++) {
+        g_string_append_printf(out, "# TYPE " METRICS_PREFIX "%s counter\n", metric_names[i]);
+        g_string_append_printf(out, "# HELP " METRICS_PREFIX "%s %s\n", metric_names[i], metric_help[i]);
+        g_string_append_printf(out, METRICS_PREFIX "%s_total %" G_GINT64_FORMAT "\n",
+                               metric_names[i], llm_metrics_get(i));
+    }
+
+    for (guint i = 0; i < LLM_HISTOGRAM_COUNT; i++) {
+        format_histogram(out, i);
+    }
+
+    g_string_append(out, "# EOF\n");
+    return g_string_free(out, FALSE);
+}
+
+/* Write the snapshot; runs in a worker thread */
+static void export_thread(GTask *task,
+                          gpointer source_object G_GNUC_UNUSED,
+                          gpointer task_data,
+                          GCancellable *cancellable G_GNUC_UNUSED) {
+    MetricsExport *export = task_data;
+    gchar *text = llm_metrics_format_openmetrics();
+    GError *error = NULL;
+
+    /* g_file_set_contents() writes a temporary file and renames it over the
+     * old one, so the collector never reads a partial file */
+    if (!g_file_set_contents(export->path, text, -1, &error)) {
+        g_warning("LLM Metrics: Failed to write %s: %s", export->path, error->message);
+        g_error_free(error);
+    }
+
+    g_free(text);
+    g_atomic_int_set(&export->writing, FALSE);
+    g_task_return_boolean(task, TRUE);
+}
+
+static gboolean export_tick(gpointer user_data) {
+    MetricsExport *export = user_data;
+
+    if (!g_atomic_int_compare_and_exchange(&export->writing, FALSE, TRUE)) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    GTask *task = g_task_new(NULL, NULL, NULL, NULL);
+    g_task_set_task_data(task, export, NULL);
+    g_task_run_in_thread(task, export_thread);
+    g_object_unref(task);
+
+    return G_SOURCE_CONTINUE;
+}
+
+void llm_metrics_start_export(const gchar *path, guint interval_s) {
+    static gsize started = 0;
+
+    g_return_if_fail(path != NULL);
+
+    if (g_once_init_enter(&started)) {
+        MetricsExport *export = g_new0(MetricsExport, 1);
+        export->path = g_strdup(path);
+        export->interval_s = MAX(interval_s, 1);
+
+        g_print("LLM Metrics: Writing %s every %u s\n", export->path, export->interval_s);
+        g_timeout_add_seconds(export->interval_s, export_tick, export);
+        export_tick(export);
+
+        g_once_init_leave(&started, 1);
+    }
+}
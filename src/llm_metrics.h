@@ -0,0 +1,100 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_METRICS_H
+#define LLM_METRICS_H
+
+#include <glib.h>
+
+/* Process-wide counters; they only ever increase */
+typedef enum {
+    LLM_METRIC_REQUESTS,
+    LLM_METRIC_REQUEST_LATENCY_MS,
+    LLM_METRIC_COMPRESSED_REQUESTS,
+    LLM_METRIC_COMPRESSED_REQUEST_LATENCY_MS,
+    LLM_METRIC_COMPRESSION_WORDS_IN,
+    LLM_METRIC_COMPRESSION_WORDS_SAVED,
+    LLM_METRIC_COMPRESSION_TIME_US,
+    LLM_METRIC_BOILERPLATE_BYTES_REMOVED,
+    LLM_METRIC_HTML_BYTES_IN,
+    LLM_METRIC_HTML_TIME_US,
+    LLM_METRIC_ATTACHMENT_BYTES_IN,
+    LLM_METRIC_ATTACHMENT_CACHE_HITS,
+    LLM_METRIC_HTTP_REQUESTS,
+    LLM_METRIC_HTTP_TTFB_MS,
+    LLM_METRIC_REALTIME_REQUESTS,
+    LLM_METRIC_REALTIME_TTFB_MS,
+    LLM_METRIC_REALTIME_CONNECTS,
+    LLM_METRIC_REQUEST_ERRORS,
+    LLM_METRIC_RETRIES,
+    LLM_METRIC_DEADLINE_DROPPED,
+    LLM_METRIC_DEADLINE_DOWNGRADES,
+    LLM_METRIC_REWRITE_PARAGRAPHS,
+    LLM_METRIC_REWRITE_PARAGRAPHS_REUSED,
+    LLM_METRIC_REVIEW_PARAGRAPHS,
+    LLM_METRIC_REVIEW_PARAGRAPHS_SENT,
+    LLM_METRIC_HTTP_RATE_LIMITED,
+    LLM_METRIC_BYTES_SENT,
+    LLM_METRIC_BYTES_RECEIVED,
+    LLM_METRIC_PROMPT_TOKENS,
+    LLM_METRIC_COMPLETION_TOKENS,
+    LLM_METRIC_CACHED_TOKENS,
+    LLM_METRIC_CACHE_LOOKUPS,
+    LLM_METRIC_CACHE_HITS,
+    LLM_METRIC_BUDGET_REFUSED,
+    LLM_METRIC_BUDGET_DOWNGRADES,
+    LLM_METRIC_COUNT
+} LLMMetric;
+
+/* Latency distributions, in milliseconds */
+typedef enum {
+    LLM_HISTOGRAM_REQUEST_LATENCY,
+    LLM_HISTOGRAM_TTFB,
+    LLM_HISTOGRAM_COUNT
+} LLMHistogram;
+
+/**
+ * Add to a counter. Safe to call from any thread.
+ */
+void llm_metrics_add(LLMMetric metric, gint64 value);
+
+gint64 llm_metrics_get(LLMMetric metric);
+
+/**
+ * Name of a counter, e.g. "requests" or "request_latency_ms"
+ */
+const gchar* llm_metrics_get_name(LLMMetric metric);
+
+/**
+ * Record a latency in a histogram. Safe to call from any thread.
+ */
+void llm_metrics_observe(LLMHistogram histogram, gint64 value_ms);
+
+/**
+ * Format all counters and histograms in the OpenMetrics text format
+ *
+ * @return Newly allocated text ending in "# EOF"; free with g_free()
+ */
+gchar* llm_metrics_format_openmetrics(void);
+
+/**
+ * Write the metrics to a file every interval_s seconds
+ *
+ * Meant for node_exporter's textfile collector, so the path should end in
+ * .prom. The file is replaced atomically from a worker thread. Only the
+ * first call in a process has an effect; later windows share the exporter.
+ *
+ * @param path File to write
+ * @param interval_s Seconds between writes
+ */
+void llm_metrics_start_export(const gchar *path, guint interval_s);
+
+#endif /* LLM_METRICS_H */
@@ -0,0 +1,185 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Per-request performance log. Every request is written as a fixed-size
+ * record into a memory-mapped ring, so appending costs a copy and the
+ * history stays bounded without rotating files.
+ *
+ * Layout (host byte order):
+ *
+ *   PerfLogHeader
+ *   LLMPerfRecord records[capacity]   record i is at written % capacity
+ */
+
+#include "llm_perflog.h"
+#include "../config/config.h"
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define PERFLOG_MAGIC "LLMPERF\0"
+#define PERFLOG_VERSION 1
+
+typedef struct {
+    gchar magic[8];
+    guint32 version;
+    guint32 record_size;
+    guint32 capacity;
+    guint32 reserved;
+    guint64 written; /* records appended since the log was created */
+} PerfLogHeader;
+
+G_STATIC_ASSERT(sizeof(PerfLogHeader) % 8 == 0);
+G_STATIC_ASSERT(sizeof(LLMPerfRecord) % 8 == 0);
+
+static GMutex perflog_mutex;
+static PerfLogHeader *perflog_map = NULL;
+static gboolean perflog_failed = FALSE;
+
+static const gchar *error_names[] = {
+    [LLM_PERF_ERROR_NONE] = "ok",
+    [LLM_PERF_ERROR_CANCELLED] = "cancelled",
+    [LLM_PERF_ERROR_CONNECT] = "connect",
+    [LLM_PERF_ERROR_TIMEOUT] = "timeout",
+    [LLM_PERF_ERROR_HTTP] = "http",
+    [LLM_PERF_ERROR_RESPONSE] = "response",
+    [LLM_PERF_ERROR_OTHER] = "other",
+};
+
+static const gchar *cache_names[] = {
+    [LLM_PERF_CACHE_NONE] = "none",
+    [LLM_PERF_CACHE_MISS] = "miss",
+    [LLM_PERF_CACHE_STALE] = "stale",
+};
+
+static gsize perflog_size(guint32 capacity) {
+    return sizeof(PerfLogHeader) + (gsize)capacity * sizeof(LLMPerfRecord);
+}
+
+static gboolean header_is_valid(const PerfLogHeader *header, gsize size) {
+    return memcmp(header->magic, PERFLOG_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == PERFLOG_VERSION &&
+           header->record_size == sizeof(LLMPerfRecord) &&
+           header->capacity > 0 &&
+           size >= perflog_size(header->capacity);
+}
+
+gchar* llm_perflog_get_path(void) {
+    return g_build_filename(g_get_user_cache_dir(), CONFIG_DIR_NAME, PERFLOG_FILE_NAME, NULL);
+}
+
+/* Map the log, starting a new one if it is missing or from another version */
+static PerfLogHeader* perflog_open(void) {
+    gchar *path = llm_perflog_get_path();
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    gsize size = perflog_size(PERFLOG_CAPACITY);
+    int fd = g_open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        g_warning("LLM Perf Log: Failed to open %s: %s", path, g_strerror(errno));
+        g_free(path);
+        return NULL;
+    }
+
+    PerfLogHeader existing = {0};
+    gboolean reuse = pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+                     existing.capacity == PERFLOG_CAPACITY &&
+                     header_is_valid(&existing, lseek(fd, 0, SEEK_END));
+
+    if (!reuse && (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0)) {
+        g_warning("LLM Perf Log: Failed to size %s: %s", path, g_strerror(errno));
+        close(fd);
+        g_free(path);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        g_warning("LLM Perf Log: Failed to map %s: %s", path, g_strerror(errno));
+        g_free(path);
+        return NULL;
+    }
+
+    PerfLogHeader *header = map;
+    if (!reuse) {
+        memcpy(header->magic, PERFLOG_MAGIC, sizeof(header->magic));
+        header->version = PERFLOG_VERSION;
+        header->record_size = sizeof(LLMPerfRecord);
+        header->capacity = PERFLOG_CAPACITY;
+        header->written = 0;
+        g_print("LLM Perf Log: Started %s\n", path);
+    }
+
+    g_free(path);
+    return header;
+}
+
+void llm_perflog_append(const LLMPerfRecord *record) {
+    g_mutex_lock(&perflog_mutex);
+
+    if (!perflog_map && !perflog_failed) {
+        perflog_map = perflog_open();
+        perflog_failed = !perflog_map;
+    }
+
+    if (perflog_map) {
+        LLMPerfRecord *records = (LLMPerfRecord *)(perflog_map + 1);
+        records[perflog_map->written % perflog_map->capacity] = *record;
+        perflog_map->written++;
+    }
+
+    g_mutex_unlock(&perflog_mutex);
+}
+
+GArray* llm_perflog_read(const gchar *path, GError **error) {
+    GMappedFile *file = g_mapped_file_new(path, FALSE, error);
+    if (!file) return NULL;
+
+    gsize size = g_mapped_file_get_length(file);
+    const PerfLogHeader *header = (const PerfLogHeader *)g_mapped_file_get_contents(file);
+
+    if (size < sizeof(PerfLogHeader) || !header_is_valid(header, size)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s is not a performance log", path);
+        g_mapped_file_unref(file);
+        return NULL;
+    }
+
+    const LLMPerfRecord *records = (const LLMPerfRecord *)(header + 1);
+    guint64 written = header->written;
+    guint count = (guint)MIN(written, (guint64)header->capacity);
+    guint first = written > header->capacity ? (guint)(written % header->capacity) : 0;
+
+    GArray *result = g_array_sized_new(FALSE, FALSE, sizeof(LLMPerfRecord), count);
+    for (guint i = 0; i < count; i++) {
+        LLMPerfRecord record = records[(first + i) % header->capacity];
+        record.model[sizeof(record.model) - 1] = '\0';
+        record.endpoint[sizeof(record.endpoint) - 1] = '\0';
+        g_array_append_val(result, record);
+    }
+
+    g_mapped_file_unref(file);
+    return result;
+}
+
+const gchar* llm_perflog_error_name(LLMPerfError error) {
+    return error < G_N_ELEMENTS(error_names) ? error_names[error] : "unknown";
+}
+
+const gchar* llm_perflog_cache_name(LLMPerfCache cache) {
+    return cache < G_N_ELEMENTS(cache_names) ? cache_names[cache] : "unknown";
+}
@@ -0,0 +1,88 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_PERFLOG_H
+#define LLM_PERFLOG_H
+
+#include <glib.h>
+
+#define PERFLOG_FILE_NAME "perf.log"
+#define PERFLOG_CAPACITY 32768 /* records kept; the oldest is overwritten first */
+
+typedef enum {
+    LLM_PERF_TRANSPORT_HTTP,
+    LLM_PERF_TRANSPORT_REALTIME
+} LLMPerfTransport;
+
+typedef enum {
+    LLM_PERF_CACHE_NONE,  /* the cache was not consulted */
+    LLM_PERF_CACHE_MISS,  /* nothing close enough was cached */
+    LLM_PERF_CACHE_STALE  /* a cached answer was shown while the request ran */
+} LLMPerfCache;
+
+typedef enum {
+    LLM_PERF_ERROR_NONE,
+    LLM_PERF_ERROR_CANCELLED,
+    LLM_PERF_ERROR_CONNECT,  /* name resolution or connection failed */
+    LLM_PERF_ERROR_TIMEOUT,
+    LLM_PERF_ERROR_HTTP,     /* the server answered with an error status */
+    LLM_PERF_ERROR_RESPONSE, /* the answer had no usable content */
+    LLM_PERF_ERROR_OTHER
+} LLMPerfError;
+
+/* One request, as stored on disk in host byte order */
+typedef struct {
+    gint64 start_us;          /* wall clock, microseconds since the epoch */
+    guint32 ttfb_ms;          /* of the first round */
+    guint32 total_ms;
+    guint32 bytes_sent;
+    guint32 bytes_received;
+    guint32 prompt_tokens;
+    guint32 completion_tokens;
+    guint16 http_status;      /* of the last round; 0 for the realtime transport */
+    guint8 transport;         /* LLMPerfTransport */
+    guint8 cache;             /* LLMPerfCache */
+    guint8 error;             /* LLMPerfError */
+    guint8 rounds;            /* model round trips, more than one with tool calls */
+    guint8 reserved[2];
+    gchar model[48];          /* NUL-terminated, truncated if longer */
+    gchar endpoint[64];
+} LLMPerfRecord;
+
+/**
+ * Path of the log, ~/.cache/evolution-llm-assistant/perf.log
+ *
+ * @return Newly allocated path; free with g_free()
+ */
+gchar* llm_perflog_get_path(void);
+
+/**
+ * Append a record to the log. Safe to call from any thread.
+ *
+ * The log is a memory-mapped ring of PERFLOG_CAPACITY records, opened on
+ * first use. Failures to open it are reported once and further records
+ * are dropped.
+ */
+void llm_perflog_append(const LLMPerfRecord *record);
+
+/**
+ * Read every record of a log, oldest first
+ *
+ * @param path Log file to read
+ * @param error Return location for an error
+ * @return Array of LLMPerfRecord, or NULL on error; free with g_array_unref()
+ */
+GArray* llm_perflog_read(const gchar *path, GError **error);
+
+const gchar* llm_perflog_error_name(LLMPerfError error);
+const gchar* llm_perflog_cache_name(LLMPerfCache cache);
+
+#endif /* LLM_PERFLOG_H */
@@ -0,0 +1,673 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Realtime transport. One WebSocket connection to a realtime endpoint is
+ * kept open by a session thread; generations are queued to it and sent as
+ * out-of-band text responses, so each one costs a single small frame
+ * instead of a new HTTP request. Several responses run on the connection
+ * at once; server events are routed to their job by response and event id.
+ */
+
+#include "llm_realtime.h"
+#include "llm_metrics.h"
+#include <curl/curl.h>
+#include <json-glib/json-glib.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#ifdef CURLWS_TEXT
+
+typedef struct {
+    /* Set by the caller, which blocks until the job is finished */
+    gchar *url;
+    gchar *api_key;
+    const gchar *system_prompt;
+    const gchar *user_prompt;
+    gint max_tokens;
+    LLMRequest *request;
+    GCancellable *cancellable;
+
+    /* Set by the session thread */
+    gchar job_id[16];   /* event id of the response.create, and the response's metadata */
+    gchar *response_id; /* once the server created the response */
+    GString *content;
+    gint64 sent_time;
+    gint64 ttfb_ms;
+    gboolean started;
+    gboolean retried;
+    gboolean success;
+
+    GMutex mutex;
+    GCond cond;
+    gboolean finished;
+} RealtimeJob;
+
+struct _LLMRealtime {
+    GAsyncQueue *jobs;
+    gint wakeup_fd;
+
+    /* Owned by the session thread */
+    CURL *curl;
+    curl_socket_t socket;
+    gchar *connected_url;
+    gchar *connected_key;
+    GQueue *waiting;    /* jobs not sent yet, oldest first */
+    GPtrArray *active;  /* jobs sent and not finished, oldest first */
+    GString *message;   /* fragments of an incoming message */
+    JsonParser *parser;
+    guint next_job_id;
+    gint64 retry_time;  /* no connection attempts before this time */
+    guint retry_delay_ms;
+};
+
+static void wake(LLMRealtime *realtime) {
+    guint64 one = 1;
+    if (write(realtime->wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        g_warning("LLM Realtime: eventfd write failed: %s", g_strerror(errno));
+    }
+}
+
+static void on_cancelled(GCancellable *cancellable G_GNUC_UNUSED, LLMRealtime *realtime) {
+    wake(realtime);
+}
+
+static void disconnect(LLMRealtime *realtime) {
+    if (realtime->curl) {
+        curl_easy_cleanup(realtime->curl);
+        realtime->curl = NULL;
+    }
+    g_clear_pointer(&realtime->connected_url, g_free);
+    g_clear_pointer(&realtime->connected_key, g_free);
+    g_string_truncate(realtime->message, 0);
+}
+
+static gboolean is_connected_for(LLMRealtime *realtime, RealtimeJob *job) {
+    return realtime->curl &&
+           g_strcmp0(realtime->connected_url, job->url) == 0 &&
+           g_strcmp0(realtime->connected_key, job->api_key) == 0;
+}
+
+static gboolean connect_session(LLMRealtime *realtime, RealtimeJob *job) {
+    if (is_connected_for(realtime, job)) return TRUE;
+
+    disconnect(realtime);
+
+    /* While backing off, callers fall back to HTTP instead of waiting */
+    if (g_get_monotonic_time() < realtime->retry_time) return FALSE;
+
+    llm_client_global_init();
+    CURL *curl = curl_easy_init();
+    if (!curl) return FALSE;
+
+    struct curl_slist *headers = NULL;
+    gchar *auth_header = g_strdup_printf("Authorization: Bearer %s", job->api_key);
+    headers = curl_slist_append(headers, auth_header);
+    headers = curl_slist_append(headers, "OpenAI-Beta: realtime=v1");
+
+    curl_easy_setopt(curl, CURLOPT_URL, job->url);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_CONNECT_ONLY, 2L); /* WebSocket upgrade, then hand over */
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)REALTIME_CONNECT_TIMEOUT_S);
+
+    CURLcode res = curl_easy_perform(curl);
+
+    curl_slist_free_all(headers);
+    g_free(auth_header);
+
+    if (res != CURLE_OK) {
+        g_warning("LLM Realtime: Cannot connect to %s: %s", job->url, curl_easy_strerror(res));
+        curl_easy_cleanup(curl);
+
+        realtime->retry_delay_ms = realtime->retry_delay_ms ?
+                                   MIN(realtime->retry_delay_ms * 2, REALTIME_RETRY_MAX_MS) :
+                                   REALTIME_RETRY_MIN_MS;
+        realtime->retry_time = g_get_monotonic_time() + (gint64)realtime->retry_delay_ms * 1000;
+        return FALSE;
+    }
+
+    curl_easy_getinfo(curl, CURLINFO_ACTIVESOCKET, &realtime->socket);
+    realtime->curl = curl;
+    realtime->connected_url = g_strdup(job->url);
+    realtime->connected_key = g_strdup(job->api_key);
+    realtime->retry_delay_ms = 0;
+    realtime->retry_time = 0;
+
+    llm_metrics_add(LLM_METRIC_REALTIME_CONNECTS, 1);
+    g_print("LLM Realtime: Connected to %s\n", job->url);
+    return TRUE;
+}
+
+static gboolean send_text(LLMRealtime *realtime, const gchar *text) {
+    gsize length = strlen(text);
+    gsize offset = 0;
+
+    while (offset < length) {
+        size_t sent = 0;
+        CURLcode res = curl_ws_send(realtime->curl, text + offset, length - offset, &sent, 0, CURLWS_TEXT);
+        offset += sent;
+
+        if (res == CURLE_AGAIN) {
+            struct pollfd fd = { realtime->socket, POLLOUT, 0 };
+            poll(&fd, 1, 1000);
+        } else if (res != CURLE_OK) {
+            g_warning("LLM Realtime: Send failed: %s", curl_easy_strerror(res));
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* An out-of-band response: it does not touch the session's conversation,
+ * so generations running side by side do not see each other */
+static gchar* build_response_event(RealtimeJob *job) {
+    JsonBuilder *builder = json_builder_new();
+
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "response.create");
+    /* Errors about this event name it, so they reach the right job */
+    json_builder_set_member_name(builder, "event_id");
+    json_builder_add_string_value(builder, job->job_id);
+    json_builder_set_member_name(builder, "response");
+    json_builder_begin_object(builder);
+
+    json_builder_set_member_name(builder, "conversation");
+    json_builder_add_string_value(builder, "none");
+    json_builder_set_member_name(builder, "metadata");
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "job");
+    json_builder_add_string_value(builder, job->job_id);
+    json_builder_end_object(builder);
+
+    json_builder_set_member_name(builder, "modalities");
+    json_builder_begin_array(builder);
+    json_builder_add_string_value(builder, "text");
+    json_builder_end_array(builder);
+
+    json_builder_set_member_name(builder, "instructions");
+    json_builder_add_string_value(builder, job->system_prompt);
+    json_builder_set_member_name(builder, "max_output_tokens");
+    json_builder_add_int_value(builder, job->max_tokens);
+    json_builder_set_member_name(builder, "temperature");
+    json_builder_add_double_value(builder, 0.7);
+
+    json_builder_set_member_name(builder, "input");
+    json_builder_begin_array(builder);
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "message");
+    json_builder_set_member_name(builder, "role");
+    json_builder_add_string_value(builder, "user");
+    json_builder_set_member_name(builder, "content");
+    json_builder_begin_array(builder);
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "input_text");
+    json_builder_set_member_name(builder, "text");
+    json_builder_add_string_value(builder, job->user_prompt);
+    json_builder_end_object(builder);
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+    json_builder_end_array(builder);
+
+    json_builder_end_object(builder);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    gchar *event = json_generator_to_data(generator, NULL);
+
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+
+    return event;
+}
+
+/* Wake the caller of a job that is in neither the waiting queue nor the
+ * active list */
+static void finish_job(RealtimeJob *job, gboolean success) {
+    g_clear_pointer(&job->response_id, g_free);
+
+    /* The caller frees the job as soon as it sees it finished */
+    g_mutex_lock(&job->mutex);
+    job->success = success;
+    job->finished = TRUE;
+    g_cond_signal(&job->cond);
+    g_mutex_unlock(&job->mutex);
+}
+
+static void finish_active_job(LLMRealtime *realtime, RealtimeJob *job, gboolean success) {
+    g_ptr_array_remove(realtime->active, job);
+    finish_job(job, success);
+}
+
+static void cancel_active_job(LLMRealtime *realtime, RealtimeJob *job) {
+    if (job->response_id && realtime->curl) {
+        gchar *event = g_strdup_printf("{\"type\":\"response.cancel\",\"response_id\":\"%s\"}",
+                                       job->response_id);
+        send_text(realtime, event);
+        g_free(event);
+    }
+
+    finish_active_job(realtime, job, FALSE);
+}
+
+/* Failing a job leaves the decision what to do instead to the client */
+static gboolean job_is_abandoned(RealtimeJob *job) {
+    return g_cancellable_is_cancelled(job->cancellable) || g_get_monotonic_time() >= job->request->deadline;
+}
+
+static gint64 job_expiry(RealtimeJob *job) {
+    return MIN(job->sent_time + REALTIME_RESPONSE_TIMEOUT_S * G_USEC_PER_SEC, job->request->deadline);
+}
+
+/* Jobs that were sent are resent over a new connection if they had not
+ * produced any text yet and were not resent before; the others fail */
+static void handle_connection_lost(LLMRealtime *realtime) {
+    disconnect(realtime);
+
+    /* Newest first, so the jobs keep their order at the head of the queue */
+    while (realtime->active->len > 0) {
+        RealtimeJob *job = g_ptr_array_index(realtime->active, realtime->active->len - 1);
+        g_ptr_array_remove_index(realtime->active, realtime->active->len - 1);
+
+        if (!job->started && !job->retried) {
+            job->retried = TRUE;
+            g_clear_pointer(&job->response_id, g_free);
+            g_queue_push_head(realtime->waiting, job);
+        } else {
+            finish_job(job, FALSE);
+        }
+    }
+}
+
+static gboolean start_job(LLMRealtime *realtime, RealtimeJob *job) {
+    g_snprintf(job->job_id, sizeof(job->job_id), "job-%u", ++realtime->next_job_id);
+    gchar *event = build_response_event(job);
+
+    gboolean sent = connect_session(realtime, job) && send_text(realtime, event);
+    g_free(event);
+
+    if (sent) {
+        job->sent_time = g_get_monotonic_time();
+        g_ptr_array_add(realtime->active, job);
+    }
+    return sent;
+}
+
+/* Take over newly queued jobs, fail the waiting ones nobody waits for any
+ * more and send as many as the session has room for */
+static void start_waiting_jobs(LLMRealtime *realtime) {
+    RealtimeJob *job;
+
+    while ((job = g_async_queue_try_pop(realtime->jobs)) != NULL) {
+        g_queue_push_tail(realtime->waiting, job);
+    }
+
+    for (GList *link = realtime->waiting->head; link; ) {
+        GList *next = link->next;
+        job = link->data;
+
+        if (job_is_abandoned(job)) {
+            g_queue_delete_link(realtime->waiting, link);
+            finish_job(job, FALSE);
+        }
+        link = next;
+    }
+
+    while (realtime->active->len < REALTIME_MAX_IN_FLIGHT &&
+           (job = g_queue_peek_head(realtime->waiting)) != NULL) {
+        /* A job for another endpoint or key waits until the session is idle */
+        if (realtime->active->len > 0 && !is_connected_for(realtime, job)) break;
+
+        g_queue_pop_head(realtime->waiting);
+        if (start_job(realtime, job)) continue;
+
+        if (!realtime->curl) {
+            /* No connection could be made */
+            finish_job(job, FALSE);
+        } else {
+            /* The server may have closed an idle connection without us noticing */
+            handle_connection_lost(realtime);
+            if (!job->retried) {
+                job->retried = TRUE;
+                g_queue_push_head(realtime->waiting, job);
+            } else {
+                finish_job(job, FALSE);
+            }
+        }
+    }
+}
+
+static RealtimeJob* find_job(LLMRealtime *realtime, const gchar *job_id) {
+    for (guint i = 0; job_id && i < realtime->active->len; i++) {
+        RealtimeJob *job = g_ptr_array_index(realtime->active, i);
+        if (g_str_equal(job->job_id, job_id)) return job;
+    }
+    return NULL;
+}
+
+static RealtimeJob* find_job_by_response(LLMRealtime *realtime, const gchar *response_id) {
+    for (guint i = 0; response_id && i < realtime->active->len; i++) {
+        RealtimeJob *job = g_ptr_array_index(realtime->active, i);
+        if (g_strcmp0(job->response_id, response_id) == 0) return job;
+    }
+    return NULL;
+}
+
+static JsonObject* get_object_member(JsonObject *object, const gchar *name) {
+    if (!object || !json_object_has_member(object, name)) return NULL;
+
+    JsonNode *node = json_object_get_member(object, name);
+    return JSON_NODE_HOLDS_OBJECT(node) ? json_node_get_object(node) : NULL;
+}
+
+static void handle_error_event(LLMRealtime *realtime, JsonObject *event) {
+    JsonObject *error = get_object_member(event, "error");
+    const gchar *event_id = error ? json_object_get_string_member_with_default(error, "event_id", NULL) : NULL;
+
+    g_warning("LLM Realtime: %s",
+              error ? json_object_get_string_member_with_default(error, "message", "unknown error") :
+                      "unknown error");
+
+    RealtimeJob *job = find_job(realtime, event_id);
+    if (job) {
+        cancel_active_job(realtime, job);
+        return;
+    }
+
+    /* An error that names no job of ours fails the jobs that have not
+     * produced any text, which the client then sends over HTTP; newest
+     * first, as cancelling removes them from the list */
+    for (guint i = realtime->active->len; i > 0; i--) {
+        job = g_ptr_array_index(realtime->active, i - 1);
+        if (!job->started) cancel_active_job(realtime, job);
+    }
+}
+
+static void handle_event(LLMRealtime *realtime, const gchar *data, gsize length) {
+    if (!json_parser_load_from_data(realtime->parser, data, length, NULL)) return;
+
+    JsonNode *root = json_parser_get_root(realtime->parser);
+    JsonObject *event = root && JSON_NODE_HOLDS_OBJECT(root) ? json_node_get_object(root) : NULL;
+    if (!event) return;
+
+    const gchar *type = json_object_get_string_member_with_default(event, "type", "");
+
+    if (g_str_equal(type, "error")) {
+        handle_error_event(realtime, event);
+        return;
+    }
+
+    if (g_str_equal(type, "response.created")) {
+        JsonObject *response = get_object_member(event, "response");
+        JsonObject *metadata = get_object_member(response, "metadata");
+        if (!response) return;
+
+        /* Responses are tagged with their job; an untagged one is taken to
+         * belong to the oldest job still waiting for its response */
+        const gchar *job_id = metadata ? json_object_get_string_member_with_default(metadata, "job", NULL) : NULL;
+        RealtimeJob *job = find_job(realtime, job_id);
+        for (guint i = 0; !job_id && !job && i < realtime->active->len; i++) {
+            RealtimeJob *candidate = g_ptr_array_index(realtime->active, i);
+            if (!candidate->response_id) job = candidate;
+        }
+
+        if (job) {
+            g_free(job->response_id);
+            job->response_id = g_strdup(json_object_get_string_member_with_default(response, "id", ""));
+        }
+        return;
+    }
+
+    if (g_str_equal(type, "response.text.delta") || g_str_equal(type, "response.output_text.delta")) {
+        RealtimeJob *job = find_job_by_response(realtime,
+            json_object_get_string_member_with_default(event, "response_id", NULL));
+        const gchar *delta = json_object_get_string_member_with_default(event, "delta", NULL);
+        if (!job || !delta || !*delta) return;
+
+        if (!job->started) {
+            job->started = TRUE;
+            job->ttfb_ms = (g_get_monotonic_time() - job->sent_time) / 1000;
+            llm_metrics_add(LLM_METRIC_REALTIME_TTFB_MS, job->ttfb_ms);
+            llm_metrics_observe(LLM_HISTOGRAM_TTFB, job->ttfb_ms);
+        }
+
+        g_string_append(job->content, delta);
+        if (job->request->token_queue) {
+            llm_token_queue_push(job->request->token_queue, delta, strlen(delta));
+        }
+    } else if (g_str_equal(type, "response.done")) {
+        JsonObject *response = get_object_member(event, "response");
+        RealtimeJob *job = response ?
+            find_job_by_response(realtime, json_object_get_string_member_with_default(response, "id", NULL)) :
+            NULL;
+        if (!job) return;
+
+        JsonObject *usage = get_object_member(response, "usage");
+        if (usage) {
+            job->request->prompt_tokens = json_object_get_int_member_with_default(usage, "input_tokens", 0);
+            job->request->completion_tokens = json_object_get_int_member_with_default(usage, "output_tokens", 0);
+
+            JsonObject *details = get_object_member(usage, "input_token_details");
+            if (details) {
+                job->request->cached_tokens = json_object_get_int_member_with_default(details, "cached_tokens", 0);
+            }
+        }
+
+        const gchar *status = json_object_get_string_member_with_default(response, "status", "");
+        if (!g_str_equal(status, "completed")) {
+            g_warning("LLM Realtime: Response ended with status '%s'", status);
+        }
+
+        finish_active_job(realtime, job, g_str_equal(status, "completed") && job->content->len > 0);
+    }
+}
+
+static void read_messages(LLMRealtime *realtime) {
+    gchar buffer[16384];
+
+    while (realtime->curl) {
+        size_t received = 0;
+        const struct curl_ws_frame *frame = NULL;
+        CURLcode res = curl_ws_recv(realtime->curl, buffer, sizeof(buffer), &received, &frame);
+
+        if (res == CURLE_AGAIN) return;
+
+        if (res != CURLE_OK || (frame->flags & CURLWS_CLOSE)) {
+            g_print("LLM Realtime: Connection closed (%s)\n",
+                    res != CURLE_OK ? curl_easy_strerror(res) : "by server");
+            handle_connection_lost(realtime);
+            return;
+        }
+
+        /* libcurl answers pings itself */
+        if (frame->flags & (CURLWS_PING | CURLWS_PONG)) continue;
+
+        g_string_append_len(realtime->message, buffer, received);
+
+        if (frame->bytesleft == 0 && !(frame->flags & CURLWS_CONT)) {
+            handle_event(realtime, realtime->message->str, realtime->message->len);
+            g_string_truncate(realtime->message, 0);
+        }
+    }
+}
+
+static gpointer session_thread(gpointer user_data) {
+    LLMRealtime *realtime = user_data;
+
+    for (;;) {
+        start_waiting_jobs(realtime);
+
+        /* Wake up for the earliest expiry of any job, sent or waiting */
+        gint64 next = G_MAXINT64;
+        for (guint i = 0; i < realtime->active->len; i++) {
+            next = MIN(next, job_expiry(g_ptr_array_index(realtime->active, i)));
+        }
+        for (GList *link = realtime->waiting->head; link; link = link->next) {
+            next = MIN(next, ((RealtimeJob *)link->data)->request->deadline);
+        }
+
+        struct pollfd fds[2] = {
+            { realtime->wakeup_fd, POLLIN, 0 },
+            { realtime->curl ? realtime->socket : -1, POLLIN, 0 },
+        };
+
+        gint timeout_ms = -1;
+        if (next != G_MAXINT64) {
+            timeout_ms = (gint)CLAMP((next - g_get_monotonic_time() + 999) / 1000, 0, G_MAXINT);
+        }
+
+        if (poll(fds, G_N_ELEMENTS(fds), timeout_ms) < 0 && errno != EINTR) {
+            g_warning("LLM Realtime: poll failed: %s", g_strerror(errno));
+            g_usleep(G_USEC_PER_SEC);
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            guint64 value;
+            if (read(realtime->wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                g_warning("LLM Realtime: eventfd read failed: %s", g_strerror(errno));
+            }
+        }
+
+        /* Newest first, as cancelling removes a job from the list */
+        gint64 now = g_get_monotonic_time();
+        for (guint i = realtime->active->len; i > 0; i--) {
+            RealtimeJob *job = g_ptr_array_index(realtime->active, i - 1);
+
+            if (g_cancellable_is_cancelled(job->cancellable)) {
+                cancel_active_job(realtime, job);
+            } else if (now >= job_expiry(job)) {
+                g_warning("LLM Realtime: No response before the deadline or within %d seconds",
+                          REALTIME_RESPONSE_TIMEOUT_S);
+                cancel_active_job(realtime, job);
+            }
+        }
+
+        if (realtime->curl && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            read_messages(realtime);
+        }
+    }
+
+    return NULL;
+}
+
+LLMRealtime* llm_realtime_get_default(void) {
+    static LLMRealtime *realtime = NULL;
+
+    if (g_once_init_enter(&realtime)) {
+        LLMRealtime *instance = g_new0(LLMRealtime, 1);
+        instance->jobs = g_async_queue_new();
+        instance->waiting = g_queue_new();
+        instance->active = g_ptr_array_new();
+        instance->message = g_string_new(NULL);
+        instance->parser = json_parser_new();
+        instance->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (instance->wakeup_fd < 0) {
+            g_warning("LLM Realtime: eventfd failed: %s", g_strerror(errno));
+        } else {
+            g_thread_unref(g_thread_new("llm-realtime", session_thread, instance));
+        }
+
+        g_once_init_leave(&realtime, instance);
+    }
+
+    return realtime;
+}
+
+gboolean llm_realtime_generate(LLMRealtime *realtime,
+                               PluginConfig *config,
+                               LLMRequest *request,
+                               const gchar *system_prompt,
+                               const gchar *user_prompt,
+                               gint max_tokens,
+                               GCancellable *cancellable,
+                               gboolean *started,
+                               gint64 *ttfb_ms) {
+    *started = FALSE;
+    *ttfb_ms = 0;
+    if (!realtime || realtime->wakeup_fd < 0 || !config->openai_api_key) return FALSE;
+
+    gchar *model = g_uri_escape_string(config->realtime_model, NULL, FALSE);
+
+    RealtimeJob job = {0};
+    job.url = g_strdup_printf("%s%smodel=%s", config->realtime_url,
+                              strchr(config->realtime_url, '?') ? "&" : "?", model);
+    job.api_key = g_strdup(config->openai_api_key);
+    job.system_prompt = system_prompt;
+    job.user_prompt = user_prompt;
+    job.max_tokens = max_tokens;
+    job.request = request;
+    job.cancellable = cancellable;
+    job.content = g_string_new(NULL);
+    g_mutex_init(&job.mutex);
+    g_cond_init(&job.cond);
+
+    gulong handler = cancellable ?
+                     g_cancellable_connect(cancellable, G_CALLBACK(on_cancelled), realtime, NULL) : 0;
+
+    llm_metrics_add(LLM_METRIC_REALTIME_REQUESTS, 1);
+    g_async_queue_push(realtime->jobs, &job);
+    wake(realtime);
+
+    g_mutex_lock(&job.mutex);
+    while (!job.finished) g_cond_wait(&job.cond, &job.mutex);
+    g_mutex_unlock(&job.mutex);
+
+    if (handler) g_cancellable_disconnect(cancellable, handler);
+
+    if (job.success) {
+        request->response = g_strdup(job.content->str);
+        g_strstrip(request->response);
+    }
+    *started = job.started;
+    *ttfb_ms = job.ttfb_ms;
+
+    g_mutex_clear(&job.mutex);
+    g_cond_clear(&job.cond);
+    g_string_free(job.content, TRUE);
+    g_free(job.url);
+    g_free(job.api_key);
+    g_free(model);
+
+    return job.success;
+}
+
+#else /* !CURLWS_TEXT */
+
+/* libcurl without WebSocket support: every request goes over HTTP */
+LLMRealtime* llm_realtime_get_default(void) {
+    return NULL;
+}
+
+gboolean llm_realtime_generate(LLMRealtime *realtime G_GNUC_UNUSED,
+                               PluginConfig *config G_GNUC_UNUSED,
+                               LLMRequest *request G_GNUC_UNUSED,
+                               const gchar *system_prompt G_GNUC_UNUSED,
+                               const gchar *user_prompt G_GNUC_UNUSED,
+                               gint max_tokens G_GNUC_UNUSED,
+                               GCancellable *cancellable G_GNUC_UNUSED,
+                               gboolean *started,
+                               gint64 *ttfb_ms) {
+    g_warning("LLM Realtime: libcurl was built without WebSocket support");
+    *started = FALSE;
+    *ttfb_ms = 0;
+    return FALSE;
+}
+
+#endif /* CURLWS_TEXT */
@@ -0,0 +1,65 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_REALTIME_H
+#define LLM_REALTIME_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "llm_client.h"
+
+#define REALTIME_CONNECT_TIMEOUT_S 10
+#define REALTIME_RESPONSE_TIMEOUT_S 30 /* same limit as an HTTP request */
+#define REALTIME_RETRY_MIN_MS 500      /* first reconnection delay after a failure */
+#define REALTIME_RETRY_MAX_MS 30000
+#define REALTIME_MAX_IN_FLIGHT 4       /* responses running on the session at once */
+
+typedef struct _LLMRealtime LLMRealtime;
+
+/**
+ * Get the WebSocket session shared by all composer windows
+ *
+ * The session is owned by a background thread that connects on first use,
+ * runs up to REALTIME_MAX_IN_FLIGHT generations at once over the same
+ * connection and reconnects after the connection dropped.
+ *
+ * @return The shared instance, owned by the plugin
+ */
+LLMRealtime* llm_realtime_get_default(void);
+
+/**
+ * Generate a response over the session; blocks until it is done
+ *
+ * Text is streamed into request->token_queue when it is set. While the
+ * session is backing off after failed connection attempts the call fails
+ * immediately; a call that waits for room on the session fails as soon as
+ * it is cancelled or its deadline passes.
+ *
+ * @param config Plugin configuration with the API key and realtime endpoint
+ * @param system_prompt Instructions for the response
+ * @param user_prompt The user message
+ * @param max_tokens Longest answer the response may have
+ * @param started Set to TRUE once any text was delivered; a request that
+ *                failed without text can safely be sent another way
+ * @param ttfb_ms Set to the time from sending to the first text, or 0
+ * @return TRUE if request->response was set
+ */
+gboolean llm_realtime_generate(LLMRealtime *realtime,
+                               PluginConfig *config,
+                               LLMRequest *request,
+                               const gchar *system_prompt,
+                               const gchar *user_prompt,
+                               gint max_tokens,
+                               GCancellable *cancellable,
+                               gboolean *started,
+                               gint64 *ttfb_ms);
+
+#endif /* LLM_REALTIME_H */
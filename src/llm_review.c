@@ -0,0 +1,396 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Background pre-send review. While a draft is written its paragraphs are
+ * checked one at a time for their tone and for which questions of the quoted
+ * message they answer. Reviews are cached by paragraph hash, so an edit only
+ * sends the paragraphs it changed, and the verdict at send time is put
+ * together from what is already known.
+ */
+
+#include "llm_review.h"
+#include "llm_client.h"
+#include "llm_metrics.h"
+#include "../config/config.h"
+#include <json-glib/json-glib.h>
+#include <string.h>
+
+typedef struct {
+    guint64 answered; /* bit n-1 for question n */
+    gchar *tone;      /* NULL if the tone is fine */
+    gint64 last_used; /* monotonic time */
+} ReviewEntry;
+
+typedef struct {
+    gchar *key;
+    gchar *model;
+    gchar *prompt;
+} ReviewTask;
+
+struct _LLMReview {
+    GMutex mutex;
+    GHashTable *entries;   /* key -> ReviewEntry */
+    GHashTable *in_flight; /* keys queued or being reviewed */
+    GThreadPool *pool;
+};
+
+struct _LLMReviewDraft {
+    gchar *model;
+    GPtrArray *paragraphs;
+    GPtrArray *keys;
+    gboolean *mentions_attachment;
+    GPtrArray *questions;
+    gchar *questions_prompt; /* the numbered questions as sent to the model */
+};
+
+/* Words that announce an attachment in the text */
+static const gchar *attachment_words[] = { "attach", "enclos" };
+
+static void review_entry_free(ReviewEntry *entry) {
+    g_free(entry->tone);
+    g_free(entry);
+}
+
+static void review_task_free(ReviewTask *task) {
+    g_free(task->key);
+    g_free(task->model);
+    g_free(task->prompt);
+    g_free(task);
+}
+
+static gchar* make_key(const gchar *model, const gchar *questions, const gchar *paragraph) {
+    const gchar *parts[] = { model, questions, paragraph };
+
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    for (gsize i = 0; i < G_N_ELEMENTS(parts); i++) {
+        g_checksum_update(checksum, (const guchar *)parts[i], strlen(parts[i]) + 1);
+    }
+
+    gchar *key = g_strdup(g_checksum_get_string(checksum));
+    g_checksum_free(checksum);
+    return key;
+}
+
+static ReviewEntry* parse_review(const gchar *response) {
+    JsonParser *parser = json_parser_new();
+    ReviewEntry *entry = NULL;
+
+    if (response && json_parser_load_from_data(parser, response, -1, NULL) &&
+        JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser))) {
+        JsonObject *root_obj = json_node_get_object(json_parser_get_root(parser));
+        JsonNode *answers = json_object_get_member(root_obj, "answers");
+        JsonNode *tone = json_object_get_member(root_obj, "tone");
+
+        entry = g_new0(ReviewEntry, 1);
+
+        JsonArray *array = answers && JSON_NODE_HOLDS_ARRAY(answers) ? json_node_get_array(answers) : NULL;
+        for (guint i = 0; array && i < json_array_get_length(array); i++) {
+            JsonNode *element = json_array_get_element(array, i);
+            gint64 number = JSON_NODE_HOLDS_VALUE(element) ? json_node_get_int(element) : 0;
+            if (number >= 1 && number <= REVIEW_MAX_QUESTIONS) {
+                entry->answered |= G_GUINT64_CONSTANT(1) << (number - 1);
+            }
+        }
+
+        const gchar *note = tone && JSON_NODE_HOLDS_VALUE(tone) ? json_node_get_string(tone) : NULL;
+        if (note && *note) {
+            entry->tone = g_strstrip(g_strdup(note));
+        }
+    }
+
+    g_object_unref(parser);
+    return entry;
+}
+
+static void evict_least_recently_used_locked(LLMReview *review) {
+    while (g_hash_table_size(review->entries) > REVIEW_MAX_ENTRIES) {
+        GHashTableIter iter;
+        gpointer key, value;
+        gpointer oldest_key = NULL;
+        gint64 oldest = G_MAXINT64;
+
+        g_hash_table_iter_init(&iter, review->entries);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            ReviewEntry *entry = value;
+            if (entry->last_used < oldest) {
+                oldest = entry->last_used;
+                oldest_key = key;
+            }
+        }
+
+        g_hash_table_remove(review->entries, oldest_key);
+    }
+}
+
+/* Runs in a pool thread */
+static void review_paragraph(gpointer data, gpointer user_data) {
+    ReviewTask *task = data;
+    LLMReview *review = user_data;
+    PluginConfig *config = config_load();
+    LLMClient *client = llm_client_new(config);
+    ReviewEntry *entry = NULL;
+
+    if (client) {
+        LLMRequest *request = llm_request_new();
+        request->prompt = g_strdup(task->prompt);
+        request->model = g_strdup(task->model);
+        request->system_prompt = g_strdup(REVIEW_SYSTEM_PROMPT);
+        request->work_class = LLM_WORK_BATCH;
+        request->json_output = TRUE;
+        /* A slow review is overtaken by the next edit anyway */
+        request->deadline = g_get_monotonic_time() + (gint64)REVIEW_DEADLINE_S * G_USEC_PER_SEC;
+
+        if (llm_client_generate_response(client, request)) {
+            entry = parse_review(request->response);
+        }
+        if (!entry) {
+            g_warning("LLM Review: No usable review of a paragraph");
+        }
+
+        llm_request_free(request);
+        llm_client_free(client);
+    }
+    config_free(config);
+
+    g_mutex_lock(&review->mutex);
+    g_hash_table_remove(review->in_flight, task->key);
+    if (entry) {
+        entry->last_used = g_get_monotonic_time();
+        g_hash_table_replace(review->entries, g_strdup(task->key), entry);
+        evict_least_recently_used_locked(review);
+    }
+    g_mutex_unlock(&review->mutex);
+
+    review_task_free(task);
+}
+
+LLMReview* llm_review_get_default(void) {
+    static LLMReview *review = NULL;
+
+    if (g_once_init_enter(&review)) {
+        LLMReview *instance = g_new0(LLMReview, 1);
+        g_mutex_init(&instance->mutex);
+        instance->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                  (GDestroyNotify)review_entry_free);
+        instance->in_flight = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        instance->pool = g_thread_pool_new(review_paragraph, instance, REVIEW_MAX_PARALLEL, FALSE, NULL);
+
+        g_once_init_leave(&review, instance);
+    }
+
+    return review;
+}
+
+/* Paragraphs end at blank lines */
+static GPtrArray* split_paragraphs(const gchar *text) {
+    GPtrArray *paragraphs = g_ptr_array_new_with_free_func(g_free);
+    gchar **lines = g_strsplit(text ? text : "", "\n", -1);
+    GString *current = g_string_new(NULL);
+
+    for (gchar **line = lines; ; line++) {
+        gboolean blank = !*line || strspn(*line, " \t\r") == strlen(*line);
+
+        if (!blank) {
+            if (current->len > 0) g_string_append_c(current, '\n');
+            g_string_append(current, *line);
+        } else if (current->len > 0) {
+            g_ptr_array_add(paragraphs, g_strstrip(g_strdup(current->str)));
+            g_string_truncate(current, 0);
+        }
+
+        if (!*line) break;
+    }
+
+    g_string_free(current, TRUE);
+    g_strfreev(lines);
+    return paragraphs;
+}
+
+/* Sentences of the quoted message that end in a question mark. Quoted
+ * plain text is wrapped, so only blank lines end a sentence besides its
+ * punctuation; single line breaks and quote markers become spaces. */
+static GPtrArray* collect_questions(const gchar *quoted) {
+    GPtrArray *questions = g_ptr_array_new_with_free_func(g_free);
+    if (!quoted) return questions;
+
+    GString *sentence = g_string_new(NULL);
+    gboolean line_start = TRUE;
+
+    for (const gchar *p = quoted; *p && questions->len < REVIEW_MAX_QUESTIONS; p++) {
+        if (*p == '\n') {
+            /* A line with nothing but quote markers and spaces is blank */
+            const gchar *next = p + 1;
+            while (*next == '>' || *next == ' ' || *next == '\t' || *next == '\r') next++;
+            if (*next == '\n' || !*next) {
+                g_string_truncate(sentence, 0);
+                p = next - 1;
+            } else if (sentence->len > 0 && sentence->str[sentence->len - 1] != ' ') {
+                g_string_append_c(sentence, ' ');
+            }
+            line_start = TRUE;
+            continue;
+        }
+
+        if (line_start && (*p == '>' || *p == ' ' || *p == '\t' || *p == '\r')) continue;
+        line_start = FALSE;
+
+        if (*p == '.' || *p == '!') {
+            g_string_truncate(sentence, 0);
+            continue;
+        }
+
+        g_string_append_c(sentence, *p == '\t' || *p == '\r' ? ' ' : *p);
+        if (*p != '?') continue;
+
+        gchar *question = g_strstrip(g_strdup(sentence->str));
+        g_string_truncate(sentence, 0);
+
+        gboolean seen = FALSE;
+        for (guint i = 0; i < questions->len && !seen; i++) {
+            seen = g_strcmp0(g_ptr_array_index(questions, i), question) == 0;
+        }
+
+        if (strlen(question) > 1 && !seen) {
+            g_ptr_array_add(questions, question);
+        } else {
+            g_free(question);
+        }
+    }
+
+    g_string_free(sentence, TRUE);
+    return questions;
+}
+
+LLMReviewDraft* llm_review_draft_new(const gchar *model, const gchar *text, const gchar *quoted) {
+    LLMReviewDraft *draft = g_new0(LLMReviewDraft, 1);
+    draft->model = g_strdup(model);
+    draft->paragraphs = split_paragraphs(text);
+    draft->keys = g_ptr_array_new_with_free_func(g_free);
+    draft->mentions_attachment = g_new0(gboolean, draft->paragraphs->len);
+    draft->questions = collect_questions(quoted);
+
+    GString *questions_prompt = g_string_new(NULL);
+    for (guint i = 0; i < draft->questions->len; i++) {
+        g_string_append_printf(questions_prompt, "%u. %s\n", i + 1,
+                               (const gchar *)g_ptr_array_index(draft->questions, i));
+    }
+    draft->questions_prompt = g_string_free(questions_prompt, FALSE);
+
+    for (guint i = 0; i < draft->paragraphs->len; i++) {
+        const gchar *paragraph = g_ptr_array_index(draft->paragraphs, i);
+        gchar *lower = g_utf8_strdown(paragraph, -1);
+
+        for (gsize j = 0; j < G_N_ELEMENTS(attachment_words) && !draft->mentions_attachment[i]; j++) {
+            draft->mentions_attachment[i] = strstr(lower, attachment_words[j]) != NULL;
+        }
+        g_ptr_array_add(draft->keys, make_key(draft->model, draft->questions_prompt, paragraph));
+        g_free(lower);
+    }
+
+    return draft;
+}
+
+void llm_review_draft_free(LLMReviewDraft *draft) {
+    if (!draft) return;
+
+    g_free(draft->model);
+    g_ptr_array_unref(draft->paragraphs);
+    g_ptr_array_unref(draft->keys);
+    g_free(draft->mentions_attachment);
+    g_ptr_array_unref(draft->questions);
+    g_free(draft->questions_prompt);
+    g_free(draft);
+}
+
+guint llm_review_submit(LLMReview *review, LLMReviewDraft *draft) {
+    guint queued = 0;
+
+    g_mutex_lock(&review->mutex);
+    for (guint i = 0; i < draft->keys->len; i++) {
+        const gchar *key = g_ptr_array_index(draft->keys, i);
+        if (g_hash_table_contains(review->entries, key) || g_hash_table_contains(review->in_flight, key)) {
+            continue;
+        }
+
+        ReviewTask *task = g_new0(ReviewTask, 1);
+        task->key = g_strdup(key);
+        task->model = g_strdup(draft->model);
+        task->prompt = g_strdup_printf("Questions:\n%s\nParagraph:\n%s",
+                                       *draft->questions_prompt ? draft->questions_prompt : "none\n",
+                                       (const gchar *)g_ptr_array_index(draft->paragraphs, i));
+
+        g_hash_table_add(review->in_flight, g_strdup(key));
+        g_thread_pool_push(review->pool, task, NULL);
+        queued++;
+    }
+    g_mutex_unlock(&review->mutex);
+
+    llm_metrics_add(LLM_METRIC_REVIEW_PARAGRAPHS, draft->keys->len);
+    llm_metrics_add(LLM_METRIC_REVIEW_PARAGRAPHS_SENT, queued);
+    if (queued > 0) {
+        g_print("LLM Review: %u of %u paragraphs changed\n", queued, draft->keys->len);
+    }
+
+    return queued;
+}
+
+LLMReviewVerdict* llm_review_get_verdict(LLMReview *review, LLMReviewDraft *draft, gboolean has_attachments) {
+    LLMReviewVerdict *verdict = g_new0(LLMReviewVerdict, 1);
+    GPtrArray *tone = g_ptr_array_new();
+    GPtrArray *unanswered = g_ptr_array_new();
+    gboolean mentions_attachment = FALSE;
+    guint64 answered = 0;
+    gint64 now = g_get_monotonic_time();
+
+    g_mutex_lock(&review->mutex);
+    for (guint i = 0; i < draft->keys->len; i++) {
+        mentions_attachment |= draft->mentions_attachment[i];
+
+        ReviewEntry *entry = g_hash_table_lookup(review->entries, g_ptr_array_index(draft->keys, i));
+        if (!entry) {
+            verdict->n_pending++;
+            continue;
+        }
+
+        entry->last_used = now;
+        answered |= entry->answered;
+        if (entry->tone) {
+            g_ptr_array_add(tone, g_strdup_printf("Paragraph %u: %s", i + 1, entry->tone));
+        }
+    }
+    g_mutex_unlock(&review->mutex);
+
+    /* A paragraph not reviewed yet may still answer a question */
+    for (guint i = 0; verdict->n_pending == 0 && i < draft->questions->len; i++) {
+        if (!(answered & (G_GUINT64_CONSTANT(1) << i))) {
+            g_ptr_array_add(unanswered, g_strdup(g_ptr_array_index(draft->questions, i)));
+        }
+    }
+
+    g_ptr_array_add(tone, NULL);
+    g_ptr_array_add(unanswered, NULL);
+    verdict->tone = (gchar **)g_ptr_array_free(tone, FALSE);
+    verdict->unanswered = (gchar **)g_ptr_array_free(unanswered, FALSE);
+    verdict->missing_attachment = mentions_attachment && !has_attachments;
+
+    return verdict;
+}
+
+gboolean llm_review_verdict_is_clean(LLMReviewVerdict *verdict) {
+    return !verdict->missing_attachment && !*verdict->unanswered && !*verdict->tone;
+}
+
+void llm_review_verdict_free(LLMReviewVerdict *verdict) {
+    if (!verdict) return;
+
+    g_strfreev(verdict->unanswered);
+    g_strfreev(verdict->tone);
+    g_free(verdict);
+}
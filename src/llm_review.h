@@ -0,0 +1,87 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_REVIEW_H
+#define LLM_REVIEW_H
+
+#include <glib.h>
+
+#define REVIEW_INTERVAL_S 3      /* how often the composer's text is looked at */
+#define REVIEW_DEADLINE_S 60     /* a paragraph's review is of no use after this */
+#define REVIEW_MAX_PARALLEL 2    /* paragraphs reviewed at the same time */
+#define REVIEW_MAX_ENTRIES 1000
+#define REVIEW_MAX_QUESTIONS 16  /* taken from the quoted message */
+
+/* The user prompt numbers the questions "1.", "2.", ... and ends with the paragraph */
+#define REVIEW_SYSTEM_PROMPT \
+    "You check one paragraph of an email draft before it is sent. The numbered " \
+    "questions come from the message being answered. Answer with a JSON object with " \
+    "\"answers\", an array of the numbers of the questions this paragraph answers, and " \
+    "\"tone\", null if the paragraph reads as friendly and professional, or else a few " \
+    "words on what sounds curt, unfriendly or rude."
+
+typedef struct _LLMReview LLMReview;
+typedef struct _LLMReviewDraft LLMReviewDraft;
+
+typedef struct {
+    gboolean missing_attachment; /* the text mentions an attachment the message lacks */
+    gchar **unanswered;          /* questions of the quoted message no paragraph answers */
+    gchar **tone;                /* notes on paragraphs that read as unfriendly */
+    guint n_pending;             /* paragraphs without a review yet */
+} LLMReviewVerdict;
+
+/**
+ * Get the paragraph reviews shared by all composer windows
+ *
+ * Reviews are kept in memory, keyed by a hash of the model, the quoted
+ * message's questions and the paragraph, and requested by a small pool
+ * of worker threads. Safe to use from any thread.
+ *
+ * @return The shared instance, owned by the plugin
+ */
+LLMReview* llm_review_get_default(void);
+
+/**
+ * Split a draft into paragraphs at blank lines and collect the questions
+ * of the message it answers
+ *
+ * @param text The text written so far, without quoted text or signature
+ * @param quoted The quoted message, or NULL
+ */
+LLMReviewDraft* llm_review_draft_new(const gchar *model, const gchar *text, const gchar *quoted);
+void llm_review_draft_free(LLMReviewDraft *draft);
+
+/**
+ * Queue the paragraphs that have neither a review nor one in progress
+ *
+ * Returns at once; the reviews are sent to the draft's model as batch
+ * work, so they are the first to go when a budget runs low.
+ *
+ * @return Paragraphs queued
+ */
+guint llm_review_submit(LLMReview *review, LLMReviewDraft *draft);
+
+/**
+ * Combine the reviews available now into a verdict; never waits for one.
+ * Unanswered questions are only listed once every paragraph is reviewed.
+ *
+ * @param has_attachments Whether the message carries attachments
+ * @return The verdict; free with llm_review_verdict_free()
+ */
+LLMReviewVerdict* llm_review_get_verdict(LLMReview *review, LLMReviewDraft *draft, gboolean has_attachments);
+
+/**
+ * @return TRUE if the verdict found nothing to point out
+ */
+gboolean llm_review_verdict_is_clean(LLMReviewVerdict *verdict);
+void llm_review_verdict_free(LLMReviewVerdict *verdict);
+
+#endif /* LLM_REVIEW_H */
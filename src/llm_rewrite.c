@@ -0,0 +1,415 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Paragraph-wise rewriting and translation. A draft is split at blank lines
+ * and every paragraph is rewritten on its own, with its neighbours as
+ * context, so that after an edit only the paragraphs whose hash changed are
+ * sent again, in parallel, and the rest comes from the cache.
+ */
+
+#include "llm_rewrite.h"
+#include "llm_metrics.h"
+#include "../config/config.h"
+#include <json-glib/json-glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+typedef struct {
+    gchar *text;
+    gint64 last_used; /* seconds since the epoch */
+} RewriteEntry;
+
+struct _LLMRewrite {
+    GMutex mutex;
+    gchar *path;
+    GHashTable *entries; /* key -> RewriteEntry */
+};
+
+struct _LLMRewriteJob {
+    LLMRewrite *rewrite;
+    gchar *model;
+    gchar *instruction;
+    GPtrArray *paragraphs; /* source text */
+    GPtrArray *results;    /* rewritten text, NULL where missing; never resized */
+    gboolean *requested;   /* results that came from the model in this job */
+
+    /* Set for the duration of llm_rewrite_job_run() */
+    LLMClient *client;
+    GCancellable *cancellable;
+    gint64 deadline;
+};
+
+static void rewrite_entry_free(RewriteEntry *entry) {
+    g_free(entry->text);
+    g_free(entry);
+}
+
+/* The model and instruction decide what a paragraph becomes, and its
+ * neighbours how it has to fit in */
+static gchar* make_key(LLMRewriteJob *job, GPtrArray *paragraphs, guint index) {
+    const gchar *parts[] = {
+        job->model,
+        job->instruction,
+        index > 0 ? g_ptr_array_index(paragraphs, index - 1) : "",
+        g_ptr_array_index(paragraphs, index),
+        index + 1 < paragraphs->len ? g_ptr_array_index(paragraphs, index + 1) : "",
+    };
+
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    for (gsize i = 0; i < G_N_ELEMENTS(parts); i++) {
+        /* Including the terminator keeps "ab" + "c" apart from "a" + "bc" */
+        g_checksum_update(checksum, (const guchar *)parts[i], strlen(parts[i]) + 1);
+    }
+
+    gchar *key = g_strdup(g_checksum_get_string(checksum));
+    g_checksum_free(checksum);
+    return key;
+}
+
+static void load_from_file(LLMRewrite *rewrite) {
+    if (!g_file_test(rewrite->path, G_FILE_TEST_EXISTS)) return;
+
+    JsonParser *parser = json_parser_new();
+    GError *error = NULL;
+
+    if (json_parser_load_from_file(parser, rewrite->path, &error)) {
+        JsonObject *root_obj = json_node_get_object(json_parser_get_root(parser));
+        JsonArray *entries = root_obj && json_object_has_member(root_obj, "entries")
+            ? json_object_get_array_member(root_obj, "entries") : NULL;
+
+        for (guint i = 0; entries && i < json_array_get_length(entries); i++) {
+            JsonObject *object = json_array_get_object_element(entries, i);
+            const gchar *key = json_object_get_string_member_with_default(object, "key", NULL);
+            const gchar *text = json_object_get_string_member_with_default(object, "text", NULL);
+            if (!key || !text) continue;
+
+            RewriteEntry *entry = g_new0(RewriteEntry, 1);
+            entry->text = g_strdup(text);
+            entry->last_used = json_object_get_int_member_with_default(object, "last_used", 0);
+            g_hash_table_replace(rewrite->entries, g_strdup(key), entry);
+        }
+    } else {
+        g_warning("LLM Rewrite: Failed to parse %s: %s", rewrite->path, error->message);
+        g_error_free(error);
+    }
+
+    g_object_unref(parser);
+}
+
+static void save_to_file_locked(LLMRewrite *rewrite) {
+    gchar *cache_dir = g_path_get_dirname(rewrite->path);
+    g_mkdir_with_parents(cache_dir, 0700);
+    g_free(cache_dir);
+
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "entries");
+    json_builder_begin_array(builder);
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, rewrite->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        RewriteEntry *entry = value;
+
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "key");
+        json_builder_add_string_value(builder, key);
+        json_builder_set_member_name(builder, "text");
+        json_builder_add_string_value(builder, entry->text);
+        json_builder_set_member_name(builder, "last_used");
+        json_builder_add_int_value(builder, entry->last_used);
+        json_builder_end_object(builder);
+    }
+
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+
+    GError *error = NULL;
+    if (!json_generator_to_file(generator, rewrite->path, &error)) {
+        g_warning("LLM Rewrite: Failed to write %s: %s", rewrite->path, error->message);
+        g_error_free(error);
+    }
+
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+}
+
+static void evict_least_recently_used_locked(LLMRewrite *rewrite) {
+    while (g_hash_table_size(rewrite->entries) > REWRITE_MAX_ENTRIES) {
+        GHashTableIter iter;
+        gpointer key, value;
+        gpointer oldest_key = NULL;
+        gint64 oldest = G_MAXINT64;
+
+        g_hash_table_iter_init(&iter, rewrite->entries);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            RewriteEntry *entry = value;
+            if (entry->last_used < oldest) {
+                oldest = entry->last_used;
+                oldest_key = key;
+            }
+        }
+
+        g_hash_table_remove(rewrite->entries, oldest_key);
+    }
+}
+
+static void store_locked(LLMRewrite *rewrite, gchar *key, const gchar *text) {
+    RewriteEntry *entry = g_new0(RewriteEntry, 1);
+    entry->text = g_strdup(text);
+    entry->last_used = g_get_real_time() / G_USEC_PER_SEC;
+    g_hash_table_replace(rewrite->entries, key, entry);
+}
+
+LLMRewrite* llm_rewrite_get_default(void) {
+    static LLMRewrite *rewrite = NULL;
+
+    if (g_once_init_enter(&rewrite)) {
+        LLMRewrite *instance = g_new0(LLMRewrite, 1);
+        g_mutex_init(&instance->mutex);
+        instance->path = g_build_filename(g_get_user_cache_dir(), CONFIG_DIR_NAME, REWRITE_FILE_NAME, NULL);
+        instance->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                  (GDestroyNotify)rewrite_entry_free);
+        load_from_file(instance);
+
+        g_once_init_leave(&rewrite, instance);
+    }
+
+    return rewrite;
+}
+
+gboolean llm_rewrite_parse(const gchar *text, gchar **instruction, gchar **body) {
+    if (!text || !instruction || !body) return FALSE;
+
+    const gchar *line_start = strstr(text, REWRITE_PREFIX);
+    if (!line_start) return FALSE;
+
+    const gchar *start = line_start + strlen(REWRITE_PREFIX);
+    const gchar *line_end = strchr(start, '\n');
+    if (!line_end) line_end = start + strlen(start);
+
+    *instruction = g_strstrip(g_strndup(start, line_end - start));
+    *body = g_strdup_printf("%.*s%s", (int)(line_start - text), text, *line_end ? line_end + 1 : "");
+    g_strstrip(*body);
+
+    if (**instruction && **body) return TRUE;
+
+    g_clear_pointer(instruction, g_free);
+    g_clear_pointer(body, g_free);
+    return FALSE;
+}
+
+/* Paragraphs end at blank lines; lines within one are kept as they are */
+static GPtrArray* split_paragraphs(const gchar *text) {
+    GPtrArray *paragraphs = g_ptr_array_new_with_free_func(g_free);
+    gchar **lines = g_strsplit(text, "\n", -1);
+    GString *current = g_string_new(NULL);
+
+    for (gchar **line = lines; ; line++) {
+        gboolean blank = !*line || strspn(*line, " \t\r") == strlen(*line);
+
+        if (!blank) {
+            if (current->len > 0) g_string_append_c(current, '\n');
+            g_string_append(current, *line);
+        } else if (current->len > 0) {
+            g_ptr_array_add(paragraphs, g_strstrip(g_strdup(current->str)));
+            g_string_truncate(current, 0);
+        }
+
+        if (!*line) break;
+    }
+
+    g_string_free(current, TRUE);
+    g_strfreev(lines);
+    return paragraphs;
+}
+
+LLMRewriteJob* llm_rewrite_job_new(LLMRewrite *rewrite,
+                                   const gchar *model,
+                                   const gchar *instruction,
+                                   const gchar *text) {
+    LLMRewriteJob *job = g_new0(LLMRewriteJob, 1);
+    job->rewrite = rewrite;
+    job->model = g_strdup(model);
+    job->instruction = g_strdup(instruction);
+    job->paragraphs = split_paragraphs(text);
+    job->results = g_ptr_array_new_with_free_func(g_free);
+    job->requested = g_new0(gboolean, job->paragraphs->len);
+    g_ptr_array_set_size(job->results, job->paragraphs->len);
+
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    g_mutex_lock(&rewrite->mutex);
+    for (guint i = 0; i < job->paragraphs->len; i++) {
+        gchar *key = make_key(job, job->paragraphs, i);
+        RewriteEntry *entry = g_hash_table_lookup(rewrite->entries, key);
+        if (entry) {
+            entry->last_used = now;
+            g_ptr_array_index(job->results, i) = g_strdup(entry->text);
+        }
+        g_free(key);
+    }
+    g_mutex_unlock(&rewrite->mutex);
+
+    return job;
+}
+
+void llm_rewrite_job_free(LLMRewriteJob *job) {
+    if (!job) return;
+
+    g_free(job->model);
+    g_free(job->instruction);
+    g_ptr_array_unref(job->paragraphs);
+    g_ptr_array_unref(job->results);
+    g_free(job->requested);
+    g_free(job);
+}
+
+guint llm_rewrite_job_get_n_paragraphs(LLMRewriteJob *job) {
+    return job ? job->paragraphs->len : 0;
+}
+
+guint llm_rewrite_job_get_n_missing(LLMRewriteJob *job) {
+    guint missing = 0;
+    for (guint i = 0; job && i < job->results->len; i++) {
+        if (!g_ptr_array_index(job->results, i)) missing++;
+    }
+    return missing;
+}
+
+/* Runs in a pool thread; every paragraph writes only its own result slot */
+static void rewrite_paragraph(gpointer data, gpointer user_data) {
+    LLMRewriteJob *job = user_data;
+    guint index = GPOINTER_TO_UINT(data) - 1;
+
+    if (g_cancellable_is_cancelled(job->cancellable)) return;
+
+    GString *prompt = g_string_new(NULL);
+    g_string_append_printf(prompt, "Instruction: %s\n\n", job->instruction);
+    if (index > 0) {
+        g_string_append_printf(prompt, "Before:\n%s\n\n", (const gchar *)g_ptr_array_index(job->paragraphs, index - 1));
+    }
+    g_string_append_printf(prompt, "<paragraph>\n%s\n</paragraph>",
+                           (const gchar *)g_ptr_array_index(job->paragraphs, index));
+    if (index + 1 < job->paragraphs->len) {
+        g_string_append_printf(prompt, "\n\nAfter:\n%s", (const gchar *)g_ptr_array_index(job->paragraphs, index + 1));
+    }
+
+    LLMRequest *request = llm_request_new();
+    request->prompt = g_string_free(prompt, FALSE);
+    request->model = g_strdup(job->model);
+    request->system_prompt = g_strdup(REWRITE_SYSTEM_PROMPT);
+    request->deadline = job->deadline;
+
+    if (llm_client_generate_response(job->client, request) && request->response && *request->response) {
+        g_ptr_array_index(job->results, index) = g_steal_pointer(&request->response);
+        job->requested[index] = TRUE;
+    }
+
+    llm_request_free(request);
+}
+
+gboolean llm_rewrite_job_run(LLMRewriteJob *job, LLMClient *client, GCancellable *cancellable) {
+    guint missing = llm_rewrite_job_get_n_missing(job);
+
+    llm_metrics_add(LLM_METRIC_REWRITE_PARAGRAPHS, job->paragraphs->len);
+    llm_metrics_add(LLM_METRIC_REWRITE_PARAGRAPHS_REUSED, job->paragraphs->len - missing);
+    g_print("LLM Rewrite: %u of %u paragraphs cached\n", job->paragraphs->len - missing, job->paragraphs->len);
+
+    if (missing > 0) {
+        job->client = client;
+        job->cancellable = cancellable;
+        /* All paragraphs share the deadline of the one action */
+        job->deadline = g_get_monotonic_time() + (gint64)CLIENT_INTERACTIVE_DEADLINE_S * G_USEC_PER_SEC;
+
+        GThreadPool *pool = g_thread_pool_new(rewrite_paragraph, job, MIN(missing, REWRITE_MAX_PARALLEL),
+                                              FALSE, NULL);
+        for (guint i = 0; i < job->results->len; i++) {
+            if (!g_ptr_array_index(job->results, i)) {
+                g_thread_pool_push(pool, GUINT_TO_POINTER(i + 1), NULL);
+            }
+        }
+        g_thread_pool_free(pool, FALSE, TRUE);
+
+        job->client = NULL;
+        job->cancellable = NULL;
+    }
+
+    gboolean complete = llm_rewrite_job_get_n_missing(job) == 0;
+    LLMRewrite *rewrite = job->rewrite;
+
+    g_mutex_lock(&rewrite->mutex);
+    for (guint i = 0; i < job->paragraphs->len; i++) {
+        if (job->requested[i]) {
+            store_locked(rewrite, make_key(job, job->paragraphs, i), g_ptr_array_index(job->results, i));
+        }
+
+        /* A result is its own rewrite: running the instruction again on an
+         * edited result leaves the paragraphs that were not touched alone */
+        if (complete) {
+            store_locked(rewrite, make_key(job, job->results, i), g_ptr_array_index(job->results, i));
+        }
+    }
+    evict_least_recently_used_locked(rewrite);
+    if (missing > 0) save_to_file_locked(rewrite);
+    g_mutex_unlock(&rewrite->mutex);
+
+    return complete;
+}
+
+static void run_thread(GTask *task,
+                       gpointer source_object G_GNUC_UNUSED,
+                       gpointer task_data,
+                       GCancellable *cancellable) {
+    LLMRewriteJob *job = task_data;
+    LLMClient *client = g_object_get_data(G_OBJECT(task), "llm-client");
+
+    if (llm_rewrite_job_run(job, client, cancellable)) {
+        g_task_return_boolean(task, TRUE);
+    } else if (g_cancellable_is_cancelled(cancellable)) {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Rewrite cancelled");
+    } else {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to rewrite %u paragraphs",
+                                llm_rewrite_job_get_n_missing(job));
+    }
+}
+
+void llm_rewrite_job_run_async(LLMRewriteJob *job,
+                               LLMClient *client,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data) {
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, job, NULL);
+    g_object_set_data_full(G_OBJECT(task), "llm-client", llm_client_ref(client),
+                           (GDestroyNotify)llm_client_free);
+    g_task_run_in_thread(task, run_thread);
+    g_object_unref(task);
+}
+
+gboolean llm_rewrite_job_run_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+gchar* llm_rewrite_job_get_text(LLMRewriteJob *job) {
+    if (!job || llm_rewrite_job_get_n_missing(job) > 0) return NULL;
+
+    GString *text = g_string_new(NULL);
+    for (guint i = 0; i < job->results->len; i++) {
+        if (i > 0) g_string_append(text, "\n\n");
+        g_string_append(text, g_ptr_array_index(job->results, i));
+    }
+    return g_string_free(text, FALSE);
+}
@@ -0,0 +1,97 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_REWRITE_H
+#define LLM_REWRITE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "llm_client.h"
+
+#define REWRITE_PREFIX "/rw:"
+#define REWRITE_FILE_NAME "rewrites.json"
+#define REWRITE_MAX_ENTRIES 2000
+#define REWRITE_MAX_PARALLEL 4 /* paragraphs requested at the same time */
+
+#define REWRITE_SYSTEM_PROMPT \
+    "You rewrite one paragraph of an email at a time. Apply the instruction to the " \
+    "paragraph between the <paragraph> tags only; the text before and after it is " \
+    "there so that the paragraph still fits in. Answer with the rewritten paragraph " \
+    "alone, without tags or comments."
+
+typedef struct _LLMRewrite LLMRewrite;
+typedef struct _LLMRewriteJob LLMRewriteJob;
+
+/**
+ * Get the paragraph cache shared by all composer windows
+ *
+ * Rewritten paragraphs are kept in ~/.cache/evolution-llm-assistant/rewrites.json,
+ * keyed by a hash of the model, the instruction, the paragraph and its two
+ * neighbours. Every result is also stored as its own rewrite, so running the
+ * same instruction again on an edited result only sends what was edited and
+ * the paragraphs next to it. Safe to use from any thread.
+ *
+ * @return The shared instance, owned by the plugin
+ */
+LLMRewrite* llm_rewrite_get_default(void);
+
+/**
+ * Find a REWRITE_PREFIX instruction in selected text
+ *
+ * @param instruction Set to the rest of the prefix's line
+ * @param body Set to the text without that line
+ * @return TRUE if the text asks for a paragraph-wise rewrite
+ */
+gboolean llm_rewrite_parse(const gchar *text, gchar **instruction, gchar **body);
+
+/**
+ * Split text into paragraphs at blank lines and look each one up in the cache
+ */
+LLMRewriteJob* llm_rewrite_job_new(LLMRewrite *rewrite,
+                                   const gchar *model,
+                                   const gchar *instruction,
+                                   const gchar *text);
+void llm_rewrite_job_free(LLMRewriteJob *job);
+
+guint llm_rewrite_job_get_n_paragraphs(LLMRewriteJob *job);
+
+/**
+ * @return Paragraphs the cache had no rewrite for
+ */
+guint llm_rewrite_job_get_n_missing(LLMRewriteJob *job);
+
+/**
+ * Request the missing paragraphs, REWRITE_MAX_PARALLEL at a time, and
+ * store their rewrites. Blocks; a cancelled job sends no more paragraphs
+ * but lets those in flight finish.
+ *
+ * @return TRUE if every paragraph has a rewrite
+ */
+gboolean llm_rewrite_job_run(LLMRewriteJob *job, LLMClient *client, GCancellable *cancellable);
+
+/**
+ * Run llm_rewrite_job_run() in a worker thread; the job must stay alive
+ * until the callback has run
+ */
+void llm_rewrite_job_run_async(LLMRewriteJob *job,
+                               LLMClient *client,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data);
+gboolean llm_rewrite_job_run_finish(GAsyncResult *result, GError **error);
+
+/**
+ * @return The rewritten paragraphs joined by blank lines, or NULL while
+ *         any is missing; free with g_free()
+ */
+gchar* llm_rewrite_job_get_text(LLMRewriteJob *job);
+
+#endif /* LLM_REWRITE_H */
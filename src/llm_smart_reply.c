@@ -0,0 +1,601 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Smart replies. Short reply intents for the message shown in the reader
+ * are generated by a small model, several messages per request, and cached
+ * per Message-ID together with the full replies written from them.
+ */
+
+#include "llm_smart_reply.h"
+#include "llm_client.h"
+#include "llm_attachment.h"
+#include "llm_triage.h"
+#include "../config/config.h"
+#include <json-glib/json-glib.h>
+#include <string.h>
+
+typedef struct {
+    gchar **intents;
+    GHashTable *replies; /* intent -> full reply */
+    gint64 last_used;
+} SmartReplyEntry;
+
+typedef struct {
+    CamelMimeMessage *message;
+    GSList *tasks; /* waiting for the message's intents */
+} PendingMessage;
+
+struct _LLMSmartReply {
+    gchar *path;
+    GHashTable *entries;    /* Message-ID -> SmartReplyEntry */
+    GHashTable *pending;    /* Message-ID -> PendingMessage, queued or in a batch */
+    GQueue *queue;          /* Message-IDs not yet sent, borrowed from pending */
+    GHashTable *generating; /* "Message-ID\nintent" -> GSList of waiting GTasks */
+    guint flush_id;
+    GMutex triage_mutex;
+    LLMTriageModel *triage_model; /* loaded by the first batch that needs it */
+    gboolean triage_loaded;
+};
+
+typedef struct {
+    LLMSmartReply *smart_reply;
+    GPtrArray *message_ids;
+    GPtrArray *messages;
+    GPtrArray *intents; /* gchar**, filled in by the worker; empty for skipped messages */
+} IntentsBatch;
+
+typedef struct {
+    gchar *message_id;
+    CamelMimeMessage *message;
+    gchar *intent;
+} ReplyJob;
+
+static void smart_reply_entry_free(SmartReplyEntry *entry) {
+    g_strfreev(entry->intents);
+    g_hash_table_unref(entry->replies);
+    g_free(entry);
+}
+
+static SmartReplyEntry* smart_reply_entry_new(gchar **intents) {
+    SmartReplyEntry *entry = g_new0(SmartReplyEntry, 1);
+    entry->intents = intents;
+    entry->replies = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    entry->last_used = g_get_real_time() / G_USEC_PER_SEC;
+    return entry;
+}
+
+static void pending_message_free(PendingMessage *pending) {
+    g_object_unref(pending->message);
+    g_slist_free_full(pending->tasks, g_object_unref);
+    g_free(pending);
+}
+
+static void intents_batch_free(IntentsBatch *batch) {
+    g_ptr_array_unref(batch->message_ids);
+    g_ptr_array_unref(batch->messages);
+    g_ptr_array_unref(batch->intents);
+    g_free(batch);
+}
+
+static void reply_job_free(ReplyJob *job) {
+    g_free(job->message_id);
+    g_object_unref(job->message);
+    g_free(job->intent);
+    g_free(job);
+}
+
+static gchar* make_reply_key(const gchar *message_id, const gchar *intent) {
+    return g_strdup_printf("%s\n%s", message_id, intent);
+}
+
+static void load_from_file(LLMSmartReply *smart_reply) {
+    if (!g_file_test(smart_reply->path, G_FILE_TEST_EXISTS)) return;
+
+    JsonParser *parser = json_parser_new();
+    GError *error = NULL;
+
+    if (json_parser_load_from_file(parser, smart_reply->path, &error)) {
+        JsonObject *root_obj = json_node_get_object(json_parser_get_root(parser));
+        JsonArray *messages = root_obj && json_object_has_member(root_obj, "messages")
+            ? json_object_get_array_member(root_obj, "messages") : NULL;
+
+        for (guint i = 0; messages && i < json_array_get_length(messages); i++) {
+            JsonObject *message = json_array_get_object_element(messages, i);
+            const gchar *id = json_object_get_string_member_with_default(message, "id", NULL);
+            if (!id || !json_object_has_member(message, "intents")) continue;
+
+            JsonArray *intents = json_object_get_array_member(message, "intents");
+            GPtrArray *strv = g_ptr_array_new();
+            for (guint j = 0; j < json_array_get_length(intents); j++) {
+                g_ptr_array_add(strv, g_strdup(json_array_get_string_element(intents, j)));
+            }
+            g_ptr_array_add(strv, NULL);
+
+            SmartReplyEntry *entry = smart_reply_entry_new((gchar **)g_ptr_array_free(strv, FALSE));
+            entry->last_used = json_object_get_int_member_with_default(message, "last_used", 0);
+
+            if (json_object_has_member(message, "replies")) {
+                JsonObject *replies = json_object_get_object_member(message, "replies");
+                GList *members = json_object_get_members(replies);
+                for (GList *link = members; link; link = link->next) {
+                    g_hash_table_replace(entry->replies, g_strdup(link->data),
+                                         g_strdup(json_object_get_string_member(replies, link->data)));
+                }
+                g_list_free(members);
+            }
+
+            g_hash_table_replace(smart_reply->entries, g_strdup(id), entry);
+        }
+    } else {
+        g_warning("LLM Smart Reply: Failed to parse %s: %s", smart_reply->path, error->message);
+        g_error_free(error);
+    }
+
+    g_object_unref(parser);
+}
+
+static void save_to_file(LLMSmartReply *smart_reply) {
+    gchar *cache_dir = g_path_get_dirname(smart_reply->path);
+    g_mkdir_with_parents(cache_dir, 0700);
+    g_free(cache_dir);
+
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "messages");
+    json_builder_begin_array(builder);
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, smart_reply->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        SmartReplyEntry *entry = value;
+
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "id");
+        json_builder_add_string_value(builder, key);
+        json_builder_set_member_name(builder, "last_used");
+        json_builder_add_int_value(builder, entry->last_used);
+        json_builder_set_member_name(builder, "intents");
+        json_builder_begin_array(builder);
+        for (guint i = 0; entry->intents[i]; i++) {
+            json_builder_add_string_value(builder, entry->intents[i]);
+        }
+        json_builder_end_array(builder);
+
+        json_builder_set_member_name(builder, "replies");
+        json_builder_begin_object(builder);
+        GHashTableIter reply_iter;
+        gpointer intent, reply;
+        g_hash_table_iter_init(&reply_iter, entry->replies);
+        while (g_hash_table_iter_next(&reply_iter, &intent, &reply)) {
+            json_builder_set_member_name(builder, intent);
+            json_builder_add_string_value(builder, reply);
+        }
+        json_builder_end_object(builder);
+        json_builder_end_object(builder);
+    }
+
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+
+    GError *error = NULL;
+    if (!json_generator_to_file(generator, smart_reply->path, &error)) {
+        g_warning("LLM Smart Reply: Failed to write %s: %s", smart_reply->path, error->message);
+        g_error_free(error);
+    }
+
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+}
+
+static void evict_least_recently_used(LLMSmartReply *smart_reply) {
+    GHashTableIter iter;
+    gpointer key, value;
+    gpointer oldest_key = NULL;
+    gint64 oldest = G_MAXINT64;
+
+    g_hash_table_iter_init(&iter, smart_reply->entries);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        SmartReplyEntry *entry = value;
+        if (entry->last_used < oldest) {
+            oldest = entry->last_used;
+            oldest_key = key;
+        }
+    }
+
+    if (oldest_key) {
+        g_hash_table_remove(smart_reply->entries, oldest_key);
+    }
+}
+
+LLMSmartReply* llm_smart_reply_get_default(void) {
+    static LLMSmartReply *smart_reply = NULL;
+
+    if (g_once_init_enter(&smart_reply)) {
+        LLMSmartReply *instance = g_new0(LLMSmartReply, 1);
+        instance->path = g_build_filename(g_get_user_cache_dir(), CONFIG_DIR_NAME,
+                                          SMART_REPLY_FILE_NAME, NULL);
+        instance->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                  (GDestroyNotify)smart_reply_entry_free);
+        instance->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                  (GDestroyNotify)pending_message_free);
+        instance->queue = g_queue_new();
+        instance->generating = g_hash_table_new(g_str_hash, g_str_equal);
+        g_mutex_init(&instance->triage_mutex);
+        load_from_file(instance);
+
+        g_once_init_leave(&smart_reply, instance);
+    }
+
+    return smart_reply;
+}
+
+/* The triage classifier, loaded once; NULL when none was trained */
+static LLMTriageModel* get_triage_model(LLMSmartReply *smart_reply) {
+    g_mutex_lock(&smart_reply->triage_mutex);
+    if (!smart_reply->triage_loaded) {
+        gchar *path = llm_triage_get_model_path();
+        if (g_file_test(path, G_FILE_TEST_EXISTS)) {
+            GError *error = NULL;
+            smart_reply->triage_model = llm_triage_model_load(path, &error);
+            if (error) {
+                g_warning("LLM Smart Reply: %s", error->message);
+                g_error_free(error);
+            }
+        }
+        g_free(path);
+        smart_reply->triage_loaded = TRUE;
+    }
+    g_mutex_unlock(&smart_reply->triage_mutex);
+
+    return smart_reply->triage_model;
+}
+
+/* Text of a message as sent in a batch, or NULL if it is not worth a reply */
+static gchar* get_batch_body(LLMSmartReply *smart_reply, PluginConfig *config, CamelMimeMessage *message) {
+    gchar *body = llm_attachment_extract_body(message, SMART_REPLY_MAX_BODY_BYTES, NULL);
+    if (!body || !*body) {
+        g_free(body);
+        return NULL;
+    }
+
+    if (config->triage_enabled &&
+        !llm_triage_should_generate(get_triage_model(smart_reply), body,
+                                    config->triage_reply_label, config->triage_min_confidence)) {
+        g_free(body);
+        return NULL;
+    }
+
+    return body;
+}
+
+/* Read the messages and send one request for those worth a reply; runs in a worker thread */
+static void intents_batch_thread(GTask *task,
+                                 gpointer source_object G_GNUC_UNUSED,
+                                 gpointer task_data,
+                                 GCancellable *cancellable G_GNUC_UNUSED) {
+    IntentsBatch *batch = task_data;
+    LLMSmartReply *smart_reply = batch->smart_reply;
+    PluginConfig *config = config_load();
+    LLMClient *client = llm_client_new(config);
+
+    if (!client) {
+        config_free(config);
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED, "No valid configuration");
+        return;
+    }
+
+    /* Number the messages that are sent; skipped ones get no number */
+    GString *prompt = g_string_new(NULL);
+    GArray *numbers = g_array_sized_new(FALSE, FALSE, sizeof(guint), batch->messages->len);
+    guint n_sent = 0;
+    for (guint i = 0; i < batch->messages->len; i++) {
+        gchar *body = get_batch_body(smart_reply, config, g_ptr_array_index(batch->messages, i));
+        guint number = body ? ++n_sent : 0;
+
+        if (body) {
+            g_string_append_printf(prompt, "Email %u:\n---\n%s\n---\n\n", number, body);
+            g_free(body);
+        }
+        g_array_append_val(numbers, number);
+    }
+
+    if (n_sent == 0) {
+        for (guint i = 0; i < batch->messages->len; i++) {
+            g_ptr_array_add(batch->intents, g_new0(gchar *, 1));
+        }
+        g_task_return_boolean(task, TRUE);
+
+        g_array_unref(numbers);
+        g_string_free(prompt, TRUE);
+        llm_client_free(client);
+        config_free(config);
+        return;
+    }
+    if (n_sent < batch->messages->len) {
+        g_print("LLM Smart Reply: Skipped %u messages without text or not worth a reply\n",
+                batch->messages->len - n_sent);
+    }
+
+    LLMRequest *request = llm_request_new();
+    request->prompt = g_string_free(prompt, FALSE);
+    request->model = g_strdup(config->smart_reply_model);
+    request->work_class = LLM_WORK_BATCH;
+    request->system_prompt = g_strdup_printf(SMART_REPLY_INTENTS_PROMPT, SMART_REPLY_MAX_INTENTS);
+    request->json_output = TRUE;
+
+    gboolean success = llm_client_generate_response(client, request);
+    JsonParser *parser = json_parser_new();
+
+    if (success && json_parser_load_from_data(parser, request->response, -1, NULL) &&
+        JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser))) {
+        JsonObject *root_obj = json_node_get_object(json_parser_get_root(parser));
+
+        for (guint i = 0; i < batch->message_ids->len; i++) {
+            guint index = g_array_index(numbers, guint, i);
+            gchar *number = g_strdup_printf("%u", index);
+            JsonNode *node = index > 0 ? json_object_get_member(root_obj, number) : NULL;
+            GPtrArray *strv = g_ptr_array_new();
+
+            JsonArray *intents = node && JSON_NODE_HOLDS_ARRAY(node) ? json_node_get_array(node) : NULL;
+            for (guint j = 0; intents && j < json_array_get_length(intents) && strv->len < SMART_REPLY_MAX_INTENTS; j++) {
+                JsonNode *element = json_array_get_element(intents, j);
+                const gchar *intent = JSON_NODE_HOLDS_VALUE(element) ? json_node_get_string(element) : NULL;
+                if (intent && *intent) g_ptr_array_add(strv, g_strstrip(g_strdup(intent)));
+            }
+            g_ptr_array_add(strv, NULL);
+
+            g_ptr_array_add(batch->intents, g_ptr_array_free(strv, FALSE));
+            g_free(number);
+        }
+        g_task_return_boolean(task, TRUE);
+    } else {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED, "No usable intents in the response");
+    }
+
+    g_object_unref(parser);
+    g_array_unref(numbers);
+    llm_request_free(request);
+    llm_client_free(client);
+    config_free(config);
+}
+
+static void on_intents_batch_ready(GObject *source G_GNUC_UNUSED, GAsyncResult *result, gpointer user_data) {
+    LLMSmartReply *smart_reply = user_data;
+    IntentsBatch *batch = g_task_get_task_data(G_TASK(result));
+    GError *error = NULL;
+
+    gboolean success = g_task_propagate_boolean(G_TASK(result), &error);
+    if (!success) {
+        g_warning("LLM Smart Reply: Batch of %u messages failed: %s", batch->message_ids->len, error->message);
+    }
+
+    for (guint i = 0; i < batch->message_ids->len; i++) {
+        const gchar *message_id = g_ptr_array_index(batch->message_ids, i);
+        PendingMessage *pending = g_hash_table_lookup(smart_reply->pending, message_id);
+        gchar **intents = success ? g_ptr_array_index(batch->intents, i) : NULL;
+
+        if (intents && intents[0]) {
+            if (!g_hash_table_contains(smart_reply->entries, message_id) &&
+                g_hash_table_size(smart_reply->entries) >= SMART_REPLY_MAX_MESSAGES) {
+                evict_least_recently_used(smart_reply);
+            }
+            g_hash_table_replace(smart_reply->entries, g_strdup(message_id),
+                                 smart_reply_entry_new(g_strdupv(intents)));
+        }
+
+        for (GSList *link = pending ? pending->tasks : NULL; link; link = link->next) {
+            if (intents && intents[0]) {
+                g_task_return_pointer(link->data, g_strdupv(intents), (GDestroyNotify)g_strfreev);
+            } else if (error) {
+                g_task_return_error(link->data, g_error_copy(error));
+            } else {
+                g_task_return_new_error(link->data, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No intents for this message");
+            }
+        }
+
+        g_hash_table_remove(smart_reply->pending, message_id);
+    }
+
+    if (success) save_to_file(smart_reply);
+    g_clear_error(&error);
+}
+
+static gboolean flush_batch(gpointer user_data) {
+    LLMSmartReply *smart_reply = user_data;
+    smart_reply->flush_id = 0;
+
+    while (!g_queue_is_empty(smart_reply->queue)) {
+        IntentsBatch *batch = g_new0(IntentsBatch, 1);
+        batch->smart_reply = smart_reply;
+        batch->message_ids = g_ptr_array_new_with_free_func(g_free);
+        batch->messages = g_ptr_array_new_with_free_func(g_object_unref);
+        batch->intents = g_ptr_array_new_with_free_func((GDestroyNotify)g_strfreev);
+
+        while (batch->message_ids->len < SMART_REPLY_BATCH_SIZE && !g_queue_is_empty(smart_reply->queue)) {
+            const gchar *message_id = g_queue_pop_head(smart_reply->queue);
+            PendingMessage *pending = g_hash_table_lookup(smart_reply->pending, message_id);
+
+            g_ptr_array_add(batch->message_ids, g_strdup(message_id));
+            g_ptr_array_add(batch->messages, g_object_ref(pending->message));
+        }
+
+        g_print("LLM Smart Reply: Requesting intents for %u messages\n", batch->message_ids->len);
+
+        /* Bodies are extracted and triaged by the worker, off the main thread */
+        GTask *task = g_task_new(NULL, NULL, on_intents_batch_ready, smart_reply);
+        g_task_set_task_data(task, batch, (GDestroyNotify)intents_batch_free);
+        g_task_run_in_thread(task, intents_batch_thread);
+        g_object_unref(task);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+void llm_smart_reply_intents_async(LLMSmartReply *smart_reply,
+                                   const gchar *message_id,
+                                   CamelMimeMessage *message,
+                                   GCancellable *cancellable,
+                                   GAsyncReadyCallback callback,
+                                   gpointer user_data) {
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    SmartReplyEntry *entry = g_hash_table_lookup(smart_reply->entries, message_id);
+
+    if (entry) {
+        entry->last_used = g_get_real_time() / G_USEC_PER_SEC;
+        g_task_return_pointer(task, g_strdupv(entry->intents), (GDestroyNotify)g_strfreev);
+        g_object_unref(task);
+        return;
+    }
+
+    /* Wait for the message's batch if it is already queued or sent */
+    PendingMessage *pending = g_hash_table_lookup(smart_reply->pending, message_id);
+    if (!pending) {
+        pending = g_new0(PendingMessage, 1);
+        pending->message = g_object_ref(message);
+
+        gchar *key = g_strdup(message_id);
+        g_hash_table_insert(smart_reply->pending, key, pending);
+        g_queue_push_tail(smart_reply->queue, key);
+    }
+    pending->tasks = g_slist_prepend(pending->tasks, task);
+
+    if (g_queue_get_length(smart_reply->queue) >= SMART_REPLY_BATCH_SIZE) {
+        if (smart_reply->flush_id) g_source_remove(smart_reply->flush_id);
+        flush_batch(smart_reply);
+    } else if (!smart_reply->flush_id) {
+        smart_reply->flush_id = g_timeout_add(SMART_REPLY_BATCH_DELAY_MS, flush_batch, smart_reply);
+    }
+}
+
+gchar** llm_smart_reply_intents_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+static void generate_reply_thread(GTask *task,
+                                  gpointer source_object G_GNUC_UNUSED,
+                                  gpointer task_data,
+                                  GCancellable *cancellable G_GNUC_UNUSED) {
+    ReplyJob *job = task_data;
+    gchar *body = llm_attachment_extract_body(job->message, SMART_REPLY_MAX_BODY_BYTES, NULL);
+    if (!body || !*body) {
+        g_free(body);
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "The message has no text");
+        return;
+    }
+
+    PluginConfig *config = config_load();
+    LLMClient *client = llm_client_new(config);
+
+    if (!client) {
+        config_free(config);
+        g_free(body);
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED, "No valid configuration");
+        return;
+    }
+
+    LLMRequest *request = llm_request_new();
+    request->prompt = g_strdup_printf("%s\n\n---\nWrite a complete reply to the email above. "
+                                      "The reply should say: %s", body, job->intent);
+    g_free(body);
+
+    if (llm_client_generate_response(client, request)) {
+        g_task_return_pointer(task, g_steal_pointer(&request->response), g_free);
+    } else {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to generate the reply");
+    }
+
+    llm_request_free(request);
+    llm_client_free(client);
+    config_free(config);
+}
+
+static void on_reply_generated(GObject *source G_GNUC_UNUSED, GAsyncResult *result, gpointer user_data) {
+    LLMSmartReply *smart_reply = user_data;
+    ReplyJob *job = g_task_get_task_data(G_TASK(result));
+    GError *error = NULL;
+
+    gchar *reply = g_task_propagate_pointer(G_TASK(result), &error);
+    gchar *key = make_reply_key(job->message_id, job->intent);
+    gpointer original_key = NULL;
+    GSList *tasks = NULL;
+
+    if (g_hash_table_steal_extended(smart_reply->generating, key, &original_key, (gpointer *)&tasks)) {
+        g_free(original_key);
+    }
+
+    SmartReplyEntry *entry = g_hash_table_lookup(smart_reply->entries, job->message_id);
+    if (reply && entry) {
+        g_hash_table_replace(entry->replies, g_strdup(job->intent), g_strdup(reply));
+        save_to_file(smart_reply);
+    }
+
+    for (GSList *link = tasks; link; link = link->next) {
+        if (reply) {
+            g_task_return_pointer(link->data, g_strdup(reply), g_free);
+        } else {
+            g_task_return_error(link->data, g_error_copy(error));
+        }
+    }
+
+    g_slist_free_full(tasks, g_object_unref);
+    g_clear_error(&error);
+    g_free(reply);
+    g_free(key);
+}
+
+void llm_smart_reply_generate_async(LLMSmartReply *smart_reply,
+                                    const gchar *message_id,
+                                    CamelMimeMessage *message,
+                                    const gchar *intent,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data) {
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    SmartReplyEntry *entry = g_hash_table_lookup(smart_reply->entries, message_id);
+    const gchar *reply = entry ? g_hash_table_lookup(entry->replies, intent) : NULL;
+
+    if (reply) {
+        entry->last_used = g_get_real_time() / G_USEC_PER_SEC;
+        g_task_return_pointer(task, g_strdup(reply), g_free);
+        g_object_unref(task);
+        return;
+    }
+
+    gchar *key = make_reply_key(message_id, intent);
+    gpointer original_key = NULL;
+    GSList *tasks = NULL;
+
+    if (g_hash_table_lookup_extended(smart_reply->generating, key, &original_key, (gpointer *)&tasks)) {
+        g_hash_table_insert(smart_reply->generating, original_key, g_slist_prepend(tasks, task));
+        g_free(key);
+        return;
+    }
+    g_hash_table_insert(smart_reply->generating, key, g_slist_prepend(NULL, task));
+
+    ReplyJob *job = g_new0(ReplyJob, 1);
+    job->message_id = g_strdup(message_id);
+    job->message = g_object_ref(message);
+    job->intent = g_strdup(intent);
+
+    GTask *generate_task = g_task_new(NULL, NULL, on_reply_generated, smart_reply);
+    g_task_set_task_data(generate_task, job, (GDestroyNotify)reply_job_free);
+    g_task_run_in_thread(generate_task, generate_reply_thread);
+    g_object_unref(generate_task);
+}
+
+gchar* llm_smart_reply_generate_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
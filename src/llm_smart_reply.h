@@ -0,0 +1,94 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_SMART_REPLY_H
+#define LLM_SMART_REPLY_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <camel/camel.h>
+
+#define SMART_REPLY_FILE_NAME "smart-replies.json"
+#define SMART_REPLY_MAX_MESSAGES 500
+#define SMART_REPLY_MAX_INTENTS 3
+#define SMART_REPLY_BATCH_SIZE 8
+#define SMART_REPLY_BATCH_DELAY_MS 400   /* wait this long for more messages before sending a batch */
+#define SMART_REPLY_MAX_BODY_BYTES 3000  /* of each message in a batch */
+
+/* System prompt of a batch; the user prompt numbers the emails "Email 1:", "Email 2:", ... */
+#define SMART_REPLY_INTENTS_PROMPT \
+    "You suggest quick replies to emails. For every numbered email, write up to %d " \
+    "distinct one-line replies the recipient would plausibly send, each at most eight " \
+    "words and written as the reply itself, e.g. \"Yes, Tuesday works for me.\" " \
+    "Answer with a JSON object that maps each email's number to an array of strings."
+
+typedef struct _LLMSmartReply LLMSmartReply;
+
+/**
+ * Get the smart-reply cache shared by all reader windows
+ *
+ * Intents and generated replies are kept per Message-ID in
+ * ~/.cache/evolution-llm-assistant/smart-replies.json. The functions below
+ * must be called from the main thread; requests read the configuration
+ * file when they are sent, so they see saved preferences at once.
+ *
+ * @return The shared instance, owned by the plugin
+ */
+LLMSmartReply* llm_smart_reply_get_default(void);
+
+/**
+ * Get one-line reply intents for a message
+ *
+ * Cached intents are returned at once. Otherwise the message joins a batch
+ * that is sent to the smart-reply model after SMART_REPLY_BATCH_DELAY_MS or
+ * once it holds SMART_REPLY_BATCH_SIZE messages. A cancelled call still
+ * lets its batch finish, so the intents are cached for the next time.
+ *
+ * The message's text is read in the batch's worker thread. Messages
+ * without text, and with [triage] enabled those the classifier considers
+ * routine, are not sent and fail with G_IO_ERROR_NOT_FOUND.
+ *
+ * @param message_id Message-ID of the message
+ * @param message The message; a reference is kept until its batch is done
+ */
+void llm_smart_reply_intents_async(LLMSmartReply *smart_reply,
+                                   const gchar *message_id,
+                                   CamelMimeMessage *message,
+                                   GCancellable *cancellable,
+                                   GAsyncReadyCallback callback,
+                                   gpointer user_data);
+
+/**
+ * @return NULL-terminated intents; free with g_strfreev()
+ */
+gchar** llm_smart_reply_intents_finish(GAsyncResult *result, GError **error);
+
+/**
+ * Get the full reply for one of a message's intents
+ *
+ * A reply is generated once with the configured model and then cached.
+ * Calls for a reply that is being generated wait for the same request.
+ * The message's text is read in a worker thread.
+ */
+void llm_smart_reply_generate_async(LLMSmartReply *smart_reply,
+                                    const gchar *message_id,
+                                    CamelMimeMessage *message,
+                                    const gchar *intent,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
+
+/**
+ * @return The reply; free with g_free()
+ */
+gchar* llm_smart_reply_generate_finish(GAsyncResult *result, GError **error);
+
+#endif /* LLM_SMART_REPLY_H */
@@ -0,0 +1,200 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Token queue between the network thread and the GTK main thread. A
+ * lock-free single-producer single-consumer ring buffer, drained in batches
+ * by a GSource that is woken through an eventfd.
+ */
+
+#include "llm_stream.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define TOKEN_QUEUE_MASK (TOKEN_QUEUE_CAPACITY - 1)
+
+struct _LLMTokenQueue {
+    gchar buffer[TOKEN_QUEUE_CAPACITY];
+    volatile gint head;      /* bytes ever pushed; written by the producer only */
+    volatile gint tail;      /* bytes ever drained; written by the consumer only */
+    volatile gint signalled; /* eventfd written and not yet consumed */
+    volatile gint closed;    /* producer is done */
+    volatile gint abandoned; /* consumer source was destroyed */
+    gint event_fd;
+};
+
+typedef struct {
+    GSource source;
+    LLMTokenQueue *queue;
+    gpointer fd_tag;
+    GString *batch; /* reused between dispatches */
+} TokenQueueSource;
+
+LLMTokenQueue* llm_token_queue_new(void) {
+    LLMTokenQueue *queue = g_new0(LLMTokenQueue, 1);
+
+    queue->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->event_fd < 0) {
+        g_warning("LLM Stream: eventfd failed: %s", g_strerror(errno));
+        g_free(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+void llm_token_queue_free(LLMTokenQueue *queue) {
+    if (!queue) return;
+
+    close(queue->event_fd);
+    g_free(queue);
+}
+
+/* Wake the consumer, but only once per drain: later pushes ride along */
+static void wake_consumer(LLMTokenQueue *queue) {
+    if (g_atomic_int_compare_and_exchange(&queue->signalled, 0, 1)) {
+        guint64 one = 1;
+        if (write(queue->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            g_warning("LLM Stream: eventfd write failed: %s", g_strerror(errno));
+        }
+    }
+}
+
+static gboolean push_chunk(LLMTokenQueue *queue, const gchar *text, guint length) {
+    guint head = (guint)g_atomic_int_get(&queue->head);
+
+    /* Only the producer advances head, so free space can only grow while waiting */
+    while (TOKEN_QUEUE_CAPACITY - (head - (guint)g_atomic_int_get(&queue->tail)) < length) {
+        if (g_atomic_int_get(&queue->abandoned)) return FALSE;
+        g_usleep(500);
+    }
+
+    guint offset = head & TOKEN_QUEUE_MASK;
+    guint first = MIN(length, TOKEN_QUEUE_CAPACITY - offset);
+    memcpy(queue->buffer + offset, text, first);
+    memcpy(queue->buffer, text + first, length - first);
+
+    /* Publish the bytes before the consumer can see the new head */
+    g_atomic_int_set(&queue->head, (gint)(head + length));
+    wake_consumer(queue);
+
+    return TRUE;
+}
+
+void llm_token_queue_push(LLMTokenQueue *queue, const gchar *text, gsize length) {
+    if (!queue || !text) return;
+
+    /* Text longer than the ring goes in pieces that end on a character boundary */
+    while (length > 0) {
+        guint chunk = MIN(length, TOKEN_QUEUE_CAPACITY / 2);
+        if (chunk < length) {
+            const gchar *end = g_utf8_find_prev_char(text, text + chunk + 1);
+            if (end && end > text) chunk = end - text;
+        }
+
+        if (!push_chunk(queue, text, chunk)) return;
+        text += chunk;
+        length -= chunk;
+    }
+}
+
+void llm_token_queue_close(LLMTokenQueue *queue) {
+    if (!queue) return;
+
+    g_atomic_int_set(&queue->closed, 1);
+
+    /* Always wake: the final batch must be delivered even without new text */
+    guint64 one = 1;
+    g_atomic_int_set(&queue->signalled, 1);
+    if (write(queue->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        g_warning("LLM Stream: eventfd write failed: %s", g_strerror(errno));
+    }
+}
+
+static gboolean token_queue_source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data) {
+    TokenQueueSource *self = (TokenQueueSource *)source;
+    LLMTokenQueue *queue = self->queue;
+
+    /* Either the eventfd fired or the throttle interval ran out; listen again */
+    g_source_set_ready_time(source, -1);
+    g_source_modify_unix_fd(source, self->fd_tag, G_IO_IN);
+
+    guint64 count;
+    if (read(queue->event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        g_warning("LLM Stream: eventfd read failed: %s", g_strerror(errno));
+    }
+
+    /* Reset before draining: a push after this point signals again */
+    g_atomic_int_set(&queue->signalled, 0);
+    gboolean closed = g_atomic_int_get(&queue->closed);
+
+    guint tail = (guint)g_atomic_int_get(&queue->tail);
+    guint head = (guint)g_atomic_int_get(&queue->head);
+    guint length = head - tail;
+
+    g_string_truncate(self->batch, 0);
+    if (length > 0) {
+        guint offset = tail & TOKEN_QUEUE_MASK;
+        guint first = MIN(length, TOKEN_QUEUE_CAPACITY - offset);
+        g_string_append_len(self->batch, queue->buffer + offset, first);
+        g_string_append_len(self->batch, queue->buffer, length - first);
+        g_atomic_int_set(&queue->tail, (gint)head);
+    }
+
+    gboolean finished = closed && length == 0;
+
+    if (length > 0 || finished) {
+        if (callback) {
+            ((LLMTokenQueueFunc)(void (*)(void))callback)(self->batch->str, self->batch->len,
+                                                          finished, user_data);
+        }
+    }
+
+    if (finished) return G_SOURCE_REMOVE;
+
+    /* Bound the wake-up rate: ignore the eventfd until the interval passed */
+    if (length > 0) {
+        g_source_modify_unix_fd(source, self->fd_tag, 0);
+        g_source_set_ready_time(source, g_source_get_time(source) + TOKEN_QUEUE_INTERVAL_MS * 1000);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void token_queue_source_finalize(GSource *source) {
+    TokenQueueSource *self = (TokenQueueSource *)source;
+
+    g_atomic_int_set(&self->queue->abandoned, 1);
+    g_string_free(self->batch, TRUE);
+}
+
+static GSourceFuncs token_queue_source_funcs = {
+    NULL, /* prepare */
+    NULL, /* check */
+    token_queue_source_dispatch,
+    token_queue_source_finalize,
+    NULL,
+    NULL,
+};
+
+GSource* llm_token_queue_source_new(LLMTokenQueue *queue) {
+    g_return_val_if_fail(queue != NULL, NULL);
+
+    GSource *source = g_source_new(&token_queue_source_funcs, sizeof(TokenQueueSource));
+    TokenQueueSource *self = (TokenQueueSource *)source;
+
+    self->queue = queue;
+    self->batch = g_string_sized_new(4096);
+    self->fd_tag = g_source_add_unix_fd(source, queue->event_fd, G_IO_IN);
+    g_source_set_name(source, "LLM token queue");
+
+    return source;
+}
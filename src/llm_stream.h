@@ -0,0 +1,70 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_STREAM_H
+#define LLM_STREAM_H
+
+#include <glib.h>
+
+#define TOKEN_QUEUE_CAPACITY 65536 /* bytes, power of two */
+#define TOKEN_QUEUE_INTERVAL_MS 16 /* minimum time between two batches */
+
+typedef struct _LLMTokenQueue LLMTokenQueue;
+
+/**
+ * Callback type for the main-thread side of a token queue
+ *
+ * @param text Every byte pushed since the previous call, NUL-terminated.
+ *             Only valid during the call
+ * @param length Length of text in bytes
+ * @param finished TRUE once the producer closed the queue and it is empty
+ * @param user_data User data passed to g_source_set_callback()
+ */
+typedef void (*LLMTokenQueueFunc)(const gchar *text, gsize length, gboolean finished, gpointer user_data);
+
+/**
+ * Create a single-producer single-consumer byte queue
+ *
+ * One worker thread pushes, the main thread drains through the GSource
+ * from llm_token_queue_source_new(). Pushing never allocates.
+ */
+LLMTokenQueue* llm_token_queue_new(void);
+
+/**
+ * Free the queue. The producer must have finished and the source must be destroyed.
+ */
+void llm_token_queue_free(LLMTokenQueue *queue);
+
+/**
+ * Append text from the producer thread
+ *
+ * Waits while the queue is full, unless the consumer went away.
+ */
+void llm_token_queue_push(LLMTokenQueue *queue, const gchar *text, gsize length);
+
+/**
+ * Tell the consumer that no more text will be pushed
+ */
+void llm_token_queue_close(LLMTokenQueue *queue);
+
+/**
+ * Create the consumer GSource
+ *
+ * The source wakes up on an eventfd and hands everything queued so far to
+ * its LLMTokenQueueFunc callback in one batch, at most once per
+ * TOKEN_QUEUE_INTERVAL_MS. It removes itself after the final batch.
+ * Releasing the source early unblocks a waiting producer.
+ *
+ * @return A new source; set its callback with g_source_set_callback()
+ */
+GSource* llm_token_queue_source_new(LLMTokenQueue *queue);
+
+#endif /* LLM_STREAM_H */
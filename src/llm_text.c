@@ -0,0 +1,64 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Shared text helpers for the local (non-LLM) matching features.
+ */
+
+#include "llm_text.h"
+#include <string.h>
+
+static const gchar *stopwords[] = {
+    "a", "an", "and", "are", "as", "at", "be", "but", "by", "for", "from",
+    "has", "have", "i", "if", "in", "is", "it", "me", "my", "of", "on", "or",
+    "our", "so", "that", "the", "this", "to", "was", "we", "were", "will",
+    "with", "you", "your",
+    "de", "het", "een", "en", "van", "ik", "je", "is", "dat", "die", "op",
+    "te", "met", "voor", "niet", "zijn", "er", "aan", "om", "ook", "wij", "u",
+    NULL
+};
+
+gboolean llm_text_is_stopword(const gchar *token) {
+    static GHashTable *table = NULL;
+
+    if (g_once_init_enter(&table)) {
+        GHashTable *set = g_hash_table_new(g_str_hash, g_str_equal);
+        for (gsize i = 0; stopwords[i]; i++) {
+            g_hash_table_add(set, (gpointer)stopwords[i]);
+        }
+        g_once_init_leave(&table, set);
+    }
+
+    return g_hash_table_contains(table, token);
+}
+
+GPtrArray* llm_text_tokenize(const gchar *text, gboolean skip_stopwords) {
+    GPtrArray *tokens = g_ptr_array_new_with_free_func(g_free);
+    GString *word = g_string_new(NULL);
+
+    if (!text) text = "";
+
+    for (const gchar *p = text; ; p = g_utf8_next_char(p)) {
+        gunichar c = *p ? g_utf8_get_char(p) : 0;
+
+        if (c && g_unichar_isalnum(c)) {
+            g_string_append_unichar(word, g_unichar_tolower(c));
+        } else if (word->len > 0) {
+            if (!skip_stopwords || !llm_text_is_stopword(word->str)) {
+                g_ptr_array_add(tokens, g_strndup(word->str, word->len));
+            }
+            g_string_truncate(word, 0);
+        }
+
+        if (!c) break;
+    }
+    g_string_free(word, TRUE);
+
+    return tokens;
+}
@@ -0,0 +1,28 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_TEXT_H
+#define LLM_TEXT_H
+
+#include <glib.h>
+
+/**
+ * Split text into lower-cased alphanumeric words
+ *
+ * @param text UTF-8 text
+ * @param skip_stopwords Drop common English/Dutch function words
+ * @return Array of newly allocated tokens. Free with g_ptr_array_unref()
+ */
+GPtrArray* llm_text_tokenize(const gchar *text, gboolean skip_stopwords);
+
+gboolean llm_text_is_stopword(const gchar *token);
+
+#endif /* LLM_TEXT_H */
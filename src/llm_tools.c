@@ -0,0 +1,608 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Local tools the model can call while writing a reply. They answer
+ * scheduling and contact questions from the user's calendars and address
+ * books through evolution-data-server; calls of one round run in parallel
+ * and their results are cached briefly.
+ */
+
+#include "llm_tools.h"
+#include <libedataserver/libedataserver.h>
+#include <libecal/libecal.h>
+#include <libebook/libebook.h>
+#include <string.h>
+
+typedef struct {
+    gint64 start; /* seconds since the epoch */
+    gint64 end;
+    gchar *summary;
+    gboolean all_day;
+    gboolean busy;
+} CalendarInstance;
+
+typedef struct {
+    gchar *result;
+    gint64 expires; /* monotonic time in microseconds */
+} CachedResult;
+
+typedef struct {
+    GMutex mutex;         /* guards results */
+    GMutex connect_mutex; /* guards connecting and the client arrays */
+    gboolean connected;
+    GPtrArray *calendars; /* EClient */
+    GPtrArray *books;     /* EClient */
+    GHashTable *results;  /* "name\narguments" -> CachedResult */
+} LLMTools;
+
+typedef struct {
+    LLMToolCall *call;
+    GCancellable *cancellable;
+} ToolJob;
+
+static void cached_result_free(CachedResult *cached) {
+    g_free(cached->result);
+    g_free(cached);
+}
+
+static gboolean cached_result_expired(gpointer key G_GNUC_UNUSED, gpointer value, gpointer user_data) {
+    return ((CachedResult *)value)->expires <= *(gint64 *)user_data;
+}
+
+static void calendar_instance_clear(CalendarInstance *instance) {
+    g_free(instance->summary);
+}
+
+LLMToolCall* llm_tool_call_new(const gchar *id, const gchar *name, const gchar *arguments) {
+    LLMToolCall *call = g_new0(LLMToolCall, 1);
+    call->id = g_strdup(id);
+    call->name = g_strdup(name);
+    call->arguments = g_strdup(arguments ? arguments : "");
+    return call;
+}
+
+void llm_tool_call_free(LLMToolCall *call) {
+    if (!call) return;
+
+    g_free(call->id);
+    g_free(call->name);
+    g_free(call->arguments);
+    g_free(call->result);
+    g_free(call);
+}
+
+static LLMTools* get_tools(void) {
+    static LLMTools *tools = NULL;
+
+    if (g_once_init_enter(&tools)) {
+        LLMTools *instance = g_new0(LLMTools, 1);
+        g_mutex_init(&instance->mutex);
+        g_mutex_init(&instance->connect_mutex);
+        instance->calendars = g_ptr_array_new_with_free_func(g_object_unref);
+        instance->books = g_ptr_array_new_with_free_func(g_object_unref);
+        instance->results = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                  (GDestroyNotify)cached_result_free);
+        g_once_init_leave(&tools, instance);
+    }
+
+    return tools;
+}
+
+/* Connect to every enabled calendar and address book once per process */
+static void connect_clients_locked(LLMTools *tools, GCancellable *cancellable) {
+    if (tools->connected) return;
+
+    GError *error = NULL;
+    ESourceRegistry *registry = e_source_registry_new_sync(cancellable, &error);
+    if (!registry) {
+        g_warning("LLM Tools: Cannot open the source registry: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    /* Built aside and only kept when connecting was not cancelled, so a
+     * later attempt does not add the same clients again */
+    GPtrArray *calendars = g_ptr_array_new_with_free_func(g_object_unref);
+    GPtrArray *books = g_ptr_array_new_with_free_func(g_object_unref);
+
+    GList *sources = e_source_registry_list_enabled(registry, E_SOURCE_EXTENSION_CALENDAR);
+    for (GList *link = sources; link; link = link->next) {
+        EClient *client = e_cal_client_connect_sync(link->data, E_CAL_CLIENT_SOURCE_TYPE_EVENTS,
+                                                    TOOLS_CONNECT_TIMEOUT_S, cancellable, &error);
+        if (client) {
+            g_ptr_array_add(calendars, client);
+        } else {
+            g_warning("LLM Tools: Cannot open calendar %s: %s",
+                      e_source_get_display_name(link->data), error->message);
+            g_clear_error(&error);
+        }
+    }
+    g_list_free_full(sources, g_object_unref);
+
+    sources = e_source_registry_list_enabled(registry, E_SOURCE_EXTENSION_ADDRESS_BOOK);
+    for (GList *link = sources; link; link = link->next) {
+        EClient *client = e_book_client_connect_sync(link->data, TOOLS_CONNECT_TIMEOUT_S,
+                                                     cancellable, &error);
+        if (client) {
+            g_ptr_array_add(books, client);
+        } else {
+            g_warning("LLM Tools: Cannot open address book %s: %s",
+                      e_source_get_display_name(link->data), error->message);
+            g_clear_error(&error);
+        }
+    }
+    g_list_free_full(sources, g_object_unref);
+
+    if (!g_cancellable_is_cancelled(cancellable)) {
+        g_print("LLM Tools: Connected to %u calendars and %u address books\n", calendars->len, books->len);
+        g_ptr_array_unref(tools->calendars);
+        g_ptr_array_unref(tools->books);
+        tools->calendars = g_ptr_array_ref(calendars);
+        tools->books = g_ptr_array_ref(books);
+        tools->connected = TRUE;
+    }
+
+    g_ptr_array_unref(calendars);
+    g_ptr_array_unref(books);
+    g_object_unref(registry);
+}
+
+static GPtrArray* copy_clients(GPtrArray *clients) {
+    GPtrArray *copy = g_ptr_array_new_full(clients->len, g_object_unref);
+    for (guint i = 0; i < clients->len; i++) {
+        g_ptr_array_add(copy, g_object_ref(g_ptr_array_index(clients, i)));
+    }
+    return copy;
+}
+
+/* Connect if needed and return references to the clients; the lock is
+ * only held while connecting, so tool calls query in parallel */
+static void ref_clients(LLMTools *tools, GCancellable *cancellable, GPtrArray **calendars, GPtrArray **books) {
+    g_mutex_lock(&tools->connect_mutex);
+    connect_clients_locked(tools, cancellable);
+    if (calendars) *calendars = copy_clients(tools->calendars);
+    if (books) *books = copy_clients(tools->books);
+    g_mutex_unlock(&tools->connect_mutex);
+}
+
+static void add_function(JsonBuilder *builder, const gchar *name, const gchar *description) {
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "function");
+    json_builder_set_member_name(builder, "function");
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "name");
+    json_builder_add_string_value(builder, name);
+    json_builder_set_member_name(builder, "description");
+    json_builder_add_string_value(builder, description);
+    json_builder_set_member_name(builder, "parameters");
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "object");
+    json_builder_set_member_name(builder, "properties");
+    json_builder_begin_object(builder);
+}
+
+static void add_parameter(JsonBuilder *builder, const gchar *name, const gchar *type, const gchar *description) {
+    json_builder_set_member_name(builder, name);
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, type);
+    json_builder_set_member_name(builder, "description");
+    json_builder_add_string_value(builder, description);
+    json_builder_end_object(builder);
+}
+
+static void end_function(JsonBuilder *builder, const gchar * const *required) {
+    json_builder_end_object(builder); /* properties */
+    json_builder_set_member_name(builder, "required");
+    json_builder_begin_array(builder);
+    for (guint i = 0; required[i]; i++) json_builder_add_string_value(builder, required[i]);
+    json_builder_end_array(builder);
+    json_builder_end_object(builder); /* parameters */
+    json_builder_end_object(builder); /* function */
+    json_builder_end_object(builder);
+}
+
+JsonNode* llm_tools_get_definitions(void) {
+    static const gchar * const date_range[] = { "start_date", "end_date", NULL };
+    static const gchar * const query[] = { "query", NULL };
+
+    GDateTime *now = g_date_time_new_now_local();
+    gchar *today = g_date_time_format(now, "%A %Y-%m-%d");
+    gchar *free_time_description = g_strdup_printf(
+        "Find the user's free time slots on weekdays between %02d:00 and %02d:00 from their calendars. "
+        "Today is %s. At most %d days.", TOOLS_WORKDAY_START_HOUR, TOOLS_WORKDAY_END_HOUR,
+        today, TOOLS_MAX_RANGE_DAYS);
+    gchar *events_description = g_strdup_printf(
+        "List the events in the user's calendars. Today is %s. At most %d days.", today, TOOLS_MAX_RANGE_DAYS);
+
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_array(builder);
+
+    add_function(builder, "find_free_time", free_time_description);
+    add_parameter(builder, "start_date", "string", "First day, YYYY-MM-DD");
+    add_parameter(builder, "end_date", "string", "Last day, YYYY-MM-DD (inclusive)");
+    add_parameter(builder, "duration_minutes", "integer", "Minimum length of a slot, default 30");
+    end_function(builder, date_range);
+
+    add_function(builder, "list_events", events_description);
+    add_parameter(builder, "start_date", "string", "First day, YYYY-MM-DD");
+    add_parameter(builder, "end_date", "string", "Last day, YYYY-MM-DD (inclusive)");
+    end_function(builder, date_range);
+
+    add_function(builder, "lookup_contact",
+                 "Look up people in the user's address books by name, email address or organization.");
+    add_parameter(builder, "query", "string", "Text to search for");
+    end_function(builder, query);
+
+    json_builder_end_array(builder);
+    JsonNode *definitions = json_builder_get_root(builder);
+
+    g_object_unref(builder);
+    g_free(events_description);
+    g_free(free_time_description);
+    g_free(today);
+    g_date_time_unref(now);
+
+    return definitions;
+}
+
+/* Local midnight of a YYYY-MM-DD date, or NULL */
+static GDateTime* parse_date(JsonObject *arguments, const gchar *member) {
+    const gchar *text = json_object_get_string_member_with_default(arguments, member, NULL);
+    gint year, month, day;
+
+    if (!text || sscanf(text, "%d-%d-%d", &year, &month, &day) != 3) return NULL;
+    if (!g_date_valid_dmy(day, month, year)) return NULL;
+
+    return g_date_time_new_local(year, month, day, 0, 0, 0);
+}
+
+static gint64 instance_time(ICalTime *time) {
+    ICalTimezone *zone = i_cal_time_get_timezone(time);
+    return i_cal_time_as_timet_with_zone(time, zone ? zone : e_cal_util_get_system_timezone());
+}
+
+static gboolean collect_instance(ICalComponent *icomp,
+                                 ICalTime *instance_start,
+                                 ICalTime *instance_end,
+                                 gpointer user_data,
+                                 GCancellable *cancellable G_GNUC_UNUSED,
+                                 GError **error G_GNUC_UNUSED) {
+    GArray *instances = user_data;
+    CalendarInstance instance = { 0 };
+
+    instance.start = instance_time(instance_start);
+    instance.end = instance_time(instance_end);
+    instance.summary = g_strdup(i_cal_component_get_summary(icomp));
+    instance.all_day = i_cal_time_is_date(instance_start);
+    instance.busy = TRUE;
+
+    ICalProperty *transp = i_cal_component_get_first_property(icomp, I_CAL_TRANSP_PROPERTY);
+    if (transp) {
+        instance.busy = i_cal_property_get_transp(transp) != I_CAL_TRANSP_TRANSPARENT;
+        g_object_unref(transp);
+    }
+
+    g_array_append_val(instances, instance);
+    return TRUE;
+}
+
+static gint compare_instances(gconstpointer a, gconstpointer b) {
+    const CalendarInstance *instance_a = a;
+    const CalendarInstance *instance_b = b;
+    return (instance_a->start > instance_b->start) - (instance_a->start < instance_b->start);
+}
+
+/* Instances of all calendars between the dates, sorted by start */
+static GArray* collect_calendar_range(LLMTools *tools, JsonObject *arguments,
+                                      GDateTime **range_start, gint *days,
+                                      GCancellable *cancellable, gchar **error_text) {
+    GDateTime *start = parse_date(arguments, "start_date");
+    GDateTime *last = parse_date(arguments, "end_date");
+
+    if (!start || !last || g_date_time_compare(last, start) < 0 ||
+        g_date_time_difference(last, start) >= (GTimeSpan)TOOLS_MAX_RANGE_DAYS * G_TIME_SPAN_DAY) {
+        *error_text = g_strdup_printf("Error: expected start_date and end_date as YYYY-MM-DD, "
+                                      "at most %d days apart", TOOLS_MAX_RANGE_DAYS);
+        if (start) g_date_time_unref(start);
+        if (last) g_date_time_unref(last);
+        return NULL;
+    }
+
+    GDateTime *end = g_date_time_add_days(last, 1);
+    GArray *instances = g_array_new(FALSE, TRUE, sizeof(CalendarInstance));
+    g_array_set_clear_func(instances, (GDestroyNotify)calendar_instance_clear);
+
+    GPtrArray *calendars = NULL;
+    ref_clients(tools, cancellable, &calendars, NULL);
+    for (guint i = 0; i < calendars->len; i++) {
+        e_cal_client_generate_instances_sync(E_CAL_CLIENT(g_ptr_array_index(calendars, i)),
+                                             g_date_time_to_unix(start), g_date_time_to_unix(end),
+                                             cancellable, collect_instance, instances);
+    }
+    if (calendars->len == 0) {
+        *error_text = g_strdup("Error: no calendar is available");
+    }
+    g_ptr_array_unref(calendars);
+
+    g_array_sort(instances, compare_instances);
+
+    *range_start = start;
+    *days = g_date_time_difference(last, start) / G_TIME_SPAN_DAY + 1;
+    g_date_time_unref(last);
+    g_date_time_unref(end);
+
+    return instances;
+}
+
+static void append_time_range(GString *text, gint64 start, gint64 end) {
+    GDateTime *start_time = g_date_time_new_from_unix_local(start);
+    GDateTime *end_time = g_date_time_new_from_unix_local(end);
+    gchar *day = g_date_time_format(start_time, "%a %Y-%m-%d");
+
+    g_string_append_printf(text, "%s %02d:%02d-%02d:%02d", day,
+                           g_date_time_get_hour(start_time), g_date_time_get_minute(start_time),
+                           g_date_time_get_hour(end_time), g_date_time_get_minute(end_time));
+
+    g_free(day);
+    g_date_time_unref(end_time);
+    g_date_time_unref(start_time);
+}
+
+static gchar* run_list_events(LLMTools *tools, JsonObject *arguments, GCancellable *cancellable) {
+    GDateTime *start = NULL;
+    gint days = 0;
+    gchar *error_text = NULL;
+    GArray *instances = collect_calendar_range(tools, arguments, &start, &days, cancellable, &error_text);
+    if (!instances) return error_text;
+
+    GString *text = g_string_new(NULL);
+    for (guint i = 0; i < instances->len; i++) {
+        CalendarInstance *instance = &g_array_index(instances, CalendarInstance, i);
+
+        if (instance->all_day) {
+            GDateTime *day = g_date_time_new_from_unix_local(instance->start);
+            gchar *date = g_date_time_format(day, "%a %Y-%m-%d");
+            g_string_append_printf(text, "%s all day", date);
+            g_free(date);
+            g_date_time_unref(day);
+        } else {
+            append_time_range(text, instance->start, instance->end);
+        }
+        g_string_append_printf(text, " %s%s\n", instance->summary ? instance->summary : "(no title)",
+                               instance->busy ? "" : " (free)");
+    }
+
+    if (text->len == 0) g_string_append(text, error_text ? error_text : "No events.");
+
+    g_free(error_text);
+    g_array_unref(instances);
+    g_date_time_unref(start);
+
+    return g_string_free(text, FALSE);
+}
+
+static gchar* run_find_free_time(LLMTools *tools, JsonObject *arguments, GCancellable *cancellable) {
+    GDateTime *start = NULL;
+    gint days = 0;
+    gchar *error_text = NULL;
+    GArray *instances = collect_calendar_range(tools, arguments, &start, &days, cancellable, &error_text);
+    if (!instances) return error_text;
+    if (error_text) {
+        g_array_unref(instances);
+        g_date_time_unref(start);
+        return error_text;
+    }
+
+    gint64 duration = json_object_get_int_member_with_default(arguments, "duration_minutes", 30) * 60;
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    GString *text = g_string_new(NULL);
+
+    for (gint d = 0; d < days; d++) {
+        GDateTime *date = g_date_time_add_days(start, d);
+        gint weekday = g_date_time_get_day_of_week(date);
+        if (weekday >= 6) {
+            g_date_time_unref(date);
+            continue;
+        }
+
+        GDateTime *day_start = g_date_time_new_local(g_date_time_get_year(date), g_date_time_get_month(date),
+                                                     g_date_time_get_day_of_month(date),
+                                                     TOOLS_WORKDAY_START_HOUR, 0, 0);
+        GDateTime *day_end = g_date_time_new_local(g_date_time_get_year(date), g_date_time_get_month(date),
+                                                   g_date_time_get_day_of_month(date),
+                                                   TOOLS_WORKDAY_END_HOUR, 0, 0);
+        gint64 slot_start = MAX(g_date_time_to_unix(day_start), now);
+        gint64 window_end = g_date_time_to_unix(day_end);
+
+        /* Walk the busy instances in start order, emitting the gaps between them */
+        for (guint i = 0; i < instances->len && slot_start < window_end; i++) {
+            CalendarInstance *instance = &g_array_index(instances, CalendarInstance, i);
+            if (!instance->busy || instance->end <= slot_start || instance->start >= window_end) continue;
+
+            if (instance->start - slot_start >= duration) {
+                append_time_range(text, slot_start, instance->start);
+                g_string_append_c(text, '\n');
+            }
+            slot_start = MAX(slot_start, instance->end);
+        }
+        if (window_end - slot_start >= duration) {
+            append_time_range(text, slot_start, window_end);
+            g_string_append_c(text, '\n');
+        }
+
+        g_date_time_unref(day_end);
+        g_date_time_unref(day_start);
+        g_date_time_unref(date);
+    }
+
+    if (text->len == 0) g_string_append(text, "No free time in this range.");
+
+    g_array_unref(instances);
+    g_date_time_unref(start);
+
+    return g_string_free(text, FALSE);
+}
+
+static void append_contact(GString *text, EContact *contact) {
+    const gchar *name = e_contact_get_const(contact, E_CONTACT_FULL_NAME);
+    g_string_append(text, name ? name : "(no name)");
+
+    GList *emails = e_contact_get(contact, E_CONTACT_EMAIL);
+    for (GList *link = emails; link; link = link->next) {
+        g_string_append_printf(text, "%s%s", link == emails ? " <" : ", ", (const gchar *)link->data);
+        if (!link->next) g_string_append_c(text, '>');
+    }
+    g_list_free_full(emails, g_free);
+
+    static const struct {
+        EContactField field;
+        const gchar *label;
+    } details[] = {
+        { E_CONTACT_ORG, "organization" },
+        { E_CONTACT_TITLE, "title" },
+        { E_CONTACT_PHONE_BUSINESS, "work phone" },
+        { E_CONTACT_PHONE_MOBILE, "mobile" },
+    };
+    for (gsize i = 0; i < G_N_ELEMENTS(details); i++) {
+        const gchar *value = e_contact_get_const(contact, details[i].field);
+        if (value && *value) g_string_append_printf(text, "; %s: %s", details[i].label, value);
+    }
+    g_string_append_c(text, '\n');
+}
+
+static gchar* run_lookup_contact(LLMTools *tools, JsonObject *arguments, GCancellable *cancellable) {
+    const gchar *query = json_object_get_string_member_with_default(arguments, "query", NULL);
+    if (!query || !*query) return g_strdup("Error: expected a query");
+
+    EBookQuery *book_query = e_book_query_any_field_contains(query);
+    gchar *sexp = e_book_query_to_string(book_query);
+    e_book_query_unref(book_query);
+
+    GString *text = g_string_new(NULL);
+    guint found = 0;
+
+    GPtrArray *books = NULL;
+    ref_clients(tools, cancellable, NULL, &books);
+    for (guint i = 0; i < books->len && found < TOOLS_MAX_CONTACTS; i++) {
+        GSList *contacts = NULL;
+        GError *error = NULL;
+
+        if (!e_book_client_get_contacts_sync(E_BOOK_CLIENT(g_ptr_array_index(books, i)),
+                                             sexp, &contacts, cancellable, &error)) {
+            g_warning("LLM Tools: Contact search failed: %s", error->message);
+            g_error_free(error);
+            continue;
+        }
+
+        for (GSList *link = contacts; link && found < TOOLS_MAX_CONTACTS; link = link->next, found++) {
+            append_contact(text, link->data);
+        }
+        g_slist_free_full(contacts, g_object_unref);
+    }
+    g_ptr_array_unref(books);
+    g_free(sexp);
+
+    if (found == 0) g_string_append(text, "No matching contacts.");
+    return g_string_free(text, FALSE);
+}
+
+static gchar* run_tool(LLMTools *tools, LLMToolCall *call, GCancellable *cancellable) {
+    JsonParser *parser = json_parser_new();
+    JsonObject *arguments = NULL;
+
+    /* Models send an empty string for a call without arguments */
+    if (json_parser_load_from_data(parser, *call->arguments ? call->arguments : "{}", -1, NULL) &&
+        JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser))) {
+        arguments = json_node_get_object(json_parser_get_root(parser));
+    }
+
+    gchar *result;
+    if (!arguments) {
+        result = g_strdup("Error: arguments are not a JSON object");
+    } else if (g_strcmp0(call->name, "find_free_time") == 0) {
+        result = run_find_free_time(tools, arguments, cancellable);
+    } else if (g_strcmp0(call->name, "list_events") == 0) {
+        result = run_list_events(tools, arguments, cancellable);
+    } else if (g_strcmp0(call->name, "lookup_contact") == 0) {
+        result = run_lookup_contact(tools, arguments, cancellable);
+    } else {
+        result = g_strdup_printf("Error: unknown tool %s", call->name);
+    }
+
+    g_object_unref(parser);
+    return result;
+}
+
+static gpointer tool_thread(gpointer user_data) {
+    ToolJob *job = user_data;
+
+    job->call->result = run_tool(get_tools(), job->call, job->cancellable);
+    return NULL;
+}
+
+void llm_tools_execute(GPtrArray *calls, guint ttl_s, GCancellable *cancellable) {
+    if (!calls) return;
+
+    LLMTools *tools = get_tools();
+    gint64 now = g_get_monotonic_time();
+    GPtrArray *threads = g_ptr_array_new();
+    ToolJob *jobs = g_new0(ToolJob, calls->len);
+
+    g_mutex_lock(&tools->mutex);
+    for (guint i = 0; i < calls->len; i++) {
+        LLMToolCall *call = g_ptr_array_index(calls, i);
+        gchar *key = g_strconcat(call->name, "\n", call->arguments, NULL);
+        CachedResult *cached = g_hash_table_lookup(tools->results, key);
+        g_free(key);
+
+        if (cached && cached->expires > now) {
+            call->result = g_strdup(cached->result);
+        }
+    }
+    g_mutex_unlock(&tools->mutex);
+
+    for (guint i = 0; i < calls->len; i++) {
+        LLMToolCall *call = g_ptr_array_index(calls, i);
+        if (call->result) continue;
+
+        jobs[i].call = call;
+        jobs[i].cancellable = cancellable;
+        g_ptr_array_add(threads, g_thread_new("llm-tool", tool_thread, &jobs[i]));
+    }
+
+    for (guint i = 0; i < threads->len; i++) {
+        g_thread_join(g_ptr_array_index(threads, i));
+    }
+    g_print("LLM Tools: Ran %u of %u tool calls, %.1f ms\n", threads->len, calls->len,
+            (g_get_monotonic_time() - now) / 1000.0);
+
+    if (ttl_s > 0 && threads->len > 0) {
+        g_mutex_lock(&tools->mutex);
+        now = g_get_monotonic_time();
+        g_hash_table_foreach_remove(tools->results, cached_result_expired, &now);
+        for (guint i = 0; i < calls->len; i++) {
+            if (!jobs[i].call || g_cancellable_is_cancelled(cancellable)) continue;
+
+            CachedResult *cached = g_new0(CachedResult, 1);
+            cached->result = g_strdup(jobs[i].call->result);
+            cached->expires = now + (gint64)ttl_s * G_USEC_PER_SEC;
+            g_hash_table_replace(tools->results,
+                                 g_strconcat(jobs[i].call->name, "\n", jobs[i].call->arguments, NULL),
+                                 cached);
+        }
+        g_mutex_unlock(&tools->mutex);
+    }
+
+    g_ptr_array_unref(threads);
+    g_free(jobs);
+}
@@ -0,0 +1,59 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_TOOLS_H
+#define LLM_TOOLS_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+
+#define TOOLS_MAX_ROUNDS 2          /* model round trips that may request tools */
+#define TOOLS_MAX_RANGE_DAYS 31
+#define TOOLS_WORKDAY_START_HOUR 9  /* free time is only offered on weekdays within these hours */
+#define TOOLS_WORKDAY_END_HOUR 17
+#define TOOLS_MAX_CONTACTS 5
+#define TOOLS_CONNECT_TIMEOUT_S 10
+
+typedef struct {
+    gchar *id;        /* chosen by the model, echoed in the result message */
+    gchar *name;
+    gchar *arguments; /* JSON object, possibly empty */
+    gchar *result;    /* set by llm_tools_execute() */
+} LLMToolCall;
+
+LLMToolCall* llm_tool_call_new(const gchar *id, const gchar *name, const gchar *arguments);
+void llm_tool_call_free(LLMToolCall *call);
+
+/**
+ * Build the chat completions "tools" array
+ *
+ * Describes find_free_time and list_events, which read the enabled
+ * calendars, and lookup_contact, which searches the enabled address books.
+ *
+ * @return New JSON array node; free with json_node_free()
+ */
+JsonNode* llm_tools_get_definitions(void);
+
+/**
+ * Run tool calls against evolution-data-server, each in its own thread
+ *
+ * Blocks until every call has a result. Results are cached for ttl_s
+ * seconds by tool name and arguments, so a follow-up question in the next
+ * minutes does not query the calendars again. Errors are reported to the
+ * model in the result text.
+ *
+ * @param calls Array of LLMToolCall; result is set on each
+ * @param ttl_s Lifetime of cached results; 0 disables the cache
+ */
+void llm_tools_execute(GPtrArray *calls, guint ttl_s, GCancellable *cancellable);
+
+#endif /* LLM_TOOLS_H */
@@ -0,0 +1,428 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Local triage classifier. A multinomial logistic regression over hashed word
+ * unigrams and bigrams that recognises routine mail (out-of-office replies,
+ * newsletters, notifications) so no tokens are spent generating replies to it.
+ */
+
+#include "llm_triage.h"
+#include "llm_text.h"
+#include "../config/config.h"
+#include <gio/gio.h>
+#include <math.h>
+#include <string.h>
+
+#define TRIAGE_MAGIC "LLMTRIA1"
+#define TRIAGE_DIM_BITS 18
+#define TRIAGE_DIM (1u << TRIAGE_DIM_BITS)
+#define TRIAGE_MAX_TEXT 8192
+#define TRIAGE_MAX_EXAMPLES_PER_LABEL 5000
+#define TRIAGE_EPOCHS 5
+
+typedef struct {
+    guint32 index;
+    gfloat value; /* signed, see add_feature() */
+} Feature;
+
+typedef struct {
+    guint label;
+    GArray *features;
+} Example;
+
+struct _LLMTriageModel {
+    GPtrArray *labels; /* gchar* */
+    gfloat *bias;      /* n_labels */
+    gfloat *weights;   /* n_labels * TRIAGE_DIM, row per label */
+};
+
+static guint32 hash_string(const gchar *s, guint32 seed) {
+    guint32 h = 0x811c9dc5u ^ seed;
+
+    for (; *s; s++) {
+        h ^= (guchar)*s;
+        h *= 0x01000193u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+/* The top hash bit picks the sign, which keeps collisions unbiased */
+static void add_feature(GArray *features, guint32 hash) {
+    Feature feature = {
+        .index = hash & (TRIAGE_DIM - 1),
+        .value = (hash & 0x80000000u) ? -1.0f : 1.0f,
+    };
+    g_array_append_val(features, feature);
+}
+
+static void add_ngrams(GArray *features, const gchar *text, guint32 seed) {
+    GPtrArray *tokens = llm_text_tokenize(text, FALSE);
+    guint32 previous = 0;
+
+    for (guint i = 0; i < tokens->len; i++) {
+        guint32 hash = hash_string(g_ptr_array_index(tokens, i), seed);
+        add_feature(features, hash);
+        if (i > 0) add_feature(features, (previous * 0x9e3779b1u) ^ hash ^ 0x5bd1e995u);
+        previous = hash;
+    }
+
+    g_ptr_array_unref(tokens);
+}
+
+/*
+ * Headers, when present, contribute their names ("list-unsubscribe",
+ * "auto-submitted") and the words of their values in a separate feature
+ * space from the body text.
+ */
+static GArray* extract_features(const gchar *text) {
+    GArray *features = g_array_new(FALSE, FALSE, sizeof(Feature));
+    gsize length = strlen(text);
+    gchar *valid = g_utf8_make_valid(text, MIN(length, TRIAGE_MAX_TEXT));
+    const gchar *body = valid;
+
+    if (g_regex_match_simple("^[A-Za-z][A-Za-z0-9-]*:", valid, 0, 0)) {
+        const gchar *end = strstr(valid, "\n\n");
+        gchar *headers = end ? g_strndup(valid, end - valid) : g_strdup(valid);
+        gchar **lines = g_strsplit(headers, "\n", -1);
+
+        for (gsize i = 0; lines[i]; i++) {
+            gchar *colon = strchr(lines[i], ':');
+            if (!colon || lines[i][0] == ' ' || lines[i][0] == '\t') continue;
+
+            gchar *name = g_ascii_strdown(lines[i], colon - lines[i]);
+            add_feature(features, hash_string(name, 0x68656164u));
+            add_ngrams(features, colon + 1, 0x76616c75u);
+            g_free(name);
+        }
+
+        g_strfreev(lines);
+        g_free(headers);
+        body = end ? end + 2 : valid + strlen(valid);
+    }
+
+    add_ngrams(features, body, 0);
+
+    /* Normalize so long messages do not dominate the updates */
+    if (features->len > 0) {
+        gfloat scale = 1.0f / sqrtf((gfloat)features->len);
+        for (guint i = 0; i < features->len; i++) {
+            g_array_index(features, Feature, i).value *= scale;
+        }
+    }
+
+    g_free(valid);
+    return features;
+}
+
+static void compute_probabilities(LLMTriageModel *model, GArray *features, gdouble *probabilities) {
+    guint n_labels = model->labels->len;
+    gdouble max_score = -G_MAXDOUBLE;
+
+    for (guint l = 0; l < n_labels; l++) {
+        const gfloat *row = model->weights + (gsize)l * TRIAGE_DIM;
+        gdouble score = model->bias[l];
+
+        for (guint f = 0; f < features->len; f++) {
+            const Feature *feature = &g_array_index(features, Feature, f);
+            score += row[feature->index] * feature->value;
+        }
+
+        probabilities[l] = score;
+        max_score = MAX(max_score, score);
+    }
+
+    gdouble sum = 0.0;
+    for (guint l = 0; l < n_labels; l++) {
+        probabilities[l] = exp(probabilities[l] - max_score);
+        sum += probabilities[l];
+    }
+    for (guint l = 0; l < n_labels; l++) {
+        probabilities[l] /= sum;
+    }
+}
+
+static LLMTriageModel* triage_model_new(GPtrArray *labels) {
+    LLMTriageModel *model = g_new0(LLMTriageModel, 1);
+    model->labels = labels;
+    model->bias = g_new0(gfloat, labels->len);
+    model->weights = g_new0(gfloat, (gsize)labels->len * TRIAGE_DIM);
+    return model;
+}
+
+void llm_triage_model_free(LLMTriageModel *model) {
+    if (!model) return;
+
+    g_ptr_array_unref(model->labels);
+    g_free(model->bias);
+    g_free(model->weights);
+    g_free(model);
+}
+
+/* Add every message below path: single-message files or mbox files */
+static void collect_messages(const gchar *path, GPtrArray *messages) {
+    if (messages->len >= TRIAGE_MAX_EXAMPLES_PER_LABEL) return;
+
+    if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+        GDir *dir = g_dir_open(path, 0, NULL);
+        if (!dir) return;
+
+        const gchar *name;
+        while ((name = g_dir_read_name(dir)) != NULL) {
+            if (name[0] == '.') continue;
+            gchar *child = g_build_filename(path, name, NULL);
+            collect_messages(child, messages);
+            g_free(child);
+        }
+        g_dir_close(dir);
+        return;
+    }
+
+    gchar *contents = NULL;
+    if (!g_file_get_contents(path, &contents, NULL, NULL)) return;
+
+    if (g_str_has_prefix(contents, "From ")) {
+        /* mbox: every line starting with "From " begins a new message */
+        const gchar *start = contents;
+        while (start && messages->len < TRIAGE_MAX_EXAMPLES_PER_LABEL) {
+            const gchar *body = strchr(start, '\n');
+            if (!body) break;
+            body++;
+
+            const gchar *next = strstr(body, "\nFrom ");
+            g_ptr_array_add(messages, next ? g_strndup(body, next - body) : g_strdup(body));
+            start = next ? next + 1 : NULL;
+        }
+        g_free(contents);
+    } else {
+        g_ptr_array_add(messages, contents);
+    }
+}
+
+static void example_clear(Example *example) {
+    g_array_unref(example->features);
+}
+
+LLMTriageModel* llm_triage_model_train(const gchar *training_dir, GError **error) {
+    GDir *dir = g_dir_open(training_dir, 0, error);
+    if (!dir) return NULL;
+
+    GPtrArray *labels = g_ptr_array_new_with_free_func(g_free);
+    GArray *examples = g_array_new(FALSE, FALSE, sizeof(Example));
+    g_array_set_clear_func(examples, (GDestroyNotify)example_clear);
+
+    const gchar *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        gchar *label_dir = g_build_filename(training_dir, name, NULL);
+
+        if (name[0] != '.' && g_file_test(label_dir, G_FILE_TEST_IS_DIR)) {
+            GPtrArray *messages = g_ptr_array_new_with_free_func(g_free);
+            collect_messages(label_dir, messages);
+
+            if (messages->len > 0) {
+                guint label = labels->len;
+                g_ptr_array_add(labels, g_strdup(name));
+
+                for (guint i = 0; i < messages->len; i++) {
+                    Example example = { label, extract_features(g_ptr_array_index(messages, i)) };
+                    g_array_append_val(examples, example);
+                }
+                g_print("LLM Triage: %u examples labelled '%s'\n", messages->len, name);
+            }
+            g_ptr_array_unref(messages);
+        }
+        g_free(label_dir);
+    }
+    g_dir_close(dir);
+
+    if (labels->len < 2) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "Training needs at least two labelled folders with messages in %s",
+                    training_dir);
+        g_ptr_array_unref(labels);
+        g_array_unref(examples);
+        return NULL;
+    }
+
+    LLMTriageModel *model = triage_model_new(labels);
+    guint n_labels = labels->len;
+    gdouble *probabilities = g_new(gdouble, n_labels);
+    guint *order = g_new(guint, examples->len);
+    GRand *rand = g_rand_new_with_seed(42);
+
+    for (guint i = 0; i < examples->len; i++) order[i] = i;
+
+    /* Stochastic gradient descent on the softmax cross-entropy loss */
+    for (guint epoch = 0; epoch < TRIAGE_EPOCHS; epoch++) {
+        gdouble rate = 0.5 / (1.0 + epoch);
+
+        for (guint i = examples->len; i > 1; i--) {
+            guint j = g_rand_int_range(rand, 0, i);
+            guint tmp = order[i - 1];
+            order[i - 1] = order[j];
+            order[j] = tmp;
+        }
+
+        for (guint i = 0; i < examples->len; i++) {
+            Example *example = &g_array_index(examples, Example, order[i]);
+            compute_probabilities(model, example->features, probabilities);
+
+            for (guint l = 0; l < n_labels; l++) {
+                gdouble gradient = probabilities[l] - (l == example->label ? 1.0 : 0.0);
+                gfloat *row = model->weights + (gsize)l * TRIAGE_DIM;
+
+                model->bias[l] -= rate * gradient;
+                for (guint f = 0; f < example->features->len; f++) {
+                    const Feature *feature = &g_array_index(example->features, Feature, f);
+                    row[feature->index] -= rate * gradient * feature->value;
+                }
+            }
+        }
+    }
+
+    g_rand_free(rand);
+    g_free(order);
+    g_free(probabilities);
+    g_array_unref(examples);
+
+    return model;
+}
+
+gboolean llm_triage_model_save(LLMTriageModel *model, const gchar *path, GError **error) {
+    g_return_val_if_fail(model != NULL, FALSE);
+
+    GByteArray *data = g_byte_array_new();
+    guint32 n_labels = model->labels->len;
+    guint32 dim_bits = TRIAGE_DIM_BITS;
+
+    g_byte_array_append(data, (const guint8 *)TRIAGE_MAGIC, 8);
+    g_byte_array_append(data, (const guint8 *)&n_labels, sizeof(n_labels));
+    g_byte_array_append(data, (const guint8 *)&dim_bits, sizeof(dim_bits));
+
+    for (guint l = 0; l < n_labels; l++) {
+        const gchar *label = g_ptr_array_index(model->labels, l);
+        guint32 length = strlen(label);
+        g_byte_array_append(data, (const guint8 *)&length, sizeof(length));
+        g_byte_array_append(data, (const guint8 *)label, length);
+    }
+
+    g_byte_array_append(data, (const guint8 *)model->bias, n_labels * sizeof(gfloat));
+    g_byte_array_append(data, (const guint8 *)model->weights,
+                        (gsize)n_labels * TRIAGE_DIM * sizeof(gfloat));
+
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    gboolean result = g_file_set_contents(path, (const gchar *)data->data, data->len, error);
+    g_byte_array_unref(data);
+
+    return result;
+}
+
+LLMTriageModel* llm_triage_model_load(const gchar *path, GError **error) {
+    gchar *contents = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents(path, &contents, &length, error)) return NULL;
+
+    const gchar *p = contents;
+    const gchar *end = contents + length;
+    guint32 n_labels = 0, dim_bits = 0;
+    LLMTriageModel *model = NULL;
+
+    if (length < 16 || memcmp(p, TRIAGE_MAGIC, 8) != 0) goto invalid;
+    p += 8;
+    memcpy(&n_labels, p, sizeof(n_labels));
+    p += sizeof(n_labels);
+    memcpy(&dim_bits, p, sizeof(dim_bits));
+    p += sizeof(dim_bits);
+
+    if (dim_bits != TRIAGE_DIM_BITS || n_labels < 2 || n_labels > 64) goto invalid;
+
+    GPtrArray *labels = g_ptr_array_new_with_free_func(g_free);
+    for (guint l = 0; l < n_labels; l++) {
+        guint32 label_length;
+        if ((gsize)(end - p) < sizeof(label_length)) break;
+        memcpy(&label_length, p, sizeof(label_length));
+        p += sizeof(label_length);
+        if ((gsize)(end - p) < label_length) break;
+        g_ptr_array_add(labels, g_strndup(p, label_length));
+        p += label_length;
+    }
+
+    gsize weights_size = ((gsize)n_labels * TRIAGE_DIM + n_labels) * sizeof(gfloat);
+    if (labels->len != n_labels || (gsize)(end - p) != weights_size) {
+        g_ptr_array_unref(labels);
+        goto invalid;
+    }
+
+    model = triage_model_new(labels);
+    memcpy(model->bias, p, n_labels * sizeof(gfloat));
+    memcpy(model->weights, p + n_labels * sizeof(gfloat), (gsize)n_labels * TRIAGE_DIM * sizeof(gfloat));
+
+    g_free(contents);
+    return model;
+
+invalid:
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s is not a valid triage model", path);
+    g_free(contents);
+    return NULL;
+}
+
+gchar* llm_triage_get_model_path(void) {
+    return g_build_filename(g_get_user_cache_dir(), CONFIG_DIR_NAME, TRIAGE_MODEL_FILE_NAME, NULL);
+}
+
+const gchar* llm_triage_model_classify(LLMTriageModel *model, const gchar *text, gdouble *confidence) {
+    g_return_val_if_fail(model != NULL, NULL);
+
+    GArray *features = extract_features(text ? text : "");
+    gdouble *probabilities = g_new(gdouble, model->labels->len);
+    guint best = 0;
+
+    compute_probabilities(model, features, probabilities);
+    for (guint l = 1; l < model->labels->len; l++) {
+        if (probabilities[l] > probabilities[best]) best = l;
+    }
+
+    if (confidence) *confidence = probabilities[best];
+
+    g_free(probabilities);
+    g_array_unref(features);
+
+    return g_ptr_array_index(model->labels, best);
+}
+
+gboolean llm_triage_label_wants_reply(const gchar *label,
+                                      gdouble confidence,
+                                      const gchar *reply_label,
+                                      gdouble min_confidence) {
+    return g_strcmp0(label, reply_label ? reply_label : DEFAULT_TRIAGE_REPLY_LABEL) == 0 ||
+           confidence < min_confidence;
+}
+
+gboolean llm_triage_should_generate(LLMTriageModel *model,
+                                    const gchar *text,
+                                    const gchar *reply_label,
+                                    gdouble min_confidence) {
+    if (!model) return TRUE;
+
+    gdouble confidence = 0.0;
+    const gchar *label = llm_triage_model_classify(model, text, &confidence);
+
+    return llm_triage_label_wants_reply(label, confidence, reply_label, min_confidence);
+}
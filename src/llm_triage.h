@@ -0,0 +1,73 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ */
+
+#ifndef LLM_TRIAGE_H
+#define LLM_TRIAGE_H
+
+#include <glib.h>
+
+#define TRIAGE_MODEL_FILE_NAME "triage.model"
+
+typedef struct _LLMTriageModel LLMTriageModel;
+
+/**
+ * Train a classifier from a directory of labelled mail
+ *
+ * Every subdirectory is a label ("reply", "newsletter", "out-of-office", ...)
+ * and holds messages as single files (e.g. a Maildir) or mbox files.
+ * Subdirectories are searched recursively.
+ *
+ * @param training_dir Directory with one subdirectory per label
+ * @param error Return location for an error
+ * @return The trained model, or NULL if fewer than two labels have examples
+ */
+LLMTriageModel* llm_triage_model_train(const gchar *training_dir, GError **error);
+
+LLMTriageModel* llm_triage_model_load(const gchar *path, GError **error);
+gboolean llm_triage_model_save(LLMTriageModel *model, const gchar *path, GError **error);
+void llm_triage_model_free(LLMTriageModel *model);
+
+/**
+ * Path of the trained model in ~/.cache/evolution-llm-assistant/
+ *
+ * @return Newly allocated path
+ */
+gchar* llm_triage_get_model_path(void);
+
+/**
+ * Classify a message
+ *
+ * @param text Message body, optionally preceded by its headers
+ * @param confidence Optional return location for the label's probability
+ * @return The most likely label, owned by the model
+ */
+const gchar* llm_triage_model_classify(LLMTriageModel *model, const gchar *text, gdouble *confidence);
+
+/**
+ * Decide whether a message is worth spending a generation on
+ *
+ * Messages are skipped only when the classifier picks a label other than
+ * @reply_label with at least @min_confidence.
+ */
+gboolean llm_triage_should_generate(LLMTriageModel *model,
+                                    const gchar *text,
+                                    const gchar *reply_label,
+                                    gdouble min_confidence);
+
+/**
+ * The same decision for a label llm_triage_model_classify() already returned
+ */
+gboolean llm_triage_label_wants_reply(const gchar *label,
+                                      gdouble confidence,
+                                      const gchar *reply_label,
+                                      gdouble min_confidence);
+
+#endif /* LLM_TRIAGE_H */
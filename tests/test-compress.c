@@ -0,0 +1,94 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Prompt compression must shorten a mail without changing what it asks.
+ */
+
+#include "../src/llm_compress.h"
+#include <string.h>
+
+/* Repeat a sentence until the text is long enough to be compressed */
+static gchar* repeat_sentence(const gchar *sentence) {
+    GString *text = g_string_new(NULL);
+    guint words = 0;
+    gchar **split = g_strsplit(sentence, " ", -1);
+    guint sentence_words = g_strv_length(split);
+    g_strfreev(split);
+
+    while (words < COMPRESS_MIN_WORDS) {
+        g_string_append(text, sentence);
+        g_string_append_c(text, ' ');
+        words += sentence_words;
+    }
+
+    return g_string_free(text, FALSE);
+}
+
+/* Every sentence left after compression still holds each of the words */
+static void assert_sentences_keep(const gchar *sentence, const gchar * const *keep) {
+    gchar *text = repeat_sentence(sentence);
+    LLMCompressStats stats;
+    gchar *compressed = llm_compress_text(text, 0.5, NULL, &stats);
+
+    g_assert_cmpuint(stats.words_out, <, stats.words_in);
+
+    gchar **sentences = g_strsplit(compressed, ".", -1);
+    guint kept = 0;
+    for (gchar **s = sentences; *s; s++) {
+        gchar *stripped = g_strstrip(g_strdup(*s));
+        if (*stripped) {
+            gchar *padded = g_strdup_printf(" %s ", stripped);
+            for (const gchar * const *word = keep; *word; word++) {
+                gchar *needle = g_strdup_printf(" %s ", *word);
+                g_assert_nonnull(strstr(padded, needle));
+                g_free(needle);
+            }
+            g_free(padded);
+            kept++;
+        }
+        g_free(stripped);
+    }
+    g_assert_cmpuint(kept, >, 0);
+
+    g_strfreev(sentences);
+    g_free(compressed);
+    g_free(text);
+}
+
+static void test_negation_kept(void) {
+    const gchar *keep[] = { "will", "not", "if", NULL };
+    assert_sentences_keep("the parcel will not leave if the invoice is open.", keep);
+}
+
+static void test_negation_kept_dutch(void) {
+    const gchar *keep[] = { "niet", "als", NULL };
+    assert_sentences_keep("het pakket gaat niet weg als de factuur open staat.", keep);
+}
+
+/* At the highest ratio only two sentences are left, with room to trim both */
+static void test_filler_removed(void) {
+    gchar *text = repeat_sentence("the parcel will not leave if the invoice is open.");
+    gchar *compressed = llm_compress_text(text, 0.9, NULL, NULL);
+
+    g_assert_null(strstr(compressed, "the "));
+
+    g_free(compressed);
+    g_free(text);
+}
+
+int main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/compress/negation-kept", test_negation_kept);
+    g_test_add_func("/compress/negation-kept-dutch", test_negation_kept_dutch);
+    g_test_add_func("/compress/filler-removed", test_filler_removed);
+
+    return g_test_run();
+}
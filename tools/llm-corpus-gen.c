@@ -0,0 +1,567 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Generator of synthetic mail corpora for llm-load-gen. Writes threads of
+ * RFC 5322 messages, one .eml file each, with replies that quote what they
+ * answer, HTML alternatives, attachments, recurring signatures and
+ * disclaimers, in a mix of languages. The same seed gives the same corpus.
+ *
+ *   llm-corpus-gen --threads=500 --max-depth=8 --html-ratio=0.5 --languages=en:3,de:1 corpus/
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_PARTICIPANTS 3
+
+typedef struct {
+    const gchar *code;
+    const gchar *greetings[4];   /* %s is the recipient's first name */
+    const gchar *closings[3];
+    const gchar *subjects[6];
+    const gchar *sentences[12];
+    const gchar *wrote;          /* %s is the date, %s the sender */
+    const gchar *reply_prefix;
+    const gchar *disclaimer;
+} Language;
+
+static const Language languages[] = {
+    { "en",
+      { "Hi %s,", "Hello %s,", "Dear %s,", "%s," },
+      { "Best regards,", "Thanks,", "Cheers," },
+      { "Quarterly report", "Meeting next week", "Invoice 2024-117", "Project timeline",
+        "Question about the contract", "Travel arrangements" },
+      { "Could you send me the updated figures by Friday?",
+        "I have attached the latest version for your review.",
+        "The client asked whether we can move the deadline to the end of the month.",
+        "Let me know if Tuesday afternoon works for you.",
+        "We still need sign-off from legal before we can proceed.",
+        "Thanks for the quick turnaround on this.",
+        "I am not sure the budget covers the additional licences.",
+        "The numbers in the second table do not match the summary.",
+        "Can we schedule a short call to go through the open points?",
+        "I will be out of the office on Monday but reachable by phone.",
+        "Please confirm the delivery address before we place the order.",
+        "The team agreed to go ahead with the second option." },
+      "On %s, %s wrote:", "Re: ",
+      "This email and any attachments are confidential and intended solely for the addressee. "
+      "If you have received it in error, please notify the sender and delete it." },
+    { "de",
+      { "Hallo %s,", "Liebe/r %s,", "Guten Tag %s,", "Hi %s," },
+      { "Viele Grüße", "Beste Grüße", "Danke und Gruß" },
+      { "Quartalsbericht", "Termin nächste Woche", "Rechnung 2024-117", "Projektplan",
+        "Frage zum Vertrag", "Reiseplanung" },
+      { "Könntest du mir die aktualisierten Zahlen bis Freitag schicken?",
+        "Anbei die neueste Version zur Durchsicht.",
+        "Der Kunde fragt, ob wir die Frist auf Ende des Monats verschieben können.",
+        "Passt dir Dienstagnachmittag?",
+        "Wir brauchen noch die Freigabe der Rechtsabteilung.",
+        "Danke für die schnelle Rückmeldung.",
+        "Ich bin nicht sicher, ob das Budget die zusätzlichen Lizenzen abdeckt.",
+        "Die Zahlen in der zweiten Tabelle passen nicht zur Zusammenfassung.",
+        "Können wir kurz telefonieren, um die offenen Punkte zu klären?",
+        "Am Montag bin ich nicht im Büro, aber telefonisch erreichbar.",
+        "Bitte bestätige die Lieferadresse, bevor wir bestellen.",
+        "Das Team hat sich für die zweite Variante entschieden." },
+      "Am %s schrieb %s:", "AW: ",
+      "Diese E-Mail enthält vertrauliche Informationen. Wenn Sie nicht der richtige Adressat sind, "
+      "informieren Sie bitte sofort den Absender und vernichten Sie diese E-Mail." },
+    { "fr",
+      { "Bonjour %s,", "Salut %s,", "Cher %s,", "%s," },
+      { "Cordialement,", "Merci,", "Bien à vous," },
+      { "Rapport trimestriel", "Réunion la semaine prochaine", "Facture 2024-117",
+        "Calendrier du projet", "Question sur le contrat", "Organisation du voyage" },
+      { "Pourrais-tu m'envoyer les chiffres mis à jour d'ici vendredi ?",
+        "Vous trouverez ci-joint la dernière version.",
+        "Le client demande si nous pouvons repousser l'échéance à la fin du mois.",
+        "Est-ce que mardi après-midi te convient ?",
+        "Nous attendons encore la validation du service juridique.",
+        "Merci pour ta réponse rapide.",
+        "Je ne suis pas sûr que le budget couvre les licences supplémentaires.",
+        "Les chiffres du deuxième tableau ne correspondent pas au résumé.",
+        "Pouvons-nous prévoir un court appel pour passer en revue les points ouverts ?",
+        "Je serai absent lundi mais joignable par téléphone.",
+        "Merci de confirmer l'adresse de livraison avant la commande.",
+        "L'équipe a choisi la deuxième option." },
+      "Le %s, %s a écrit :", "RE: ",
+      "Ce message et ses pièces jointes sont confidentiels. Si vous l'avez reçu par erreur, "
+      "merci de prévenir l'expéditeur et de le supprimer." },
+    { "es",
+      { "Hola %s,", "Estimado/a %s,", "Buenos días %s,", "%s," },
+      { "Saludos,", "Gracias,", "Un abrazo," },
+      { "Informe trimestral", "Reunión la próxima semana", "Factura 2024-117",
+        "Calendario del proyecto", "Pregunta sobre el contrato", "Viaje de negocios" },
+      { "¿Podrías enviarme las cifras actualizadas antes del viernes?",
+        "Adjunto la última versión para tu revisión.",
+        "El cliente pregunta si podemos mover la fecha límite a final de mes.",
+        "¿Te viene bien el martes por la tarde?",
+        "Todavía necesitamos la aprobación del departamento legal.",
+        "Gracias por la rápida respuesta.",
+        "No estoy seguro de que el presupuesto cubra las licencias adicionales.",
+        "Las cifras de la segunda tabla no coinciden con el resumen.",
+        "¿Podemos hacer una llamada corta para revisar los puntos abiertos?",
+        "El lunes no estaré en la oficina, pero sí localizable por teléfono.",
+        "Por favor, confirma la dirección de entrega antes de hacer el pedido.",
+        "El equipo decidió seguir con la segunda opción." },
+      "El %s, %s escribió:", "RE: ",
+      "Este mensaje y sus anexos son confidenciales. Si lo ha recibido por error, "
+      "comuníquelo al remitente y elimínelo." },
+};
+
+static const gchar *first_names[] = {
+    "Anna", "Ben", "Carla", "David", "Elif", "Felix", "Grace", "Hugo", "Ines", "Jonas",
+    "Katrin", "Luis", "Marie", "Nils", "Olivia", "Paul", "Rosa", "Sven", "Tara", "Yusuf"
+};
+
+static const gchar *last_names[] = {
+    "Schmidt", "Dubois", "García", "Miller", "Novak", "Rossi", "Jensen", "Kaya", "Moreau", "Weber"
+};
+
+static const gchar *domains[] = {
+    "example.com", "example.org", "acme-corp.example", "globex.example", "initech.example"
+};
+
+typedef struct {
+    gchar *name;
+    gchar *address;
+    gchar *title;
+    gboolean disclaimer; /* appends the corporate disclaimer to every message */
+} Person;
+
+typedef struct {
+    guint messages;
+    guint threads;
+    guint html;
+    guint attachments;
+    guint quoted;
+    guint64 bytes;
+    guint per_language[G_N_ELEMENTS(languages)];
+} CorpusStats;
+
+static gint opt_threads = 200;
+static gint opt_max_depth = 6;
+static gdouble opt_quote_ratio = 0.7;
+static gdouble opt_html_ratio = 0.4;
+static gdouble opt_attachment_ratio = 0.15;
+static gchar *opt_languages = NULL;
+static gint opt_seed = 1;
+
+static GOptionEntry entries[] = {
+    { "threads", 't', 0, G_OPTION_ARG_INT, &opt_threads, "Number of threads (default: 200)", "N" },
+    { "max-depth", 'd', 0, G_OPTION_ARG_INT, &opt_max_depth,
+      "Most messages in a thread; lengths fall off geometrically (default: 6)", "N" },
+    { "quote-ratio", 'q', 0, G_OPTION_ARG_DOUBLE, &opt_quote_ratio,
+      "Share of replies that quote the message they answer (default: 0.7)", "RATIO" },
+    { "html-ratio", 0, 0, G_OPTION_ARG_DOUBLE, &opt_html_ratio,
+      "Share of messages with an HTML alternative (default: 0.4)", "RATIO" },
+    { "attachment-ratio", 'a', 0, G_OPTION_ARG_DOUBLE, &opt_attachment_ratio,
+      "Share of messages with an attachment (default: 0.15)", "RATIO" },
+    { "languages", 'l', 0, G_OPTION_ARG_STRING, &opt_languages,
+      "Weighted language mix of en, de, fr, es (default: en:6,de:2,fr:1,es:1)", "MIX" },
+    { "seed", 's', 0, G_OPTION_ARG_INT, &opt_seed, "Random seed (default: 1)", "N" },
+    { NULL }
+};
+
+#define PICK(rand, array) ((array)[g_rand_int_range((rand), 0, G_N_ELEMENTS(array))])
+
+static gboolean parse_languages(const gchar *spec, gdouble *weights) {
+    gchar **items = g_strsplit(spec, ",", -1);
+    gboolean valid = TRUE;
+
+    for (guint i = 0; items[i] && valid; i++) {
+        gchar **pair = g_strsplit(g_strstrip(items[i]), ":", 2);
+        guint j;
+        for (j = 0; j < G_N_ELEMENTS(languages) && g_strcmp0(pair[0], languages[j].code) != 0; j++);
+
+        if (j == G_N_ELEMENTS(languages)) {
+            fprintf(stderr, "Unknown language '%s'; use en, de, fr or es\n", pair[0]);
+            valid = FALSE;
+        } else {
+            weights[j] = pair[1] ? g_ascii_strtod(pair[1], NULL) : 1.0;
+        }
+        g_strfreev(pair);
+    }
+
+    g_strfreev(items);
+    return valid;
+}
+
+static guint pick_language(GRand *rand, const gdouble *weights) {
+    gdouble total = 0.0;
+    for (guint i = 0; i < G_N_ELEMENTS(languages); i++) total += weights[i];
+
+    gdouble r = g_rand_double(rand) * total;
+    for (guint i = 0; i < G_N_ELEMENTS(languages); i++) {
+        if (r < weights[i]) return i;
+        r -= weights[i];
+    }
+    return 0;
+}
+
+static void person_init(Person *person, GRand *rand) {
+    const gchar *first = PICK(rand, first_names);
+    const gchar *last = PICK(rand, last_names);
+    const gchar *domain = PICK(rand, domains);
+    gchar *local = g_ascii_strdown(first, -1);
+
+    person->name = g_strdup_printf("%s %s", first, last);
+    person->address = g_strdup_printf("%s.%u@%s", local, g_rand_int_range(rand, 1, 100), domain);
+    person->title = g_strdup(g_rand_boolean(rand) ? "Project Manager" : "Account Executive");
+    person->disclaimer = g_str_has_suffix(domain, ".example") && g_rand_boolean(rand);
+    g_free(local);
+}
+
+static void person_clear(Person *person) {
+    g_free(person->name);
+    g_free(person->address);
+    g_free(person->title);
+}
+
+/* RFC 2047 encoded-word for header text that is not plain ASCII */
+static gchar* encode_header(const gchar *text) {
+    for (const gchar *p = text; *p; p++) {
+        if ((guchar)*p >= 0x80) {
+            gchar *encoded = g_base64_encode((const guchar *)text, strlen(text));
+            gchar *word = g_strdup_printf("=?UTF-8?B?%s?=", encoded);
+            g_free(encoded);
+            return word;
+        }
+    }
+    return g_strdup(text);
+}
+
+static void append_base64(GString *out, const guchar *data, gsize length) {
+    gchar *encoded = g_base64_encode(data, length);
+    for (gsize i = 0, n = strlen(encoded); i < n; i += 76) {
+        g_string_append_len(out, encoded + i, MIN(76, n - i));
+        g_string_append(out, "\r\n");
+    }
+    g_free(encoded);
+}
+
+/* Plain-text body: greeting, a few paragraphs, closing, signature, and the
+ * quoted message being answered */
+static gchar* make_body(GRand *rand, const Language *lang, const Person *from, const Person *to,
+                        const gchar *date, const gchar *quoted) {
+    GString *body = g_string_new(NULL);
+    gchar *first = g_strndup(to->name, strcspn(to->name, " "));
+
+    g_string_append_printf(body, PICK(rand, lang->greetings), first);
+    g_string_append(body, "\n\n");
+
+    for (gint p = g_rand_int_range(rand, 1, 4); p > 0; p--) {
+        for (gint s = g_rand_int_range(rand, 1, 5); s > 0; s--) {
+            g_string_append(body, PICK(rand, lang->sentences));
+            g_string_append_c(body, s > 1 ? ' ' : '\n');
+        }
+        g_string_append_c(body, '\n');
+    }
+
+    g_string_append_printf(body, "%s\n%s\n\n-- \n%s\n%s\n", PICK(rand, lang->closings),
+                           from->name, from->name, from->title);
+    if (from->disclaimer) {
+        g_string_append_printf(body, "\n%s\n", lang->disclaimer);
+    }
+
+    if (quoted) {
+        g_string_append_c(body, '\n');
+        g_string_append_printf(body, lang->wrote, date, to->name);
+        g_string_append_c(body, '\n');
+
+        gchar **lines = g_strsplit(quoted, "\n", -1);
+        for (guint i = 0; lines[i]; i++) {
+            if (!lines[i + 1] && !*lines[i]) break;
+            g_string_append_printf(body, lines[i][0] == '>' ? ">%s\n" : "> %s\n", lines[i]);
+        }
+        g_strfreev(lines);
+    }
+
+    g_free(first);
+    return g_string_free(body, FALSE);
+}
+
+/* HTML alternative of a plain-text body; quoted lines go into a blockquote */
+static gchar* make_html(const gchar *text) {
+    GString *html = g_string_new("<html><body>\n<p>");
+    gchar **lines = g_strsplit(text, "\n", -1);
+    gboolean in_quote = FALSE;
+
+    for (guint i = 0; lines[i]; i++) {
+        gboolean quote_line = lines[i][0] == '>';
+        if (quote_line != in_quote) {
+            g_string_append(html, quote_line ? "</p>\n<blockquote type=\"cite\"><p>" : "</p></blockquote>\n<p>");
+            in_quote = quote_line;
+        }
+
+        const gchar *line = quote_line ? lines[i] + (lines[i][1] == ' ' ? 2 : 1) : lines[i];
+        if (!*line) {
+            g_string_append(html, "</p>\n<p>");
+        } else {
+            gchar *escaped = g_markup_escape_text(line, -1);
+            g_string_append_printf(html, "%s<br>\n", escaped);
+            g_free(escaped);
+        }
+    }
+
+    g_string_append(html, in_quote ? "</p></blockquote>\n" : "</p>\n");
+    g_string_append(html, "</body></html>\n");
+    g_strfreev(lines);
+    return g_string_free(html, FALSE);
+}
+
+/* Table, notes or an opaque binary, as mail attachments tend to be */
+static void append_attachment(GString *out, GRand *rand, const Language *lang, const gchar *boundary) {
+    g_string_append_printf(out, "--%s\r\n", boundary);
+
+    switch (g_rand_int_range(rand, 0, 3)) {
+    case 0: {
+        GString *csv = g_string_new("item,quantity,unit_price,total\n");
+        for (gint i = g_rand_int_range(rand, 5, 60); i > 0; i--) {
+            gint quantity = g_rand_int_range(rand, 1, 50);
+            gint price = g_rand_int_range(rand, 5, 900);
+            g_string_append_printf(csv, "SKU-%05d,%d,%d.00,%d.00\n",
+                                   g_rand_int_range(rand, 0, 99999), quantity, price, quantity * price);
+        }
+        g_string_append(out, "Content-Type: text/csv; charset=UTF-8; name=\"items.csv\"\r\n"
+                             "Content-Disposition: attachment; filename=\"items.csv\"\r\n"
+                             "Content-Transfer-Encoding: base64\r\n\r\n");
+        append_base64(out, (const guchar *)csv->str, csv->len);
+        g_string_free(csv, TRUE);
+        break;
+    }
+    case 1: {
+        GString *notes = g_string_new(NULL);
+        for (gint i = g_rand_int_range(rand, 5, 40); i > 0; i--) {
+            g_string_append_printf(notes, "- %s\n", PICK(rand, lang->sentences));
+        }
+        g_string_append(out, "Content-Type: text/plain; charset=UTF-8; name=\"notes.txt\"\r\n"
+                             "Content-Disposition: attachment; filename=\"notes.txt\"\r\n"
+                             "Content-Transfer-Encoding: base64\r\n\r\n");
+        append_base64(out, (const guchar *)notes->str, notes->len);
+        g_string_free(notes, TRUE);
+        break;
+    }
+    default: {
+        gsize length = g_rand_int_range(rand, 4096, 65536);
+        guchar *data = g_malloc(length);
+        memcpy(data, "%PDF-1.4\n", 9);
+        for (gsize i = 9; i < length; i++) data[i] = g_rand_int(rand) & 0xff;
+        g_string_append(out, "Content-Type: application/pdf; name=\"scan.pdf\"\r\n"
+                             "Content-Disposition: attachment; filename=\"scan.pdf\"\r\n"
+                             "Content-Transfer-Encoding: base64\r\n\r\n");
+        append_base64(out, data, length);
+        g_free(data);
+        break;
+    }
+    }
+}
+
+static void append_text_part(GString *out, const gchar *type, const gchar *text) {
+    g_string_append_printf(out, "Content-Type: %s; charset=UTF-8\r\n"
+                                "Content-Transfer-Encoding: 8bit\r\n\r\n", type);
+    gchar **lines = g_strsplit(text, "\n", -1);
+    gchar *crlf = g_strjoinv("\r\n", lines);
+    g_string_append(out, crlf);
+    g_string_append(out, "\r\n");
+    g_free(crlf);
+    g_strfreev(lines);
+}
+
+static gchar* make_message(GRand *rand, CorpusStats *stats, guint index, const Language *lang,
+                           const Person *from, const Person *to, const gchar *subject,
+                           GDateTime *date, const gchar *message_id, const gchar *references,
+                           const gchar *body) {
+    GString *out = g_string_new(NULL);
+    gchar *from_name = encode_header(from->name);
+    gchar *to_name = encode_header(to->name);
+    gchar *encoded_subject = encode_header(subject);
+    gchar *date_str = g_date_time_format(date, "%a, %d %b %Y %H:%M:%S %z");
+
+    g_string_append_printf(out, "From: %s <%s>\r\nTo: %s <%s>\r\nSubject: %s\r\nDate: %s\r\n"
+                                "Message-ID: %s\r\nContent-Language: %s\r\nMIME-Version: 1.0\r\n",
+                           from_name, from->address, to_name, to->address, encoded_subject,
+                           date_str, message_id, lang->code);
+    if (references) {
+        const gchar *parent = strrchr(references, ' ');
+        g_string_append_printf(out, "In-Reply-To: %s\r\nReferences: %s\r\n",
+                               parent ? parent + 1 : references, references);
+    }
+
+    gboolean html = g_rand_double(rand) < opt_html_ratio;
+    gboolean attachment = g_rand_double(rand) < opt_attachment_ratio;
+    gchar *mixed = g_strdup_printf("=_mixed_%u", index);
+    gchar *alternative = g_strdup_printf("=_alt_%u", index);
+
+    if (attachment) {
+        g_string_append_printf(out, "Content-Type: multipart/mixed; boundary=\"%s\"\r\n\r\n--%s\r\n",
+                               mixed, mixed);
+        stats->attachments++;
+    }
+
+    if (html) {
+        gchar *html_body = make_html(body);
+        g_string_append_printf(out, "Content-Type: multipart/alternative; boundary=\"%s\"\r\n\r\n--%s\r\n",
+                               alternative, alternative);
+        append_text_part(out, "text/plain", body);
+        g_string_append_printf(out, "--%s\r\n", alternative);
+        append_text_part(out, "text/html", html_body);
+        g_string_append_printf(out, "--%s--\r\n", alternative);
+        g_free(html_body);
+        stats->html++;
+    } else {
+        append_text_part(out, "text/plain", body);
+    }
+
+    if (attachment) {
+        append_attachment(out, rand, lang, mixed);
+        g_string_append_printf(out, "--%s--\r\n", mixed);
+    }
+
+    g_free(mixed);
+    g_free(alternative);
+    g_free(date_str);
+    g_free(encoded_subject);
+    g_free(to_name);
+    g_free(from_name);
+    return g_string_free(out, FALSE);
+}
+
+static gboolean write_thread(GRand *rand, const gdouble *weights, const gchar *dir,
+                             guint thread, CorpusStats *stats, GError **error) {
+    guint lang_index = pick_language(rand, weights);
+    const Language *lang = &languages[lang_index];
+    Person people[MAX_PARTICIPANTS];
+    guint participants = g_rand_int_range(rand, 2, MAX_PARTICIPANTS + 1);
+    for (guint i = 0; i < participants; i++) person_init(&people[i], rand);
+
+    const gchar *topic = PICK(rand, lang->subjects);
+    GDateTime *date = g_date_time_new_utc(2024, g_rand_int_range(rand, 1, 13), g_rand_int_range(rand, 1, 29),
+                                          g_rand_int_range(rand, 7, 19), g_rand_int_range(rand, 0, 60), 0);
+    GString *references = NULL;
+    gchar *previous_body = NULL;
+    gchar *previous_date = NULL;
+    gboolean success = TRUE;
+    guint from = 0;
+
+    for (gint depth = 0; depth < opt_max_depth && success; depth++) {
+        if (depth > 0 && g_rand_double(rand) > 0.55) break;
+
+        /* Every reply answers the previous message, from anyone else in the thread */
+        guint to = from;
+        from = (to + 1 + g_rand_int_range(rand, 0, participants - 1)) % participants;
+        if (depth == 0) {
+            to = from;
+            from = 0;
+        }
+
+        gboolean quote = previous_body && g_rand_double(rand) < opt_quote_ratio;
+        gchar *body = make_body(rand, lang, &people[from], &people[to], previous_date,
+                                quote ? previous_body : NULL);
+        gchar *subject = depth > 0 ? g_strconcat(lang->reply_prefix, topic, NULL) : g_strdup(topic);
+        gchar *message_id = g_strdup_printf("<corpus.%d.%u.%d@%s>", opt_seed, thread, depth,
+                                            strchr(people[from].address, '@') + 1);
+
+        gchar *message = make_message(rand, stats, stats->messages, lang, &people[from], &people[to], subject,
+                                      date, message_id, references ? references->str : NULL, body);
+        gchar *name = g_strdup_printf("%06u.eml", stats->messages);
+        gchar *path = g_build_filename(dir, name, NULL);
+        success = g_file_set_contents(path, message, -1, error);
+
+        stats->messages++;
+        stats->bytes += strlen(message);
+        stats->quoted += quote;
+        stats->per_language[lang_index]++;
+
+        if (!references) {
+            references = g_string_new(message_id);
+        } else {
+            g_string_append_printf(references, " %s", message_id);
+        }
+        g_free(previous_body);
+        previous_body = body;
+
+        g_free(previous_date);
+        previous_date = g_date_time_format(date, "%a, %d %b %Y %H:%M");
+
+        GDateTime *next = g_date_time_add_minutes(date, g_rand_int_range(rand, 5, 2 * 24 * 60));
+        g_date_time_unref(date);
+        date = next;
+
+        g_free(path);
+        g_free(name);
+        g_free(message);
+        g_free(message_id);
+        g_free(subject);
+    }
+
+    stats->threads++;
+    if (references) g_string_free(references, TRUE);
+    g_free(previous_body);
+    g_free(previous_date);
+    g_date_time_unref(date);
+    for (guint i = 0; i < participants; i++) person_clear(&people[i]);
+    return success;
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("DIRECTORY");
+    g_option_context_set_summary(context,
+        "Write a synthetic mail corpus for llm-load-gen into DIRECTORY, one .eml file\n"
+        "per message, in thread order.");
+    g_option_context_add_main_entries(context, entries, NULL);
+
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    if (argc != 2 || opt_threads < 1 || opt_max_depth < 1) {
+        fprintf(stderr, "Usage: llm-corpus-gen [OPTION...] DIRECTORY\n");
+        return 2;
+    }
+
+    gdouble weights[G_N_ELEMENTS(languages)] = { 0 };
+    if (!parse_languages(opt_languages ? opt_languages : "en:6,de:2,fr:1,es:1", weights)) {
+        return 2;
+    }
+
+    if (g_mkdir_with_parents(argv[1], 0755) != 0) {
+        fprintf(stderr, "Cannot create %s: %s\n", argv[1], g_strerror(errno));
+        return 1;
+    }
+
+    GRand *rand = g_rand_new_with_seed(opt_seed);
+    CorpusStats stats = { 0 };
+
+    for (gint thread = 0; thread < opt_threads; thread++) {
+        if (!write_thread(rand, weights, argv[1], thread, &stats, &error)) {
+            fprintf(stderr, "%s\n", error->message);
+            g_error_free(error);
+            g_rand_free(rand);
+            return 1;
+        }
+    }
+
+    printf("%u messages in %u threads, %.1f MB\n", stats.messages, stats.threads, stats.bytes / 1048576.0);
+    printf("  quoting: %u  html: %u  attachments: %u\n", stats.quoted, stats.html, stats.attachments);
+    for (guint i = 0; i < G_N_ELEMENTS(languages); i++) {
+        if (stats.per_language[i]) printf("  %s: %u\n", languages[i].code, stats.per_language[i]);
+    }
+
+    g_rand_free(rand);
+    return 0;
+}
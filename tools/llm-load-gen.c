@@ -0,0 +1,682 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Load generator for the client library. Simulates composers that answer
+ * messages of a corpus from llm-corpus-gen with the hotkey, rewrite their
+ * drafts and ask for batches of smart replies, each in its own thread,
+ * against an OpenAI-compatible server such as llm-replay-server. Streamed
+ * text is drained on the main loop as in Evolution, through the same
+ * response cache, attachment extraction and client code.
+ *
+ *   llm-load-gen --composers=16 --duration=60 --mix=hotkey:6,rewrite:3,batch:1 corpus/
+ */
+
+#include "../src/llm_client.h"
+#include "../src/llm_cache.h"
+#include "../src/llm_attachment.h"
+#include "../src/llm_catalog.h"
+#include "../src/llm_metrics.h"
+#include "../src/llm_smart_reply.h"
+#include <glib/gstdio.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MEMORY_SAMPLE_INTERVAL_MS 250
+#define BODY_MAX_BYTES (64 * 1024)
+
+typedef enum {
+    OP_HOTKEY,
+    OP_REWRITE,
+    OP_BATCH,
+    OP_COUNT
+} Operation;
+
+static const gchar *op_names[] = {
+    [OP_HOTKEY] = "hotkey",
+    [OP_REWRITE] = "rewrite",
+    [OP_BATCH] = "batch",
+};
+
+static const gchar *reply_instructions[] = {
+    "Reply politely and confirm.",
+    "Decline, we are fully booked this month.",
+    "Ask for the missing figures before Friday.",
+    "Say thanks and that I will get back to them next week.",
+    "Propose Tuesday at 10:00 instead.",
+    "Forward the question to our legal team and say so.",
+};
+
+static const gchar *rewrite_instructions[] = {
+    "Make this shorter.",
+    "Make this more formal.",
+    "Make this friendlier.",
+    "Fix grammar and spelling only.",
+};
+
+typedef struct {
+    CamelMimeMessage *message;
+    gchar *body;
+    gchar *sender_name;
+    gchar *sender_email;
+} CorpusMessage;
+
+typedef struct {
+    guint count;
+    guint failed;
+    GArray *first_token_ms; /* gdouble; as the main loop saw it */
+    GArray *total_ms;       /* gdouble; until the last text reached the main loop */
+} OpStats;
+
+/* Main-loop side of one streamed request */
+typedef struct {
+    GMutex mutex;
+    GCond cond;
+    gint64 first_token_time;
+    gboolean finished;
+} StreamWatch;
+
+typedef struct {
+    GThread *thread;
+    GRand *rand;
+    gchar *last_response; /* the composer's current draft */
+} Composer;
+
+static gchar *opt_url = NULL;
+static gchar *opt_model = NULL;
+static gchar *opt_batch_model = NULL;
+static gint opt_composers = 8;
+static gint opt_duration = 30;
+static gchar *opt_mix = NULL;
+static gint opt_think_ms = 500;
+static gint opt_seed = 1;
+static gboolean opt_no_cache = FALSE;
+static gboolean opt_verbose = FALSE;
+static gboolean opt_keep = FALSE;
+
+static GOptionEntry entries[] = {
+    { "url", 'u', 0, G_OPTION_ARG_STRING, &opt_url,
+      "API base URL (default: http://127.0.0.1:8089/v1)", "URL" },
+    { "model", 'm', 0, G_OPTION_ARG_STRING, &opt_model,
+      "Model for hotkey and rewrite (default: the first the server lists)", "MODEL" },
+    { "batch-model", 'b', 0, G_OPTION_ARG_STRING, &opt_batch_model,
+      "Model for smart-reply batches (default: --model)", "MODEL" },
+    { "composers", 'c', 0, G_OPTION_ARG_INT, &opt_composers, "Concurrent composers (default: 8)", "N" },
+    { "duration", 'd', 0, G_OPTION_ARG_INT, &opt_duration, "Seconds to run (default: 30)", "SECONDS" },
+    { "mix", 0, 0, G_OPTION_ARG_STRING, &opt_mix,
+      "Weighted mix of hotkey, rewrite and batch (default: hotkey:6,rewrite:3,batch:1)", "MIX" },
+    { "think", 't', 0, G_OPTION_ARG_INT, &opt_think_ms,
+      "Mean pause of a composer between operations (default: 500)", "MS" },
+    { "seed", 's', 0, G_OPTION_ARG_INT, &opt_seed, "Random seed (default: 1)", "N" },
+    { "no-cache", 0, 0, G_OPTION_ARG_NONE, &opt_no_cache, "Do not show cached drafts", NULL },
+    { "verbose", 'v', 0, G_OPTION_ARG_NONE, &opt_verbose, "Keep the client's debug output", NULL },
+    { "keep", 'k', 0, G_OPTION_ARG_NONE, &opt_keep,
+      "Keep the temporary caches and performance log instead of removing them", NULL },
+    { NULL }
+};
+
+static PluginConfig *config;
+static LLMClient *client;
+static LLMCache *cache;
+static GPtrArray *corpus;
+static gdouble mix[OP_COUNT];
+
+static OpStats op_stats[OP_COUNT];
+static GMutex stats_mutex;
+static guint attachment_extractions;
+
+static gint stopping;
+static gint running_composers;
+static GMainLoop *loop;
+static gint64 peak_rss_kb;
+
+static void quiet_print(const gchar *string G_GNUC_UNUSED) {
+}
+
+/* Resident set size of this process, from /proc */
+static gint64 read_rss_kb(const gchar *field) {
+    gchar *status = NULL;
+    gint64 kb = 0;
+
+    if (g_file_get_contents("/proc/self/status", &status, NULL, NULL)) {
+        const gchar *line = strstr(status, field);
+        if (line) kb = g_ascii_strtoll(line + strlen(field), NULL, 10);
+        g_free(status);
+    }
+    return kb;
+}
+
+static gboolean sample_memory(gpointer user_data G_GNUC_UNUSED) {
+    peak_rss_kb = MAX(peak_rss_kb, read_rss_kb("VmRSS:"));
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean parse_mix(const gchar *spec) {
+    gchar **items = g_strsplit(spec, ",", -1);
+    gboolean valid = TRUE;
+
+    for (guint i = 0; items[i] && valid; i++) {
+        gchar **pair = g_strsplit(g_strstrip(items[i]), ":", 2);
+        guint op;
+        for (op = 0; op < OP_COUNT && g_strcmp0(pair[0], op_names[op]) != 0; op++);
+
+        if (op == OP_COUNT) {
+            fprintf(stderr, "Unknown operation '%s'; use hotkey, rewrite or batch\n", pair[0]);
+            valid = FALSE;
+        } else {
+            mix[op] = pair[1] ? g_ascii_strtod(pair[1], NULL) : 1.0;
+        }
+        g_strfreev(pair);
+    }
+
+    g_strfreev(items);
+    return valid;
+}
+
+static void corpus_message_free(CorpusMessage *message) {
+    g_object_unref(message->message);
+    g_free(message->body);
+    g_free(message->sender_name);
+    g_free(message->sender_email);
+    g_free(message);
+}
+
+static CorpusMessage* corpus_message_load(const gchar *path) {
+    gchar *contents = NULL;
+    gsize length = 0;
+    if (!g_file_get_contents(path, &contents, &length, NULL)) return NULL;
+
+    CamelMimeMessage *mime = camel_mime_message_new();
+    CamelStream *stream = camel_stream_mem_new_with_buffer(contents, length);
+    gboolean parsed = camel_data_wrapper_construct_from_stream_sync(CAMEL_DATA_WRAPPER(mime), stream, NULL, NULL);
+    g_object_unref(stream);
+    g_free(contents);
+
+    gchar *body = parsed ? llm_attachment_extract_body(mime, BODY_MAX_BYTES, NULL) : NULL;
+    if (!body) {
+        g_object_unref(mime);
+        return NULL;
+    }
+
+    CorpusMessage *message = g_new0(CorpusMessage, 1);
+    message->message = mime;
+    message->body = body;
+
+    CamelInternetAddress *from = camel_mime_message_get_from(mime);
+    const gchar *name = NULL, *email = NULL;
+    if (from && camel_internet_address_get(from, 0, &name, &email)) {
+        message->sender_name = g_strdup(name);
+        message->sender_email = g_strdup(email);
+    }
+    return message;
+}
+
+static GPtrArray* corpus_load(const gchar *dir_path, GError **error) {
+    GDir *dir = g_dir_open(dir_path, 0, error);
+    if (!dir) return NULL;
+
+    GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+    const gchar *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (g_str_has_suffix(name, ".eml")) g_ptr_array_add(names, g_build_filename(dir_path, name, NULL));
+    }
+    g_dir_close(dir);
+
+    GPtrArray *messages = g_ptr_array_new_with_free_func((GDestroyNotify)corpus_message_free);
+    for (guint i = 0; i < names->len; i++) {
+        CorpusMessage *message = corpus_message_load(g_ptr_array_index(names, i));
+        if (message) g_ptr_array_add(messages, message);
+    }
+    g_ptr_array_unref(names);
+
+    if (messages->len == 0) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No readable .eml files in %s", dir_path);
+        g_ptr_array_unref(messages);
+        return NULL;
+    }
+    return messages;
+}
+
+static void on_stream_tokens(const gchar *text G_GNUC_UNUSED, gsize length,
+                             gboolean finished, gpointer user_data) {
+    StreamWatch *watch = user_data;
+    gint64 now = g_get_monotonic_time();
+
+    g_mutex_lock(&watch->mutex);
+    if (length > 0 && !watch->first_token_time) watch->first_token_time = now;
+    if (finished) {
+        watch->finished = TRUE;
+        g_cond_signal(&watch->cond);
+    }
+    g_mutex_unlock(&watch->mutex);
+}
+
+static void record_op(Operation op, gboolean success, gint64 start_time, gint64 first_token_time) {
+    gdouble total_ms = (g_get_monotonic_time() - start_time) / 1000.0;
+
+    g_mutex_lock(&stats_mutex);
+    OpStats *stats = &op_stats[op];
+    stats->count++;
+    if (!success) {
+        stats->failed++;
+    } else {
+        gdouble first_ms = first_token_time ? (first_token_time - start_time) / 1000.0 : total_ms;
+        g_array_append_val(stats->first_token_ms, first_ms);
+        g_array_append_val(stats->total_ms, total_ms);
+    }
+    g_mutex_unlock(&stats_mutex);
+}
+
+/* Send a request with its text streamed to the main loop, as the composer
+ * does, and wait until the main loop has seen all of it */
+static gboolean run_streamed(LLMRequest *request, gint64 *first_token_time) {
+    StreamWatch watch = { 0 };
+    g_mutex_init(&watch.mutex);
+    g_cond_init(&watch.cond);
+
+    request->token_queue = llm_token_queue_new();
+    GSource *source = llm_token_queue_source_new(request->token_queue);
+    g_source_set_callback(source, (GSourceFunc)(void (*)(void))on_stream_tokens, &watch, NULL);
+    g_source_attach(source, NULL);
+
+    gboolean success = llm_client_generate_response(client, request);
+    llm_token_queue_close(request->token_queue); /* not every early failure closes it */
+
+    g_mutex_lock(&watch.mutex);
+    while (!watch.finished) g_cond_wait(&watch.cond, &watch.mutex);
+    g_mutex_unlock(&watch.mutex);
+
+    g_source_destroy(source);
+    g_source_unref(source);
+    llm_token_queue_free(request->token_queue);
+    request->token_queue = NULL;
+
+    *first_token_time = watch.first_token_time;
+    g_mutex_clear(&watch.mutex);
+    g_cond_clear(&watch.cond);
+    return success;
+}
+
+/* Show the closest cached answer first, as stale-while-revalidate does */
+static void lookup_cached_draft(LLMRequest *request) {
+    if (opt_no_cache) return;
+
+    llm_metrics_add(LLM_METRIC_CACHE_LOOKUPS, 1);
+    request->cache_status = LLM_PERF_CACHE_MISS;
+
+    gchar *draft = llm_cache_lookup(cache, request->model, request->prompt);
+    if (!draft) {
+        draft = llm_cache_lookup_closest(cache, request->model, request->prompt,
+                                         DEFAULT_SWR_MIN_SIMILARITY, NULL);
+    }
+
+    if (draft) {
+        llm_metrics_add(LLM_METRIC_CACHE_HITS, 1);
+        request->cache_status = LLM_PERF_CACHE_STALE;
+        g_free(draft);
+    }
+}
+
+static void store_response(LLMRequest *request) {
+    llm_cache_store(cache, request->model, request->prompt, request->response);
+}
+
+static void run_hotkey(Composer *composer) {
+    CorpusMessage *message = g_ptr_array_index(corpus, g_rand_int_range(composer->rand, 0, corpus->len));
+    const gchar *instruction = reply_instructions[g_rand_int_range(composer->rand, 0,
+                                                                   G_N_ELEMENTS(reply_instructions))];
+    gint64 start_time = g_get_monotonic_time();
+
+    LLMRequest *request = llm_request_new();
+    request->model = g_strdup(config->model);
+    request->prompt = g_strdup_printf("%s %s\n\n%s", PROMPT_PREFIX, instruction, message->body);
+    request->original_email = g_strdup(message->body);
+    request->sender_name = g_strdup(message->sender_name);
+    request->sender_email = g_strdup(message->sender_email);
+
+    if (config->attachments_enabled) {
+        request->attachments = llm_attachment_extract_text(message->message, config->attachment_max_tokens, NULL);
+        if (request->attachments) g_atomic_int_inc((gint *)&attachment_extractions);
+    }
+    lookup_cached_draft(request);
+
+    gint64 first_token_time = 0;
+    gboolean success = run_streamed(request, &first_token_time);
+    if (success) {
+        store_response(request);
+        g_free(composer->last_response);
+        composer->last_response = g_strdup(request->response);
+    }
+
+    record_op(OP_HOTKEY, success, start_time, first_token_time);
+    llm_request_free(request);
+}
+
+static void run_rewrite(Composer *composer) {
+    if (!composer->last_response) {
+        run_hotkey(composer);
+        return;
+    }
+
+    const gchar *instruction = rewrite_instructions[g_rand_int_range(composer->rand, 0,
+                                                                     G_N_ELEMENTS(rewrite_instructions))];
+    gint64 start_time = g_get_monotonic_time();
+
+    LLMRequest *request = llm_request_new();
+    request->model = g_strdup(config->model);
+    request->prompt = g_strdup_printf("%s %s\n\n%s", PROMPT_PREFIX, instruction, composer->last_response);
+    lookup_cached_draft(request);
+
+    gint64 first_token_time = 0;
+    gboolean success = run_streamed(request, &first_token_time);
+    if (success) {
+        store_response(request);
+        g_free(composer->last_response);
+        composer->last_response = g_strdup(request->response);
+    }
+
+    record_op(OP_REWRITE, success, start_time, first_token_time);
+    llm_request_free(request);
+}
+
+/* One smart-reply batch, built like the reader extension builds it */
+static void run_batch(Composer *composer) {
+    GString *prompt = g_string_new(NULL);
+    for (guint i = 0; i < SMART_REPLY_BATCH_SIZE; i++) {
+        CorpusMessage *message = g_ptr_array_index(corpus, g_rand_int_range(composer->rand, 0, corpus->len));
+        gchar *body = g_utf8_make_valid(message->body, MIN(strlen(message->body), SMART_REPLY_MAX_BODY_BYTES));
+        g_string_append_printf(prompt, "Email %u:\n---\n%s\n---\n\n", i + 1, body);
+        g_free(body);
+    }
+
+    gint64 start_time = g_get_monotonic_time();
+    LLMRequest *request = llm_request_new();
+    request->prompt = g_string_free(prompt, FALSE);
+    request->model = g_strdup(opt_batch_model ? opt_batch_model : config->model);
+    request->work_class = LLM_WORK_BATCH;
+    request->system_prompt = g_strdup_printf(SMART_REPLY_INTENTS_PROMPT, SMART_REPLY_MAX_INTENTS);
+    request->json_output = TRUE;
+
+    gboolean success = llm_client_generate_response(client, request);
+    record_op(OP_BATCH, success, start_time, 0);
+    llm_request_free(request);
+}
+
+static Operation pick_operation(GRand *rand) {
+    gdouble total = 0.0;
+    for (guint op = 0; op < OP_COUNT; op++) total += mix[op];
+
+    gdouble r = g_rand_double(rand) * total;
+    for (guint op = 0; op < OP_COUNT; op++) {
+        if (r < mix[op]) return op;
+        r -= mix[op];
+    }
+    return OP_HOTKEY;
+}
+
+static gboolean quit_loop(gpointer user_data G_GNUC_UNUSED) {
+    g_main_loop_quit(loop);
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer composer_thread(gpointer user_data) {
+    Composer *composer = user_data;
+
+    while (!g_atomic_int_get(&stopping)) {
+        switch (pick_operation(composer->rand)) {
+        case OP_REWRITE:
+            run_rewrite(composer);
+            break;
+        case OP_BATCH:
+            run_batch(composer);
+            break;
+        default:
+            run_hotkey(composer);
+            break;
+        }
+
+        /* Exponentially distributed think time, in slices so stopping is prompt */
+        gint64 think_us = (gint64)(-log(1.0 - g_rand_double(composer->rand)) * opt_think_ms * 1000);
+        while (think_us > 0 && !g_atomic_int_get(&stopping)) {
+            g_usleep(MIN(think_us, 100000));
+            think_us -= 100000;
+        }
+    }
+
+    if (g_atomic_int_dec_and_test(&running_composers)) g_idle_add(quit_loop, NULL);
+    return NULL;
+}
+
+static gboolean stop_composers(gpointer user_data G_GNUC_UNUSED) {
+    g_atomic_int_set(&stopping, 1);
+    return G_SOURCE_REMOVE;
+}
+
+static gint compare_doubles(gconstpointer a, gconstpointer b) {
+    gdouble x = *(const gdouble *)a, y = *(const gdouble *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted array */
+static gdouble percentile(GArray *sorted, gdouble p) {
+    if (sorted->len == 0) return 0.0;
+
+    guint rank = (guint)(p / 100.0 * sorted->len + 0.999999);
+    rank = CLAMP(rank, 1, sorted->len);
+    return g_array_index(sorted, gdouble, rank - 1);
+}
+
+static void print_op_row(const gchar *name, OpStats *stats, gdouble seconds) {
+    g_array_sort(stats->first_token_ms, compare_doubles);
+    g_array_sort(stats->total_ms, compare_doubles);
+
+    printf("%-8s %7u %7u %7.2f   %7.0f %7.0f %7.0f   %7.0f %7.0f %7.0f\n",
+           name, stats->count, stats->failed, stats->count / seconds,
+           percentile(stats->first_token_ms, 50), percentile(stats->first_token_ms, 90),
+           percentile(stats->first_token_ms, 99),
+           percentile(stats->total_ms, 50), percentile(stats->total_ms, 90), percentile(stats->total_ms, 99));
+}
+
+static void print_report(gdouble seconds, gint64 baseline_rss_kb) {
+    OpStats all = { 0 };
+    all.first_token_ms = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    all.total_ms = g_array_new(FALSE, FALSE, sizeof(gdouble));
+
+    printf("\n%d composers for %.1f s against %s, model %s, %u messages\n\n",
+           opt_composers, seconds, opt_url, config->model, corpus->len);
+    printf("%-8s %7s %7s %7s   %-23s   %-23s\n", "", "ops", "failed", "ops/s",
+           "first text p50/p90/p99", "complete p50/p90/p99");
+
+    for (guint op = 0; op < OP_COUNT; op++) {
+        if (op_stats[op].count == 0) continue;
+        all.count += op_stats[op].count;
+        all.failed += op_stats[op].failed;
+        g_array_append_vals(all.first_token_ms, op_stats[op].first_token_ms->data, op_stats[op].first_token_ms->len);
+        g_array_append_vals(all.total_ms, op_stats[op].total_ms->data, op_stats[op].total_ms->len);
+        print_op_row(op_names[op], &op_stats[op], seconds);
+    }
+    print_op_row("all", &all, seconds);
+    g_array_unref(all.first_token_ms);
+    g_array_unref(all.total_ms);
+
+    gint64 lookups = llm_metrics_get(LLM_METRIC_CACHE_LOOKUPS);
+    gint64 hits = llm_metrics_get(LLM_METRIC_CACHE_HITS);
+    printf("\nCache:       %" G_GINT64_FORMAT " lookups, %" G_GINT64_FORMAT " cached drafts shown (%.1f%%)\n",
+           lookups, hits, lookups ? 100.0 * hits / lookups : 0.0);
+    printf("Attachments: %u extracted, %" G_GINT64_FORMAT " from cache, %.1f MB decoded\n",
+           attachment_extractions, llm_metrics_get(LLM_METRIC_ATTACHMENT_CACHE_HITS),
+           llm_metrics_get(LLM_METRIC_ATTACHMENT_BYTES_IN) / 1048576.0);
+    printf("Requests:    %" G_GINT64_FORMAT " sent, %" G_GINT64_FORMAT " errors, %" G_GINT64_FORMAT " rate-limited\n",
+           llm_metrics_get(LLM_METRIC_REQUESTS), llm_metrics_get(LLM_METRIC_REQUEST_ERRORS),
+           llm_metrics_get(LLM_METRIC_HTTP_RATE_LIMITED));
+    printf("Traffic:     %.1f MB sent, %.1f MB received, %" G_GINT64_FORMAT " prompt and %" G_GINT64_FORMAT
+           " completion tokens\n",
+           llm_metrics_get(LLM_METRIC_BYTES_SENT) / 1048576.0, llm_metrics_get(LLM_METRIC_BYTES_RECEIVED) / 1048576.0,
+           llm_metrics_get(LLM_METRIC_PROMPT_TOKENS), llm_metrics_get(LLM_METRIC_COMPLETION_TOKENS));
+    printf("Memory:      %.1f MB resident with the corpus loaded, peak %.1f MB, %.1f MB at the end\n",
+           baseline_rss_kb / 1024.0, MAX(peak_rss_kb, read_rss_kb("VmHWM:")) / 1024.0,
+           read_rss_kb("VmRSS:") / 1024.0);
+
+    if (opt_keep) {
+        gchar *perflog = llm_perflog_get_path();
+        printf("Performance log: %s\n", perflog);
+        g_free(perflog);
+    }
+}
+
+/* Delete the temporary cache directory and everything in it */
+static void remove_tree(const gchar *path) {
+    GDir *dir = g_dir_open(path, 0, NULL);
+    const gchar *name;
+
+    while (dir && (name = g_dir_read_name(dir))) {
+        gchar *child = g_build_filename(path, name, NULL);
+        if (g_file_test(child, G_FILE_TEST_IS_DIR) && !g_file_test(child, G_FILE_TEST_IS_SYMLINK)) {
+            remove_tree(child);
+        } else {
+            g_remove(child);
+        }
+        g_free(child);
+    }
+    if (dir) g_dir_close(dir);
+    g_rmdir(path);
+}
+
+static gchar* pick_default_model(void) {
+    GPtrArray *models = llm_catalog_list(llm_catalog_get_default());
+    gchar *model = NULL;
+
+    for (guint i = 0; i < models->len && !model; i++) {
+        LLMModelInfo *info = g_ptr_array_index(models, i);
+        if (g_strcmp0(info->endpoint, opt_url) == 0) model = g_strdup(info->id);
+    }
+
+    g_ptr_array_unref(models);
+    return model;
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("CORPUS");
+    g_option_context_set_summary(context,
+        "Drive the LLM Assistant client with concurrent simulated composers and\n"
+        "report throughput, latency, cache efficiency and memory. CORPUS is a\n"
+        "directory of .eml files, e.g. from llm-corpus-gen. Times are in milliseconds.\n"
+        "Caches and the performance log go to a fresh temporary directory.");
+    g_option_context_add_main_entries(context, entries, NULL);
+
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    if (argc != 2 || opt_composers < 1 || opt_duration < 1 ||
+        !parse_mix(opt_mix ? opt_mix : "hotkey:6,rewrite:3,batch:1")) {
+        fprintf(stderr, "Usage: llm-load-gen [OPTION...] CORPUS\n");
+        return 2;
+    }
+    if (!opt_url) opt_url = g_strdup("http://127.0.0.1:8089/v1");
+    /* The catalog stores endpoints without trailing slashes */
+    gsize url_length = strlen(opt_url);
+    while (url_length > 0 && opt_url[url_length - 1] == '/') opt_url[--url_length] = '\0';
+    if (!opt_verbose) g_set_print_handler(quiet_print);
+
+    /* Keep the user's caches and usage accounting out of it; must happen
+     * before anything asks for the cache or data dir */
+    gchar *cache_home = g_dir_make_tmp("llm-load-gen-XXXXXX", &error);
+    if (!cache_home) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+    g_setenv("XDG_CACHE_HOME", cache_home, TRUE);
+    g_setenv("XDG_DATA_HOME", cache_home, TRUE);
+
+    corpus = corpus_load(argv[1], &error);
+    if (!corpus) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        remove_tree(cache_home);
+        return 1;
+    }
+
+    config = g_new0(PluginConfig, 1);
+    config->openai_api_key = g_strdup(""); /* the catalog skips OpenAI without a key */
+    config->model_endpoints = g_new0(gchar *, 2);
+    config->model_endpoints[0] = g_strdup(opt_url);
+    config->stale_while_revalidate = !opt_no_cache;
+    config->swr_min_similarity = DEFAULT_SWR_MIN_SIMILARITY;
+    config->attachments_enabled = TRUE;
+    config->attachment_max_tokens = DEFAULT_ATTACHMENT_MAX_TOKENS;
+
+    if (!llm_catalog_refresh(llm_catalog_get_default(), config)) {
+        fprintf(stderr, "%s does not answer %s/models\n", opt_url, opt_url);
+        remove_tree(cache_home);
+        return 1;
+    }
+    config->model = opt_model ? g_strdup(opt_model) : pick_default_model();
+    if (!config->model) {
+        fprintf(stderr, "%s lists no models\n", opt_url);
+        remove_tree(cache_home);
+        return 1;
+    }
+
+    /* Only OpenAI would get the key; it must merely look valid to the client */
+    g_free(config->openai_api_key);
+    config->openai_api_key = g_strdup("not-sent-to-local-endpoints");
+    client = llm_client_new(config);
+    cache = llm_cache_new();
+    loop = g_main_loop_new(NULL, FALSE);
+    for (guint op = 0; op < OP_COUNT; op++) {
+        op_stats[op].first_token_ms = g_array_new(FALSE, FALSE, sizeof(gdouble));
+        op_stats[op].total_ms = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    }
+
+    gint64 baseline_rss_kb = read_rss_kb("VmRSS:");
+    peak_rss_kb = baseline_rss_kb;
+    g_timeout_add(MEMORY_SAMPLE_INTERVAL_MS, sample_memory, NULL);
+    g_timeout_add_seconds(opt_duration, stop_composers, NULL);
+
+    Composer *composers = g_new0(Composer, opt_composers);
+    gint64 start_time = g_get_monotonic_time();
+    g_atomic_int_set(&running_composers, opt_composers);
+    for (gint i = 0; i < opt_composers; i++) {
+        composers[i].rand = g_rand_new_with_seed(opt_seed + i);
+        composers[i].thread = g_thread_new("composer", composer_thread, &composers[i]);
+    }
+
+    g_main_loop_run(loop);
+    gdouble seconds = (g_get_monotonic_time() - start_time) / (gdouble)G_USEC_PER_SEC;
+
+    for (gint i = 0; i < opt_composers; i++) {
+        g_thread_join(composers[i].thread);
+        g_rand_free(composers[i].rand);
+        g_free(composers[i].last_response);
+    }
+    g_free(composers);
+
+    print_report(seconds, baseline_rss_kb);
+
+    for (guint op = 0; op < OP_COUNT; op++) {
+        g_array_unref(op_stats[op].first_token_ms);
+        g_array_unref(op_stats[op].total_ms);
+    }
+    g_main_loop_unref(loop);
+    llm_cache_free(cache);
+    llm_client_free(client);
+    config_free(config);
+    g_ptr_array_unref(corpus);
+    if (!opt_keep) remove_tree(cache_home);
+    g_free(cache_home);
+    return 0;
+}
@@ -0,0 +1,302 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Command-line reporter for the per-request performance log. Groups the
+ * records by model, hour, endpoint, transport or error and prints request
+ * counts and latency percentiles per group.
+ *
+ *   llm-perf-report --by=model,hour --since=48 --model=gpt-4o
+ */
+
+#include "../src/llm_perflog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    KEY_MODEL,
+    KEY_HOUR,
+    KEY_DAY,
+    KEY_ENDPOINT,
+    KEY_TRANSPORT,
+    KEY_ERROR
+} GroupKey;
+
+static const gchar *key_names[] = {
+    [KEY_MODEL] = "model",
+    [KEY_HOUR] = "hour",
+    [KEY_DAY] = "day",
+    [KEY_ENDPOINT] = "endpoint",
+    [KEY_TRANSPORT] = "transport",
+    [KEY_ERROR] = "error",
+};
+
+typedef struct {
+    gchar *name;
+    gint64 first_us; /* groups are printed in order of their first record */
+    guint count;
+    guint errors;
+    guint stale;
+    guint64 bytes;
+    GArray *ttfb_ms;
+    GArray *total_ms;
+    GArray *tokens_per_s;
+} Group;
+
+static gchar *opt_by = NULL;
+static gint opt_since_hours = 0;
+static gchar *opt_model = NULL;
+static gchar *opt_endpoint = NULL;
+static gboolean opt_errors_only = FALSE;
+
+static GOptionEntry entries[] = {
+    { "by", 'b', 0, G_OPTION_ARG_STRING, &opt_by,
+      "Comma-separated grouping: model, hour, day, endpoint, transport, error (default: model)", "KEYS" },
+    { "since", 's', 0, G_OPTION_ARG_INT, &opt_since_hours,
+      "Only requests of the last HOURS hours", "HOURS" },
+    { "model", 'm', 0, G_OPTION_ARG_STRING, &opt_model,
+      "Only requests for models whose name contains NAME", "NAME" },
+    { "endpoint", 'e', 0, G_OPTION_ARG_STRING, &opt_endpoint,
+      "Only requests to endpoints whose URL contains URL", "URL" },
+    { "errors", 0, 0, G_OPTION_ARG_NONE, &opt_errors_only,
+      "Only failed requests", NULL },
+    { NULL }
+};
+
+static void group_free(Group *group) {
+    g_free(group->name);
+    g_array_unref(group->ttfb_ms);
+    g_array_unref(group->total_ms);
+    g_array_unref(group->tokens_per_s);
+    g_free(group);
+}
+
+static gint compare_doubles(gconstpointer a, gconstpointer b) {
+    gdouble x = *(const gdouble *)a, y = *(const gdouble *)b;
+    return (x > y) - (x < y);
+}
+
+static gint compare_groups(gconstpointer a, gconstpointer b) {
+    const Group *x = *(Group * const *)a, *y = *(Group * const *)b;
+    return (x->first_us > y->first_us) - (x->first_us < y->first_us);
+}
+
+/* Nearest-rank percentile of a sorted array */
+static gdouble percentile(GArray *sorted, gdouble p) {
+    if (sorted->len == 0) return 0.0;
+
+    guint rank = (guint)(p / 100.0 * sorted->len + 0.999999);
+    rank = CLAMP(rank, 1, sorted->len);
+    return g_array_index(sorted, gdouble, rank - 1);
+}
+
+static gboolean parse_keys(const gchar *spec, GArray *keys) {
+    gchar **names = g_strsplit(spec, ",", -1);
+    gboolean valid = TRUE;
+
+    for (guint i = 0; names[i] && valid; i++) {
+        gchar *name = g_strstrip(names[i]);
+        valid = FALSE;
+        for (guint k = 0; k < G_N_ELEMENTS(key_names); k++) {
+            if (g_strcmp0(name, key_names[k]) == 0) {
+                GroupKey key = k;
+                g_array_append_val(keys, key);
+                valid = TRUE;
+            }
+        }
+        if (!valid) fprintf(stderr, "Unknown grouping '%s'\n", name);
+    }
+
+    g_strfreev(names);
+    return valid && keys->len > 0;
+}
+
+static gchar* format_time(gint64 time_us, const gchar *format) {
+    GDateTime *time = g_date_time_new_from_unix_local(time_us / G_USEC_PER_SEC);
+    gchar *text = g_date_time_format(time, format);
+    g_date_time_unref(time);
+    return text;
+}
+
+static gchar* make_group_name(const LLMPerfRecord *record, GArray *keys) {
+    GString *name = g_string_new(NULL);
+
+    for (guint i = 0; i < keys->len; i++) {
+        gchar *part = NULL;
+
+        switch (g_array_index(keys, GroupKey, i)) {
+        case KEY_MODEL:
+            part = g_strdup(record->model);
+            break;
+        case KEY_HOUR:
+            part = format_time(record->start_us, "%a %Y-%m-%d %H:00");
+            break;
+        case KEY_DAY:
+            part = format_time(record->start_us, "%a %Y-%m-%d");
+            break;
+        case KEY_ENDPOINT:
+            part = g_strdup(record->endpoint);
+            break;
+        case KEY_TRANSPORT:
+            part = g_strdup(record->transport == LLM_PERF_TRANSPORT_REALTIME ? "realtime" : "http");
+            break;
+        case KEY_ERROR:
+            part = g_strdup(llm_perflog_error_name(record->error));
+            break;
+        }
+
+        if (name->len) g_string_append(name, "  ");
+        g_string_append(name, part);
+        g_free(part);
+    }
+
+    return g_string_free(name, FALSE);
+}
+
+static gboolean record_matches(const LLMPerfRecord *record, gint64 since_us) {
+    if (record->start_us < since_us) return FALSE;
+    if (opt_model && !strstr(record->model, opt_model)) return FALSE;
+    if (opt_endpoint && !strstr(record->endpoint, opt_endpoint)) return FALSE;
+    if (opt_errors_only && record->error == LLM_PERF_ERROR_NONE) return FALSE;
+    return TRUE;
+}
+
+static void add_record(Group *group, const LLMPerfRecord *record) {
+    group->count++;
+    group->bytes += record->bytes_sent + record->bytes_received;
+    if (record->cache == LLM_PERF_CACHE_STALE) group->stale++;
+
+    if (record->error != LLM_PERF_ERROR_NONE) {
+        group->errors++;
+        return;
+    }
+
+    /* Latencies of successful requests only; the realtime transport does
+     * not report a time to first byte */
+    gdouble total = record->total_ms;
+    g_array_append_val(group->total_ms, total);
+
+    if (record->ttfb_ms > 0) {
+        gdouble ttfb = record->ttfb_ms;
+        g_array_append_val(group->ttfb_ms, ttfb);
+
+        if (record->total_ms > record->ttfb_ms && record->completion_tokens > 0) {
+            gdouble rate = record->completion_tokens * 1000.0 / (record->total_ms - record->ttfb_ms);
+            g_array_append_val(group->tokens_per_s, rate);
+        }
+    }
+}
+
+static void print_group(const Group *group, gint name_width) {
+    g_array_sort(group->ttfb_ms, compare_doubles);
+    g_array_sort(group->total_ms, compare_doubles);
+    g_array_sort(group->tokens_per_s, compare_doubles);
+
+    printf("%-*s %6u %5.1f%% %6u %7.0f %7.0f %7.0f %7.0f %7.0f %7.0f %7.1f %9.1f\n",
+           name_width, group->name, group->count,
+           100.0 * group->errors / group->count, group->stale,
+           percentile(group->ttfb_ms, 50), percentile(group->ttfb_ms, 90), percentile(group->ttfb_ms, 99),
+           percentile(group->total_ms, 50), percentile(group->total_ms, 90), percentile(group->total_ms, 99),
+           percentile(group->tokens_per_s, 50),
+           group->bytes / 1024.0);
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("[LOG]");
+    g_option_context_set_summary(context,
+        "Report request latencies from the LLM Assistant performance log.\n"
+        "LOG defaults to ~/.cache/evolution-llm-assistant/perf.log. Times are in\n"
+        "milliseconds; tok/s is the median generation speed after the first byte.");
+    g_option_context_add_main_entries(context, entries, NULL);
+
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    GArray *keys = g_array_new(FALSE, FALSE, sizeof(GroupKey));
+    if (!parse_keys(opt_by ? opt_by : "model", keys)) {
+        g_array_unref(keys);
+        return 2;
+    }
+
+    gchar *path = argc > 1 ? g_strdup(argv[1]) : llm_perflog_get_path();
+    GArray *records = llm_perflog_read(path, &error);
+    if (!records) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_free(path);
+        g_array_unref(keys);
+        return 1;
+    }
+
+    gint64 since_us = opt_since_hours > 0
+        ? g_get_real_time() - (gint64)opt_since_hours * 3600 * G_USEC_PER_SEC : G_MININT64;
+
+    GHashTable *groups = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)group_free);
+    gint name_width = 5;
+    guint matched = 0;
+
+    for (guint i = 0; i < records->len; i++) {
+        const LLMPerfRecord *record = &g_array_index(records, LLMPerfRecord, i);
+        if (!record_matches(record, since_us)) continue;
+
+        gchar *name = make_group_name(record, keys);
+        Group *group = g_hash_table_lookup(groups, name);
+
+        if (!group) {
+            group = g_new0(Group, 1);
+            group->name = name;
+            group->first_us = record->start_us;
+            group->ttfb_ms = g_array_new(FALSE, FALSE, sizeof(gdouble));
+            group->total_ms = g_array_new(FALSE, FALSE, sizeof(gdouble));
+            group->tokens_per_s = g_array_new(FALSE, FALSE, sizeof(gdouble));
+            g_hash_table_insert(groups, group->name, group);
+            name_width = MAX(name_width, (gint)g_utf8_strlen(name, -1));
+        } else {
+            g_free(name);
+        }
+
+        add_record(group, record);
+        matched++;
+    }
+
+    if (matched == 0) {
+        printf("No matching requests in %s (%u records)\n", path, records->len);
+    } else {
+        GPtrArray *sorted = g_ptr_array_new();
+        GList *values = g_hash_table_get_values(groups);
+        for (GList *l = values; l != NULL; l = l->next) {
+            g_ptr_array_add(sorted, l->data);
+        }
+        g_list_free(values);
+        g_ptr_array_sort(sorted, compare_groups);
+
+        printf("%-*s %6s %6s %6s %7s %7s %7s %7s %7s %7s %7s %9s\n",
+               name_width, "group", "n", "err", "stale",
+               "ttfb50", "ttfb90", "ttfb99", "tot50", "tot90", "tot99", "tok/s", "KiB");
+        for (guint i = 0; i < sorted->len; i++) {
+            print_group(g_ptr_array_index(sorted, i), name_width);
+        }
+
+        printf("\n%u of %u requests in %s\n", matched, records->len, path);
+        g_ptr_array_unref(sorted);
+    }
+
+    g_hash_table_unref(groups);
+    g_array_unref(records);
+    g_array_unref(keys);
+    g_free(path);
+    return 0;
+}
@@ -0,0 +1,332 @@
+/*
+ * Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+ *
+ * Copyright (c) 2025 rf@remotedots.com
+ *
+ * This file is part of Evolution LLM Assistant.
+ *
+ * Evolution LLM Assistant is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License as published in the LICENSE file.
+ *
+ * Local stand-in for a model endpoint that replays a cassette recorded with
+ * LLM_ASSISTANT_CASSETTE. Every recorded chunk is sent as its own HTTP
+ * chunk at its recorded time, so streaming responses arrive with the same
+ * fragmentation, first-byte delay and slow tail as in production.
+ *
+ *   llm-replay-server --port=8089 --speed=1 session.cassette
+ *
+ * Add http://127.0.0.1:8089/v1 to [models] endpoints to send the recorded
+ * models' requests to it; configured endpoints take precedence over OpenAI
+ * for the models they list, so this works with a valid API key too.
+ */
+
+#include "../src/llm_cassette.h"
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_HEADER_LINES 100
+
+typedef struct {
+    GPtrArray *exchanges;   /* LLMCassetteExchange */
+    GHashTable *by_request; /* request body -> GPtrArray of exchanges with that body */
+    GHashTable *by_model;   /* model -> GPtrArray of exchanges for that model */
+    GHashTable *next;       /* GPtrArray -> next index, so repeated requests cycle */
+    GMutex mutex;
+} Replay;
+
+static gint opt_port = 8089;
+static gdouble opt_speed = 1.0;
+static gboolean opt_verbose = FALSE;
+
+static GOptionEntry entries[] = {
+    { "port", 'p', 0, G_OPTION_ARG_INT, &opt_port, "Port to listen on (default: 8089)", "PORT" },
+    { "speed", 's', 0, G_OPTION_ARG_DOUBLE, &opt_speed,
+      "Playback speed; 2 is twice as fast, 0 sends everything at once (default: 1)", "FACTOR" },
+    { "verbose", 'v', 0, G_OPTION_ARG_NONE, &opt_verbose, "Print every request", NULL },
+    { NULL }
+};
+
+static void index_exchange(GHashTable *index, const gchar *key, LLMCassetteExchange *exchange) {
+    GPtrArray *list = g_hash_table_lookup(index, key);
+    if (!list) {
+        list = g_ptr_array_new();
+        g_hash_table_insert(index, (gpointer)key, list);
+    }
+    g_ptr_array_add(list, exchange);
+}
+
+static Replay* replay_new(GPtrArray *exchanges) {
+    Replay *replay = g_new0(Replay, 1);
+    replay->exchanges = exchanges;
+    replay->by_request = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)g_ptr_array_unref);
+    replay->by_model = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)g_ptr_array_unref);
+    replay->next = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_mutex_init(&replay->mutex);
+
+    for (guint i = 0; i < exchanges->len; i++) {
+        LLMCassetteExchange *exchange = g_ptr_array_index(exchanges, i);
+        index_exchange(replay->by_request, exchange->request_body, exchange);
+        index_exchange(replay->by_model, exchange->model, exchange);
+    }
+
+    return replay;
+}
+
+static LLMCassetteExchange* take_next(Replay *replay, GPtrArray *list) {
+    guint index = GPOINTER_TO_UINT(g_hash_table_lookup(replay->next, list));
+    g_hash_table_insert(replay->next, list, GUINT_TO_POINTER((index + 1) % list->len));
+    return g_ptr_array_index(list, index);
+}
+
+/* The same request body replays its own answer; otherwise the model's
+ * recorded answers are handed out in turn, and failing that any answer */
+static LLMCassetteExchange* replay_find(Replay *replay, const gchar *body) {
+    LLMCassetteExchange *exchange = NULL;
+
+    g_mutex_lock(&replay->mutex);
+
+    GPtrArray *list = g_hash_table_lookup(replay->by_request, body);
+    if (!list) {
+        gchar *model = NULL;
+        JsonParser *parser = json_parser_new();
+        if (json_parser_load_from_data(parser, body, -1, NULL) &&
+            JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser))) {
+            model = g_strdup(json_object_get_string_member_with_default(
+                json_node_get_object(json_parser_get_root(parser)), "model", NULL));
+        }
+        g_object_unref(parser);
+
+        list = model ? g_hash_table_lookup(replay->by_model, model) : NULL;
+        g_free(model);
+    }
+
+    if (list) {
+        exchange = take_next(replay, list);
+    } else if (replay->exchanges->len > 0) {
+        exchange = take_next(replay, replay->exchanges);
+    }
+
+    g_mutex_unlock(&replay->mutex);
+    return exchange;
+}
+
+static gboolean write_all(GOutputStream *out, const void *data, gsize length) {
+    return g_output_stream_write_all(out, data, length, NULL, NULL, NULL);
+}
+
+static gboolean write_chunk(GOutputStream *out, const void *data, gsize length) {
+    gchar *size_line = g_strdup_printf("%" G_GSIZE_MODIFIER "x\r\n", length);
+    gboolean ok = write_all(out, size_line, strlen(size_line)) &&
+                  write_all(out, data, length) &&
+                  write_all(out, "\r\n", 2) &&
+                  g_output_stream_flush(out, NULL, NULL);
+    g_free(size_line);
+    return ok;
+}
+
+static gboolean send_simple(GOutputStream *out, guint status, const gchar *reason,
+                            const gchar *content_type, const gchar *body) {
+    gchar *head = g_strdup_printf("HTTP/1.1 %u %s\r\n"
+                                  "Content-Type: %s\r\n"
+                                  "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+                                  "\r\n",
+                                  status, reason, content_type, strlen(body));
+    gboolean ok = write_all(out, head, strlen(head)) && write_all(out, body, strlen(body));
+    g_free(head);
+    return ok;
+}
+
+static gboolean send_models(Replay *replay, GOutputStream *out) {
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "object");
+    json_builder_add_string_value(builder, "list");
+    json_builder_set_member_name(builder, "data");
+    json_builder_begin_array(builder);
+
+    GHashTableIter iter;
+    gpointer model;
+    g_hash_table_iter_init(&iter, replay->by_model);
+    while (g_hash_table_iter_next(&iter, &model, NULL)) {
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "id");
+        json_builder_add_string_value(builder, model);
+        json_builder_set_member_name(builder, "object");
+        json_builder_add_string_value(builder, "model");
+        json_builder_set_member_name(builder, "owned_by");
+        json_builder_add_string_value(builder, "cassette");
+        json_builder_end_object(builder);
+    }
+
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    gchar *body = json_generator_to_data(generator, NULL);
+
+    gboolean ok = send_simple(out, 200, "OK", "application/json", body);
+
+    g_free(body);
+    json_node_free(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+    return ok;
+}
+
+/* Send the recorded chunks at their recorded offsets, scaled by --speed */
+static gboolean send_exchange(LLMCassetteExchange *exchange, GOutputStream *out) {
+    gchar *head = g_strdup_printf("HTTP/1.1 %u %s\r\n"
+                                  "Content-Type: %s\r\n"
+                                  "Transfer-Encoding: chunked\r\n"
+                                  "\r\n",
+                                  exchange->status, exchange->status < 400 ? "OK" : "Error",
+                                  *exchange->content_type ? exchange->content_type : "application/json");
+    gboolean ok = write_all(out, head, strlen(head)) && g_output_stream_flush(out, NULL, NULL);
+    g_free(head);
+
+    gint64 start_time = g_get_monotonic_time();
+    for (guint i = 0; ok && i < exchange->chunks->len; i++) {
+        LLMCassetteChunk *chunk = g_ptr_array_index(exchange->chunks, i);
+
+        if (opt_speed > 0) {
+            gint64 due = start_time + (gint64)(chunk->offset_us / opt_speed);
+            gint64 now = g_get_monotonic_time();
+            if (due > now) g_usleep(due - now);
+        }
+
+        gsize length = 0;
+        const void *data = g_bytes_get_data(chunk->data, &length);
+        ok = write_chunk(out, data, length);
+    }
+
+    return ok && write_all(out, "0\r\n\r\n", 5) && g_output_stream_flush(out, NULL, NULL);
+}
+
+/* Serve requests on one keep-alive connection; runs in a service thread */
+static gboolean on_run(GThreadedSocketService *service G_GNUC_UNUSED,
+                       GSocketConnection *connection,
+                       GObject *source_object G_GNUC_UNUSED,
+                       gpointer user_data) {
+    Replay *replay = user_data;
+    GSocket *socket = g_socket_connection_get_socket(connection);
+    GDataInputStream *in = g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+    GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+
+    /* Chunks must leave one by one to keep their fragmentation */
+    g_socket_set_option(socket, IPPROTO_TCP, TCP_NODELAY, 1, NULL);
+    g_data_input_stream_set_newline_type(in, G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+
+    for (gboolean keep_alive = TRUE; keep_alive;) {
+        gchar *request_line = g_data_input_stream_read_line(in, NULL, NULL, NULL);
+        if (!request_line) break;
+
+        gsize content_length = 0;
+        for (guint i = 0; i < MAX_HEADER_LINES; i++) {
+            gchar *header = g_data_input_stream_read_line(in, NULL, NULL, NULL);
+            if (!header || !*header) {
+                g_free(header);
+                break;
+            }
+            if (g_ascii_strncasecmp(header, "Content-Length:", 15) == 0) {
+                content_length = g_ascii_strtoull(header + 15, NULL, 10);
+            } else if (g_ascii_strncasecmp(header, "Connection:", 11) == 0 && strstr(header, "close")) {
+                keep_alive = FALSE;
+            } else if (g_ascii_strncasecmp(header, "Expect:", 7) == 0 && strstr(header, "100-continue")) {
+                /* curl waits for this before sending a large body */
+                write_all(out, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+            }
+            g_free(header);
+        }
+
+        gchar *body = g_malloc0(content_length + 1);
+        gsize read = 0;
+        if (content_length > 0 &&
+            !g_input_stream_read_all(G_INPUT_STREAM(in), body, content_length, &read, NULL, NULL)) {
+            keep_alive = FALSE;
+        }
+
+        gchar **parts = g_strsplit(request_line, " ", 3);
+        const gchar *method = parts[0];
+        const gchar *path = parts[0] ? parts[1] : NULL;
+        gboolean ok = FALSE;
+
+        if (opt_verbose) g_print("%s\n", request_line);
+
+        if (g_strcmp0(method, "GET") == 0 && path && g_str_has_suffix(path, "/models")) {
+            ok = send_models(replay, out);
+        } else if (g_strcmp0(method, "POST") == 0) {
+            LLMCassetteExchange *exchange = replay_find(replay, body);
+            ok = exchange ? send_exchange(exchange, out)
+                          : send_simple(out, 404, "Not Found", "application/json",
+                                        "{\"error\":{\"message\":\"cassette is empty\"}}");
+        } else {
+            ok = send_simple(out, 404, "Not Found", "application/json",
+                             "{\"error\":{\"message\":\"not recorded\"}}");
+        }
+
+        keep_alive = keep_alive && ok;
+
+        g_strfreev(parts);
+        g_free(body);
+        g_free(request_line);
+    }
+
+    g_object_unref(in);
+    return TRUE;
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("CASSETTE");
+    g_option_context_set_summary(context,
+        "Replay exchanges recorded with LLM_ASSISTANT_CASSETTE=FILE as a local\n"
+        "OpenAI-compatible endpoint, with the original chunking and timing.");
+    g_option_context_add_main_entries(context, entries, NULL);
+
+    if (!g_option_context_parse(context, &argc, &argv, &error) || argc != 2) {
+        fprintf(stderr, "%s\n", error ? error->message : "Usage: llm-replay-server [OPTION...] CASSETTE");
+        g_clear_error(&error);
+        g_option_context_free(context);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    GPtrArray *exchanges = llm_cassette_load(argv[1], &error);
+    if (!exchanges) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    Replay *replay = replay_new(exchanges);
+    GSocketService *service = g_threaded_socket_service_new(-1);
+
+    /* Loopback only; the cassette holds real prompts */
+    GSocketAddress *address = g_inet_socket_address_new_from_string("127.0.0.1", opt_port);
+    gboolean listening = g_socket_listener_add_address(G_SOCKET_LISTENER(service), address,
+                                                       G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP,
+                                                       NULL, NULL, &error);
+    g_object_unref(address);
+
+    if (!listening) {
+        fprintf(stderr, "Cannot listen on port %d: %s\n", opt_port, error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    g_signal_connect(service, "run", G_CALLBACK(on_run), replay);
+    g_socket_service_start(service);
+
+    g_print("Replaying %u exchanges for %u models on http://127.0.0.1:%d/v1\n",
+            exchanges->len, g_hash_table_size(replay->by_model), opt_port);
+
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    g_main_loop_run(loop);
+    return 0;
+}
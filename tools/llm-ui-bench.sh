@@ -0,0 +1,156 @@
+#!/bin/sh
+#
+# Evolution LLM Assistant - AI-powered email generation for GNOME Evolution
+#
+# Copyright (c) 2025 rf@remotedots.com
+#
+# This file is part of Evolution LLM Assistant.
+#
+# Evolution LLM Assistant is free software: you can redistribute it and/or modify
+# it under the terms of the MIT License as published in the LICENSE file.
+#
+# Composer benchmark under Xvfb. Starts llm-replay-server on a cassette and
+# Evolution with the freshly built module in a throw-away profile, opens a
+# composer and lets the module press its hotkey RUNS times on a selected
+# text. Prints how long after the hotkey the web view was found, the
+# selection came back, the request was sent, and the first and the whole
+# answer were in the document. Then opens and closes OPENS composers and
+# prints how long the module held up each of them.
+#
+#   make && make tools
+#   tools/llm-ui-bench.sh ~/session.cassette gpt-4o-mini
+#
+# Environment: RUNS (default 20), OPENS (50), PORT (8089), SPEED (replay speed, 1),
+# TEXT (file with the text to select), TIMEOUT (seconds, 600), KEEP=1 to
+# keep the profile directory.
+
+set -eu
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 CASSETTE MODEL" >&2
+    exit 2
+fi
+
+CASSETTE=$1
+MODEL=$2
+RUNS=${RUNS:-20}
+PORT=${PORT:-8089}
+SPEED=${SPEED:-1}
+TIMEOUT=${TIMEOUT:-600}
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+
+for tool in Xvfb dbus-run-session evolution; do
+    command -v $tool >/dev/null || { echo "$tool is not installed" >&2; exit 1; }
+done
+[ -f "$TOP/module-llm-assistant.so" ] || { echo "Run make first" >&2; exit 1; }
+[ -x "$TOP/tools/llm-replay-server" ] || { echo "Run make tools first" >&2; exit 1; }
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/llm-ui-bench.XXXXXX")
+PIDS=""
+
+cleanup() {
+    for pid in $PIDS; do kill $pid 2>/dev/null || true; done
+    wait 2>/dev/null || true
+    if [ "${KEEP:-0}" = 1 ]; then echo "Profile kept in $WORK"; else rm -rf "$WORK"; fi
+}
+trap cleanup EXIT INT TERM
+
+# A profile of its own: the module, a send-less account so Evolution skips
+# its first-run assistant, and a configuration pointing at the replay server
+export XDG_CONFIG_HOME="$WORK/config" XDG_DATA_HOME="$WORK/data" XDG_CACHE_HOME="$WORK/cache"
+mkdir -p "$XDG_DATA_HOME/evolution/modules" "$XDG_CONFIG_HOME/evolution/sources" \
+         "$XDG_CONFIG_HOME/evolution-llm-assistant" "$XDG_CACHE_HOME"
+cp "$TOP/module-llm-assistant.so" "$XDG_DATA_HOME/evolution/modules/"
+
+cat > "$XDG_CONFIG_HOME/evolution/sources/bench-account.source" <<EOF
+[Data Source]
+DisplayName=Benchmark
+Enabled=true
+Parent=
+
+[Mail Account]
+BackendName=none
+IdentityUid=bench-identity
+NeedsInitialSetup=false
+EOF
+
+cat > "$XDG_CONFIG_HOME/evolution/sources/bench-identity.source" <<EOF
+[Data Source]
+DisplayName=Benchmark
+Enabled=true
+Parent=bench-account
+
+[Mail Identity]
+Address=bench@example.com
+Name=Benchmark
+
+[Mail Submission]
+TransportUid=bench-transport
+EOF
+
+cat > "$XDG_CONFIG_HOME/evolution/sources/bench-transport.source" <<EOF
+[Data Source]
+DisplayName=Benchmark
+Enabled=true
+Parent=bench-account
+
+[Mail Transport]
+BackendName=none
+EOF
+
+# Only the hotkey path itself; features that ask or look up first are off
+cat > "$XDG_CONFIG_HOME/evolution-llm-assistant/config.conf" <<EOF
+[openai]
+api_key=not-sent-to-local-endpoints
+model=$MODEL
+stream=true
+
+[cache]
+stale_while_revalidate=false
+
+[models]
+endpoints=http://127.0.0.1:$PORT/v1;
+
+[triage]
+enabled=false
+
+[boilerplate]
+enabled=false
+
+[attachments]
+enabled=false
+
+[smart_reply]
+enabled=false
+EOF
+
+"$TOP/tools/llm-replay-server" --port="$PORT" --speed="$SPEED" "$CASSETTE" > "$WORK/replay.log" 2>&1 &
+PIDS="$PIDS $!"
+
+DISPLAY_NUMBER=99
+while [ -e /tmp/.X$DISPLAY_NUMBER-lock ]; do DISPLAY_NUMBER=$((DISPLAY_NUMBER + 1)); done
+Xvfb :$DISPLAY_NUMBER -screen 0 1280x1024x24 -nolisten tcp > "$WORK/xvfb.log" 2>&1 &
+PIDS="$PIDS $!"
+export DISPLAY=:$DISPLAY_NUMBER
+
+export LLM_ASSISTANT_BENCH=$RUNS
+export LLM_ASSISTANT_BENCH_OPENS=${OPENS:-50}
+export LLM_ASSISTANT_BENCH_OUTPUT="$WORK/report.txt"
+if [ -n "${TEXT:-}" ]; then export LLM_ASSISTANT_BENCH_TEXT="$TEXT"; fi
+
+sleep 1
+dbus-run-session -- evolution "mailto:someone@example.com?subject=Benchmark" > "$WORK/evolution.log" 2>&1 &
+PIDS="$PIDS $!"
+
+elapsed=0
+while [ ! -s "$WORK/report.txt" ]; do
+    if [ $elapsed -ge "$TIMEOUT" ]; then
+        echo "No report after $TIMEOUT s; see $WORK/evolution.log" >&2
+        KEEP=1
+        exit 1
+    fi
+    sleep 1
+    elapsed=$((elapsed + 1))
+done
+
+cat "$WORK/report.txt"